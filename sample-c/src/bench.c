@@ -0,0 +1,895 @@
+#include "r3e.h"
+#include "platform.h"
+#include "gaps.h"
+#include "history.h"
+#include "metrics.h"
+#include "recorder.h"
+#include "replay.h"
+#include "resample.h"
+#include "ring.h"
+#include "snapshot.h"
+#include "soa.h"
+#include "synth.h"
+#include "thermal.h"
+#include "tickwait.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAMES_DEFAULT 800
+#define SEED_DEFAULT 1
+#define CONTENTION_MS_DEFAULT 1000
+
+// Copies are timed in batches, a single one is close to the clock's resolution
+#define COPY_BATCH 64
+#define COPY_SAMPLES 2000
+
+// Consumers reading every frame of the ring, each through its own cursor
+#define RING_CONSUMERS 3
+
+#define SCAN_ITERATIONS 20000
+#define SEEKS 2000
+
+// A minute of ticks through the resampler
+#define RESAMPLE_TICKS (60 * TICK_RATE_HZ)
+
+// A minute of ticks through the tire and brake analysis
+#define THERMAL_TICKS (60 * TICK_RATE_HZ)
+
+// A minute of ticks through the gap engine, and pit rejoin queries timed after it
+#define GAPS_TICKS (60 * TICK_RATE_HZ)
+#define GAPS_QUERIES 20000
+#define GAPS_PIT_LOSS 25.0
+
+// A minute of ticks through the lap history, every car completing a lap each
+// time the input loops, and the class pace queries timed after it
+#define HISTORY_TICKS (60 * TICK_RATE_HZ)
+#define HISTORY_QUERIES 20000
+#define HISTORY_PACE_LAPS 5
+
+typedef struct
+{
+    double mean;
+    double min;
+    double p50;
+    double p99;
+    double max;
+} sample_stats;
+
+typedef struct
+{
+    const r3e_shared* frames;
+    int num_frames;
+    r3e_shared* target;
+    volatile BOOL stop;
+    uint64_t written;
+} writer_context;
+
+typedef struct
+{
+    ring_cursor cursor;
+    r3e_shared* frame;
+    volatile BOOL* stop;
+    platform_thread thread;
+} consumer_context;
+
+typedef struct
+{
+    sample_stats copy_ns;
+
+    uint32_t contention_ms;
+    uint64_t contended_reads;
+    uint64_t torn_reads;
+    uint64_t failed_reads;
+    uint64_t writer_frames;
+
+    uint64_t ring_frames;
+    double ring_write_ns;
+    uint64_t ring_reads;
+    uint64_t ring_overruns;
+    uint64_t ring_frames_lost;
+
+    double aos_scan_ns;
+    double soa_transpose_ns;
+    double soa_scan_ns;
+
+    int resample_channels;
+    double resample_ns;
+
+    double thermal_ns;
+
+    double gaps_ns;
+    double gaps_rejoin_ns;
+
+    uint64_t history_laps;
+    double history_ns;
+    double history_query_ns;
+
+    uint64_t recorder_bytes_in;
+    uint64_t recorder_bytes_out;
+    uint64_t recorder_keyframes;
+    double recorder_us;
+
+    uint32_t seek_keyframes;
+    sample_stats seek_us;
+} bench_results;
+
+static void usage()
+{
+    wprintf_s(L"Usage: bench [-synthetic | -replay file] [-cars n] [-seed n] [-frames n] [-contention ms] [-out file] [-json file]\n");
+    wprintf_s(L"  -synthetic   generate the input frames from the synthetic race (default)\n");
+    wprintf_s(L"  -replay      read the input frames from a recording instead\n");
+    wprintf_s(L"  -cars        cars in the synthetic race, 1 - %d (default %d)\n", R3E_NUM_DRIVERS_MAX, R3E_NUM_DRIVERS_MAX);
+    wprintf_s(L"  -seed        synthetic race seed (default %d)\n", SEED_DEFAULT);
+    wprintf_s(L"  -frames      input frames, one per tick (default %d)\n", FRAMES_DEFAULT);
+    wprintf_s(L"  -contention  how long the torn read test runs, in ms (default %d)\n", CONTENTION_MS_DEFAULT);
+    wprintf_s(L"  -out         recording written by the recorder test (default bench.r3er)\n");
+    wprintf_s(L"  -json        results file (default bench.json)\n");
+}
+
+static int compare_doubles(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+// Sorts samples in place
+static void compute_stats(double* samples, int count, sample_stats* stats)
+{
+    double sum = 0.0;
+    int i;
+
+    memset(stats, 0, sizeof(*stats));
+    if (count == 0)
+        return;
+
+    qsort(samples, count, sizeof(double), compare_doubles);
+
+    for (i = 0; i < count; ++i)
+        sum += samples[i];
+
+    stats->mean = sum / count;
+    stats->min = samples[0];
+    stats->p50 = samples[count / 2];
+    stats->p99 = samples[count * 99 / 100];
+    stats->max = samples[count - 1];
+}
+
+static r3e_shared* load_synthetic(int cars, uint32_t seed, int count)
+{
+    static synth_state race;
+    r3e_shared* frames;
+    int i;
+
+    frames = (r3e_shared*)calloc(count, sizeof(r3e_shared));
+    if (frames == NULL)
+        return NULL;
+
+    synth_init(&race, cars, seed);
+
+    for (i = 0; i < count; ++i)
+    {
+        synth_step(&race);
+        synth_write(&race, &frames[i]);
+    }
+
+    return frames;
+}
+
+// Returns the frames decoded, at most count
+static r3e_shared* load_recording(const char* path, int* count)
+{
+    static replay rep;
+    r3e_shared* frames;
+    int i;
+
+    if (replay_open(&rep, path))
+        return NULL;
+
+    frames = (r3e_shared*)calloc(*count, sizeof(r3e_shared));
+
+    for (i = 0; frames != NULL && i < *count && replay_next(&rep) == 0; ++i)
+        memcpy(&frames[i], replay_frame(&rep), sizeof(r3e_shared));
+
+    *count = i;
+    replay_close(&rep);
+
+    if (i == 0)
+    {
+        free(frames);
+        return NULL;
+    }
+
+    return frames;
+}
+
+static void bench_copy(const r3e_shared* frames, int count, bench_results* results)
+{
+    static r3e_shared dest;
+    snapshot_reader reader;
+    double* samples;
+    uint64_t start_us;
+    int s, b;
+
+    samples = (double*)malloc(COPY_SAMPLES * sizeof(double));
+    if (samples == NULL)
+        return;
+
+    for (s = 0; s < COPY_SAMPLES; ++s)
+    {
+        snapshot_init(&reader, &frames[s % count], SNAPSHOT_RETRIES_DEFAULT);
+
+        start_us = time_now_us();
+        for (b = 0; b < COPY_BATCH; ++b)
+            snapshot_read(&reader, &dest);
+
+        samples[s] = (time_now_us() - start_us) * 1000.0 / COPY_BATCH;
+    }
+
+    compute_stats(samples, COPY_SAMPLES, &results->copy_ns);
+    free(samples);
+}
+
+// Plays the frames into the target over and over, as fast as it can
+static void writer_main(void* arg)
+{
+    writer_context* writer = (writer_context*)arg;
+    int i = 0;
+
+    while (!writer->stop)
+    {
+        memcpy(writer->target, &writer->frames[i], sizeof(r3e_shared));
+        platform_barrier();
+
+        writer->written++;
+        i = (i + 1) % writer->num_frames;
+    }
+}
+
+// Reads a frame that a second thread keeps rewriting. The writer publishes far
+// faster than the game does, so this is the worst case for torn reads.
+static int bench_contention(const r3e_shared* frames, int count, uint32_t duration_ms, bench_results* results)
+{
+    static r3e_shared dest;
+    writer_context writer;
+    platform_thread thread;
+    snapshot_reader reader;
+    uint64_t end_us;
+
+    memset(&writer, 0, sizeof(writer));
+    writer.frames = frames;
+    writer.num_frames = count;
+    writer.target = (r3e_shared*)aligned_malloc(sizeof(r3e_shared), CACHE_LINE_SIZE);
+
+    if (writer.target == NULL)
+        return 1;
+
+    memcpy(writer.target, &frames[0], sizeof(r3e_shared));
+    snapshot_init(&reader, writer.target, SNAPSHOT_RETRIES_DEFAULT);
+
+    if (thread_start(&thread, writer_main, &writer))
+    {
+        aligned_free(writer.target);
+        return 1;
+    }
+
+    end_us = time_now_us() + duration_ms * 1000ull;
+
+    while (time_now_us() < end_us)
+        snapshot_read(&reader, &dest);
+
+    writer.stop = TRUE;
+    thread_join(&thread);
+
+    results->contention_ms = duration_ms;
+    results->contended_reads = reader.reads;
+    results->torn_reads = reader.torn_reads;
+    results->failed_reads = reader.failed_reads;
+    results->writer_frames = writer.written;
+
+    aligned_free(writer.target);
+
+    return 0;
+}
+
+// Time each car is behind car ref, straight from all_drivers_data_1, the same result as soa_gaps
+static void consumer_main(void* arg)
+{
+    consumer_context* consumer = (consumer_context*)arg;
+
+    while (!*consumer->stop)
+    {
+        if (ring_read(&consumer->cursor, consumer->frame) == RING_READ_EMPTY)
+            sleep_ms(0);
+    }
+}
+
+// Fans the frames out through a ring to RING_CONSUMERS threads. Like the torn
+// read test the writer publishes as fast as it can, so consumers get lapped;
+// their overruns and frames lost are counted through the metrics registry.
+static int bench_ring(const r3e_shared* frames, int count, uint32_t duration_ms, bench_results* results)
+{
+    static ring r;
+    static consumer_context consumers[RING_CONSUMERS];
+    metrics_registry registry;
+    volatile BOOL stop = FALSE;
+    char name[METRICS_NAME_MAX];
+    uint64_t start_us, end_us;
+    int overruns_id, frames_lost_id, started, c;
+
+    if (ring_init(&r, RING_CAPACITY_DEFAULT))
+        return 1;
+
+    metrics_init(&registry, TRUE);
+    overruns_id = metrics_register_counter(&registry, "ring_overruns");
+    frames_lost_id = metrics_register_counter(&registry, "ring_frames_lost");
+
+    for (started = 0; started < RING_CONSUMERS; ++started)
+    {
+        consumers[started].frame = (r3e_shared*)aligned_malloc(sizeof(r3e_shared), CACHE_LINE_SIZE);
+        if (consumers[started].frame == NULL)
+            break;
+
+        snprintf(name, sizeof(name), "consumer_%d", started + 1);
+        ring_cursor_init(&consumers[started].cursor, &r);
+        ring_cursor_instrument(&consumers[started].cursor, metrics_shard_open(&registry, name), overruns_id, frames_lost_id);
+        consumers[started].stop = &stop;
+
+        if (thread_start(&consumers[started].thread, consumer_main, &consumers[started]))
+        {
+            aligned_free(consumers[started].frame);
+            break;
+        }
+    }
+
+    results->ring_frames = 0;
+
+    if (started == RING_CONSUMERS)
+    {
+        start_us = time_now_us();
+        end_us = start_us + duration_ms * 1000ull;
+
+        while (time_now_us() < end_us)
+        {
+            ring_write(&r, &frames[results->ring_frames % count]);
+            results->ring_frames++;
+        }
+
+        results->ring_write_ns = (time_now_us() - start_us) * 1000.0 / results->ring_frames;
+    }
+
+    stop = TRUE;
+
+    results->ring_reads = 0;
+    for (c = 0; c < started; ++c)
+    {
+        thread_join(&consumers[c].thread);
+        results->ring_reads += consumers[c].cursor.reads;
+        aligned_free(consumers[c].frame);
+    }
+
+    results->ring_overruns = metrics_counter_value(&registry, overruns_id);
+    results->ring_frames_lost = metrics_counter_value(&registry, frames_lost_id);
+
+    metrics_close(&registry);
+    ring_close(&r);
+
+    return started == RING_CONSUMERS ? 0 : 1;
+}
+
+static void aos_gaps(const r3e_shared* frame, int ref, float* out)
+{
+    const r3e_driver_data* drivers = frame->all_drivers_data_1;
+    float ref_distance = drivers[ref].completed_laps * frame->layout_length + drivers[ref].lap_distance;
+    float speed;
+    int i;
+
+    for (i = 0; i < frame->num_cars; ++i)
+    {
+        speed = drivers[i].car_speed > SOA_MIN_SPEED ? drivers[i].car_speed : SOA_MIN_SPEED;
+        out[i] = (ref_distance - (drivers[i].completed_laps * frame->layout_length + drivers[i].lap_distance)) / speed;
+    }
+}
+
+// Every iteration scans a different frame, the way a consumer sees a new one each tick
+static int bench_scan(const r3e_shared* frames, int count, bench_results* results)
+{
+    soa_drivers* columns;
+    ALIGNED(32) float out[SOA_CAPACITY];
+    volatile float sink = 0.f;
+    uint64_t start_us;
+    int i, cars;
+
+    columns = (soa_drivers*)aligned_malloc(count * sizeof(soa_drivers), 32);
+    if (columns == NULL)
+        return 1;
+
+    start_us = time_now_us();
+    for (i = 0; i < count; ++i)
+        soa_transpose(&columns[i], &frames[i]);
+    results->soa_transpose_ns = (time_now_us() - start_us) * 1000.0 / count;
+
+    start_us = time_now_us();
+    for (i = 0; i < SCAN_ITERATIONS; ++i)
+    {
+        cars = frames[i % count].num_cars;
+        aos_gaps(&frames[i % count], cars > 0 ? i % cars : 0, out);
+        sink += out[0];
+    }
+    results->aos_scan_ns = (time_now_us() - start_us) * 1000.0 / SCAN_ITERATIONS;
+
+    start_us = time_now_us();
+    for (i = 0; i < SCAN_ITERATIONS; ++i)
+    {
+        cars = columns[i % count].count;
+        soa_gaps(&columns[i % count], cars > 0 ? i % cars : 0, out);
+        sink += out[0];
+    }
+    results->soa_scan_ns = (time_now_us() - start_us) * 1000.0 / SCAN_ITERATIONS;
+
+    aligned_free(columns);
+    (void)sink;
+
+    return 0;
+}
+
+// Physics at the tick rate, a display rate and a logging rate, fed from one stream
+static int bench_resample(const r3e_shared* frames, int count, bench_results* results)
+{
+    static resampler sampler;
+    static r3e_shared frame;
+    uint64_t start_us;
+    int i;
+
+    resample_init(&sampler, TICK_RATE_HZ);
+    resample_add_field(&sampler, "player.local_g_force", FALSE);
+    resample_add_field(&sampler, "player.local_acceleration", FALSE);
+    resample_add_field(&sampler, "player.local_angular_velocity", FALSE);
+    resample_add_field(&sampler, "player.suspension_velocity", FALSE);
+    resample_add_field(&sampler, "car_speed", FALSE);
+    resample_add_field(&sampler, "engine_rps", FALSE);
+    resample_add_field(&sampler, "gear", FALSE);
+    resample_add_output(&sampler, TICK_RATE_HZ);
+    resample_add_output(&sampler, 60);
+    resample_add_output(&sampler, 1);
+
+    if (resample_start(&sampler))
+    {
+        resample_close(&sampler);
+        return 1;
+    }
+
+    // Only the player block changes, ticks keep counting up as the input loops
+    memcpy(&frame, &frames[0], sizeof(r3e_shared));
+
+    start_us = time_now_us();
+    for (i = 0; i < RESAMPLE_TICKS; ++i)
+    {
+        frame.player = frames[i % count].player;
+        frame.player.game_simulation_ticks = i + 1;
+        resample_push(&sampler, &frame);
+    }
+    results->resample_ns = (time_now_us() - start_us) * 1000.0 / RESAMPLE_TICKS;
+    results->resample_channels = sampler.num_channels;
+
+    resample_close(&sampler);
+
+    return 0;
+}
+
+// Every tire zone, brake, pressure and load of the player's car per tick
+static void bench_thermal(const r3e_shared* frames, int count, bench_results* results)
+{
+    static thermal th;
+    uint64_t start_us;
+    int i;
+
+    thermal_init(&th);
+
+    start_us = time_now_us();
+    for (i = 0; i < THERMAL_TICKS; ++i)
+        thermal_update(&th, &frames[i % count]);
+    results->thermal_ns = (time_now_us() - start_us) * 1000.0 / THERMAL_TICKS;
+}
+
+static int bench_recorder(const r3e_shared* frames, int count, const char* path, bench_results* results)
+{
+    static recorder rec;
+    uint64_t start_us;
+    int i;
+
+    if (recorder_open(&rec, path, RECORDER_KEYFRAME_INTERVAL_DEFAULT))
+        return 1;
+
+    start_us = time_now_us();
+
+    for (i = 0; i < count; ++i)
+    {
+        if (recorder_write(&rec, &frames[i]))
+        {
+            recorder_close(&rec);
+            return 1;
+        }
+    }
+
+    fflush(rec.file);
+    results->recorder_us = (double)(time_now_us() - start_us);
+    results->recorder_bytes_in = rec.bytes_in;
+    results->recorder_bytes_out = rec.bytes_out;
+    results->recorder_keyframes = rec.keyframes;
+
+    recorder_close(&rec);
+
+    return 0;
+}
+
+// Seeks to random ticks of the recording bench_recorder wrote
+static int bench_seek(const char* path, bench_results* results)
+{
+    static replay rep;
+    r3e_int32 first, last;
+    uint32_t state = 12345;
+    uint64_t start_us;
+    double* samples;
+    int i;
+
+    if (replay_open(&rep, path) || rep.num_frames == 0)
+        return 1;
+
+    samples = (double*)malloc(SEEKS * sizeof(double));
+    if (samples == NULL || replay_seek_frame(&rep, 0) != 0)
+    {
+        free(samples);
+        replay_close(&rep);
+        return 1;
+    }
+
+    first = replay_frame(&rep)->player.game_simulation_ticks;
+    replay_seek_frame(&rep, rep.num_frames - 1);
+    last = replay_frame(&rep)->player.game_simulation_ticks;
+
+    for (i = 0; i < SEEKS; ++i)
+    {
+        // Same sequence of seeks every run
+        state = state * 1664525u + 1013904223u;
+
+        start_us = time_now_us();
+        replay_seek(&rep, first + (r3e_int32)((state >> 8) % (uint32_t)(last - first + 1)));
+        samples[i] = (double)(time_now_us() - start_us);
+    }
+
+    results->seek_keyframes = rep.num_keyframes;
+    compute_stats(samples, SEEKS, &results->seek_us);
+
+    free(samples);
+    replay_close(&rep);
+
+    return 0;
+}
+
+static void write_stats(FILE* file, const char* unit, const sample_stats* stats)
+{
+    fprintf(file, "    \"mean_%s\": %.3f,\n", unit, stats->mean);
+    fprintf(file, "    \"min_%s\": %.3f,\n", unit, stats->min);
+    fprintf(file, "    \"p50_%s\": %.3f,\n", unit, stats->p50);
+    fprintf(file, "    \"p99_%s\": %.3f,\n", unit, stats->p99);
+    fprintf(file, "    \"max_%s\": %.3f\n", unit, stats->max);
+}
+
+static const char* simd_level()
+{
+#if PLATFORM_AVX2
+    return "avx2";
+#elif PLATFORM_SSE2
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+// Marker gaps of every car, and where the car in the middle of the field would
+// rejoin after a pit stop. Each tick is copied into one frame first, untimed,
+// as the sample updates right after capturing the tick. The input looping
+// looks like every car jumping back, which the engine takes as it would a restart.
+static int bench_gaps(const r3e_shared* frames, int count, bench_results* results)
+{
+    static gaps_engine engine;
+    static r3e_shared frame;
+    gaps_rejoin rejoin;
+    uint64_t start_us, start_ns, elapsed_ns = 0;
+    int i;
+
+    if (gaps_init(&engine, 0))
+        return 1;
+
+    for (i = 0; i < GAPS_TICKS; ++i)
+    {
+        memcpy(&frame, &frames[i % count], sizeof(r3e_shared));
+
+        start_ns = time_now_ns();
+        gaps_update(&engine, &frame);
+        elapsed_ns += time_now_ns() - start_ns;
+    }
+    results->gaps_ns = (double)elapsed_ns / GAPS_TICKS;
+
+    start_us = time_now_us();
+    for (i = 0; i < GAPS_QUERIES; ++i)
+        gaps_pit_rejoin(&engine, engine.order[engine.count / 2], GAPS_PIT_LOSS, &rejoin);
+    results->gaps_rejoin_ns = (time_now_us() - start_us) * 1000.0 / GAPS_QUERIES;
+
+    gaps_close(&engine);
+
+    return 0;
+}
+
+// Lap history of every car, and the pace of the whole field over its last laps
+static int bench_history(r3e_shared* frames, int count, bench_results* results)
+{
+    static history hist;
+    uint64_t elapsed_us = 0, start_us;
+    int i, j, pass, passes = (HISTORY_TICKS + count - 1) / count;
+    volatile double pace = 0.0;
+
+    if (history_init(&hist, HISTORY_MEMORY_DEFAULT, NULL))
+        return 1;
+
+    // Moving every car a lap on between passes isn't timed
+    for (pass = 0; pass < passes; ++pass)
+    {
+        start_us = time_now_us();
+        for (i = 0; i < count; ++i)
+            history_update(&hist, &frames[i]);
+        elapsed_us += time_now_us() - start_us;
+
+        for (i = 0; i < count; ++i)
+        {
+            for (j = 0; j < frames[i].num_cars && j < R3E_NUM_DRIVERS_MAX; ++j)
+                frames[i].all_drivers_data_1[j].completed_laps++;
+        }
+    }
+
+    results->history_ns = elapsed_us * 1000.0 / ((double)passes * count);
+    results->history_laps = hist.laps;
+
+    start_us = time_now_us();
+    for (i = 0; i < HISTORY_QUERIES; ++i)
+        pace += history_class_pace(&hist, -1, HISTORY_PACE_LAPS, HISTORY_LAP_NOT_CLEAN);
+    results->history_query_ns = (time_now_us() - start_us) * 1000.0 / HISTORY_QUERIES;
+
+    // Put the input back the way it was for the tests after this one
+    for (i = 0; i < count; ++i)
+    {
+        for (j = 0; j < frames[i].num_cars && j < R3E_NUM_DRIVERS_MAX; ++j)
+            frames[i].all_drivers_data_1[j].completed_laps -= passes;
+    }
+
+    history_close(&hist);
+
+    return 0;
+}
+
+static int write_json(const char* path, const char* source, int cars, uint32_t seed, int count, const bench_results* results)
+{
+    FILE* file = file_open(path, "w");
+
+    if (file == NULL)
+        return 1;
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"input\": {\n");
+    fprintf(file, "    \"source\": \"%s\",\n", source);
+    fprintf(file, "    \"cars\": %d,\n", cars);
+    fprintf(file, "    \"seed\": %u,\n", seed);
+    fprintf(file, "    \"frames\": %d,\n", count);
+    fprintf(file, "    \"frame_size\": %u\n", (unsigned)sizeof(r3e_shared));
+    fprintf(file, "  },\n");
+
+    fprintf(file, "  \"copy\": {\n");
+    fprintf(file, "    \"copies\": %d,\n", COPY_SAMPLES * COPY_BATCH);
+    fprintf(file, "    \"gb_per_s\": %.3f,\n", results->copy_ns.mean > 0.0 ? sizeof(r3e_shared) / results->copy_ns.mean : 0.0);
+    write_stats(file, "ns", &results->copy_ns);
+    fprintf(file, "  },\n");
+
+    fprintf(file, "  \"torn_reads\": {\n");
+    fprintf(file, "    \"duration_ms\": %u,\n", results->contention_ms);
+    fprintf(file, "    \"reads\": %llu,\n", (unsigned long long)results->contended_reads);
+    fprintf(file, "    \"torn_reads\": %llu,\n", (unsigned long long)results->torn_reads);
+    fprintf(file, "    \"failed_reads\": %llu,\n", (unsigned long long)results->failed_reads);
+    fprintf(file, "    \"retries_per_read\": %.6f,\n",
+        results->contended_reads ? (double)results->torn_reads / results->contended_reads : 0.0);
+    fprintf(file, "    \"writer_frames\": %llu\n", (unsigned long long)results->writer_frames);
+    fprintf(file, "  },\n");
+
+    fprintf(file, "  \"ring\": {\n");
+    fprintf(file, "    \"duration_ms\": %u,\n", results->contention_ms);
+    fprintf(file, "    \"consumers\": %d,\n", RING_CONSUMERS);
+    fprintf(file, "    \"capacity\": %d,\n", RING_CAPACITY_DEFAULT);
+    fprintf(file, "    \"frames\": %llu,\n", (unsigned long long)results->ring_frames);
+    fprintf(file, "    \"write_ns\": %.3f,\n", results->ring_write_ns);
+    fprintf(file, "    \"reads\": %llu,\n", (unsigned long long)results->ring_reads);
+    fprintf(file, "    \"overruns\": %llu,\n", (unsigned long long)results->ring_overruns);
+    fprintf(file, "    \"frames_lost\": %llu\n", (unsigned long long)results->ring_frames_lost);
+    fprintf(file, "  },\n");
+
+    fprintf(file, "  \"scan\": {\n");
+    fprintf(file, "    \"simd\": \"%s\",\n", simd_level());
+    fprintf(file, "    \"iterations\": %d,\n", SCAN_ITERATIONS);
+    fprintf(file, "    \"aos_ns\": %.3f,\n", results->aos_scan_ns);
+    fprintf(file, "    \"soa_transpose_ns\": %.3f,\n", results->soa_transpose_ns);
+    fprintf(file, "    \"soa_ns\": %.3f\n", results->soa_scan_ns);
+    fprintf(file, "  },\n");
+
+    fprintf(file, "  \"resample\": {\n");
+    fprintf(file, "    \"ticks\": %d,\n", RESAMPLE_TICKS);
+    fprintf(file, "    \"channels\": %d,\n", results->resample_channels);
+    fprintf(file, "    \"ns_per_tick\": %.3f\n", results->resample_ns);
+    fprintf(file, "  },\n");
+
+    fprintf(file, "  \"thermal\": {\n");
+    fprintf(file, "    \"ticks\": %d,\n", THERMAL_TICKS);
+    fprintf(file, "    \"lanes\": %d,\n", THERMAL_LANES);
+    fprintf(file, "    \"ns_per_tick\": %.3f\n", results->thermal_ns);
+    fprintf(file, "  },\n");
+
+    fprintf(file, "  \"gaps\": {\n");
+    fprintf(file, "    \"ticks\": %d,\n", GAPS_TICKS);
+    fprintf(file, "    \"markers\": %d,\n", GAPS_MARKERS_DEFAULT);
+    fprintf(file, "    \"ns_per_tick\": %.3f,\n", results->gaps_ns);
+    fprintf(file, "    \"pit_rejoin_ns\": %.3f\n", results->gaps_rejoin_ns);
+    fprintf(file, "  },\n");
+
+    fprintf(file, "  \"history\": {\n");
+    fprintf(file, "    \"ticks\": %d,\n", HISTORY_TICKS);
+    fprintf(file, "    \"laps\": %llu,\n", (unsigned long long)results->history_laps);
+    fprintf(file, "    \"ns_per_tick\": %.3f,\n", results->history_ns);
+    fprintf(file, "    \"class_pace_laps\": %d,\n", HISTORY_PACE_LAPS);
+    fprintf(file, "    \"class_pace_ns\": %.3f\n", results->history_query_ns);
+    fprintf(file, "  },\n");
+
+    fprintf(file, "  \"recorder\": {\n");
+    fprintf(file, "    \"bytes_in\": %llu,\n", (unsigned long long)results->recorder_bytes_in);
+    fprintf(file, "    \"bytes_out\": %llu,\n", (unsigned long long)results->recorder_bytes_out);
+    fprintf(file, "    \"keyframes\": %llu,\n", (unsigned long long)results->recorder_keyframes);
+    fprintf(file, "    \"ratio\": %.3f,\n",
+        results->recorder_bytes_out ? (double)results->recorder_bytes_in / results->recorder_bytes_out : 0.0);
+    fprintf(file, "    \"mb_per_s\": %.3f\n",
+        results->recorder_us > 0.0 ? results->recorder_bytes_in / results->recorder_us : 0.0);
+    fprintf(file, "  },\n");
+
+    fprintf(file, "  \"replay_seek\": {\n");
+    fprintf(file, "    \"seeks\": %d,\n", SEEKS);
+    fprintf(file, "    \"keyframes\": %u,\n", results->seek_keyframes);
+    write_stats(file, "us", &results->seek_us);
+    fprintf(file, "  }\n");
+    fprintf(file, "}\n");
+
+    return fclose(file) != 0;
+}
+
+int main(int argc, char* argv[])
+{
+    static bench_results results;
+    const char* replay_path = NULL;
+    const char* out_path = "bench.r3er";
+    const char* json_path = "bench.json";
+    r3e_shared* frames;
+    int cars = R3E_NUM_DRIVERS_MAX, count = FRAMES_DEFAULT;
+    uint32_t seed = SEED_DEFAULT, contention_ms = CONTENTION_MS_DEFAULT;
+    int i;
+
+    for (i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-synthetic") == 0)
+            replay_path = NULL;
+        else if (strcmp(argv[i], "-replay") == 0 && i + 1 < argc)
+            replay_path = argv[++i];
+        else if (strcmp(argv[i], "-cars") == 0 && i + 1 < argc)
+            cars = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc)
+            seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc)
+            count = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-contention") == 0 && i + 1 < argc)
+            contention_ms = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-out") == 0 && i + 1 < argc)
+            out_path = argv[++i];
+        else if (strcmp(argv[i], "-json") == 0 && i + 1 < argc)
+            json_path = argv[++i];
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if (cars < 1 || cars > R3E_NUM_DRIVERS_MAX || count < 1)
+    {
+        usage();
+        return 1;
+    }
+
+    frames = replay_path ? load_recording(replay_path, &count) : load_synthetic(cars, seed, count);
+    if (frames == NULL)
+    {
+        wprintf_s(L"Failed to load the input frames\n");
+        return 1;
+    }
+
+    if (replay_path)
+        cars = frames[0].num_cars;
+
+    wprintf_s(L"%d frames of %d cars from " NARROW_STR L"\n", count, cars, replay_path ? replay_path : "the synthetic race");
+
+    bench_copy(frames, count, &results);
+    wprintf_s(L"Copy: %.0f ns mean, %.0f ns p99 (%.2f GB/s)\n",
+        results.copy_ns.mean, results.copy_ns.p99, results.copy_ns.mean > 0.0 ? sizeof(r3e_shared) / results.copy_ns.mean : 0.0);
+
+    if (bench_contention(frames, count, contention_ms, &results))
+        wprintf_s(L"Torn reads: failed to start the writer thread\n");
+    else
+        wprintf_s(L"Torn reads: %llu of %llu reads retried, %llu failed, writer at %.0f frames/s\n",
+            (unsigned long long)results.torn_reads, (unsigned long long)results.contended_reads,
+            (unsigned long long)results.failed_reads, results.writer_frames * 1000.0 / contention_ms);
+
+    if (bench_ring(frames, count, contention_ms, &results))
+        wprintf_s(L"Ring: failed to start the consumer threads\n");
+    else
+        wprintf_s(L"Ring: %.0f ns per write, %llu frames to %d consumers, %llu read, %llu lost in %llu overruns\n",
+            results.ring_write_ns, (unsigned long long)results.ring_frames, RING_CONSUMERS,
+            (unsigned long long)results.ring_reads, (unsigned long long)results.ring_frames_lost,
+            (unsigned long long)results.ring_overruns);
+
+    if (bench_scan(frames, count, &results))
+        wprintf_s(L"Scan: out of memory\n");
+    else
+        wprintf_s(L"Scan: AoS %.0f ns, SoA %.0f ns + %.0f ns transpose (" NARROW_STR L")\n",
+            results.aos_scan_ns, results.soa_scan_ns, results.soa_transpose_ns, simd_level());
+
+    if (bench_resample(frames, count, &results))
+        wprintf_s(L"Resample: out of memory\n");
+    else
+        wprintf_s(L"Resample: %.0f ns per tick for %d channels at %d, 60 and 1 Hz\n",
+            results.resample_ns, results.resample_channels, TICK_RATE_HZ);
+
+    bench_thermal(frames, count, &results);
+    wprintf_s(L"Thermal: %.0f ns per tick for %d lanes (" NARROW_STR L")\n",
+        results.thermal_ns, THERMAL_LANES, simd_level());
+
+    if (bench_gaps(frames, count, &results))
+        wprintf_s(L"Gaps: out of memory\n");
+    else
+        wprintf_s(L"Gaps: %.0f ns per tick for %d cars, %.0f ns per pit rejoin\n",
+            results.gaps_ns, cars, results.gaps_rejoin_ns);
+
+    if (bench_history(frames, count, &results))
+        wprintf_s(L"History: out of memory\n");
+    else
+        wprintf_s(L"History: %.0f ns per tick for %d cars, %.0f ns for the field's pace over %d laps (%llu laps stored)\n",
+            results.history_ns, cars, results.history_query_ns, HISTORY_PACE_LAPS, (unsigned long long)results.history_laps);
+
+    if (bench_recorder(frames, count, out_path, &results))
+        wprintf_s(L"Recorder: failed to write " NARROW_STR L"\n", out_path);
+    else
+        wprintf_s(L"Recorder: %.1f MB/s, %.1fx smaller\n",
+            results.recorder_us > 0.0 ? results.recorder_bytes_in / results.recorder_us : 0.0,
+            results.recorder_bytes_out ? (double)results.recorder_bytes_in / results.recorder_bytes_out : 0.0);
+
+    if (bench_seek(out_path, &results))
+        wprintf_s(L"Replay: failed to open " NARROW_STR L"\n", out_path);
+    else
+        wprintf_s(L"Replay seek: %.1f us mean, %.1f us p99, %.1f us max\n",
+            results.seek_us.mean, results.seek_us.p99, results.seek_us.max);
+
+    free(frames);
+
+    if (write_json(json_path, replay_path ? "recording" : "synthetic", cars, seed, count, &results))
+    {
+        wprintf_s(L"Failed to write " NARROW_STR L"\n", json_path);
+        return 1;
+    }
+
+    wprintf_s(L"Results written to " NARROW_STR L"\n", json_path);
+
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include "delta.h"
+
+#include <string.h>
+
+// Shorter unchanged stretches are cheaper to keep inside a literal run
+#define MIN_SKIP 4
+
+static size_t put_varint(uint8_t* out, size_t value)
+{
+    size_t n = 0;
+
+    while (value >= 0x80)
+    {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+
+    return n;
+}
+
+static int get_varint(const uint8_t* in, size_t in_size, size_t* pos, size_t* value)
+{
+    size_t result = 0;
+    int shift = 0;
+    uint8_t byte;
+
+    do
+    {
+        if (*pos >= in_size || shift > 56)
+            return 1;
+
+        byte = in[(*pos)++];
+        result |= (size_t)(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    *value = result;
+    return 0;
+}
+
+// Number of equal bytes starting at pos, compared eight at a time where possible
+static size_t equal_run(const uint8_t* a, const uint8_t* b, size_t pos, size_t size)
+{
+    size_t start = pos;
+    uint64_t wa, wb;
+
+    while (pos + 8 <= size)
+    {
+        memcpy(&wa, a + pos, 8);
+        memcpy(&wb, b + pos, 8);
+        if (wa != wb)
+            break;
+        pos += 8;
+    }
+
+    while (pos < size && a[pos] == b[pos])
+        pos++;
+
+    return pos - start;
+}
+
+size_t delta_encode(const uint8_t* previous, const uint8_t* current, size_t size, uint8_t* out)
+{
+    size_t pos = 0, written = 0, skip, start, run, i;
+
+    while (pos < size)
+    {
+        skip = equal_run(previous, current, pos, size);
+        pos += skip;
+        if (pos >= size)
+            break;
+
+        // Extend the literal until a long enough unchanged stretch (or the end)
+        start = pos;
+        for (;;)
+        {
+            while (pos < size && previous[pos] != current[pos])
+                pos++;
+            if (pos >= size)
+                break;
+
+            run = equal_run(previous, current, pos, size);
+            if (run >= MIN_SKIP || pos + run >= size)
+                break;
+            pos += run;
+        }
+
+        written += put_varint(out + written, skip);
+        written += put_varint(out + written, pos - start);
+        for (i = start; i < pos; ++i)
+            out[written++] = previous[i] ^ current[i];
+    }
+
+    return written;
+}
+
+int delta_decode(const uint8_t* in, size_t in_size, uint8_t* frame, size_t size)
+{
+    size_t in_pos = 0, pos = 0, skip, length, i;
+
+    while (in_pos < in_size)
+    {
+        if (get_varint(in, in_size, &in_pos, &skip) || get_varint(in, in_size, &in_pos, &length))
+            return 1;
+
+        if (skip > size - pos || length > size - pos - skip || length > in_size - in_pos)
+            return 1;
+
+        pos += skip;
+        for (i = 0; i < length; ++i)
+            frame[pos + i] ^= in[in_pos + i];
+
+        pos += length;
+        in_pos += length;
+    }
+
+    return 0;
+}
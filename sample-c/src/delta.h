@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Upper bound for the encoded size of a size byte frame
+#define DELTA_BOUND(size) ((size) + (size) / 8 + 16)
+
+// Encodes current against previous as XOR runs.
+// The output is a list of (skip, length, length bytes of previous XOR current)
+// operations with varint skip and length, unchanged bytes cost nothing.
+// out must hold DELTA_BOUND(size) bytes, returns the number of bytes written
+size_t delta_encode(const uint8_t* previous, const uint8_t* current, size_t size, uint8_t* out);
+
+// Applies an encoded delta to frame in place, turning previous into current
+// Returns 0 on success, 1 if the input is malformed or runs past the frame
+int delta_decode(const uint8_t* in, size_t in_size, uint8_t* frame, size_t size);
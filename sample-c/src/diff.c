@@ -0,0 +1,290 @@
+#include "diff.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PLAYER_OFFSET offsetof(r3e_shared, player)
+#define DRIVERS_OFFSET offsetof(r3e_shared, all_drivers_data_1)
+
+static void emit(diff_engine* engine, diff_event* event)
+{
+    engine->events++;
+    engine->callback(event, engine->context);
+}
+
+static int clamp_cars(r3e_int32 num_cars)
+{
+    if (num_cars < 0)
+        return 0;
+    if (num_cars > R3E_NUM_DRIVERS_MAX)
+        return R3E_NUM_DRIVERS_MAX;
+    return num_cars;
+}
+
+// Walks a field table over two copies of the same struct and emits one event per changed element
+static uint32_t compare_fields(diff_engine* engine, diff_scope scope, r3e_int32 slot_id,
+    const field_desc* fields, int num_fields, const uint8_t* enabled,
+    const char* before, const char* after)
+{
+    diff_event event;
+    uint32_t element_size, i;
+    uint32_t emitted = 0;
+    int f;
+
+    event.kind = DIFF_CHANGED;
+    event.scope = scope;
+    event.slot_id = slot_id;
+
+    for (f = 0; f < num_fields; ++f)
+    {
+        const field_desc* field = &fields[f];
+        element_size = field_type_size(field->type);
+
+        if (!enabled[f] || memcmp(before + field->offset, after + field->offset, element_size * field->count) == 0)
+            continue;
+
+        event.field = field;
+
+        if (field->type == FIELD_U8CHAR)
+        {
+            event.element = 0;
+            event.before = before + field->offset;
+            event.after = after + field->offset;
+            emit(engine, &event);
+            emitted++;
+            continue;
+        }
+
+        for (i = 0; i < field->count; ++i)
+        {
+            event.element = i;
+            event.before = before + field->offset + i * element_size;
+            event.after = after + field->offset + i * element_size;
+
+            if (memcmp(event.before, event.after, element_size) == 0)
+                continue;
+
+            emit(engine, &event);
+            emitted++;
+        }
+    }
+
+    return emitted;
+}
+
+static uint32_t compare_drivers(diff_engine* engine, const r3e_shared* before, const r3e_shared* after)
+{
+    BOOL matched[R3E_NUM_DRIVERS_MAX];
+    diff_event event;
+    int before_cars = clamp_cars(before->num_cars);
+    int after_cars = clamp_cars(after->num_cars);
+    uint32_t emitted = 0;
+    r3e_int32 slot_id;
+    int i, j;
+
+    memset(matched, 0, sizeof(matched));
+    memset(&event, 0, sizeof(event));
+    event.scope = DIFF_DRIVER;
+
+    for (i = 0; i < after_cars; ++i)
+    {
+        const r3e_driver_data* now = &after->all_drivers_data_1[i];
+        slot_id = now->driver_info.slot_id;
+
+        // Most ticks nobody changes places, so try the same array entry first
+        j = i;
+        if (j >= before_cars || before->all_drivers_data_1[j].driver_info.slot_id != slot_id)
+        {
+            for (j = 0; j < before_cars; ++j)
+            {
+                if (!matched[j] && before->all_drivers_data_1[j].driver_info.slot_id == slot_id)
+                    break;
+            }
+        }
+
+        if (j >= before_cars || matched[j])
+        {
+            event.kind = DIFF_DRIVER_ADDED;
+            event.slot_id = slot_id;
+            emit(engine, &event);
+            emitted++;
+            continue;
+        }
+
+        matched[j] = TRUE;
+
+        if (memcmp(&before->all_drivers_data_1[j], now, sizeof(r3e_driver_data)) == 0)
+            continue;
+
+        emitted += compare_fields(engine, DIFF_DRIVER, slot_id,
+            fields_driver, FIELDS_DRIVER_COUNT, engine->enabled_driver,
+            (const char*)&before->all_drivers_data_1[j], (const char*)now);
+    }
+
+    for (j = 0; j < before_cars; ++j)
+    {
+        if (matched[j])
+            continue;
+
+        event.kind = DIFF_DRIVER_REMOVED;
+        event.slot_id = before->all_drivers_data_1[j].driver_info.slot_id;
+        emit(engine, &event);
+        emitted++;
+    }
+
+    return emitted;
+}
+
+int diff_init(diff_engine* engine, diff_callback callback, void* context)
+{
+    memset(engine, 0, sizeof(*engine));
+
+    engine->callback = callback;
+    engine->context = context;
+    engine->previous = (r3e_shared*)malloc(sizeof(r3e_shared));
+
+    if (engine->previous == NULL)
+        return 1;
+
+    memset(engine->enabled_shared, 1, sizeof(engine->enabled_shared));
+    memset(engine->enabled_player, 1, sizeof(engine->enabled_player));
+    memset(engine->enabled_driver, 1, sizeof(engine->enabled_driver));
+
+    return 0;
+}
+
+void diff_close(diff_engine* engine)
+{
+    free(engine->previous);
+    engine->previous = NULL;
+    engine->has_previous = FALSE;
+}
+
+int diff_enable(diff_engine* engine, diff_scope scope, const char* prefix, BOOL enabled)
+{
+    const field_desc* fields = fields_shared;
+    uint8_t* switches = engine->enabled_shared;
+    int num_fields = FIELDS_SHARED_COUNT;
+    size_t length = strlen(prefix);
+    int matches = 0;
+    int f;
+
+    if (scope == DIFF_PLAYER)
+    {
+        fields = fields_player;
+        switches = engine->enabled_player;
+        num_fields = FIELDS_PLAYER_COUNT;
+    }
+    else if (scope == DIFF_DRIVER)
+    {
+        fields = fields_driver;
+        switches = engine->enabled_driver;
+        num_fields = FIELDS_DRIVER_COUNT;
+    }
+
+    for (f = 0; f < num_fields; ++f)
+    {
+        if (strncmp(fields[f].name, prefix, length) != 0)
+            continue;
+
+        switches[f] = enabled ? 1 : 0;
+        matches++;
+    }
+
+    return matches;
+}
+
+uint32_t diff_update(diff_engine* engine, const r3e_shared* frame)
+{
+    const char* before = (const char*)engine->previous;
+    const char* after = (const char*)frame;
+    uint32_t emitted = 0;
+
+    engine->frames++;
+
+    if (engine->has_previous)
+    {
+        // Whole block compares first, most of the struct is the same from one tick to the next
+        if (memcmp(before, after, PLAYER_OFFSET) != 0 ||
+            memcmp(before + PLAYER_OFFSET + sizeof(r3e_playerdata), after + PLAYER_OFFSET + sizeof(r3e_playerdata),
+                DRIVERS_OFFSET - PLAYER_OFFSET - sizeof(r3e_playerdata)) != 0)
+        {
+            emitted += compare_fields(engine, DIFF_SHARED, -1,
+                fields_shared, FIELDS_SHARED_COUNT, engine->enabled_shared, before, after);
+        }
+
+        if (memcmp(before + PLAYER_OFFSET, after + PLAYER_OFFSET, sizeof(r3e_playerdata)) != 0)
+        {
+            emitted += compare_fields(engine, DIFF_PLAYER, -1,
+                fields_player, FIELDS_PLAYER_COUNT, engine->enabled_player,
+                before + PLAYER_OFFSET, after + PLAYER_OFFSET);
+        }
+
+        emitted += compare_drivers(engine, engine->previous, frame);
+    }
+
+    memcpy(engine->previous, frame, sizeof(r3e_shared));
+    engine->has_previous = TRUE;
+
+    return emitted;
+}
+
+void diff_reset(diff_engine* engine)
+{
+    engine->has_previous = FALSE;
+}
+
+static void format_value(const diff_event* event, const void* value, char* buffer, size_t size)
+{
+    switch (event->field->type)
+    {
+    case FIELD_INT32:
+        snprintf(buffer, size, "%d", *(const r3e_int32*)value);
+        break;
+    case FIELD_FLOAT32:
+        snprintf(buffer, size, "%.3f", *(const r3e_float32*)value);
+        break;
+    case FIELD_FLOAT64:
+        snprintf(buffer, size, "%.3f", *(const r3e_float64*)value);
+        break;
+    case FIELD_U8CHAR:
+        // Names are zero padded but not guaranteed to be terminated
+        snprintf(buffer, size, "\"%.*s\"", (int)event->field->count, (const char*)value);
+        break;
+    }
+}
+
+void diff_format(const diff_event* event, char* buffer, size_t size)
+{
+    char before[96];
+    char after[96];
+    char element[16];
+
+    if (event->kind == DIFF_DRIVER_ADDED)
+    {
+        snprintf(buffer, size, "driver %d added", event->slot_id);
+        return;
+    }
+
+    if (event->kind == DIFF_DRIVER_REMOVED)
+    {
+        snprintf(buffer, size, "driver %d removed", event->slot_id);
+        return;
+    }
+
+    element[0] = '\0';
+    if (event->field->count > 1 && event->field->type != FIELD_U8CHAR)
+        snprintf(element, sizeof(element), "[%u]", event->element);
+
+    format_value(event, event->before, before, sizeof(before));
+    format_value(event, event->after, after, sizeof(after));
+
+    if (event->scope == DIFF_DRIVER)
+        snprintf(buffer, size, "driver %d %s%s %s -> %s", event->slot_id, event->field->name, element, before, after);
+    else if (event->scope == DIFF_PLAYER)
+        snprintf(buffer, size, "player.%s%s %s -> %s", event->field->name, element, before, after);
+    else
+        snprintf(buffer, size, "%s%s %s -> %s", event->field->name, element, before, after);
+}
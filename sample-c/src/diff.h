@@ -0,0 +1,82 @@
+#pragma once
+
+#include "r3e.h"
+#include "fields.h"
+#include "platform.h"
+
+typedef enum
+{
+    DIFF_SHARED = 0,
+    DIFF_PLAYER = 1,
+    DIFF_DRIVER = 2
+} diff_scope;
+
+typedef enum
+{
+    // A field (or one element of an array field) changed
+    DIFF_CHANGED = 0,
+
+    // A slot id showed up in or disappeared from all_drivers_data_1, no field events follow for it
+    DIFF_DRIVER_ADDED = 1,
+    DIFF_DRIVER_REMOVED = 2
+} diff_kind;
+
+typedef struct
+{
+    diff_kind kind;
+    diff_scope scope;
+
+    // NULL for driver added/removed events
+    const field_desc* field;
+
+    // Index into the field's elements, text fields always report element 0
+    uint32_t element;
+
+    // Slot id of the driver for DIFF_DRIVER events, -1 otherwise
+    r3e_int32 slot_id;
+
+    // Old and new value of the element (of the whole text for FIELD_U8CHAR).
+    // Point into the frames handed to diff_update, only valid during the callback.
+    const void* before;
+    const void* after;
+} diff_event;
+
+typedef void (*diff_callback)(const diff_event* event, void* context);
+
+// Compares consecutive snapshots field by field and reports what changed.
+// Drivers are matched by slot id, so a place swap shows up as two place
+// changes instead of every field of two array entries.
+typedef struct
+{
+    diff_callback callback;
+    void* context;
+
+    r3e_shared* previous;
+    BOOL has_previous;
+
+    // Per field switch, all fields start enabled
+    uint8_t enabled_shared[FIELDS_SHARED_COUNT];
+    uint8_t enabled_player[FIELDS_PLAYER_COUNT];
+    uint8_t enabled_driver[FIELDS_DRIVER_COUNT];
+
+    uint64_t frames;
+    uint64_t events;
+} diff_engine;
+
+int diff_init(diff_engine* engine, diff_callback callback, void* context);
+void diff_close(diff_engine* engine);
+
+// Enables or disables every field of the scope whose name starts with prefix,
+// "" matches the whole scope. Returns the number of fields matched.
+int diff_enable(diff_engine* engine, diff_scope scope, const char* prefix, BOOL enabled);
+
+// Reports the changes since the last frame and keeps a copy of this one.
+// The first frame after init or diff_reset reports nothing.
+// Returns the number of events emitted.
+uint32_t diff_update(diff_engine* engine, const r3e_shared* frame);
+
+// Forget the previous frame, e.g. after reconnecting
+void diff_reset(diff_engine* engine);
+
+// Writes a one line description of the event, e.g. "driver 17 place 5 -> 4"
+void diff_format(const diff_event* event, char* buffer, size_t size);
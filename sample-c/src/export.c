@@ -0,0 +1,527 @@
+#include "r3e.h"
+#include "fields.h"
+#include "parquet.h"
+#include "platform.h"
+#include "replay.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define THREADS_DEFAULT 4
+#define THREADS_MAX 64
+
+// Raw size of the columns of one row group, sets the rows per group
+#define ROW_GROUP_MB_DEFAULT 256
+#define ROW_GROUP_ROWS_MIN 1024
+
+// Columns of a recording: every field of r3e_shared and the player block, then
+// every driver field for each slot that shows up in the recording, in slot
+// order. Fields with several elements get a column per element. Driver
+// columns are optional, null while that slot isn't in all_drivers_data_1.
+typedef struct
+{
+    parquet_column* columns;
+
+    // Byte offset into r3e_shared, or into r3e_driver_data for driver columns
+    uint32_t* offsets;
+    int num_columns;
+
+    // Driver columns start at driver_columns, per_driver of them per slot
+    int driver_columns;
+    int per_driver;
+
+    int slots[R3E_NUM_DRIVERS_MAX];
+    int num_slots;
+
+    // Index into slots by slot_id, -1 for slots never seen
+    int slot_index[R3E_NUM_DRIVERS_MAX];
+
+    // JSON object of "column": "unit" pairs for the footer
+    char* units;
+    size_t units_size;
+    size_t units_length;
+} export_schema;
+
+// One row group, transposed: a buffer per column and a present flag per row and slot
+typedef struct
+{
+    uint8_t* data;
+    uint8_t** buffers;
+    uint8_t* present;
+    uint32_t capacity;
+    uint32_t num_rows;
+} export_rows;
+
+typedef struct
+{
+    const export_schema* schema;
+    const export_rows* rows;
+    parquet_chunk* chunks;
+
+    int first;
+    int step;
+    parquet_encoder encoder;
+
+    platform_thread thread;
+    int err_code;
+} export_worker;
+
+typedef struct
+{
+    replay rep;
+    export_schema schema;
+    export_rows rows;
+    parquet_chunk* chunks;
+
+    export_worker workers[THREADS_MAX];
+    int num_threads;
+
+    uint32_t frames;
+    int row_groups;
+} exporter;
+
+static void usage()
+{
+    wprintf_s(L"Usage: export recording output.parquet [-threads n] [-row-group-mb n] [-no-drivers]\n");
+    wprintf_s(L"  -threads       encoder threads, 1 - %d (default %d)\n", THREADS_MAX, THREADS_DEFAULT);
+    wprintf_s(L"  -row-group-mb  raw size of a row group in MB (default %d)\n", ROW_GROUP_MB_DEFAULT);
+    wprintf_s(L"  -no-drivers    leave out the per driver columns\n");
+}
+
+// Finds the slots that show up anywhere in the recording
+static int scan_slots(replay* rep, export_schema* schema)
+{
+    const r3e_shared* frame;
+    BOOL seen[R3E_NUM_DRIVERS_MAX];
+    int count, i, slot;
+
+    memset(seen, 0, sizeof(seen));
+
+    if (replay_seek_frame(rep, 0))
+        return 1;
+
+    do
+    {
+        frame = replay_frame(rep);
+        count = frame->num_cars < R3E_NUM_DRIVERS_MAX ? frame->num_cars : R3E_NUM_DRIVERS_MAX;
+
+        for (i = 0; i < count; ++i)
+        {
+            slot = frame->all_drivers_data_1[i].driver_info.slot_id;
+            if (slot >= 0 && slot < R3E_NUM_DRIVERS_MAX)
+                seen[slot] = TRUE;
+        }
+    }
+    while (replay_next(rep) == 0);
+
+    for (slot = 0; slot < R3E_NUM_DRIVERS_MAX; ++slot)
+    {
+        if (seen[slot])
+        {
+            schema->slot_index[slot] = schema->num_slots;
+            schema->slots[schema->num_slots++] = slot;
+        }
+    }
+
+    return 0;
+}
+
+static parquet_type parquet_type_of(field_type type)
+{
+    switch (type)
+    {
+    case FIELD_INT32: return PARQUET_INT32;
+    case FIELD_FLOAT32: return PARQUET_FLOAT;
+    case FIELD_FLOAT64: return PARQUET_DOUBLE;
+    default: return PARQUET_BYTE_ARRAY;
+    }
+}
+
+// Adds a column per element of each field, prefix is prepended to the names
+static void add_fields(export_schema* schema, const field_desc* fields, int num_fields,
+    const char* prefix, size_t base, BOOL optional)
+{
+    parquet_column* column;
+    uint32_t element, elements, size;
+    int i;
+
+    for (i = 0; i < num_fields; ++i)
+    {
+        size = field_type_size(fields[i].type);
+        elements = fields[i].type == FIELD_U8CHAR ? 1 : fields[i].count;
+
+        for (element = 0; element < elements; ++element)
+        {
+            column = &schema->columns[schema->num_columns];
+
+            if (elements > 1)
+                snprintf(column->name, sizeof(column->name), "%s%s[%u]", prefix, fields[i].name, element);
+            else
+                snprintf(column->name, sizeof(column->name), "%s%s", prefix, fields[i].name);
+
+            column->type = parquet_type_of(fields[i].type);
+            column->width = fields[i].type == FIELD_U8CHAR ? fields[i].count : size;
+            column->optional = optional;
+
+            schema->offsets[schema->num_columns] = (uint32_t)(base + fields[i].offset + element * size);
+
+            if (fields[i].unit[0])
+            {
+                schema->units_length += snprintf(schema->units + schema->units_length, schema->units_size - schema->units_length,
+                    "%s\"%s\": \"%s\"", schema->units_length > 1 ? ", " : "", column->name, fields[i].unit);
+            }
+
+            schema->num_columns++;
+        }
+    }
+}
+
+// Fills in the columns for the slots found by scan_slots, returns 0 on success
+static int build_schema(export_schema* schema)
+{
+    char prefix[32];
+    size_t max_columns = 0;
+    int i;
+
+    // Upper bound, fields with several elements become a column each
+    for (i = 0; i < FIELDS_SHARED_COUNT; ++i)
+        max_columns += fields_shared[i].count;
+    for (i = 0; i < FIELDS_PLAYER_COUNT; ++i)
+        max_columns += fields_player[i].count;
+    for (i = 0; i < FIELDS_DRIVER_COUNT; ++i)
+        max_columns += fields_driver[i].count * schema->num_slots;
+
+    schema->columns = (parquet_column*)calloc(max_columns, sizeof(parquet_column));
+    schema->offsets = (uint32_t*)calloc(max_columns, sizeof(uint32_t));
+    schema->units_size = max_columns * (PARQUET_NAME_MAX + 16) + 3;
+    schema->units = (char*)calloc(schema->units_size, 1);
+
+    if (schema->columns == NULL || schema->offsets == NULL || schema->units == NULL)
+        return 1;
+
+    schema->units[0] = '{';
+    schema->units_length = 1;
+
+    add_fields(schema, fields_shared, FIELDS_SHARED_COUNT, "", 0, FALSE);
+    add_fields(schema, fields_player, FIELDS_PLAYER_COUNT, "player.", offsetof(r3e_shared, player), FALSE);
+
+    schema->driver_columns = schema->num_columns;
+
+    for (i = 0; i < schema->num_slots; ++i)
+    {
+        snprintf(prefix, sizeof(prefix), "drivers[%d].", schema->slots[i]);
+        add_fields(schema, fields_driver, FIELDS_DRIVER_COUNT, prefix, 0, TRUE);
+    }
+
+    if (schema->num_slots > 0)
+        schema->per_driver = (schema->num_columns - schema->driver_columns) / schema->num_slots;
+
+    snprintf(schema->units + schema->units_length, schema->units_size - schema->units_length, "}");
+
+    return 0;
+}
+
+static void free_schema(export_schema* schema)
+{
+    free(schema->columns);
+    free(schema->offsets);
+    free(schema->units);
+}
+
+static int alloc_rows(export_rows* rows, const export_schema* schema, uint32_t row_group_mb)
+{
+    size_t row_bytes = schema->num_slots, offset = 0;
+    int c;
+
+    for (c = 0; c < schema->num_columns; ++c)
+        row_bytes += schema->columns[c].width;
+
+    rows->capacity = (uint32_t)(((uint64_t)row_group_mb << 20) / row_bytes);
+    if (rows->capacity < ROW_GROUP_ROWS_MIN)
+        rows->capacity = ROW_GROUP_ROWS_MIN;
+
+    rows->data = (uint8_t*)aligned_malloc((size_t)rows->capacity * row_bytes, CACHE_LINE_SIZE);
+    rows->buffers = (uint8_t**)malloc(schema->num_columns * sizeof(uint8_t*));
+
+    if (rows->data == NULL || rows->buffers == NULL)
+        return 1;
+
+    for (c = 0; c < schema->num_columns; ++c)
+    {
+        rows->buffers[c] = rows->data + offset;
+        offset += (size_t)rows->capacity * schema->columns[c].width;
+    }
+
+    rows->present = rows->data + offset;
+
+    return 0;
+}
+
+static void copy_value(uint8_t* buffer, uint32_t row, const uint8_t* value, uint32_t width)
+{
+    // Constant sizes so the common cases compile to plain loads and stores
+    if (width == 4)
+        memcpy(buffer + (size_t)row * 4, value, 4);
+    else if (width == 8)
+        memcpy(buffer + (size_t)row * 8, value, 8);
+    else
+        memcpy(buffer + (size_t)row * width, value, width);
+}
+
+// Appends frame to the row group. The frame was just decoded and is still in
+// cache, so transposing it here is cheaper than gathering columns out of
+// staged frames later, which would fetch a cache line per value.
+static void add_row(export_rows* rows, const export_schema* schema, const r3e_shared* frame)
+{
+    const uint8_t* base = (const uint8_t*)frame;
+    const uint8_t* driver;
+    uint32_t r = rows->num_rows++;
+    int count, i, c, slot, index, end;
+
+    for (c = 0; c < schema->driver_columns; ++c)
+        copy_value(rows->buffers[c], r, base + schema->offsets[c], schema->columns[c].width);
+
+    if (schema->num_slots == 0)
+        return;
+
+    for (i = 0; i < schema->num_slots; ++i)
+        rows->present[(size_t)i * rows->capacity + r] = 0;
+
+    count = frame->num_cars < R3E_NUM_DRIVERS_MAX ? frame->num_cars : R3E_NUM_DRIVERS_MAX;
+
+    for (i = 0; i < count; ++i)
+    {
+        slot = frame->all_drivers_data_1[i].driver_info.slot_id;
+        if (slot < 0 || slot >= R3E_NUM_DRIVERS_MAX || schema->slot_index[slot] < 0)
+            continue;
+
+        index = schema->slot_index[slot];
+        driver = (const uint8_t*)&frame->all_drivers_data_1[i];
+        rows->present[(size_t)index * rows->capacity + r] = 1;
+
+        c = schema->driver_columns + index * schema->per_driver;
+        for (end = c + schema->per_driver; c < end; ++c)
+            copy_value(rows->buffers[c], r, driver + schema->offsets[c], schema->columns[c].width);
+    }
+}
+
+// Encodes every step-th column, starting at first
+static void encode_columns(void* arg)
+{
+    export_worker* worker = (export_worker*)arg;
+    const export_schema* schema = worker->schema;
+    const export_rows* rows = worker->rows;
+    const uint8_t* present;
+    int c;
+
+    for (c = worker->first; c < schema->num_columns; c += worker->step)
+    {
+        present = NULL;
+        if (c >= schema->driver_columns)
+            present = rows->present + (size_t)((c - schema->driver_columns) / schema->per_driver) * rows->capacity;
+
+        if (parquet_encode(&worker->encoder, &worker->chunks[c], &schema->columns[c], rows->buffers[c], present, rows->num_rows))
+        {
+            worker->err_code = 1;
+            return;
+        }
+    }
+}
+
+// Encodes the row group on all workers, returns 0 on success
+static int encode_row_group(exporter* ex)
+{
+    int err_code = 0, t;
+
+    for (t = 0; t < ex->num_threads; ++t)
+    {
+        ex->workers[t].err_code = 0;
+
+        // The calling thread does the first share itself
+        if (t > 0 && thread_start(&ex->workers[t].thread, encode_columns, &ex->workers[t]))
+            encode_columns(&ex->workers[t]);
+    }
+
+    encode_columns(&ex->workers[0]);
+
+    for (t = 0; t < ex->num_threads; ++t)
+    {
+        thread_join(&ex->workers[t].thread);
+        err_code |= ex->workers[t].err_code;
+    }
+
+    return err_code;
+}
+
+static void exporter_close(exporter* ex)
+{
+    int c, t;
+
+    for (t = 0; t < THREADS_MAX; ++t)
+        parquet_encoder_close(&ex->workers[t].encoder);
+
+    if (ex->chunks)
+    {
+        for (c = 0; c < ex->schema.num_columns; ++c)
+            parquet_chunk_close(&ex->chunks[c]);
+    }
+
+    free(ex->chunks);
+    aligned_free(ex->rows.data);
+    free(ex->rows.buffers);
+    free_schema(&ex->schema);
+    replay_close(&ex->rep);
+
+    memset(ex, 0, sizeof(*ex));
+}
+
+// Opens the recording and sets up the schema, row group and encoders, returns 0 on success
+static int exporter_open(exporter* ex, const char* path, int num_threads, uint32_t row_group_mb, BOOL drivers)
+{
+    int t;
+
+    memset(ex, 0, sizeof(*ex));
+    memset(ex->schema.slot_index, 0xff, sizeof(ex->schema.slot_index));
+
+    if (replay_open(&ex->rep, path) || ex->rep.num_frames == 0)
+    {
+        wprintf_s(L"Failed to open " NARROW_STR L"\n", path);
+        return 1;
+    }
+
+    if (drivers && scan_slots(&ex->rep, &ex->schema))
+    {
+        wprintf_s(L"Failed to read " NARROW_STR L"\n", path);
+        return 1;
+    }
+
+    if (build_schema(&ex->schema))
+    {
+        wprintf_s(L"Failed to allocate the schema\n");
+        return 1;
+    }
+
+    ex->chunks = (parquet_chunk*)calloc(ex->schema.num_columns, sizeof(parquet_chunk));
+
+    if (alloc_rows(&ex->rows, &ex->schema, row_group_mb) || ex->chunks == NULL)
+    {
+        wprintf_s(L"Failed to allocate a row group of %u rows\n", ex->rows.capacity);
+        return 1;
+    }
+
+    ex->num_threads = num_threads;
+
+    for (t = 0; t < num_threads; ++t)
+    {
+        ex->workers[t].schema = &ex->schema;
+        ex->workers[t].rows = &ex->rows;
+        ex->workers[t].chunks = ex->chunks;
+        ex->workers[t].first = t;
+        ex->workers[t].step = num_threads;
+        parquet_encoder_init(&ex->workers[t].encoder);
+    }
+
+    return 0;
+}
+
+// Writes every frame of the recording to path, returns 0 on success
+static int exporter_run(exporter* ex, const char* path)
+{
+    parquet_writer writer;
+    char version[32];
+    BOOL more;
+
+    if (parquet_open(&writer, path, ex->schema.columns, ex->schema.num_columns))
+    {
+        wprintf_s(L"Failed to create " NARROW_STR L"\n", path);
+        return 1;
+    }
+
+    snprintf(version, sizeof(version), "%d.%d", ex->rep.header.version_major, ex->rep.header.version_minor);
+    parquet_add_metadata(&writer, "r3e.version", version);
+    parquet_add_metadata(&writer, "r3e.units", ex->schema.units);
+
+    more = replay_seek_frame(&ex->rep, 0) == 0;
+
+    while (more)
+    {
+        add_row(&ex->rows, &ex->schema, replay_frame(&ex->rep));
+        ex->frames++;
+
+        more = replay_next(&ex->rep) == 0;
+
+        if (ex->rows.num_rows < ex->rows.capacity && more)
+            continue;
+
+        if (encode_row_group(ex) || parquet_write_row_group(&writer, ex->chunks))
+        {
+            wprintf_s(L"Failed to write row group %d\n", ex->row_groups);
+            parquet_close(&writer);
+            return 1;
+        }
+
+        ex->row_groups++;
+        ex->rows.num_rows = 0;
+    }
+
+    if (parquet_close(&writer))
+    {
+        wprintf_s(L"Failed to finish " NARROW_STR L"\n", path);
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    static exporter ex;
+    const char* in_path = NULL;
+    const char* out_path = NULL;
+    uint32_t row_group_mb = ROW_GROUP_MB_DEFAULT;
+    int num_threads = THREADS_DEFAULT, err_code, i;
+    BOOL drivers = TRUE;
+    uint64_t start_us;
+    double seconds;
+
+    for (i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+            num_threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-row-group-mb") == 0 && i + 1 < argc)
+            row_group_mb = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-no-drivers") == 0)
+            drivers = FALSE;
+        else if (argv[i][0] != '-' && in_path == NULL)
+            in_path = argv[i];
+        else if (argv[i][0] != '-' && out_path == NULL)
+            out_path = argv[i];
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if (in_path == NULL || out_path == NULL || num_threads < 1 || num_threads > THREADS_MAX || row_group_mb < 1)
+    {
+        usage();
+        return 1;
+    }
+
+    start_us = time_now_us();
+
+    err_code = exporter_open(&ex, in_path, num_threads, row_group_mb, drivers) || exporter_run(&ex, out_path);
+
+    if (err_code == 0)
+    {
+        seconds = (time_now_us() - start_us) / 1e6;
+        wprintf_s(L"Exported %u frames as %d columns (%d drivers) in %d row groups in %.2f s (%.0f frames/s)\n",
+            ex.frames, ex.schema.num_columns, ex.schema.num_slots, ex.row_groups, seconds, seconds > 0.0 ? ex.frames / seconds : 0.0);
+    }
+
+    exporter_close(&ex);
+
+    return err_code;
+}
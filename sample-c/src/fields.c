@@ -0,0 +1,201 @@
+#include "fields.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FIELD_ENTRY(owner, member, type, offset, unit) \
+    { #member, offset, (uint32_t)(sizeof(((owner*)0)->member) / FIELD_SIZE_##type), FIELD_##type, unit },
+
+#define FIELD_ENTRY_SHARED(member, type, offset, unit) FIELD_ENTRY(r3e_shared, member, type, offset, unit)
+#define FIELD_ENTRY_PLAYER(member, type, offset, unit) FIELD_ENTRY(r3e_playerdata, member, type, offset, unit)
+#define FIELD_ENTRY_DRIVER(member, type, offset, unit) FIELD_ENTRY(r3e_driver_data, member, type, offset, unit)
+
+// Compile time checks, the array size goes negative when a listed offset
+// doesn't match the compiler's or the fields don't add up to the whole struct
+#define FIELD_WRONG_OFFSET(owner, member, offset) + (offsetof(owner, member) != offset)
+#define FIELD_WRONG_OFFSET_SHARED(member, type, offset, unit) FIELD_WRONG_OFFSET(r3e_shared, member, offset)
+#define FIELD_WRONG_OFFSET_PLAYER(member, type, offset, unit) FIELD_WRONG_OFFSET(r3e_playerdata, member, offset)
+#define FIELD_WRONG_OFFSET_DRIVER(member, type, offset, unit) FIELD_WRONG_OFFSET(r3e_driver_data, member, offset)
+
+#define FIELD_SIZE(owner, member) + sizeof(((owner*)0)->member)
+#define FIELD_SIZE_SHARED(member, type, offset, unit) FIELD_SIZE(r3e_shared, member)
+#define FIELD_SIZE_PLAYER(member, type, offset, unit) FIELD_SIZE(r3e_playerdata, member)
+#define FIELD_SIZE_DRIVER(member, type, offset, unit) FIELD_SIZE(r3e_driver_data, member)
+
+typedef char fields_shared_offsets_match[(0 FIELDS_SHARED(FIELD_WRONG_OFFSET_SHARED)) == 0 ? 1 : -1];
+typedef char fields_player_offsets_match[(0 FIELDS_PLAYER(FIELD_WRONG_OFFSET_PLAYER)) == 0 ? 1 : -1];
+typedef char fields_driver_offsets_match[(0 FIELDS_DRIVER(FIELD_WRONG_OFFSET_DRIVER)) == 0 ? 1 : -1];
+
+typedef char fields_shared_size_match[(0 FIELDS_SHARED(FIELD_SIZE_SHARED)) + sizeof(r3e_playerdata) +
+    sizeof(r3e_driver_data) * R3E_NUM_DRIVERS_MAX == sizeof(r3e_shared) ? 1 : -1];
+typedef char fields_player_size_match[(0 FIELDS_PLAYER(FIELD_SIZE_PLAYER)) == sizeof(r3e_playerdata) ? 1 : -1];
+typedef char fields_driver_size_match[(0 FIELDS_DRIVER(FIELD_SIZE_DRIVER)) == sizeof(r3e_driver_data) ? 1 : -1];
+
+const field_desc fields_shared[FIELDS_SHARED_COUNT] =
+{
+    FIELDS_SHARED(FIELD_ENTRY_SHARED)
+};
+
+const field_desc fields_player[FIELDS_PLAYER_COUNT] =
+{
+    FIELDS_PLAYER(FIELD_ENTRY_PLAYER)
+};
+
+const field_desc fields_driver[FIELDS_DRIVER_COUNT] =
+{
+    FIELDS_DRIVER(FIELD_ENTRY_DRIVER)
+};
+
+uint32_t field_type_size(field_type type)
+{
+    switch (type)
+    {
+    case FIELD_INT32: return FIELD_SIZE_INT32;
+    case FIELD_FLOAT32: return FIELD_SIZE_FLOAT32;
+    case FIELD_FLOAT64: return FIELD_SIZE_FLOAT64;
+    case FIELD_U8CHAR: return FIELD_SIZE_U8CHAR;
+    }
+
+    return 0;
+}
+
+const char* field_type_name(field_type type)
+{
+    switch (type)
+    {
+    case FIELD_INT32: return "int32";
+    case FIELD_FLOAT32: return "float32";
+    case FIELD_FLOAT64: return "float64";
+    case FIELD_U8CHAR: return "u8char";
+    }
+
+    return "unknown";
+}
+
+const field_desc* fields_find(const field_desc* fields, int num_fields, const char* name)
+{
+    int f;
+
+    for (f = 0; f < num_fields; ++f)
+    {
+        if (strcmp(fields[f].name, name) == 0)
+            return &fields[f];
+    }
+
+    return NULL;
+}
+
+// Whether field is name itself or a member of it, "tire_temp" matches "tire_temp[2].hot_temp"
+static int field_matches(const char* field, const char* name, size_t length)
+{
+    if (strncmp(field, name, length) != 0)
+        return 0;
+
+    return field[length] == '\0' || field[length] == '.' || field[length] == '[';
+}
+
+// Matches name against one table, base is the table's offset in r3e_shared
+static int match_table(const field_desc* fields, int num_fields, size_t base, const char* name,
+    fields_match_func func, void* context)
+{
+    size_t length = strlen(name);
+    int found = 0;
+    int i;
+
+    for (i = 0; i < num_fields; ++i)
+    {
+        if (!field_matches(fields[i].name, name, length))
+            continue;
+
+        if (func(&fields[i], (uint32_t)(base + fields[i].offset), context))
+            return 1;
+
+        found++;
+    }
+
+    return found > 0 ? 0 : 1;
+}
+
+int fields_match(const char* name, fields_match_func func, void* context)
+{
+    static const char drivers[] = "all_drivers_data_1[";
+    unsigned long driver;
+    char* end;
+
+    if (strncmp(name, "player.", 7) == 0)
+        return match_table(fields_player, FIELDS_PLAYER_COUNT, offsetof(r3e_shared, player), name + 7, func, context);
+
+    if (strncmp(name, drivers, sizeof(drivers) - 1) == 0)
+    {
+        driver = strtoul(name + sizeof(drivers) - 1, &end, 10);
+
+        if (driver >= R3E_NUM_DRIVERS_MAX || end[0] != ']' || end[1] != '.')
+            return 1;
+
+        return match_table(fields_driver, FIELDS_DRIVER_COUNT,
+            offsetof(r3e_shared, all_drivers_data_1) + driver * sizeof(r3e_driver_data), end + 2, func, context);
+    }
+
+    return match_table(fields_shared, FIELDS_SHARED_COUNT, 0, name, func, context);
+}
+
+double field_get(const field_desc* field, const void* base, uint32_t element)
+{
+    const char* value = (const char*)base + field->offset + element * field_type_size(field->type);
+
+    switch (field->type)
+    {
+    case FIELD_INT32: return *(const r3e_int32*)value;
+    case FIELD_FLOAT32: return *(const r3e_float32*)value;
+    case FIELD_FLOAT64: return *(const r3e_float64*)value;
+    case FIELD_U8CHAR: return *(const r3e_u8char*)value;
+    }
+
+    return 0.0;
+}
+
+static void write_table(FILE* file, const char* name, size_t offset, size_t size, int count,
+    const field_desc* fields, int num_fields, const char* separator)
+{
+    int f;
+
+    fprintf(file, "    {\n");
+    fprintf(file, "      \"name\": \"%s\",\n", name);
+    fprintf(file, "      \"offset\": %u,\n", (unsigned)offset);
+    fprintf(file, "      \"size\": %u,\n", (unsigned)size);
+    fprintf(file, "      \"count\": %d,\n", count);
+    fprintf(file, "      \"fields\": [\n");
+
+    for (f = 0; f < num_fields; ++f)
+    {
+        fprintf(file, "        { \"name\": \"%s\", \"offset\": %u, \"type\": \"%s\", \"count\": %u, \"unit\": \"%s\" }%s\n",
+            fields[f].name, fields[f].offset, field_type_name(fields[f].type), fields[f].count, fields[f].unit,
+            f + 1 < num_fields ? "," : "");
+    }
+
+    fprintf(file, "      ]\n");
+    fprintf(file, "    }%s\n", separator);
+}
+
+int fields_write_schema(FILE* file)
+{
+    fprintf(file, "{\n");
+    fprintf(file, "  \"version_major\": %d,\n", R3E_VERSION_MAJOR);
+    fprintf(file, "  \"version_minor\": %d,\n", R3E_VERSION_MINOR);
+    fprintf(file, "  \"size\": %u,\n", (unsigned)sizeof(r3e_shared));
+    fprintf(file, "  \"structs\": [\n");
+
+    // Offsets of the nested structs are relative to r3e_shared, the driver array repeats count times
+    write_table(file, "r3e_shared", 0, sizeof(r3e_shared), 1,
+        fields_shared, FIELDS_SHARED_COUNT, ",");
+    write_table(file, "r3e_playerdata", offsetof(r3e_shared, player), sizeof(r3e_playerdata), 1,
+        fields_player, FIELDS_PLAYER_COUNT, ",");
+    write_table(file, "r3e_driver_data", offsetof(r3e_shared, all_drivers_data_1), sizeof(r3e_driver_data), R3E_NUM_DRIVERS_MAX,
+        fields_driver, FIELDS_DRIVER_COUNT, "");
+
+    fprintf(file, "  ]\n");
+    fprintf(file, "}\n");
+
+    return ferror(file) ? 1 : 0;
+}
@@ -0,0 +1,450 @@
+#pragma once
+
+#include "r3e.h"
+
+#include <stdio.h>
+
+// Leaf fields of the shared memory structs, listed in declaration order.
+// Nested structs are flattened ("flags.yellow"), arrays of structs are
+// expanded per element ("tire_temp[0].current_temp") and arrays of scalars
+// stay a single field with an element count. Enum typed members are INT32.
+//
+// The lists are X-macros taking (member, type, offset, unit) so code that needs
+// to visit every field can be generated at compile time, see fields.c for an
+// example. offset is the byte offset into the owning struct, spelled out so
+// it can be read without a compiler and checked against offsetof in fields.c.
+// unit comes from the "Unit:" comment in r3e.h, "" where there is none.
+// player and all_drivers_data_1 are left out of FIELDS_SHARED and covered by
+// FIELDS_PLAYER and FIELDS_DRIVER instead.
+//
+// Keep these in sync with r3e.h, fields.c fails to compile when an offset or
+// the total size no longer matches.
+
+typedef enum
+{
+    FIELD_INT32 = 0,
+    FIELD_FLOAT32 = 1,
+    FIELD_FLOAT64 = 2,
+    FIELD_U8CHAR = 3
+} field_type;
+
+#define FIELD_SIZE_INT32 sizeof(r3e_int32)
+#define FIELD_SIZE_FLOAT32 sizeof(r3e_float32)
+#define FIELD_SIZE_FLOAT64 sizeof(r3e_float64)
+#define FIELD_SIZE_U8CHAR sizeof(r3e_u8char)
+
+typedef struct
+{
+    // Member path as written in C, e.g. "tire_temp[0].current_temp"
+    const char* name;
+
+    // Byte offset from the start of the owning struct
+    uint32_t offset;
+
+    // Number of elements, 1 for scalars
+    uint32_t count;
+
+    field_type type;
+
+    // Abbreviated unit, e.g. "m/s", "" when r3e.h doesn't give one
+    const char* unit;
+} field_desc;
+
+#define FIELDS_SHARED(X) \
+    X(version_major, INT32, 0, "") \
+    X(version_minor, INT32, 4, "") \
+    X(all_drivers_offset, INT32, 8, "") \
+    X(driver_data_size, INT32, 12, "") \
+    X(game_mode, INT32, 16, "") \
+    X(game_paused, INT32, 20, "") \
+    X(game_in_menus, INT32, 24, "") \
+    X(game_in_replay, INT32, 28, "") \
+    X(game_using_vr, INT32, 32, "") \
+    X(game_player_in_garage, INT32, 36, "") \
+    X(track_name, U8CHAR, 600, "") \
+    X(layout_name, U8CHAR, 664, "") \
+    X(track_id, INT32, 728, "") \
+    X(layout_id, INT32, 732, "") \
+    X(layout_length, FLOAT32, 736, "") \
+    X(sector_start_factors.sector1, FLOAT32, 740, "") \
+    X(sector_start_factors.sector2, FLOAT32, 744, "") \
+    X(sector_start_factors.sector3, FLOAT32, 748, "") \
+    X(race_session_laps, INT32, 752, "") \
+    X(race_session_minutes, INT32, 764, "") \
+    X(event_index, INT32, 776, "") \
+    X(session_type, INT32, 780, "") \
+    X(session_iteration, INT32, 784, "") \
+    X(session_length_format, INT32, 788, "") \
+    X(session_pit_speed_limit, FLOAT32, 792, "m/s") \
+    X(session_phase, INT32, 796, "") \
+    X(start_lights, INT32, 800, "") \
+    X(tire_wear_active, INT32, 804, "") \
+    X(fuel_use_active, INT32, 808, "") \
+    X(number_of_laps, INT32, 812, "") \
+    X(session_time_duration, FLOAT32, 816, "s") \
+    X(session_time_remaining, FLOAT32, 820, "s") \
+    X(max_incident_points, INT32, 824, "") \
+    X(event_unused1, FLOAT32, 828, "") \
+    X(event_unused2, FLOAT32, 832, "") \
+    X(pit_window_status, INT32, 836, "") \
+    X(pit_window_start, INT32, 840, "") \
+    X(pit_window_end, INT32, 844, "") \
+    X(in_pitlane, INT32, 848, "") \
+    X(pit_menu_selection, INT32, 852, "") \
+    X(pit_menu_state, INT32, 856, "") \
+    X(pit_state, INT32, 904, "") \
+    X(pit_total_duration, FLOAT32, 908, "") \
+    X(pit_elapsed_time, FLOAT32, 912, "") \
+    X(pit_action, INT32, 916, "") \
+    X(num_pitstops, INT32, 920, "") \
+    X(pit_min_duration_total, FLOAT32, 924, "s") \
+    X(pit_min_duration_left, FLOAT32, 928, "s") \
+    X(flags.yellow, INT32, 932, "") \
+    X(flags.yellowCausedIt, INT32, 936, "") \
+    X(flags.yellowOvertake, INT32, 940, "") \
+    X(flags.yellowPositionsGained, INT32, 944, "") \
+    X(flags.sector_yellow, INT32, 948, "") \
+    X(flags.closest_yellow_distance_into_track, FLOAT32, 960, "m") \
+    X(flags.blue, INT32, 964, "") \
+    X(flags.black, INT32, 968, "") \
+    X(flags.green, INT32, 972, "") \
+    X(flags.checkered, INT32, 976, "") \
+    X(flags.white, INT32, 980, "") \
+    X(flags.black_and_white, INT32, 984, "") \
+    X(position, INT32, 988, "") \
+    X(position_class, INT32, 992, "") \
+    X(finish_status, INT32, 996, "") \
+    X(cut_track_warnings, INT32, 1000, "") \
+    X(penalties.drive_through, FLOAT32, 1004, "") \
+    X(penalties.stop_and_go, FLOAT32, 1008, "") \
+    X(penalties.pit_stop, FLOAT32, 1012, "") \
+    X(penalties.time_deduction, FLOAT32, 1016, "") \
+    X(penalties.slow_down, FLOAT32, 1020, "") \
+    X(num_penalties, INT32, 1024, "") \
+    X(completed_laps, INT32, 1028, "") \
+    X(current_lap_valid, INT32, 1032, "") \
+    X(track_sector, INT32, 1036, "") \
+    X(lap_distance, FLOAT32, 1040, "") \
+    X(lap_distance_fraction, FLOAT32, 1044, "") \
+    X(lap_time_best_leader, FLOAT32, 1048, "s") \
+    X(lap_time_best_leader_class, FLOAT32, 1052, "s") \
+    X(session_best_lap_sector_times, FLOAT32, 1056, "s") \
+    X(lap_time_best_self, FLOAT32, 1068, "s") \
+    X(sector_time_best_self, FLOAT32, 1072, "s") \
+    X(lap_time_previous_self, FLOAT32, 1084, "s") \
+    X(sector_time_previous_self, FLOAT32, 1088, "s") \
+    X(lap_time_current_self, FLOAT32, 1100, "s") \
+    X(sector_time_current_self, FLOAT32, 1104, "s") \
+    X(lap_time_delta_leader, FLOAT32, 1116, "s") \
+    X(lap_time_delta_leader_class, FLOAT32, 1120, "s") \
+    X(time_delta_front, FLOAT32, 1124, "s") \
+    X(time_delta_behind, FLOAT32, 1128, "s") \
+    X(time_delta_best_self, FLOAT32, 1132, "s") \
+    X(best_individual_sector_time_self, FLOAT32, 1136, "s") \
+    X(best_individual_sector_time_leader, FLOAT32, 1148, "s") \
+    X(best_individual_sector_time_leader_class, FLOAT32, 1160, "s") \
+    X(incident_points, INT32, 1172, "") \
+    X(lap_valid_state, INT32, 1176, "") \
+    X(prev_lap_valid, INT32, 1180, "") \
+    X(discharge_rate, FLOAT32, 1184, "") \
+    X(brake_regen, FLOAT32, 1188, "") \
+    X(unused1, FLOAT32, 1192, "") \
+    X(vehicle_info.name, U8CHAR, 1196, "") \
+    X(vehicle_info.car_number, INT32, 1260, "") \
+    X(vehicle_info.class_id, INT32, 1264, "") \
+    X(vehicle_info.model_id, INT32, 1268, "") \
+    X(vehicle_info.team_id, INT32, 1272, "") \
+    X(vehicle_info.livery_id, INT32, 1276, "") \
+    X(vehicle_info.manufacturer_id, INT32, 1280, "") \
+    X(vehicle_info.user_id, INT32, 1284, "") \
+    X(vehicle_info.slot_id, INT32, 1288, "") \
+    X(vehicle_info.class_performance_index, INT32, 1292, "") \
+    X(vehicle_info.engine_type, INT32, 1296, "") \
+    X(vehicle_info.car_width, FLOAT32, 1300, "") \
+    X(vehicle_info.car_length, FLOAT32, 1304, "") \
+    X(vehicle_info.rating, FLOAT32, 1308, "") \
+    X(vehicle_info.reputation, FLOAT32, 1312, "") \
+    X(vehicle_info.unused1, FLOAT32, 1316, "") \
+    X(vehicle_info.unused2, FLOAT32, 1320, "") \
+    X(player_name, U8CHAR, 1324, "") \
+    X(control_type, INT32, 1388, "") \
+    X(car_speed, FLOAT32, 1392, "m/s") \
+    X(engine_rps, FLOAT32, 1396, "rad/s") \
+    X(max_engine_rps, FLOAT32, 1400, "rad/s") \
+    X(upshift_rps, FLOAT32, 1404, "rad/s") \
+    X(gear, INT32, 1408, "") \
+    X(num_gears, INT32, 1412, "") \
+    X(car_cg_location.x, FLOAT32, 1416, "") \
+    X(car_cg_location.y, FLOAT32, 1420, "") \
+    X(car_cg_location.z, FLOAT32, 1424, "") \
+    X(car_orientation.pitch, FLOAT32, 1428, "rad") \
+    X(car_orientation.yaw, FLOAT32, 1432, "rad") \
+    X(car_orientation.roll, FLOAT32, 1436, "rad") \
+    X(local_acceleration.x, FLOAT32, 1440, "m/s^2") \
+    X(local_acceleration.y, FLOAT32, 1444, "m/s^2") \
+    X(local_acceleration.z, FLOAT32, 1448, "m/s^2") \
+    X(total_mass, FLOAT32, 1452, "kg") \
+    X(fuel_left, FLOAT32, 1456, "l") \
+    X(fuel_capacity, FLOAT32, 1460, "l") \
+    X(fuel_per_lap, FLOAT32, 1464, "l") \
+    X(virtual_energy_left, FLOAT32, 1468, "MJ") \
+    X(virtual_energy_capacity, FLOAT32, 1472, "MJ") \
+    X(virtual_energy_per_lap, FLOAT32, 1476, "MJ") \
+    X(engine_temp, FLOAT32, 1480, "C") \
+    X(engine_oil_temp, FLOAT32, 1484, "C") \
+    X(fuel_pressure, FLOAT32, 1488, "kPa") \
+    X(engine_oil_pressure, FLOAT32, 1492, "kPa") \
+    X(turbo_pressure, FLOAT32, 1496, "bar") \
+    X(throttle, FLOAT32, 1500, "") \
+    X(throttle_raw, FLOAT32, 1504, "") \
+    X(brake, FLOAT32, 1508, "") \
+    X(brake_raw, FLOAT32, 1512, "") \
+    X(clutch, FLOAT32, 1516, "") \
+    X(clutch_raw, FLOAT32, 1520, "") \
+    X(steer_input_raw, FLOAT32, 1524, "") \
+    X(steer_lock_degrees, INT32, 1528, "") \
+    X(steer_wheel_range_degrees, INT32, 1532, "") \
+    X(aid_settings.abs, INT32, 1536, "") \
+    X(aid_settings.tc, INT32, 1540, "") \
+    X(aid_settings.esp, INT32, 1544, "") \
+    X(aid_settings.countersteer, INT32, 1548, "") \
+    X(aid_settings.cornering, INT32, 1552, "") \
+    X(drs.equipped, INT32, 1556, "") \
+    X(drs.available, INT32, 1560, "") \
+    X(drs.numActivationsLeft, INT32, 1564, "") \
+    X(drs.engaged, INT32, 1568, "") \
+    X(pit_limiter, INT32, 1572, "") \
+    X(push_to_pass.available, INT32, 1576, "") \
+    X(push_to_pass.engaged, INT32, 1580, "") \
+    X(push_to_pass.amount_left, INT32, 1584, "") \
+    X(push_to_pass.engaged_time_left, FLOAT32, 1588, "") \
+    X(push_to_pass.wait_time_left, FLOAT32, 1592, "") \
+    X(brake_bias, FLOAT32, 1596, "") \
+    X(drs_numActivationsTotal, INT32, 1600, "") \
+    X(ptp_numActivationsTotal, INT32, 1604, "") \
+    X(battery_soc, FLOAT32, 1608, "") \
+    X(water_left, FLOAT32, 1612, "l") \
+    X(abs_setting, INT32, 1616, "") \
+    X(headlights, INT32, 1620, "") \
+    X(steer_wheel_max_rotation, INT32, 1624, "") \
+    X(tire_type, INT32, 1628, "") \
+    X(tire_rps, FLOAT32, 1632, "rad/s") \
+    X(tire_speed, FLOAT32, 1648, "m/s") \
+    X(tire_grip, FLOAT32, 1664, "") \
+    X(tire_wear, FLOAT32, 1680, "") \
+    X(tire_flatspot, INT32, 1696, "") \
+    X(tire_pressure, FLOAT32, 1712, "kPa") \
+    X(tire_dirt, FLOAT32, 1728, "") \
+    X(tire_temp[0].current_temp, FLOAT32, 1744, "C") \
+    X(tire_temp[0].optimal_temp, FLOAT32, 1756, "C") \
+    X(tire_temp[0].cold_temp, FLOAT32, 1760, "C") \
+    X(tire_temp[0].hot_temp, FLOAT32, 1764, "C") \
+    X(tire_temp[1].current_temp, FLOAT32, 1768, "C") \
+    X(tire_temp[1].optimal_temp, FLOAT32, 1780, "C") \
+    X(tire_temp[1].cold_temp, FLOAT32, 1784, "C") \
+    X(tire_temp[1].hot_temp, FLOAT32, 1788, "C") \
+    X(tire_temp[2].current_temp, FLOAT32, 1792, "C") \
+    X(tire_temp[2].optimal_temp, FLOAT32, 1804, "C") \
+    X(tire_temp[2].cold_temp, FLOAT32, 1808, "C") \
+    X(tire_temp[2].hot_temp, FLOAT32, 1812, "C") \
+    X(tire_temp[3].current_temp, FLOAT32, 1816, "C") \
+    X(tire_temp[3].optimal_temp, FLOAT32, 1828, "C") \
+    X(tire_temp[3].cold_temp, FLOAT32, 1832, "C") \
+    X(tire_temp[3].hot_temp, FLOAT32, 1836, "C") \
+    X(tire_type_front, INT32, 1840, "") \
+    X(tire_type_rear, INT32, 1844, "") \
+    X(tire_subtype_front, INT32, 1848, "") \
+    X(tire_subtype_rear, INT32, 1852, "") \
+    X(brake_temp[0].current_temp, FLOAT32, 1856, "C") \
+    X(brake_temp[0].optimal_temp, FLOAT32, 1860, "C") \
+    X(brake_temp[0].cold_temp, FLOAT32, 1864, "C") \
+    X(brake_temp[0].hot_temp, FLOAT32, 1868, "C") \
+    X(brake_temp[1].current_temp, FLOAT32, 1872, "C") \
+    X(brake_temp[1].optimal_temp, FLOAT32, 1876, "C") \
+    X(brake_temp[1].cold_temp, FLOAT32, 1880, "C") \
+    X(brake_temp[1].hot_temp, FLOAT32, 1884, "C") \
+    X(brake_temp[2].current_temp, FLOAT32, 1888, "C") \
+    X(brake_temp[2].optimal_temp, FLOAT32, 1892, "C") \
+    X(brake_temp[2].cold_temp, FLOAT32, 1896, "C") \
+    X(brake_temp[2].hot_temp, FLOAT32, 1900, "C") \
+    X(brake_temp[3].current_temp, FLOAT32, 1904, "C") \
+    X(brake_temp[3].optimal_temp, FLOAT32, 1908, "C") \
+    X(brake_temp[3].cold_temp, FLOAT32, 1912, "C") \
+    X(brake_temp[3].hot_temp, FLOAT32, 1916, "C") \
+    X(brake_pressure, FLOAT32, 1920, "kN") \
+    X(traction_control_setting, INT32, 1936, "") \
+    X(engine_map_setting, INT32, 1940, "") \
+    X(engine_brake_setting, INT32, 1944, "") \
+    X(traction_control_percent, FLOAT32, 1948, "") \
+    X(tire_on_mtrl, INT32, 1952, "") \
+    X(tire_load, FLOAT32, 1968, "") \
+    X(car_damage.engine, FLOAT32, 1984, "") \
+    X(car_damage.transmission, FLOAT32, 1988, "") \
+    X(car_damage.aerodynamics, FLOAT32, 1992, "") \
+    X(car_damage.suspension, FLOAT32, 1996, "") \
+    X(car_damage.unused1, FLOAT32, 2000, "") \
+    X(car_damage.unused2, FLOAT32, 2004, "") \
+    X(num_cars, INT32, 2008, "")
+
+#define FIELDS_PLAYER(X) \
+    X(user_id, INT32, 0, "") \
+    X(game_simulation_ticks, INT32, 4, "ticks") \
+    X(game_simulation_time, FLOAT64, 8, "s") \
+    X(position.x, FLOAT64, 16, "") \
+    X(position.y, FLOAT64, 24, "") \
+    X(position.z, FLOAT64, 32, "") \
+    X(velocity.x, FLOAT64, 40, "m/s") \
+    X(velocity.y, FLOAT64, 48, "m/s") \
+    X(velocity.z, FLOAT64, 56, "m/s") \
+    X(local_velocity.x, FLOAT64, 64, "m/s") \
+    X(local_velocity.y, FLOAT64, 72, "m/s") \
+    X(local_velocity.z, FLOAT64, 80, "m/s") \
+    X(acceleration.x, FLOAT64, 88, "m/s^2") \
+    X(acceleration.y, FLOAT64, 96, "m/s^2") \
+    X(acceleration.z, FLOAT64, 104, "m/s^2") \
+    X(local_acceleration.x, FLOAT64, 112, "m/s^2") \
+    X(local_acceleration.y, FLOAT64, 120, "m/s^2") \
+    X(local_acceleration.z, FLOAT64, 128, "m/s^2") \
+    X(orientation.x, FLOAT64, 136, "rad") \
+    X(orientation.y, FLOAT64, 144, "rad") \
+    X(orientation.z, FLOAT64, 152, "rad") \
+    X(rotation.x, FLOAT64, 160, "") \
+    X(rotation.y, FLOAT64, 168, "") \
+    X(rotation.z, FLOAT64, 176, "") \
+    X(angular_acceleration.x, FLOAT64, 184, "") \
+    X(angular_acceleration.y, FLOAT64, 192, "") \
+    X(angular_acceleration.z, FLOAT64, 200, "") \
+    X(angular_velocity.x, FLOAT64, 208, "rad/s") \
+    X(angular_velocity.y, FLOAT64, 216, "rad/s") \
+    X(angular_velocity.z, FLOAT64, 224, "rad/s") \
+    X(local_angular_velocity.x, FLOAT64, 232, "rad/s") \
+    X(local_angular_velocity.y, FLOAT64, 240, "rad/s") \
+    X(local_angular_velocity.z, FLOAT64, 248, "rad/s") \
+    X(local_g_force.x, FLOAT64, 256, "") \
+    X(local_g_force.y, FLOAT64, 264, "") \
+    X(local_g_force.z, FLOAT64, 272, "") \
+    X(steering_force, FLOAT64, 280, "") \
+    X(steering_force_percentage, FLOAT64, 288, "") \
+    X(engine_torque, FLOAT64, 296, "") \
+    X(current_downforce, FLOAT64, 304, "N") \
+    X(voltage, FLOAT64, 312, "") \
+    X(ers_level, FLOAT64, 320, "") \
+    X(power_mgu_h, FLOAT64, 328, "") \
+    X(power_mgu_k, FLOAT64, 336, "") \
+    X(torque_mgu_k, FLOAT64, 344, "") \
+    X(suspension_deflection, FLOAT64, 352, "") \
+    X(suspension_velocity, FLOAT64, 384, "") \
+    X(camber, FLOAT64, 416, "") \
+    X(ride_height, FLOAT64, 448, "") \
+    X(front_wing_height, FLOAT64, 480, "") \
+    X(front_roll_angle, FLOAT64, 488, "") \
+    X(rear_roll_angle, FLOAT64, 496, "") \
+    X(third_spring_suspension_deflection_front, FLOAT64, 504, "") \
+    X(third_spring_suspension_velocity_front, FLOAT64, 512, "") \
+    X(third_spring_suspension_deflection_rear, FLOAT64, 520, "") \
+    X(third_spring_suspension_velocity_rear, FLOAT64, 528, "") \
+    X(unused1, FLOAT64, 536, "") \
+    X(unused2, FLOAT64, 544, "") \
+    X(unused3, FLOAT64, 552, "")
+
+#define FIELDS_DRIVER(X) \
+    X(driver_info.name, U8CHAR, 0, "") \
+    X(driver_info.car_number, INT32, 64, "") \
+    X(driver_info.class_id, INT32, 68, "") \
+    X(driver_info.model_id, INT32, 72, "") \
+    X(driver_info.team_id, INT32, 76, "") \
+    X(driver_info.livery_id, INT32, 80, "") \
+    X(driver_info.manufacturer_id, INT32, 84, "") \
+    X(driver_info.user_id, INT32, 88, "") \
+    X(driver_info.slot_id, INT32, 92, "") \
+    X(driver_info.class_performance_index, INT32, 96, "") \
+    X(driver_info.engine_type, INT32, 100, "") \
+    X(driver_info.car_width, FLOAT32, 104, "") \
+    X(driver_info.car_length, FLOAT32, 108, "") \
+    X(driver_info.rating, FLOAT32, 112, "") \
+    X(driver_info.reputation, FLOAT32, 116, "") \
+    X(driver_info.unused1, FLOAT32, 120, "") \
+    X(driver_info.unused2, FLOAT32, 124, "") \
+    X(finish_status, INT32, 128, "") \
+    X(place, INT32, 132, "") \
+    X(place_class, INT32, 136, "") \
+    X(lap_distance, FLOAT32, 140, "") \
+    X(lap_distance_fraction, FLOAT32, 144, "") \
+    X(position.x, FLOAT32, 148, "") \
+    X(position.y, FLOAT32, 152, "") \
+    X(position.z, FLOAT32, 156, "") \
+    X(track_sector, INT32, 160, "") \
+    X(completed_laps, INT32, 164, "") \
+    X(current_lap_valid, INT32, 168, "") \
+    X(lap_time_current_self, FLOAT32, 172, "s") \
+    X(sector_time_current_self, FLOAT32, 176, "s") \
+    X(sector_time_previous_self, FLOAT32, 188, "s") \
+    X(sector_time_best_self, FLOAT32, 200, "s") \
+    X(time_delta_front, FLOAT32, 212, "s") \
+    X(time_delta_behind, FLOAT32, 216, "s") \
+    X(pitstop_status, INT32, 220, "") \
+    X(in_pitlane, INT32, 224, "") \
+    X(num_pitstops, INT32, 228, "") \
+    X(penalties.drive_through, FLOAT32, 232, "") \
+    X(penalties.stop_and_go, FLOAT32, 236, "") \
+    X(penalties.pit_stop, FLOAT32, 240, "") \
+    X(penalties.time_deduction, FLOAT32, 244, "") \
+    X(penalties.slow_down, FLOAT32, 248, "") \
+    X(car_speed, FLOAT32, 252, "m/s") \
+    X(tire_type_front, INT32, 256, "") \
+    X(tire_type_rear, INT32, 260, "") \
+    X(tire_subtype_front, INT32, 264, "") \
+    X(tire_subtype_rear, INT32, 268, "") \
+    X(base_penalty_weight, FLOAT32, 272, "") \
+    X(aid_penalty_weight, FLOAT32, 276, "") \
+    X(drs_state, INT32, 280, "") \
+    X(ptp_state, INT32, 284, "") \
+    X(virtual_energy, FLOAT32, 288, "") \
+    X(penaltyType, INT32, 292, "") \
+    X(penaltyReason, INT32, 296, "") \
+    X(engineState, INT32, 300, "") \
+    X(orientation.x, FLOAT32, 304, "") \
+    X(orientation.y, FLOAT32, 308, "") \
+    X(orientation.z, FLOAT32, 312, "") \
+    X(unused1, FLOAT32, 316, "") \
+    X(unused2, FLOAT32, 320, "") \
+    X(unused3, FLOAT32, 324, "")
+
+#define FIELD_COUNT_ONE(member, type, offset, unit) + 1
+
+enum
+{
+    FIELDS_SHARED_COUNT = 0 FIELDS_SHARED(FIELD_COUNT_ONE),
+    FIELDS_PLAYER_COUNT = 0 FIELDS_PLAYER(FIELD_COUNT_ONE),
+    FIELDS_DRIVER_COUNT = 0 FIELDS_DRIVER(FIELD_COUNT_ONE)
+};
+
+// Offsets relative to r3e_shared, r3e_playerdata and r3e_driver_data respectively
+extern const field_desc fields_shared[FIELDS_SHARED_COUNT];
+extern const field_desc fields_player[FIELDS_PLAYER_COUNT];
+extern const field_desc fields_driver[FIELDS_DRIVER_COUNT];
+
+// Size of one element of the given type
+uint32_t field_type_size(field_type type);
+
+// Name of the type as used in the schema, e.g. "float32"
+const char* field_type_name(field_type type);
+
+// Looks a field up by name, NULL if there is no such field
+const field_desc* fields_find(const field_desc* fields, int num_fields, const char* name);
+
+// Callback for fields_match, offset is the field's byte offset in r3e_shared
+// Returns 0 to go on, anything else stops the match
+typedef int (*fields_match_func)(const field_desc* field, uint32_t offset, void* context);
+
+// Calls func for every field a name refers to: "gear", "player.position.x" or
+// "all_drivers_data_1[3].place". A name that is the start of a nested struct
+// or array of structs matches all of it, e.g. "tire_temp" or "player.velocity".
+// Returns 0 if something matched and func returned 0 for all of it, 1 otherwise
+int fields_match(const char* name, fields_match_func func, void* context);
+
+// Reads one element of a numeric field as a double, base points at the owning struct
+double field_get(const field_desc* field, const void* base, uint32_t element);
+
+// Writes the three tables as JSON, returns 0 on success
+int fields_write_schema(FILE* file);
@@ -0,0 +1,320 @@
+#include "gaps.h"
+
+#include <math.h>
+#include <string.h>
+
+int gaps_init(gaps_engine* engine, uint32_t markers)
+{
+    size_t count;
+
+    memset(engine, 0, sizeof(*engine));
+
+    engine->markers = markers > 0 ? markers : GAPS_MARKERS_DEFAULT;
+    count = (size_t)GAPS_SLOTS * engine->markers;
+
+    engine->pass_time = (double*)aligned_malloc(count * sizeof(double), CACHE_LINE_SIZE);
+    engine->pass_lap = (r3e_int32*)aligned_malloc(count * sizeof(r3e_int32), CACHE_LINE_SIZE);
+
+    if (engine->pass_time == NULL || engine->pass_lap == NULL)
+    {
+        gaps_close(engine);
+        return 1;
+    }
+
+    return 0;
+}
+
+void gaps_close(gaps_engine* engine)
+{
+    aligned_free(engine->pass_time);
+    aligned_free(engine->pass_lap);
+
+    memset(engine, 0, sizeof(*engine));
+}
+
+// Forgets every marker the car passed, it starts over from distance
+static void reset_car(gaps_engine* engine, int slot, double distance, double time)
+{
+    gaps_car* car = &engine->cars[slot];
+    r3e_int32* lap = engine->pass_lap + (size_t)slot * engine->markers;
+    uint32_t m;
+
+    for (m = 0; m < engine->markers; ++m)
+        lap[m] = -1;
+
+    car->distance = distance;
+    car->time = time;
+    car->glitch_ticks = 0;
+    car->marker = -1;
+}
+
+static int64_t marker_at(const gaps_engine* engine, double distance)
+{
+    return (int64_t)floor(distance / engine->spacing);
+}
+
+// Records the markers the car passed on its way to distance
+static void advance_car(gaps_engine* engine, int slot, double distance, double time)
+{
+    gaps_car* car = &engine->cars[slot];
+    double* pass_time = engine->pass_time + (size_t)slot * engine->markers;
+    r3e_int32* pass_lap = engine->pass_lap + (size_t)slot * engine->markers;
+    int64_t first, last, k;
+    uint32_t m;
+
+    if (distance < car->distance)
+    {
+        if (++car->glitch_ticks > GAPS_GLITCH_TICKS)
+            reset_car(engine, slot, distance, time);
+        return;
+    }
+
+    car->glitch_ticks = 0;
+
+    // No time passed (paused, or the same tick read twice), nothing to interpolate over
+    if (time <= car->time)
+        return;
+
+    first = marker_at(engine, car->distance) + 1;
+    last = marker_at(engine, distance);
+
+    // More than a lap in one step is a jump, not driving
+    if (last - first >= (int64_t)engine->markers)
+    {
+        reset_car(engine, slot, distance, time);
+        return;
+    }
+
+    for (k = first; k <= last; ++k)
+    {
+        m = (uint32_t)(((k % engine->markers) + engine->markers) % engine->markers);
+        pass_time[m] = car->time + (k * engine->spacing - car->distance) / (distance - car->distance) * (time - car->time);
+        pass_lap[m] = (r3e_int32)((k - (int64_t)m) / (int64_t)engine->markers);
+        car->marker = k;
+    }
+
+    car->distance = distance;
+    car->time = time;
+}
+
+// Gap at the last marker behind has passed, 1 if ahead hasn't passed it
+static int marker_gap(const gaps_engine* engine, int ahead, int behind, gaps_gap* gap)
+{
+    const gaps_car* car_ahead = &engine->cars[ahead];
+    const gaps_car* car_behind = &engine->cars[behind];
+    int64_t k = car_behind->marker;
+    size_t m, lap;
+
+    gap->seconds = 0.0;
+    gap->laps = 0;
+    gap->valid = FALSE;
+
+    if (k < 0 || car_ahead->marker < k)
+        return 1;
+
+    m = (size_t)(k % engine->markers);
+    lap = (size_t)(k / engine->markers);
+
+    // ahead came along after the marker, e.g. joined the session later
+    if (engine->pass_lap[(size_t)ahead * engine->markers + m] < (r3e_int32)lap)
+        return 1;
+
+    gap->seconds = engine->pass_time[(size_t)behind * engine->markers + m] - engine->pass_time[(size_t)ahead * engine->markers + m];
+    gap->laps = engine->pass_lap[(size_t)ahead * engine->markers + m] - (r3e_int32)lap;
+    gap->valid = TRUE;
+
+    return 0;
+}
+
+// Insertion sort by distance, the order barely changes between ticks so this is about O(cars)
+static void sort_order(gaps_engine* engine)
+{
+    int i, j, slot;
+
+    for (i = 1; i < engine->count; ++i)
+    {
+        slot = engine->order[i];
+
+        for (j = i; j > 0 && engine->cars[engine->order[j - 1]].distance < engine->cars[slot].distance; --j)
+            engine->order[j] = engine->order[j - 1];
+
+        engine->order[j] = slot;
+    }
+}
+
+static void update_gaps(gaps_engine* engine)
+{
+    r3e_int32 class_ids[GAPS_SLOTS];
+    int class_leaders[GAPS_SLOTS], class_counts[GAPS_SLOTS];
+    int classes = 0, i, c, slot;
+    gaps_car* car;
+
+    for (i = 0; i < engine->count; ++i)
+    {
+        slot = engine->order[i];
+        car = &engine->cars[slot];
+
+        for (c = 0; c < classes && class_ids[c] != car->class_id; ++c)
+            ;
+
+        if (c == classes)
+        {
+            class_ids[c] = car->class_id;
+            class_leaders[c] = slot;
+            class_counts[c] = 0;
+            classes++;
+        }
+
+        car->place = i + 1;
+        car->place_class = ++class_counts[c];
+
+        marker_gap(engine, engine->order[0], slot, &car->leader);
+        marker_gap(engine, class_leaders[c], slot, &car->class_leader);
+
+        if (i > 0)
+            marker_gap(engine, engine->order[i - 1], slot, &car->interval);
+        else
+            memset(&car->interval, 0, sizeof(car->interval));
+    }
+}
+
+void gaps_update(gaps_engine* engine, const r3e_shared* frame)
+{
+    const r3e_driver_data* data;
+    BOOL seen[GAPS_SLOTS];
+    double distance, time = frame->player.game_simulation_time;
+    int count = frame->num_cars;
+    int i, n, slot;
+
+    if (frame->layout_length <= 0.f)
+        return;
+
+    // A different track, everything recorded is for the old one
+    if (frame->layout_length != engine->layout_length)
+    {
+        engine->layout_length = frame->layout_length;
+        engine->spacing = (double)frame->layout_length / engine->markers;
+        engine->count = 0;
+
+        for (slot = 0; slot < GAPS_SLOTS; ++slot)
+            engine->cars[slot].active = FALSE;
+    }
+
+    if (count > R3E_NUM_DRIVERS_MAX)
+        count = R3E_NUM_DRIVERS_MAX;
+
+    memset(seen, 0, sizeof(seen));
+
+    for (i = 0; i < count; ++i)
+    {
+        data = &frame->all_drivers_data_1[i];
+        slot = data->driver_info.slot_id;
+
+        if (slot < 0 || slot >= GAPS_SLOTS || seen[slot])
+            continue;
+
+        seen[slot] = TRUE;
+        distance = (double)data->completed_laps * frame->layout_length + data->lap_distance;
+
+        if (!engine->cars[slot].active)
+        {
+            reset_car(engine, slot, distance, time);
+            engine->cars[slot].active = TRUE;
+            engine->order[engine->count++] = slot;
+        }
+
+        engine->cars[slot].class_id = data->driver_info.class_id;
+        advance_car(engine, slot, distance, time);
+    }
+
+    // Drop the cars that left
+    for (i = 0, n = 0; i < engine->count; ++i)
+    {
+        slot = engine->order[i];
+
+        if (seen[slot])
+            engine->order[n++] = slot;
+        else
+            engine->cars[slot].active = FALSE;
+    }
+
+    engine->count = n;
+
+    sort_order(engine);
+    update_gaps(engine);
+}
+
+int gaps_between(const gaps_engine* engine, int ahead, int behind, gaps_gap* gap)
+{
+    if (ahead < 0 || ahead >= GAPS_SLOTS || behind < 0 || behind >= GAPS_SLOTS ||
+        !engine->cars[ahead].active || !engine->cars[behind].active)
+    {
+        memset(gap, 0, sizeof(*gap));
+        return 1;
+    }
+
+    if (engine->cars[behind].marker <= engine->cars[ahead].marker)
+        return marker_gap(engine, ahead, behind, gap);
+
+    if (marker_gap(engine, behind, ahead, gap))
+        return 1;
+
+    gap->seconds = -gap->seconds;
+    gap->laps = -gap->laps;
+
+    return 0;
+}
+
+int gaps_pit_rejoin(const gaps_engine* engine, int slot, double pit_loss, gaps_rejoin* rejoin)
+{
+    const gaps_car* car;
+    gaps_gap gap;
+    int index, i, other;
+
+    rejoin->place = -1;
+    rejoin->place_class = -1;
+    rejoin->ahead = -1;
+    rejoin->behind = -1;
+    rejoin->gap_ahead = 0.0;
+    rejoin->gap_behind = 0.0;
+
+    if (slot < 0 || slot >= GAPS_SLOTS || !engine->cars[slot].active)
+        return 1;
+
+    car = &engine->cars[slot];
+    index = car->place - 1;
+
+    rejoin->place = car->place;
+    rejoin->place_class = car->place_class;
+
+    if (index > 0)
+    {
+        rejoin->ahead = engine->order[index - 1];
+        rejoin->gap_ahead = car->interval.seconds + pit_loss;
+    }
+
+    // Every car on the same lap less than pit_loss behind goes past
+    for (i = index + 1; i < engine->count; ++i)
+    {
+        other = engine->order[i];
+
+        if (marker_gap(engine, slot, other, &gap) || gap.laps > 0)
+            continue;
+
+        if (gap.seconds >= pit_loss)
+        {
+            rejoin->behind = other;
+            rejoin->gap_behind = gap.seconds - pit_loss;
+            break;
+        }
+
+        rejoin->place++;
+        if (engine->cars[other].class_id == car->class_id)
+            rejoin->place_class++;
+
+        rejoin->ahead = other;
+        rejoin->gap_ahead = pit_loss - gap.seconds;
+    }
+
+    return 0;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "r3e.h"
+#include "platform.h"
+
+// Cars tracked, indexed by driver_info.slot_id
+#define GAPS_SLOTS R3E_NUM_DRIVERS_MAX
+
+// Markers per lap, ~20 m apart on a 5 km layout
+#define GAPS_MARKERS_DEFAULT 256
+
+// Ticks a car's distance may run backwards (lap_distance wrapping a tick before
+// completed_laps goes up) before it is taken as a real jump and the car starts over
+#define GAPS_GLITCH_TICKS 8
+
+typedef struct
+{
+    // Time between the two cars passing the same point (s), and how many whole
+    // laps the car in front is ahead on top of that
+    double seconds;
+    r3e_int32 laps;
+    BOOL valid;
+} gaps_gap;
+
+typedef struct
+{
+    BOOL active;
+    r3e_int32 class_id;
+
+    // completed_laps * layout_length + lap_distance (m), and the time it was there (s)
+    double distance;
+    double time;
+    uint32_t glitch_ticks;
+
+    // Last marker passed, counted from the start of the first lap, -1 for none yet
+    int64_t marker;
+
+    // Place in distance order and in the class, from 1
+    int place;
+    int place_class;
+
+    // To the car ahead, the leader and the class leader
+    gaps_gap interval;
+    gaps_gap leader;
+    gaps_gap class_leader;
+} gaps_car;
+
+typedef struct
+{
+    // Place the car would come out in and the cars it would be between, -1 for none
+    int place;
+    int place_class;
+    int ahead;
+    int behind;
+
+    // Gaps to those cars once out (s)
+    double gap_ahead;
+    double gap_behind;
+} gaps_rejoin;
+
+// Live gaps from the time every car passes fixed points of the lap.
+// The lap is cut into markers evenly spaced along layout_length. Each tick,
+// gaps_update moves every car along by its new lap_distance and stores the
+// time it passed each marker in between, interpolated between the two ticks.
+// Storing one lap of marker times per car costs slots * markers * 12 bytes.
+//
+// The gap between two cars is then the difference between the times they
+// passed the last marker the one behind has reached: two lookups, with no
+// speed estimate involved, so it's as good as the marker spacing and holds
+// through corners and pit stops. Interval, gap to the leader and gap to the
+// class leader are worked out for every car per update, which is O(cars);
+// any other pair is answered on demand by gaps_between rather than keeping
+// a 128 x 128 matrix up to date.
+typedef struct
+{
+    uint32_t markers;
+    float layout_length;
+    double spacing;
+
+    // Time each car last passed each marker and the lap it was on
+    // Index: slot * markers + marker
+    double* pass_time;
+    r3e_int32* pass_lap;
+
+    gaps_car cars[GAPS_SLOTS];
+
+    // Active slots, leader first
+    int order[GAPS_SLOTS];
+    int count;
+} gaps_engine;
+
+// markers is the number of markers per lap, 0 for GAPS_MARKERS_DEFAULT. Returns 0 on success
+int gaps_init(gaps_engine* engine, uint32_t markers);
+void gaps_close(gaps_engine* engine);
+
+// Call once per tick, or for every frame read; markers passed since the last call are filled in
+void gaps_update(gaps_engine* engine, const r3e_shared* frame);
+
+// Gap from slot ahead to slot behind. Negative seconds when behind is actually in front.
+// Returns 0 if both cars have passed a marker the other one has
+int gaps_between(const gaps_engine* engine, int ahead, int behind, gaps_gap* gap);
+
+// Where slot would be if it lost pit_loss seconds here, e.g. the time a pit stop costs
+// over driving past the pit lane. Cars a lap or more down stay behind. Returns 0 on success
+int gaps_pit_rejoin(const gaps_engine* engine, int slot, double pit_loss, gaps_rejoin* rejoin);
@@ -0,0 +1,439 @@
+#include "history.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#pragma pack(push, 1)
+
+typedef struct
+{
+    char magic[4];
+    uint32_t format_version;
+} history_file_header;
+
+// Followed by the chunk's columns, count entries each, in history_chunk order
+typedef struct
+{
+    r3e_int32 slot;
+    uint32_t count;
+} history_chunk_header;
+
+#pragma pack(pop)
+
+int history_init(history* hist, size_t memory_cap, const char* spill_path)
+{
+    history_file_header header;
+
+    memset(hist, 0, sizeof(*hist));
+
+    hist->chunk_count = (uint32_t)(memory_cap / sizeof(history_chunk));
+    // A driver's newest chunk is never evicted, with a chunk per car and one
+    // more there is always another one to evict
+    if (hist->chunk_count < HISTORY_SLOTS + 1)
+        hist->chunk_count = HISTORY_SLOTS + 1;
+
+    hist->arena = (history_chunk*)aligned_malloc(hist->chunk_count * sizeof(history_chunk), CACHE_LINE_SIZE);
+    if (hist->arena == NULL)
+        return 1;
+
+    if (spill_path)
+    {
+        memcpy(header.magic, HISTORY_MAGIC, sizeof(header.magic));
+        header.format_version = HISTORY_FORMAT_VERSION;
+
+        hist->spill = file_open(spill_path, "wb");
+        if (hist->spill == NULL || fwrite(&header, sizeof(header), 1, hist->spill) != 1 ||
+            fflush(hist->spill) != 0)
+        {
+            history_close(hist);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+void history_close(history* hist)
+{
+    if (hist->spill) fclose(hist->spill);
+    aligned_free(hist->arena);
+
+    memset(hist, 0, sizeof(*hist));
+}
+
+static int write_chunk(FILE* file, const history_chunk* chunk)
+{
+    history_chunk_header header;
+    int c;
+
+    header.slot = chunk->slot;
+    header.count = chunk->count;
+
+    if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+        fwrite(chunk->lap, sizeof(chunk->lap[0]), chunk->count, file) != chunk->count ||
+        fwrite(chunk->lap_time, sizeof(chunk->lap_time[0]), chunk->count, file) != chunk->count)
+        return 1;
+
+    for (c = 0; c < 3; ++c)
+    {
+        if (fwrite(chunk->sector_time[c], sizeof(chunk->sector_time[c][0]), chunk->count, file) != chunk->count)
+            return 1;
+    }
+
+    if (fwrite(chunk->ticks, sizeof(chunk->ticks[0]), chunk->count, file) != chunk->count ||
+        fwrite(chunk->compound, sizeof(chunk->compound[0]), chunk->count, file) != chunk->count ||
+        fwrite(chunk->flags, sizeof(chunk->flags[0]), chunk->count, file) != chunk->count)
+        return 1;
+
+    return 0;
+}
+
+// Takes the chunk taken the longest ago that isn't its driver's newest away
+// from its driver, spilling it first
+static history_chunk* evict_chunk(history* hist)
+{
+    history_chunk* previous = NULL;
+    history_chunk* chunk = hist->first_taken;
+    history_driver* driver;
+
+    // Skips at most a chunk per driver, history_init makes sure one is left
+    while (chunk->newer == NULL)
+    {
+        previous = chunk;
+        chunk = chunk->next_taken;
+    }
+
+    driver = &hist->drivers[chunk->slot];
+
+    if (previous)
+        previous->next_taken = chunk->next_taken;
+    else
+        hist->first_taken = chunk->next_taken;
+    if (hist->last_taken == chunk)
+        hist->last_taken = previous;
+
+    // Chunks are taken in order, so the first one of a driver still in the list is its oldest
+    driver->oldest = chunk->newer;
+    if (driver->oldest)
+        driver->oldest->older = NULL;
+    else
+        driver->newest = NULL;
+
+    driver->laps_evicted += chunk->count;
+    hist->chunks_evicted++;
+
+    if (hist->spill)
+    {
+        if (write_chunk(hist->spill, chunk) || fflush(hist->spill) != 0)
+            hist->spill_errors++;
+        else
+            hist->chunks_spilled++;
+    }
+
+    return chunk;
+}
+
+static history_chunk* take_chunk(history* hist, int slot)
+{
+    history_driver* driver = &hist->drivers[slot];
+    history_chunk* chunk;
+
+    if (hist->chunks_taken < hist->chunk_count)
+        chunk = &hist->arena[hist->chunks_taken++];
+    else
+        chunk = evict_chunk(hist);
+
+    chunk->slot = slot;
+    chunk->count = 0;
+    chunk->next_taken = NULL;
+    chunk->newer = NULL;
+    chunk->older = driver->newest;
+
+    if (driver->newest)
+        driver->newest->newer = chunk;
+    else
+        driver->oldest = chunk;
+    driver->newest = chunk;
+
+    if (hist->last_taken)
+        hist->last_taken->next_taken = chunk;
+    else
+        hist->first_taken = chunk;
+    hist->last_taken = chunk;
+
+    return chunk;
+}
+
+static void append_lap(history* hist, int slot, const history_lap* lap)
+{
+    history_driver* driver = &hist->drivers[slot];
+    history_chunk* chunk = driver->newest;
+    uint32_t i;
+    int c;
+
+    if (chunk == NULL || chunk->count == HISTORY_CHUNK_LAPS)
+        chunk = take_chunk(hist, slot);
+
+    i = chunk->count++;
+    chunk->lap[i] = lap->lap;
+    chunk->lap_time[i] = lap->lap_time;
+    for (c = 0; c < 3; ++c)
+        chunk->sector_time[c][i] = lap->sector_time[c];
+    chunk->ticks[i] = lap->ticks;
+    chunk->compound[i] = (int8_t)lap->compound;
+    chunk->flags[i] = (uint8_t)lap->flags;
+
+    driver->laps++;
+    hist->laps++;
+}
+
+// Cumulative sector times (sector 2 includes sector 1, sector 3 is the lap time) to split times
+static void split_sectors(const r3e_float32* cumulative, r3e_float32* split)
+{
+    split[0] = cumulative[0];
+    split[1] = cumulative[0] >= 0.f && cumulative[1] >= 0.f ? cumulative[1] - cumulative[0] : -1.0f;
+    split[2] = cumulative[1] >= 0.f && cumulative[2] >= 0.f ? cumulative[2] - cumulative[1] : -1.0f;
+}
+
+static void complete_lap(history* hist, int slot, const r3e_driver_data* data, r3e_int32 ticks)
+{
+    history_driver* driver = &hist->drivers[slot];
+    const r3e_float32* sectors = data->sector_time_previous_self;
+    history_lap lap;
+
+    // The previous lap's times should be there from the tick the line is crossed,
+    // fall back to what was seen during the lap if they aren't yet
+    if (sectors[2] < 0.f)
+        sectors = driver->sector_time_current;
+
+    lap.lap = data->completed_laps;
+    lap.lap_time = sectors[2] >= 0.f ? sectors[2] : driver->lap_time_current;
+    split_sectors(sectors, lap.sector_time);
+    lap.ticks = ticks;
+    lap.compound = data->tire_subtype_front;
+    lap.flags = driver->flags;
+
+    append_lap(hist, slot, &lap);
+}
+
+static void start_lap(history_driver* driver, const r3e_driver_data* data, uint32_t flags)
+{
+    driver->completed_laps = data->completed_laps;
+    driver->track_sector = data->track_sector;
+    driver->lap_time_current = -1.0f;
+    driver->sector_time_current[0] = -1.0f;
+    driver->sector_time_current[1] = -1.0f;
+    driver->sector_time_current[2] = -1.0f;
+    driver->flags = flags;
+}
+
+void history_update(history* hist, const r3e_shared* frame)
+{
+    const r3e_driver_data* data;
+    history_driver* driver;
+    r3e_int32 sector;
+    int i, slot, count = frame->num_cars;
+
+    if (count > R3E_NUM_DRIVERS_MAX)
+        count = R3E_NUM_DRIVERS_MAX;
+
+    for (i = 0; i < count; ++i)
+    {
+        data = &frame->all_drivers_data_1[i];
+        slot = data->driver_info.slot_id;
+
+        if (slot < 0 || slot >= HISTORY_SLOTS)
+            continue;
+
+        driver = &hist->drivers[slot];
+        driver->class_id = data->driver_info.class_id;
+
+        if (!driver->seen)
+        {
+            driver->seen = TRUE;
+            driver->num_pitstops = data->num_pitstops;
+            start_lap(driver, data, HISTORY_LAP_PARTIAL);
+        }
+
+        // A stop counts for the lap it was made on, even if the counter only goes up on the line
+        if (data->num_pitstops != driver->num_pitstops)
+        {
+            driver->num_pitstops = data->num_pitstops;
+            driver->flags |= HISTORY_LAP_PITSTOP;
+        }
+
+        if (data->completed_laps != driver->completed_laps)
+        {
+            if (data->completed_laps == driver->completed_laps + 1)
+            {
+                complete_lap(hist, slot, data, frame->player.game_simulation_ticks);
+                start_lap(driver, data, 0);
+            }
+            else
+            {
+                // Laps missed, or a new session started
+                start_lap(driver, data, HISTORY_LAP_PARTIAL);
+            }
+        }
+        else if (data->track_sector != driver->track_sector)
+        {
+            sector = driver->track_sector;
+            if (sector >= 1 && sector <= 3)
+                driver->sector_time_current[sector - 1] = data->sector_time_current_self[sector - 1];
+            driver->track_sector = data->track_sector;
+        }
+
+        if (data->current_lap_valid == 0)
+            driver->flags |= HISTORY_LAP_INVALID;
+        if (data->in_pitlane > 0)
+            driver->flags |= HISTORY_LAP_PITLANE;
+
+        driver->lap_time_current = data->lap_time_current_self;
+    }
+}
+
+int history_recent(const history* hist, int slot, history_lap* out, int count)
+{
+    const history_chunk* chunk;
+    int copied = 0, i, c;
+
+    if (slot < 0 || slot >= HISTORY_SLOTS)
+        return 0;
+
+    for (chunk = hist->drivers[slot].newest; chunk != NULL && copied < count; chunk = chunk->older)
+    {
+        for (i = (int)chunk->count - 1; i >= 0 && copied < count; --i, ++copied)
+        {
+            out[copied].lap = chunk->lap[i];
+            out[copied].lap_time = chunk->lap_time[i];
+            for (c = 0; c < 3; ++c)
+                out[copied].sector_time[c] = chunk->sector_time[c][i];
+            out[copied].ticks = chunk->ticks[i];
+            out[copied].compound = chunk->compound[i];
+            out[copied].flags = chunk->flags[i];
+        }
+    }
+
+    return copied;
+}
+
+// Adds up the lap times of the driver's last laps laps that are timed and have none of the exclude flags
+static void sum_pace(const history_driver* driver, int laps, uint32_t exclude, double* sum, uint32_t* count)
+{
+    const history_chunk* chunk;
+    int i;
+
+    for (chunk = driver->newest; chunk != NULL && laps > 0; chunk = chunk->older)
+    {
+        for (i = (int)chunk->count - 1; i >= 0 && laps > 0; --i, --laps)
+        {
+            if ((chunk->flags[i] & exclude) != 0 || chunk->lap_time[i] <= 0.f)
+                continue;
+
+            *sum += chunk->lap_time[i];
+            (*count)++;
+        }
+    }
+}
+
+double history_driver_pace(const history* hist, int slot, int laps, uint32_t exclude)
+{
+    double sum = 0.0;
+    uint32_t count = 0;
+
+    if (slot < 0 || slot >= HISTORY_SLOTS)
+        return -1.0;
+
+    sum_pace(&hist->drivers[slot], laps, exclude, &sum, &count);
+
+    return count > 0 ? sum / count : -1.0;
+}
+
+double history_class_pace(const history* hist, r3e_int32 class_id, int laps, uint32_t exclude)
+{
+    const history_driver* driver;
+    double sum = 0.0;
+    uint32_t count = 0;
+    int slot;
+
+    for (slot = 0; slot < HISTORY_SLOTS; ++slot)
+    {
+        driver = &hist->drivers[slot];
+
+        if (driver->newest == NULL || (class_id != -1 && driver->class_id != class_id))
+            continue;
+
+        sum_pace(driver, laps, exclude, &sum, &count);
+    }
+
+    return count > 0 ? sum / count : -1.0;
+}
+
+int history_read_spill(const char* path, history_lap_func func, void* context)
+{
+    history_file_header header;
+    history_chunk_header chunk_header;
+    history_chunk* chunk;
+    history_lap lap;
+    FILE* file;
+    uint32_t i, n;
+    int c, result = 1;
+
+    file = file_open(path, "rb");
+    if (file == NULL)
+        return 1;
+
+    chunk = (history_chunk*)malloc(sizeof(history_chunk));
+
+    if (chunk == NULL ||
+        fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, HISTORY_MAGIC, sizeof(header.magic)) != 0 ||
+        header.format_version != HISTORY_FORMAT_VERSION)
+    {
+        free(chunk);
+        fclose(file);
+        return 1;
+    }
+
+    for (;;)
+    {
+        if (fread(&chunk_header, sizeof(chunk_header), 1, file) != 1)
+        {
+            // Only a clean end of file between chunks counts as read
+            result = feof(file) ? 0 : 1;
+            break;
+        }
+
+        n = chunk_header.count;
+        if (n > HISTORY_CHUNK_LAPS)
+            break;
+
+        if (fread(chunk->lap, sizeof(chunk->lap[0]), n, file) != n ||
+            fread(chunk->lap_time, sizeof(chunk->lap_time[0]), n, file) != n ||
+            fread(chunk->sector_time[0], sizeof(chunk->sector_time[0][0]), n, file) != n ||
+            fread(chunk->sector_time[1], sizeof(chunk->sector_time[1][0]), n, file) != n ||
+            fread(chunk->sector_time[2], sizeof(chunk->sector_time[2][0]), n, file) != n ||
+            fread(chunk->ticks, sizeof(chunk->ticks[0]), n, file) != n ||
+            fread(chunk->compound, sizeof(chunk->compound[0]), n, file) != n ||
+            fread(chunk->flags, sizeof(chunk->flags[0]), n, file) != n)
+            break;
+
+        for (i = 0; i < n; ++i)
+        {
+            lap.lap = chunk->lap[i];
+            lap.lap_time = chunk->lap_time[i];
+            for (c = 0; c < 3; ++c)
+                lap.sector_time[c] = chunk->sector_time[c][i];
+            lap.ticks = chunk->ticks[i];
+            lap.compound = chunk->compound[i];
+            lap.flags = chunk->flags[i];
+
+            func(chunk_header.slot, &lap, context);
+        }
+    }
+
+    free(chunk);
+    fclose(file);
+
+    return result;
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "r3e.h"
+#include "platform.h"
+
+#define HISTORY_MAGIC "R3EH"
+#define HISTORY_FORMAT_VERSION 1
+
+// Driver slots tracked, indexed by driver_info.slot_id
+#define HISTORY_SLOTS R3E_NUM_DRIVERS_MAX
+
+// Laps per chunk, the unit memory is handed out, evicted and spilled in
+#define HISTORY_CHUNK_LAPS 32
+
+// ~300k laps, more than 128 cars do in a 24 h race
+#define HISTORY_MEMORY_DEFAULT (8 * 1024 * 1024)
+
+// What happened on a lap, laps without any of these are clean timed laps
+enum
+{
+    // current_lap_valid went to 0 at some point in the lap
+    HISTORY_LAP_INVALID = 1,
+
+    // The car was in the pit lane at some point in the lap (in- and out-laps)
+    HISTORY_LAP_PITLANE = 2,
+
+    // num_pitstops went up during the lap
+    HISTORY_LAP_PITSTOP = 4,
+
+    // The store didn't see the whole lap (started mid-lap, or laps were skipped)
+    HISTORY_LAP_PARTIAL = 8,
+
+    // Laps to leave out of pace figures
+    HISTORY_LAP_NOT_CLEAN = HISTORY_LAP_INVALID | HISTORY_LAP_PITLANE | HISTORY_LAP_PITSTOP | HISTORY_LAP_PARTIAL,
+};
+
+// One lap, as returned by the queries
+typedef struct
+{
+    // completed_laps once the lap was done, so the first lap is 1
+    r3e_int32 lap;
+
+    // Lap time and the time of each sector on its own, -1.0 = N/A (s)
+    r3e_float32 lap_time;
+    r3e_float32 sector_time[3];
+
+    // player.game_simulation_ticks when the lap was completed
+    r3e_int32 ticks;
+
+    // r3e_tire_subtype of the front tires at the end of the lap
+    r3e_int32 compound;
+
+    uint32_t flags;
+} history_lap;
+
+// HISTORY_CHUNK_LAPS laps of one driver, one column per field
+typedef struct history_chunk
+{
+    // The driver's chunks, newest first
+    struct history_chunk* older;
+    struct history_chunk* newer;
+
+    // Chunks in use in the order they were taken, eviction takes the first
+    // one that isn't its driver's newest
+    struct history_chunk* next_taken;
+
+    int slot;
+    uint32_t count;
+
+    r3e_int32 lap[HISTORY_CHUNK_LAPS];
+    r3e_float32 lap_time[HISTORY_CHUNK_LAPS];
+    r3e_float32 sector_time[3][HISTORY_CHUNK_LAPS];
+    r3e_int32 ticks[HISTORY_CHUNK_LAPS];
+    int8_t compound[HISTORY_CHUNK_LAPS];
+    uint8_t flags[HISTORY_CHUNK_LAPS];
+} history_chunk;
+
+typedef struct
+{
+    BOOL seen;
+    r3e_int32 class_id;
+
+    // State of the lap in progress
+    r3e_int32 completed_laps;
+    r3e_int32 track_sector;
+    r3e_int32 num_pitstops;
+    r3e_float32 lap_time_current;
+    r3e_float32 sector_time_current[3];
+    uint32_t flags;
+
+    history_chunk* newest;
+    history_chunk* oldest;
+
+    // Laps recorded, and the ones of them evicted since
+    uint64_t laps;
+    uint64_t laps_evicted;
+} history_driver;
+
+// Lap and sector history of every car in the session.
+// r3e_driver_data only has the current, previous and best sector times, so
+// history_update watches completed_laps and track_sector each tick and
+// appends a lap to the car's history whenever it crosses the line.
+//
+// Memory is one arena allocated up front, cut into chunks of laps. A driver
+// takes a chunk whenever its newest one is full; once the arena is used up
+// the chunk taken the longest ago (the oldest laps of whichever car) is
+// written to the spill file, if there is one, and reused. A driver's newest
+// chunk is never evicted, so its latest laps (at least the last one, up to
+// HISTORY_CHUNK_LAPS) are always in memory and queries never touch the disk;
+// at the default cap nothing is evicted at all.
+typedef struct
+{
+    history_driver drivers[HISTORY_SLOTS];
+
+    history_chunk* arena;
+    uint32_t chunk_count;
+    uint32_t chunks_taken;
+
+    history_chunk* first_taken;
+    history_chunk* last_taken;
+
+    FILE* spill;
+
+    // Statistics
+    uint64_t laps;
+    uint64_t chunks_evicted;
+    uint64_t chunks_spilled;
+    uint64_t spill_errors;
+} history;
+
+// memory_cap is the arena size in bytes, at least one chunk per slot and one more
+// (~100 KB) is always allocated.
+// spill_path names a file evicted laps are written to, NULL drops them instead.
+// Returns 0 on success
+int history_init(history* hist, size_t memory_cap, const char* spill_path);
+void history_close(history* hist);
+
+// Call once per tick (or as often as frames are read)
+void history_update(history* hist, const r3e_shared* frame);
+
+// Copies up to count of the driver's laps still in memory into out, newest first.
+// Returns the number copied
+int history_recent(const history* hist, int slot, history_lap* out, int count);
+
+// Mean lap time over the last laps laps of a driver, skipping the ones with any of the
+// exclude flags (e.g. HISTORY_LAP_NOT_CLEAN). Returns -1.0 if there are none (s)
+double history_driver_pace(const history* hist, int slot, int laps, uint32_t exclude);
+
+// The same over every driver of class_id, -1 for all classes (s)
+double history_class_pace(const history* hist, r3e_int32 class_id, int laps, uint32_t exclude);
+
+typedef void (*history_lap_func)(int slot, const history_lap* lap, void* context);
+
+// Reads back the laps written to a spill file, oldest chunk first.
+// Returns 0 if the whole file was read
+int history_read_spill(const char* path, history_lap_func func, void* context);
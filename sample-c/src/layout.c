@@ -0,0 +1,108 @@
+#include "layout.h"
+
+#include <string.h>
+
+// Adds a copy, or extends the last one if this one carries straight on from it
+static void add_copy(layout_adapter* layout, uint32_t source_offset, uint32_t dest_offset, uint32_t size)
+{
+    snapshot_copy* last = layout->num_copies > 0 ? &layout->copies[layout->num_copies - 1] : NULL;
+
+    if (last && last->source_offset + last->size == source_offset && last->dest_offset + last->size == dest_offset)
+    {
+        last->size += size;
+        return;
+    }
+
+    layout->copies[layout->num_copies].source_offset = source_offset;
+    layout->copies[layout->num_copies].dest_offset = dest_offset;
+    layout->copies[layout->num_copies].size = size;
+    layout->num_copies++;
+}
+
+int layout_negotiate(layout_adapter* layout, const void* header)
+{
+    const uint32_t num_cars_offset = (uint32_t)offsetof(r3e_shared, num_cars);
+    const uint32_t drivers_gap = (uint32_t)(offsetof(r3e_shared, all_drivers_data_1) - offsetof(r3e_shared, num_cars));
+    const uint32_t player_end = (uint32_t)(offsetof(r3e_shared, player) + sizeof(r3e_playerdata));
+    const uint32_t record_size = (uint32_t)sizeof(r3e_driver_data);
+    const r3e_int32* values = (const r3e_int32*)header;
+    uint32_t drivers_offset, driver_size, i;
+
+    memset(layout, 0, sizeof(*layout));
+
+    layout->version_major = values[0];
+    layout->version_minor = values[1];
+    layout->all_drivers_offset = values[2];
+    layout->driver_data_size = values[3];
+    layout->match = LAYOUT_UNSUPPORTED;
+
+    if (layout->version_major == 0)
+    {
+        layout->match = LAYOUT_NOT_READY;
+        return 1;
+    }
+
+    // The tick the snapshot guard reads has to be in the part we copy as is
+    if (layout->version_major != R3E_VERSION_MAJOR ||
+        layout->all_drivers_offset < (r3e_int32)player_end || layout->all_drivers_offset > LAYOUT_SIZE_MAX ||
+        layout->driver_data_size <= 0 || layout->driver_data_size > LAYOUT_DRIVER_SIZE_MAX)
+        return 1;
+
+    drivers_offset = (uint32_t)layout->all_drivers_offset;
+    driver_size = (uint32_t)layout->driver_data_size;
+    layout->size = drivers_offset + drivers_gap + R3E_NUM_DRIVERS_MAX * (size_t)driver_size;
+
+    if (layout->version_minor == R3E_VERSION_MINOR && drivers_offset == num_cars_offset && driver_size == record_size)
+    {
+        layout->match = LAYOUT_EXACT;
+        return 0;
+    }
+
+    layout->match = LAYOUT_ADAPTED;
+
+    add_copy(layout, 0, 0, drivers_offset < num_cars_offset ? drivers_offset : num_cars_offset);
+    add_copy(layout, drivers_offset, num_cars_offset, (uint32_t)sizeof(r3e_int32));
+
+    for (i = 0; i < R3E_NUM_DRIVERS_MAX; ++i)
+    {
+        add_copy(layout, drivers_offset + drivers_gap + i * driver_size,
+            num_cars_offset + drivers_gap + i * record_size,
+            driver_size < record_size ? driver_size : record_size);
+    }
+
+    return 0;
+}
+
+int layout_map(layout_adapter* layout, shared_map* map, const char* name)
+{
+    int err_code;
+
+    if (shared_map_open(map, name, LAYOUT_HEADER_SIZE, FALSE))
+    {
+        layout->match = LAYOUT_UNSUPPORTED;
+        return 1;
+    }
+
+    err_code = layout_negotiate(layout, map->view);
+    shared_map_close(map);
+
+    if (err_code)
+        return 1;
+
+    return shared_map_open(map, name, layout->size, FALSE);
+}
+
+int layout_read(const layout_adapter* layout, snapshot_reader* reader, r3e_shared* dest)
+{
+    int err_code;
+
+    if (layout->match == LAYOUT_EXACT)
+        return snapshot_read(reader, dest);
+
+    err_code = snapshot_read_copies(reader, dest, layout->copies, layout->num_copies);
+
+    dest->all_drivers_offset = (r3e_int32)offsetof(r3e_shared, num_cars);
+    dest->driver_data_size = (r3e_int32)sizeof(r3e_driver_data);
+
+    return err_code;
+}
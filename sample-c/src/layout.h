@@ -0,0 +1,74 @@
+#pragma once
+
+#include "r3e.h"
+#include "platform.h"
+#include "snapshot.h"
+
+// The version block at the start of the shared memory, all layout_negotiate reads
+#define LAYOUT_HEADER_SIZE (4 * sizeof(r3e_int32))
+
+// Largest block or driver record a header is believed about
+#define LAYOUT_SIZE_MAX (16 * 1024 * 1024)
+#define LAYOUT_DRIVER_SIZE_MAX (64 * 1024)
+
+// Prefix, num_cars and a record per driver, before merging
+#define LAYOUT_COPIES_MAX (2 + R3E_NUM_DRIVERS_MAX)
+
+typedef enum
+{
+    // The version and layout r3e.h describes, frames are copied as they are
+    LAYOUT_EXACT = 0,
+
+    // Same major version, but a different minor version or driver array
+    // offset or record size. Frames are copied through a remapping.
+    LAYOUT_ADAPTED = 1,
+
+    // Another major version, or a header that makes no sense
+    LAYOUT_UNSUPPORTED = 2,
+
+    // The version is still 0: the game created the shared memory but hasn't
+    // written the header yet, try again later
+    LAYOUT_NOT_READY = 3
+} layout_match;
+
+// What the game's shared memory looks like compared to r3e.h, worked out once
+// when it is mapped. A minor version bump keeps the fields we know where they
+// were and adds new ones at the end of the main block (before num_cars) or of
+// the driver record, which moves the driver array; all_drivers_offset and
+// driver_data_size say where it went. The remapping copies the known part of
+// the main block, num_cars and every driver record (at the game's stride) to
+// where r3e_shared has them, so everything downstream keeps using r3e.h.
+// Contiguous copies are merged, so a layout that only differs in its version
+// number is still one copy.
+typedef struct
+{
+    // As the game reports them
+    r3e_int32 version_major;
+    r3e_int32 version_minor;
+    r3e_int32 all_drivers_offset;
+    r3e_int32 driver_data_size;
+
+    layout_match match;
+
+    // Bytes to map for the game's layout
+    size_t size;
+
+    // Remapping for LAYOUT_ADAPTED
+    snapshot_copy copies[LAYOUT_COPIES_MAX];
+    int num_copies;
+} layout_adapter;
+
+// Works out the layout from the first LAYOUT_HEADER_SIZE bytes of the shared memory
+// Returns 0 if it can be read (exact or adapted), 1 if it's unsupported or not written yet
+int layout_negotiate(layout_adapter* layout, const void* header);
+
+// Maps the shared memory sized for the layout its header reports
+// Returns 0 on success, 1 if it couldn't be mapped or the layout is unsupported or not ready (see layout->match)
+int layout_map(layout_adapter* layout, shared_map* map, const char* name);
+
+// Copies a frame into dest in the r3e.h layout, as snapshot_read for an exact
+// layout. In dest all_drivers_offset and driver_data_size describe r3e_shared,
+// the version stays the game's. Fields the game's layout doesn't have are left
+// as they were in dest.
+// Returns 0 on a consistent copy, 1 if every attempt was torn
+int layout_read(const layout_adapter* layout, snapshot_reader* reader, r3e_shared* dest);
@@ -0,0 +1,452 @@
+#include "metrics.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// How often the dump thread checks for stop while waiting out the interval
+#define DUMP_POLL_MS 50
+
+#define LINE_MAX_CHARS 512
+
+void metrics_init(metrics_registry* registry, BOOL enabled)
+{
+    memset(registry, 0, sizeof(*registry));
+
+    registry->enabled = enabled;
+    registry->start_us = time_now_us();
+}
+
+void metrics_close(metrics_registry* registry)
+{
+    int s;
+
+    metrics_dump_stop(registry);
+
+    for (s = 0; s < registry->num_shards; ++s)
+        aligned_free(registry->shards[s]);
+
+    memset(registry, 0, sizeof(*registry));
+}
+
+static void copy_name(char* dest, size_t size, const char* name)
+{
+    snprintf(dest, size, "%s", name);
+}
+
+int metrics_register_counter(metrics_registry* registry, const char* name)
+{
+    if (registry->num_counters == METRICS_COUNTERS_MAX)
+        return -1;
+
+    copy_name(registry->counter_names[registry->num_counters], METRICS_NAME_MAX, name);
+
+    return registry->num_counters++;
+}
+
+int metrics_register_histogram(metrics_registry* registry, const char* name, const char* unit)
+{
+    if (registry->num_histograms == METRICS_HISTOGRAMS_MAX)
+        return -1;
+
+    copy_name(registry->histogram_names[registry->num_histograms], METRICS_NAME_MAX, name);
+    copy_name(registry->histogram_units[registry->num_histograms], METRICS_UNIT_MAX, unit);
+
+    return registry->num_histograms++;
+}
+
+metrics_shard* metrics_shard_open(metrics_registry* registry, const char* name)
+{
+    metrics_shard* shard;
+
+    if (!registry->enabled || registry->num_shards == METRICS_SHARDS_MAX)
+        return NULL;
+
+    shard = (metrics_shard*)aligned_malloc(sizeof(metrics_shard), CACHE_LINE_SIZE);
+    if (shard == NULL)
+        return NULL;
+
+    memset(shard, 0, sizeof(*shard));
+    copy_name(shard->name, sizeof(shard->name), name);
+
+    registry->shards[registry->num_shards++] = shard;
+
+    return shard;
+}
+
+static int highest_bit(uint64_t value)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+
+    if (_BitScanReverse(&index, (unsigned long)(value >> 32)))
+        return (int)index + 32;
+
+    _BitScanReverse(&index, (unsigned long)value);
+    return (int)index;
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+static int bucket_of(uint64_t value)
+{
+    int shift;
+
+    if (value >= ((uint64_t)1 << METRICS_VALUE_BITS))
+        value = ((uint64_t)1 << METRICS_VALUE_BITS) - 1;
+
+    if (value < (1u << METRICS_SUB_BITS))
+        return (int)value;
+
+    shift = highest_bit(value) - METRICS_SUB_BITS + 1;
+
+    return (shift << (METRICS_SUB_BITS - 1)) + (int)(value >> shift);
+}
+
+// Middle of the range of values that land in bucket
+static uint64_t bucket_value(int bucket)
+{
+    int shift;
+
+    if (bucket < (1 << METRICS_SUB_BITS))
+        return (uint64_t)bucket;
+
+    shift = (bucket >> (METRICS_SUB_BITS - 1)) - 1;
+
+    return ((uint64_t)(bucket - (shift << (METRICS_SUB_BITS - 1))) << shift) + (((uint64_t)1 << shift) - 1) / 2;
+}
+
+void metrics_add(metrics_shard* shard, int counter, uint64_t n)
+{
+    if ((unsigned)counter >= METRICS_COUNTERS_MAX)
+        return;
+
+    shard->sequence++;
+    platform_compiler_barrier();
+
+    shard->counters[counter] += n;
+
+    platform_compiler_barrier();
+    shard->sequence++;
+}
+
+void metrics_record(metrics_shard* shard, int histogram, uint64_t value)
+{
+    metrics_histogram_data* data;
+    int bucket = bucket_of(value);
+
+    if ((unsigned)histogram >= METRICS_HISTOGRAMS_MAX)
+        return;
+
+    data = &shard->histograms[histogram];
+
+    shard->sequence++;
+    platform_compiler_barrier();
+
+    data->buckets[bucket]++;
+    if (data->count == 0 || value < data->min)
+        data->min = value;
+    if (value > data->max)
+        data->max = value;
+    data->count++;
+    data->sum += value;
+
+    platform_compiler_barrier();
+    shard->sequence++;
+}
+
+static uint32_t read_begin(const metrics_shard* shard)
+{
+    uint32_t sequence;
+
+    while ((sequence = shard->sequence) & 1)
+        platform_cpu_relax();
+
+    platform_barrier();
+
+    return sequence;
+}
+
+static BOOL read_retry(const metrics_shard* shard, uint32_t sequence)
+{
+    platform_barrier();
+
+    return shard->sequence != sequence;
+}
+
+static uint64_t shard_counter(const metrics_shard* shard, int counter)
+{
+    uint32_t sequence;
+    uint64_t value;
+
+    do
+    {
+        sequence = read_begin(shard);
+        value = shard->counters[counter];
+    } while (read_retry(shard, sequence));
+
+    return value;
+}
+
+uint64_t metrics_counter_value(const metrics_registry* registry, int counter)
+{
+    uint64_t value = 0;
+    int s;
+
+    if (counter < 0 || counter >= registry->num_counters)
+        return 0;
+
+    for (s = 0; s < registry->num_shards; ++s)
+        value += shard_counter(registry->shards[s], counter);
+
+    return value;
+}
+
+// Bucket value at fraction of the way through the merged samples
+static uint64_t percentile(const metrics_histogram_data* data, double fraction)
+{
+    uint64_t target = (uint64_t)(data->count * fraction), seen = 0;
+    uint64_t value;
+    int b;
+
+    for (b = 0; b < METRICS_BUCKETS; ++b)
+    {
+        seen += data->buckets[b];
+        if (seen > target)
+            break;
+    }
+
+    value = bucket_value(b < METRICS_BUCKETS ? b : METRICS_BUCKETS - 1);
+
+    if (value > data->max)
+        value = data->max;
+    if (value < data->min)
+        value = data->min;
+
+    return value;
+}
+
+void metrics_histogram_summary(const metrics_registry* registry, int histogram, metrics_summary* summary)
+{
+    metrics_histogram_data merged, copy;
+    const metrics_shard* shard;
+    uint32_t sequence;
+    int s, b;
+
+    memset(summary, 0, sizeof(*summary));
+
+    if (histogram < 0 || histogram >= registry->num_histograms)
+        return;
+
+    memset(&merged, 0, sizeof(merged));
+
+    for (s = 0; s < registry->num_shards; ++s)
+    {
+        shard = registry->shards[s];
+
+        do
+        {
+            sequence = read_begin(shard);
+            memcpy(&copy, &shard->histograms[histogram], sizeof(copy));
+        } while (read_retry(shard, sequence));
+
+        if (copy.count == 0)
+            continue;
+
+        for (b = 0; b < METRICS_BUCKETS; ++b)
+            merged.buckets[b] += copy.buckets[b];
+
+        if (merged.count == 0 || copy.min < merged.min)
+            merged.min = copy.min;
+        if (copy.max > merged.max)
+            merged.max = copy.max;
+        merged.count += copy.count;
+        merged.sum += copy.sum;
+    }
+
+    if (merged.count == 0)
+        return;
+
+    summary->count = merged.count;
+    summary->sum = merged.sum;
+    summary->min = merged.min;
+    summary->max = merged.max;
+    summary->mean = (double)merged.sum / merged.count;
+    summary->p50 = percentile(&merged, 0.5);
+    summary->p90 = percentile(&merged, 0.9);
+    summary->p99 = percentile(&merged, 0.99);
+    summary->p999 = percentile(&merged, 0.999);
+}
+
+// Lines go to file, or the console when file is NULL
+static int write_line(FILE* file, const char* line)
+{
+    if (file == NULL)
+    {
+        wprintf_s(NARROW_STR L"\n", line);
+        return 0;
+    }
+
+    return fprintf(file, "%s\n", line) < 0;
+}
+
+static int write_text(const metrics_registry* registry, FILE* file)
+{
+    char line[LINE_MAX_CHARS];
+    metrics_summary summary;
+    size_t length;
+    int i, s, err = 0;
+
+    snprintf(line, sizeof(line), "Metrics after %.1f s", (time_now_us() - registry->start_us) / 1e6);
+    err |= write_line(file, line);
+
+    for (i = 0; i < registry->num_counters; ++i)
+    {
+        length = (size_t)snprintf(line, sizeof(line), "  %-24s %12llu", registry->counter_names[i],
+            (unsigned long long)metrics_counter_value(registry, i));
+
+        // Per shard breakdown when there's more than one to tell apart
+        for (s = 0; registry->num_shards > 1 && s < registry->num_shards && length < sizeof(line); ++s)
+        {
+            length += (size_t)snprintf(line + length, sizeof(line) - length, "%s%s %llu", s == 0 ? "  (" : ", ",
+                registry->shards[s]->name, (unsigned long long)shard_counter(registry->shards[s], i));
+
+            if (s == registry->num_shards - 1 && length < sizeof(line))
+                snprintf(line + length, sizeof(line) - length, ")");
+        }
+
+        err |= write_line(file, line);
+    }
+
+    for (i = 0; i < registry->num_histograms; ++i)
+    {
+        metrics_histogram_summary(registry, i, &summary);
+
+        snprintf(line, sizeof(line), "  %-24s %12llu samples, mean %.1f, min %llu, p50 %llu, p90 %llu, p99 %llu, p99.9 %llu, max %llu %s",
+            registry->histogram_names[i], (unsigned long long)summary.count, summary.mean,
+            (unsigned long long)summary.min, (unsigned long long)summary.p50, (unsigned long long)summary.p90,
+            (unsigned long long)summary.p99, (unsigned long long)summary.p999, (unsigned long long)summary.max,
+            registry->histogram_units[i]);
+
+        err |= write_line(file, line);
+    }
+
+    return err;
+}
+
+static int write_json(const metrics_registry* registry, FILE* file)
+{
+    metrics_summary summary;
+    int i, s;
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"uptime_s\": %.3f,\n", (time_now_us() - registry->start_us) / 1e6);
+
+    fprintf(file, "  \"counters\": {\n");
+    for (i = 0; i < registry->num_counters; ++i)
+    {
+        fprintf(file, "    \"%s\": { \"total\": %llu, \"shards\": {", registry->counter_names[i],
+            (unsigned long long)metrics_counter_value(registry, i));
+
+        for (s = 0; s < registry->num_shards; ++s)
+            fprintf(file, "%s \"%s\": %llu", s == 0 ? "" : ",", registry->shards[s]->name,
+                (unsigned long long)shard_counter(registry->shards[s], i));
+
+        fprintf(file, " } }%s\n", i + 1 < registry->num_counters ? "," : "");
+    }
+    fprintf(file, "  },\n");
+
+    fprintf(file, "  \"histograms\": {\n");
+    for (i = 0; i < registry->num_histograms; ++i)
+    {
+        metrics_histogram_summary(registry, i, &summary);
+
+        fprintf(file, "    \"%s\": { \"unit\": \"%s\", \"count\": %llu, \"mean\": %.3f, \"min\": %llu, "
+            "\"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"p999\": %llu, \"max\": %llu }%s\n",
+            registry->histogram_names[i], registry->histogram_units[i], (unsigned long long)summary.count,
+            summary.mean, (unsigned long long)summary.min, (unsigned long long)summary.p50,
+            (unsigned long long)summary.p90, (unsigned long long)summary.p99, (unsigned long long)summary.p999,
+            (unsigned long long)summary.max, i + 1 < registry->num_histograms ? "," : "");
+    }
+    fprintf(file, "  }\n");
+
+    return fprintf(file, "}\n") < 0;
+}
+
+int metrics_write(const metrics_registry* registry, FILE* file, metrics_format format)
+{
+    if (format == METRICS_JSON)
+        return write_json(registry, file);
+
+    return write_text(registry, file);
+}
+
+void metrics_print(const metrics_registry* registry)
+{
+    write_text(registry, NULL);
+}
+
+// Writes next to the target and moves it over, so the file is never half written
+static int dump_once(const metrics_registry* registry)
+{
+    char temp_path[sizeof(registry->path) + 4];
+    FILE* file;
+    int err;
+
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", registry->path);
+
+    file = file_open(temp_path, "w");
+    if (file == NULL)
+        return 1;
+
+    err = metrics_write(registry, file, registry->format);
+    err |= fclose(file) != 0;
+
+    return err || file_replace(temp_path, registry->path);
+}
+
+static void dump_main(void* arg)
+{
+    metrics_registry* registry = (metrics_registry*)arg;
+    uint64_t next_us = time_now_us() + registry->interval_ms * 1000ull;
+
+    while (!registry->stop)
+    {
+        sleep_ms(DUMP_POLL_MS);
+
+        if (time_now_us() < next_us)
+            continue;
+
+        if (dump_once(registry))
+            registry->dump_errors++;
+
+        next_us += registry->interval_ms * 1000ull;
+    }
+}
+
+int metrics_dump_start(metrics_registry* registry, const char* path, metrics_format format, uint32_t interval_ms)
+{
+    if (registry->thread.started || strlen(path) >= sizeof(registry->path))
+        return 1;
+
+    copy_name(registry->path, sizeof(registry->path), path);
+    registry->format = format;
+    registry->interval_ms = interval_ms > 0 ? interval_ms : METRICS_DUMP_INTERVAL_DEFAULT;
+    registry->stop = FALSE;
+
+    return thread_start(&registry->thread, dump_main, registry);
+}
+
+void metrics_dump_stop(metrics_registry* registry)
+{
+    if (!registry->thread.started)
+        return;
+
+    registry->stop = TRUE;
+    thread_join(&registry->thread);
+    memset(&registry->thread, 0, sizeof(registry->thread));
+
+    // One last time, so the file ends up with the final numbers
+    if (dump_once(registry))
+        registry->dump_errors++;
+}
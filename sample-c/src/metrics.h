@@ -0,0 +1,135 @@
+#pragma once
+
+#include "platform.h"
+
+#define METRICS_COUNTERS_MAX 32
+#define METRICS_HISTOGRAMS_MAX 16
+#define METRICS_SHARDS_MAX 16
+#define METRICS_NAME_MAX 48
+#define METRICS_UNIT_MAX 8
+
+// Histogram buckets are log-linear, like HDR histograms: values below
+// 2^METRICS_SUB_BITS get a bucket each, above that every power of two is split
+// into 2^(METRICS_SUB_BITS - 1) buckets, so a bucket is within ~6% of the
+// values in it. Values of METRICS_VALUE_BITS bits or more go in the last bucket.
+#define METRICS_SUB_BITS 5
+#define METRICS_VALUE_BITS 40
+#define METRICS_BUCKETS ((METRICS_VALUE_BITS - METRICS_SUB_BITS + 2) << (METRICS_SUB_BITS - 1))
+
+#define METRICS_DUMP_INTERVAL_DEFAULT 1000
+
+typedef enum
+{
+    METRICS_TEXT = 0,
+    METRICS_JSON = 1,
+} metrics_format;
+
+typedef struct
+{
+    uint32_t buckets[METRICS_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+} metrics_histogram_data;
+
+// Counters and histograms of one thread. Only the owning thread writes it, so
+// updates are plain increments with no atomics or locks. The sequence number
+// is odd while an update is in progress; readers on other threads copy what
+// they need and retry if it changed meanwhile, which keeps 64-bit values whole
+// on 32-bit builds too.
+// Note: Relies on x86 keeping stores in order, only the compiler is fenced
+typedef struct
+{
+    volatile uint32_t sequence;
+    char name[METRICS_NAME_MAX];
+
+    uint64_t counters[METRICS_COUNTERS_MAX];
+    metrics_histogram_data histograms[METRICS_HISTOGRAMS_MAX];
+} metrics_shard;
+
+typedef struct
+{
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    double mean;
+
+    // Percentiles, to the middle of the bucket they fall in
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t p999;
+} metrics_summary;
+
+// Counters and histograms for watching a capture pipeline while it runs.
+// Metrics are registered by name at setup and updated by id through a shard
+// each thread opens for itself. Readers (metrics_counter_value, the dump
+// thread, ...) add the shards up, counters are also listed per shard so e.g.
+// each ring consumer's overruns show up under its own name.
+//
+// A disabled registry hands out NULL shards, and METRICS_ADD/METRICS_RECORD
+// skip NULL shards, so instrumented code costs a branch per update when
+// metrics are off. Define METRICS_DISABLED to compile the updates out entirely.
+typedef struct
+{
+    BOOL enabled;
+
+    char counter_names[METRICS_COUNTERS_MAX][METRICS_NAME_MAX];
+    int num_counters;
+
+    char histogram_names[METRICS_HISTOGRAMS_MAX][METRICS_NAME_MAX];
+    char histogram_units[METRICS_HISTOGRAMS_MAX][METRICS_UNIT_MAX];
+    int num_histograms;
+
+    metrics_shard* shards[METRICS_SHARDS_MAX];
+    int num_shards;
+
+    uint64_t start_us;
+
+    // Periodic dump
+    platform_thread thread;
+    volatile BOOL stop;
+    char path[260];
+    metrics_format format;
+    uint32_t interval_ms;
+    uint64_t dump_errors;
+} metrics_registry;
+
+void metrics_init(metrics_registry* registry, BOOL enabled);
+void metrics_close(metrics_registry* registry);
+
+// Registration and opening shards happen at setup, before the threads updating them start.
+// The register functions return the id to update with, or -1 when full (updates to -1 are ignored)
+int metrics_register_counter(metrics_registry* registry, const char* name);
+int metrics_register_histogram(metrics_registry* registry, const char* name, const char* unit);
+
+// A shard for one thread to update, NULL if the registry is disabled or has no shards left
+metrics_shard* metrics_shard_open(metrics_registry* registry, const char* name);
+
+void metrics_add(metrics_shard* shard, int counter, uint64_t n);
+void metrics_record(metrics_shard* shard, int histogram, uint64_t value);
+
+#ifdef METRICS_DISABLED
+#define METRICS_ADD(shard, counter, n) ((void)sizeof(shard), (void)sizeof(counter), (void)sizeof(n))
+#define METRICS_RECORD(shard, histogram, value) ((void)sizeof(shard), (void)sizeof(histogram), (void)sizeof(value))
+#else
+#define METRICS_ADD(shard, counter, n) ((shard) ? metrics_add(shard, counter, n) : (void)0)
+#define METRICS_RECORD(shard, histogram, value) ((shard) ? metrics_record(shard, histogram, value) : (void)0)
+#endif
+
+// Readers, safe to call from any thread while the shards are being updated
+uint64_t metrics_counter_value(const metrics_registry* registry, int counter);
+void metrics_histogram_summary(const metrics_registry* registry, int histogram, metrics_summary* summary);
+
+// Writes every metric to file, returns 0 on success
+int metrics_write(const metrics_registry* registry, FILE* file, metrics_format format);
+
+// Prints every metric to the console as text
+void metrics_print(const metrics_registry* registry);
+
+// Rewrites path every interval_ms from a background thread, returns 0 on success
+// The file is replaced in one go, so readers never see half of it
+int metrics_dump_start(metrics_registry* registry, const char* path, metrics_format format, uint32_t interval_ms);
+void metrics_dump_stop(metrics_registry* registry);
@@ -0,0 +1,234 @@
+#ifndef _WIN32
+// ip_mreq is outside of POSIX
+#define _DEFAULT_SOURCE
+#endif
+
+#include "net.h"
+
+#include <string.h>
+
+#ifdef _WIN32
+
+#include <ws2tcpip.h>
+
+#pragma comment(lib, "ws2_32.lib")
+
+#define close_handle closesocket
+#define INVALID_HANDLE INVALID_SOCKET
+
+typedef int socklen_t;
+
+int net_init()
+{
+    WSADATA data;
+
+    return WSAStartup(MAKEWORD(2, 2), &data) != 0;
+}
+
+void net_cleanup()
+{
+    WSACleanup();
+}
+
+#else
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define close_handle close
+#define INVALID_HANDLE -1
+
+int net_init()
+{
+    return 0;
+}
+
+void net_cleanup()
+{
+}
+
+#endif
+
+static int open_socket(udp_socket* sock, const char* group)
+{
+    memset(sock, 0, sizeof(*sock));
+
+    sock->group = inet_addr(group);
+    if (sock->group == INADDR_NONE)
+        return 1;
+
+    sock->handle = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock->handle == INVALID_HANDLE)
+        return 1;
+
+    sock->open = TRUE;
+    return 0;
+}
+
+int udp_open_sender(udp_socket* sock, const char* group, int ttl, BOOL loopback)
+{
+    unsigned char ttl_value = (unsigned char)ttl;
+    unsigned char loop_value = loopback ? 1 : 0;
+
+    if (open_socket(sock, group))
+        return 1;
+
+    if (setsockopt(sock->handle, IPPROTO_IP, IP_MULTICAST_TTL, (const char*)&ttl_value, sizeof(ttl_value)) != 0 ||
+        setsockopt(sock->handle, IPPROTO_IP, IP_MULTICAST_LOOP, (const char*)&loop_value, sizeof(loop_value)) != 0)
+    {
+        udp_close(sock);
+        return 1;
+    }
+
+    return 0;
+}
+
+int udp_open_receiver(udp_socket* sock, const char* group, uint16_t port)
+{
+    struct sockaddr_in address;
+    struct ip_mreq request;
+    int reuse = 1;
+
+    // Big enough to ride out a keyframe burst while the reader is busy
+    int buffer_size = 4 * 1024 * 1024;
+
+    if (open_socket(sock, group))
+        return 1;
+
+    sock->port = port;
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+
+    memset(&request, 0, sizeof(request));
+    request.imr_multiaddr.s_addr = sock->group;
+    request.imr_interface.s_addr = htonl(INADDR_ANY);
+
+    // Several receivers on one machine can listen to the same group
+    setsockopt(sock->handle, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+    setsockopt(sock->handle, SOL_SOCKET, SO_RCVBUF, (const char*)&buffer_size, sizeof(buffer_size));
+
+    if (bind(sock->handle, (const struct sockaddr*)&address, sizeof(address)) != 0 ||
+        setsockopt(sock->handle, IPPROTO_IP, IP_ADD_MEMBERSHIP, (const char*)&request, sizeof(request)) != 0)
+    {
+        udp_close(sock);
+        return 1;
+    }
+
+    return 0;
+}
+
+int udp_send(udp_socket* sock, uint16_t port, const void* data, size_t size)
+{
+    struct sockaddr_in address;
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = sock->group;
+    address.sin_port = htons(port);
+
+    return sendto(sock->handle, (const char*)data, (int)size, 0,
+        (const struct sockaddr*)&address, sizeof(address)) != (int)size;
+}
+
+// Receive timeouts are a socket option, only touched when the timeout changes
+static int set_timeout(udp_socket* sock, uint32_t timeout_ms)
+{
+#ifdef _WIN32
+    DWORD timeout = timeout_ms;
+#else
+    struct timeval timeout;
+
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_usec = (timeout_ms % 1000) * 1000;
+#endif
+
+    if (sock->has_timeout && sock->timeout_ms == timeout_ms)
+        return 0;
+
+    if (setsockopt(sock->handle, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout)) != 0)
+        return 1;
+
+    sock->timeout_ms = timeout_ms;
+    sock->has_timeout = TRUE;
+
+    return 0;
+}
+
+static BOOL timed_out()
+{
+#ifdef _WIN32
+    return WSAGetLastError() == WSAETIMEDOUT;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+int udp_receive(udp_socket* sock, void* buffer, size_t size, uint32_t timeout_ms)
+{
+    int result;
+
+    // A zero timeout means wait forever to the socket option
+    if (timeout_ms == 0)
+        timeout_ms = 1;
+
+    if (set_timeout(sock, timeout_ms))
+        return -1;
+
+    result = (int)recv(sock->handle, (char*)buffer, (int)size, 0);
+    if (result < 0)
+        return timed_out() ? 0 : -1;
+
+    return result;
+}
+
+uint32_t udp_select(udp_socket* sockets, int count, uint32_t timeout_ms)
+{
+    struct timeval timeout;
+    fd_set readable;
+    net_handle highest = 0;
+    uint32_t ready = 0;
+    int i;
+
+    FD_ZERO(&readable);
+
+    for (i = 0; i < count; ++i)
+    {
+        if (!sockets[i].open)
+            continue;
+
+        FD_SET(sockets[i].handle, &readable);
+        if (sockets[i].handle > highest)
+            highest = sockets[i].handle;
+    }
+
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_usec = (timeout_ms % 1000) * 1000;
+
+    // The first argument is ignored by Winsock
+    if (select((int)highest + 1, &readable, NULL, NULL, &timeout) <= 0)
+        return 0;
+
+    for (i = 0; i < count; ++i)
+    {
+        if (sockets[i].open && FD_ISSET(sockets[i].handle, &readable))
+            ready |= 1u << i;
+    }
+
+    return ready;
+}
+
+void udp_close(udp_socket* sock)
+{
+    if (sock->open)
+        close_handle(sock->handle);
+
+    memset(sock, 0, sizeof(*sock));
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "platform.h"
+
+#ifdef _WIN32
+typedef SOCKET net_handle;
+#else
+typedef int net_handle;
+#endif
+
+// A UDP socket bound to one IPv4 multicast group, either for sending to
+// group:port or for receiving what is sent to it
+typedef struct
+{
+    net_handle handle;
+    BOOL open;
+
+    // Group address in network byte order
+    uint32_t group;
+    uint16_t port;
+
+    // Receive timeout currently set on the socket
+    uint32_t timeout_ms;
+    BOOL has_timeout;
+} udp_socket;
+
+// Winsock needs to be started once per process, does nothing elsewhere
+// Returns 0 on success
+int net_init();
+void net_cleanup();
+
+// Opens a socket sending to group, ttl 1 keeps packets on the local network.
+// loopback also delivers them to receivers on this machine.
+// Returns 0 on success
+int udp_open_sender(udp_socket* sock, const char* group, int ttl, BOOL loopback);
+
+// Joins group and receives what is sent to port, returns 0 on success
+int udp_open_receiver(udp_socket* sock, const char* group, uint16_t port);
+
+// Returns 0 if the whole datagram was sent
+int udp_send(udp_socket* sock, uint16_t port, const void* data, size_t size);
+
+// Waits up to timeout_ms until any of count sockets has a datagram waiting
+// Returns a mask with bit i set when sockets[i] is readable, 0 on timeout or error
+uint32_t udp_select(udp_socket* sockets, int count, uint32_t timeout_ms);
+
+// Waits up to timeout_ms for a datagram
+// Returns its size, 0 on timeout or -1 on error
+int udp_receive(udp_socket* sock, void* buffer, size_t size, uint32_t timeout_ms);
+
+void udp_close(udp_socket* sock);
@@ -0,0 +1,767 @@
+#include "parquet.h"
+#include "snappy.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Values from parquet.thrift
+enum
+{
+    PAGE_DATA = 0,
+    PAGE_DICTIONARY = 2,
+
+    ENCODING_PLAIN = 0,
+    ENCODING_RLE = 3,
+    ENCODING_RLE_DICTIONARY = 8,
+    ENCODING_BYTE_STREAM_SPLIT = 9,
+
+    CODEC_SNAPPY = 1,
+
+    REPETITION_REQUIRED = 0,
+    REPETITION_OPTIONAL = 1,
+
+    CONVERTED_UTF8 = 0
+};
+
+// Thrift compact protocol field types
+enum
+{
+    THRIFT_I32 = 5,
+    THRIFT_I64 = 6,
+    THRIFT_BINARY = 8,
+    THRIFT_LIST = 9,
+    THRIFT_STRUCT = 12
+};
+
+// Open addressing table for the dictionary, twice PARQUET_DICTIONARY_MAX
+#define DICTIONARY_HASH_SIZE 2048
+
+#define THRIFT_DEPTH_MAX 8
+
+typedef struct
+{
+    parquet_buffer* out;
+    int16_t last_id[THRIFT_DEPTH_MAX];
+    int depth;
+} thrift_writer;
+
+static int buffer_reserve(parquet_buffer* buffer, size_t size)
+{
+    uint8_t* grown;
+    size_t capacity;
+
+    if (buffer->failed)
+        return 1;
+
+    if (buffer->size + size <= buffer->capacity)
+        return 0;
+
+    capacity = buffer->capacity ? buffer->capacity : 4096;
+    while (capacity < buffer->size + size)
+        capacity *= 2;
+
+    grown = (uint8_t*)realloc(buffer->data, capacity);
+    if (grown == NULL)
+    {
+        buffer->failed = TRUE;
+        return 1;
+    }
+
+    buffer->data = grown;
+    buffer->capacity = capacity;
+
+    return 0;
+}
+
+static void buffer_write(parquet_buffer* buffer, const void* data, size_t size)
+{
+    if (buffer_reserve(buffer, size))
+        return;
+
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+}
+
+static void buffer_byte(parquet_buffer* buffer, uint8_t value)
+{
+    buffer_write(buffer, &value, 1);
+}
+
+static void buffer_u32(parquet_buffer* buffer, uint32_t value)
+{
+    uint8_t bytes[4];
+
+    bytes[0] = (uint8_t)value;
+    bytes[1] = (uint8_t)(value >> 8);
+    bytes[2] = (uint8_t)(value >> 16);
+    bytes[3] = (uint8_t)(value >> 24);
+
+    buffer_write(buffer, bytes, sizeof(bytes));
+}
+
+static void buffer_varint(parquet_buffer* buffer, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        buffer_byte(buffer, (uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+
+    buffer_byte(buffer, (uint8_t)value);
+}
+
+static void buffer_free(parquet_buffer* buffer)
+{
+    free(buffer->data);
+    memset(buffer, 0, sizeof(*buffer));
+}
+
+// Thrift compact protocol, just the parts the Parquet metadata needs
+
+static void thrift_begin(thrift_writer* thrift, parquet_buffer* out)
+{
+    thrift->out = out;
+    thrift->depth = 0;
+    thrift->last_id[0] = 0;
+}
+
+static void thrift_field(thrift_writer* thrift, int16_t id, uint8_t type)
+{
+    int delta = id - thrift->last_id[thrift->depth];
+
+    if (delta > 0 && delta <= 15)
+    {
+        buffer_byte(thrift->out, (uint8_t)((delta << 4) | type));
+    }
+    else
+    {
+        buffer_byte(thrift->out, type);
+        buffer_varint(thrift->out, (uint16_t)((id << 1) ^ (id >> 15)));
+    }
+
+    thrift->last_id[thrift->depth] = id;
+}
+
+static void thrift_value_i64(thrift_writer* thrift, int64_t value)
+{
+    buffer_varint(thrift->out, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static void thrift_value_string(thrift_writer* thrift, const char* value)
+{
+    size_t length = strlen(value);
+
+    buffer_varint(thrift->out, length);
+    buffer_write(thrift->out, value, length);
+}
+
+static void thrift_i32(thrift_writer* thrift, int16_t id, int32_t value)
+{
+    thrift_field(thrift, id, THRIFT_I32);
+    thrift_value_i64(thrift, value);
+}
+
+static void thrift_i64(thrift_writer* thrift, int16_t id, int64_t value)
+{
+    thrift_field(thrift, id, THRIFT_I64);
+    thrift_value_i64(thrift, value);
+}
+
+static void thrift_string(thrift_writer* thrift, int16_t id, const char* value)
+{
+    thrift_field(thrift, id, THRIFT_BINARY);
+    thrift_value_string(thrift, value);
+}
+
+// Header of a list field, the count elements follow
+static void thrift_list(thrift_writer* thrift, int16_t id, uint8_t type, uint32_t count)
+{
+    thrift_field(thrift, id, THRIFT_LIST);
+
+    if (count < 15)
+    {
+        buffer_byte(thrift->out, (uint8_t)((count << 4) | type));
+    }
+    else
+    {
+        buffer_byte(thrift->out, (uint8_t)(0xf0 | type));
+        buffer_varint(thrift->out, count);
+    }
+}
+
+// A struct field (id > 0) or a struct element of a list (id 0)
+static void thrift_struct_begin(thrift_writer* thrift, int16_t id)
+{
+    if (id > 0)
+        thrift_field(thrift, id, THRIFT_STRUCT);
+
+    thrift->last_id[++thrift->depth] = 0;
+}
+
+static void thrift_struct_end(thrift_writer* thrift)
+{
+    buffer_byte(thrift->out, 0);
+    thrift->depth--;
+}
+
+// RLE/bit-packed hybrid encoding of values of bit_width bits. Runs of 8 or more
+// equal values become RLE runs, everything else is bit-packed 8 values at a time.
+static void encode_hybrid(parquet_buffer* out, const uint32_t* values, uint32_t count, int bit_width)
+{
+    uint32_t i = 0, run, start, groups, g, k, value;
+    uint64_t bits;
+    int filled, b;
+
+    while (i < count)
+    {
+        for (run = 1; i + run < count && values[i + run] == values[i]; ++run)
+            ;
+
+        if (run >= 8)
+        {
+            buffer_varint(out, (uint64_t)run << 1);
+            for (b = 0; b < bit_width; b += 8)
+                buffer_byte(out, (uint8_t)(values[i] >> b));
+
+            i += run;
+            continue;
+        }
+
+        // Bit-pack until the next long run, which may start at a group boundary
+        start = i;
+        groups = 0;
+
+        while (i < count)
+        {
+            if (groups > 0)
+            {
+                for (run = 1; i + run < count && values[i + run] == values[i]; ++run)
+                    ;
+
+                if (run >= 8)
+                    break;
+            }
+
+            i += 8;
+            groups++;
+        }
+
+        buffer_varint(out, ((uint64_t)groups << 1) | 1);
+
+        for (g = 0; g < groups; ++g)
+        {
+            bits = 0;
+            filled = 0;
+
+            for (k = 0; k < 8; ++k)
+            {
+                value = start + g * 8 + k < count ? values[start + g * 8 + k] : 0;
+                bits |= (uint64_t)value << filled;
+                filled += bit_width;
+
+                while (filled >= 8)
+                {
+                    buffer_byte(out, (uint8_t)bits);
+                    bits >>= 8;
+                    filled -= 8;
+                }
+            }
+        }
+
+        if (i > count)
+            i = count;
+    }
+}
+
+static int index_width(uint32_t max_value)
+{
+    int width = 1;
+
+    while (width < 32 && (max_value >> width) != 0)
+        width++;
+
+    return width;
+}
+
+// Length of a value as written, strings stop at their first NUL
+static uint32_t value_length(const parquet_column* column, const uint8_t* value)
+{
+    const uint8_t* nul;
+
+    if (column->type != PARQUET_BYTE_ARRAY)
+        return column->width;
+
+    nul = (const uint8_t*)memchr(value, 0, column->width);
+    return nul ? (uint32_t)(nul - value) : column->width;
+}
+
+static void write_plain(parquet_buffer* out, const parquet_column* column, const uint8_t* value)
+{
+    uint32_t length = value_length(column, value);
+
+    if (column->type == PARQUET_BYTE_ARRAY)
+        buffer_u32(out, length);
+
+    buffer_write(out, value, length);
+}
+
+// Writes the values of the present rows, PLAIN encoded
+static void write_values(parquet_buffer* out, const parquet_column* column,
+    const uint8_t* values, const uint8_t* present, uint32_t rows)
+{
+    uint32_t row;
+
+    // Fixed size values are stored as they are, the whole run in one go when none are missing
+    if (column->type != PARQUET_BYTE_ARRAY && !column->optional)
+    {
+        buffer_write(out, values, (size_t)rows * column->width);
+        return;
+    }
+
+    if (column->type != PARQUET_BYTE_ARRAY && buffer_reserve(out, (size_t)rows * column->width))
+        return;
+
+    for (row = 0; row < rows; ++row)
+    {
+        if (!column->optional || present[row])
+            write_plain(out, column, values + (size_t)row * column->width);
+    }
+}
+
+// BYTE_STREAM_SPLIT: byte k of every value, then byte k + 1 and so on. Sign,
+// exponent and high mantissa bytes of telemetry floats barely move from one
+// tick to the next, split out like this they compress well where the values
+// as a whole don't at all.
+static void write_split(parquet_buffer* out, const parquet_column* column,
+    const uint8_t* values, const uint8_t* present, uint32_t rows)
+{
+    uint8_t* stream;
+    uint32_t width = column->width, count = 0, row, k;
+
+    for (row = 0; row < rows; ++row)
+        count += !column->optional || present[row];
+
+    if (buffer_reserve(out, (size_t)count * width))
+        return;
+
+    stream = out->data + out->size;
+
+    for (row = 0; row < rows; ++row)
+    {
+        if (column->optional && !present[row])
+            continue;
+
+        for (k = 0; k < width; ++k)
+            stream[(size_t)k * count] = values[(size_t)row * width + k];
+
+        stream++;
+    }
+
+    out->size += (size_t)count * width;
+}
+
+static uint32_t hash_value(const uint8_t* value, uint32_t length)
+{
+    uint32_t hash = 2166136261u;
+    uint32_t i;
+
+    for (i = 0; i < length; ++i)
+        hash = (hash ^ value[i]) * 16777619u;
+
+    return hash;
+}
+
+// Maps every present value to a dictionary index in encoder->indices and writes
+// the dictionary as PLAIN values to encoder->plain. Returns the number of
+// entries, 0 if there are more than PARQUET_DICTIONARY_MAX
+static uint32_t build_dictionary(parquet_encoder* encoder, const parquet_column* column,
+    const uint8_t* values, const uint8_t* present, uint32_t rows)
+{
+    int16_t table[DICTIONARY_HASH_SIZE];
+    uint32_t first_row[PARQUET_DICTIONARY_MAX];
+    const uint8_t* value;
+    const uint8_t* entry;
+    const uint8_t* previous = NULL;
+    uint32_t entries = 0, count = 0, row, length, h = 0;
+
+    memset(table, 0xff, sizeof(table));
+
+    for (row = 0; row < rows; ++row)
+    {
+        if (column->optional && !present[row])
+            continue;
+
+        value = values + (size_t)row * column->width;
+
+        // Most values repeat the one before, e.g. gear or anything that changes once a lap
+        if (previous && memcmp(previous, value, column->width) == 0)
+        {
+            encoder->indices[count++] = (uint32_t)table[h];
+            continue;
+        }
+
+        previous = value;
+        length = value_length(column, value);
+        h = hash_value(value, length) & (DICTIONARY_HASH_SIZE - 1);
+
+        for (;;)
+        {
+            if (table[h] < 0)
+            {
+                if (entries == PARQUET_DICTIONARY_MAX)
+                    return 0;
+
+                first_row[entries] = row;
+                table[h] = (int16_t)entries++;
+                break;
+            }
+
+            entry = values + (size_t)first_row[table[h]] * column->width;
+            if (value_length(column, entry) == length && memcmp(entry, value, length) == 0)
+                break;
+
+            h = (h + 1) & (DICTIONARY_HASH_SIZE - 1);
+        }
+
+        encoder->indices[count++] = (uint32_t)table[h];
+    }
+
+    encoder->plain.size = 0;
+    for (h = 0; h < entries; ++h)
+        write_plain(&encoder->plain, column, values + (size_t)first_row[h] * column->width);
+
+    return entries;
+}
+
+static void page_header(parquet_buffer* out, int type, uint32_t uncompressed, uint32_t compressed,
+    uint32_t num_values, int encoding)
+{
+    thrift_writer thrift;
+
+    thrift_begin(&thrift, out);
+    thrift_i32(&thrift, 1, type);
+    thrift_i32(&thrift, 2, (int32_t)uncompressed);
+    thrift_i32(&thrift, 3, (int32_t)compressed);
+
+    if (type == PAGE_DICTIONARY)
+    {
+        thrift_struct_begin(&thrift, 7);
+        thrift_i32(&thrift, 1, (int32_t)num_values);
+        thrift_i32(&thrift, 2, encoding);
+        thrift_struct_end(&thrift);
+    }
+    else
+    {
+        thrift_struct_begin(&thrift, 5);
+        thrift_i32(&thrift, 1, (int32_t)num_values);
+        thrift_i32(&thrift, 2, encoding);
+        thrift_i32(&thrift, 3, ENCODING_RLE);
+        thrift_i32(&thrift, 4, ENCODING_RLE);
+        thrift_struct_end(&thrift);
+    }
+
+    buffer_byte(out, 0);
+}
+
+// Compresses encoder->plain into a page appended to chunk->pages
+static void add_page(parquet_encoder* encoder, parquet_chunk* chunk, int type, uint32_t num_values, int encoding)
+{
+    size_t start = chunk->pages.size;
+    size_t compressed;
+
+    encoder->packed.size = 0;
+    if (buffer_reserve(&encoder->packed, SNAPPY_BOUND(encoder->plain.size)))
+        return;
+
+    compressed = snappy_compress(encoder->plain.data, encoder->plain.size, encoder->packed.data);
+
+    page_header(&chunk->pages, type, (uint32_t)encoder->plain.size, (uint32_t)compressed, num_values, encoding);
+    chunk->uncompressed_bytes += chunk->pages.size - start + encoder->plain.size;
+
+    buffer_write(&chunk->pages, encoder->packed.data, compressed);
+}
+
+void parquet_encoder_init(parquet_encoder* encoder)
+{
+    memset(encoder, 0, sizeof(*encoder));
+}
+
+void parquet_encoder_close(parquet_encoder* encoder)
+{
+    buffer_free(&encoder->plain);
+    buffer_free(&encoder->packed);
+    free(encoder->indices);
+    free(encoder->levels);
+
+    memset(encoder, 0, sizeof(*encoder));
+}
+
+void parquet_chunk_close(parquet_chunk* chunk)
+{
+    buffer_free(&chunk->pages);
+
+    memset(chunk, 0, sizeof(*chunk));
+}
+
+int parquet_encode(parquet_encoder* encoder, parquet_chunk* chunk, const parquet_column* column,
+    const uint8_t* values, const uint8_t* present, uint32_t rows)
+{
+    uint32_t entries = 0, count = 0, row;
+    size_t levels_at;
+    int width, encoding;
+
+    chunk->pages.size = 0;
+    chunk->pages.failed = FALSE;
+    chunk->dictionary_bytes = 0;
+    chunk->dictionary = FALSE;
+    chunk->rows = rows;
+    chunk->uncompressed_bytes = 0;
+
+    // A failed allocation is sticky, start over with fresh buffers
+    if (encoder->plain.failed || encoder->packed.failed)
+        parquet_encoder_close(encoder);
+
+    if (rows > encoder->rows)
+    {
+        free(encoder->indices);
+        free(encoder->levels);
+
+        encoder->indices = (uint32_t*)malloc(rows * sizeof(uint32_t));
+        encoder->levels = (uint32_t*)malloc(rows * sizeof(uint32_t));
+        encoder->rows = rows;
+
+        if (encoder->indices == NULL || encoder->levels == NULL)
+        {
+            parquet_encoder_close(encoder);
+            return 1;
+        }
+    }
+
+    if (column->type == PARQUET_INT32 || column->type == PARQUET_BYTE_ARRAY)
+        entries = build_dictionary(encoder, column, values, present, rows);
+
+    if (entries > 0)
+    {
+        add_page(encoder, chunk, PAGE_DICTIONARY, entries, ENCODING_PLAIN);
+        chunk->dictionary_bytes = (uint32_t)chunk->pages.size;
+        chunk->dictionary = TRUE;
+    }
+
+    encoder->plain.size = 0;
+
+    // Definition levels, 1 for a value and 0 for null, prefixed with their length
+    if (column->optional)
+    {
+        for (row = 0; row < rows; ++row)
+            encoder->levels[row] = present[row] != 0;
+
+        levels_at = encoder->plain.size;
+        buffer_u32(&encoder->plain, 0);
+        encode_hybrid(&encoder->plain, encoder->levels, rows, 1);
+
+        if (!encoder->plain.failed)
+        {
+            row = (uint32_t)(encoder->plain.size - levels_at - 4);
+            encoder->plain.data[levels_at] = (uint8_t)row;
+            encoder->plain.data[levels_at + 1] = (uint8_t)(row >> 8);
+            encoder->plain.data[levels_at + 2] = (uint8_t)(row >> 16);
+            encoder->plain.data[levels_at + 3] = (uint8_t)(row >> 24);
+        }
+    }
+
+    if (entries > 0)
+    {
+        for (row = 0; row < rows; ++row)
+            count += !column->optional || present[row];
+
+        width = index_width(entries - 1);
+        buffer_byte(&encoder->plain, (uint8_t)width);
+        encode_hybrid(&encoder->plain, encoder->indices, count, width);
+    }
+    else if (column->type == PARQUET_FLOAT || column->type == PARQUET_DOUBLE)
+    {
+        write_split(&encoder->plain, column, values, present, rows);
+    }
+    else
+    {
+        write_values(&encoder->plain, column, values, present, rows);
+    }
+
+    if (entries > 0)
+        encoding = ENCODING_RLE_DICTIONARY;
+    else if (column->type == PARQUET_FLOAT || column->type == PARQUET_DOUBLE)
+        encoding = ENCODING_BYTE_STREAM_SPLIT;
+    else
+        encoding = ENCODING_PLAIN;
+
+    add_page(encoder, chunk, PAGE_DATA, rows, encoding);
+    chunk->encoding = encoding;
+
+    return chunk->pages.failed || encoder->plain.failed || encoder->packed.failed;
+}
+
+int parquet_open(parquet_writer* writer, const char* path, const parquet_column* columns, int num_columns)
+{
+    memset(writer, 0, sizeof(*writer));
+
+    writer->file = file_open(path, "wb");
+    if (writer->file == NULL)
+        return 1;
+
+    writer->columns = columns;
+    writer->num_columns = num_columns;
+
+    if (fwrite(PARQUET_MAGIC, 4, 1, writer->file) != 1)
+    {
+        fclose(writer->file);
+        writer->file = NULL;
+        return 1;
+    }
+
+    writer->offset = 4;
+
+    return 0;
+}
+
+int parquet_add_metadata(parquet_writer* writer, const char* key, const char* value)
+{
+    if (writer->num_metadata == PARQUET_METADATA_MAX)
+        return 1;
+
+    writer->metadata_keys[writer->num_metadata] = key;
+    writer->metadata_values[writer->num_metadata] = value;
+    writer->num_metadata++;
+
+    return 0;
+}
+
+int parquet_write_row_group(parquet_writer* writer, const parquet_chunk* chunks)
+{
+    const parquet_column* column;
+    const parquet_chunk* chunk;
+    thrift_writer thrift;
+    uint64_t total_bytes = 0;
+    int c;
+
+    thrift_begin(&thrift, &writer->row_groups);
+    thrift_struct_begin(&thrift, 0);
+    thrift_list(&thrift, 1, THRIFT_STRUCT, (uint32_t)writer->num_columns);
+
+    for (c = 0; c < writer->num_columns; ++c)
+    {
+        column = &writer->columns[c];
+        chunk = &chunks[c];
+
+        thrift_struct_begin(&thrift, 0);
+        thrift_i64(&thrift, 2, (int64_t)writer->offset);
+
+        thrift_struct_begin(&thrift, 3);
+        thrift_i32(&thrift, 1, column->type);
+
+        // The levels are RLE, a dictionary page is PLAIN
+        thrift_list(&thrift, 2, THRIFT_I32, chunk->encoding == ENCODING_PLAIN ? 2 : chunk->dictionary ? 3 : 2);
+        thrift_value_i64(&thrift, ENCODING_RLE);
+        if (chunk->encoding == ENCODING_PLAIN || chunk->dictionary)
+            thrift_value_i64(&thrift, ENCODING_PLAIN);
+        if (chunk->encoding != ENCODING_PLAIN)
+            thrift_value_i64(&thrift, chunk->encoding);
+
+        thrift_list(&thrift, 3, THRIFT_BINARY, 1);
+        thrift_value_string(&thrift, column->name);
+
+        thrift_i32(&thrift, 4, CODEC_SNAPPY);
+        thrift_i64(&thrift, 5, chunk->rows);
+        thrift_i64(&thrift, 6, (int64_t)chunk->uncompressed_bytes);
+        thrift_i64(&thrift, 7, (int64_t)chunk->pages.size);
+        thrift_i64(&thrift, 9, (int64_t)(writer->offset + chunk->dictionary_bytes));
+        if (chunk->dictionary)
+            thrift_i64(&thrift, 11, (int64_t)writer->offset);
+        thrift_struct_end(&thrift);
+
+        thrift_struct_end(&thrift);
+
+        if (chunk->pages.size > 0 && fwrite(chunk->pages.data, chunk->pages.size, 1, writer->file) != 1)
+            return 1;
+
+        writer->offset += chunk->pages.size;
+        total_bytes += chunk->uncompressed_bytes;
+    }
+
+    thrift_i64(&thrift, 2, (int64_t)total_bytes);
+    thrift_i64(&thrift, 3, chunks[0].rows);
+    thrift_struct_end(&thrift);
+
+    writer->num_row_groups++;
+    writer->num_rows += chunks[0].rows;
+
+    return writer->row_groups.failed;
+}
+
+int parquet_close(parquet_writer* writer)
+{
+    parquet_buffer footer;
+    thrift_writer thrift;
+    const parquet_column* column;
+    int err_code, c;
+
+    if (writer->file == NULL)
+        return 1;
+
+    memset(&footer, 0, sizeof(footer));
+    thrift_begin(&thrift, &footer);
+
+    thrift_i32(&thrift, 1, 1);
+
+    thrift_list(&thrift, 2, THRIFT_STRUCT, (uint32_t)writer->num_columns + 1);
+    thrift_struct_begin(&thrift, 0);
+    thrift_string(&thrift, 4, "schema");
+    thrift_i32(&thrift, 5, writer->num_columns);
+    thrift_struct_end(&thrift);
+
+    for (c = 0; c < writer->num_columns; ++c)
+    {
+        column = &writer->columns[c];
+
+        thrift_struct_begin(&thrift, 0);
+        thrift_i32(&thrift, 1, column->type);
+        thrift_i32(&thrift, 3, column->optional ? REPETITION_OPTIONAL : REPETITION_REQUIRED);
+        thrift_string(&thrift, 4, column->name);
+        if (column->type == PARQUET_BYTE_ARRAY)
+            thrift_i32(&thrift, 6, CONVERTED_UTF8);
+        thrift_struct_end(&thrift);
+    }
+
+    thrift_i64(&thrift, 3, writer->num_rows);
+
+    thrift_list(&thrift, 4, THRIFT_STRUCT, (uint32_t)writer->num_row_groups);
+    buffer_write(&footer, writer->row_groups.data, writer->row_groups.size);
+
+    if (writer->num_metadata > 0)
+    {
+        thrift_list(&thrift, 5, THRIFT_STRUCT, (uint32_t)writer->num_metadata);
+
+        for (c = 0; c < writer->num_metadata; ++c)
+        {
+            thrift_struct_begin(&thrift, 0);
+            thrift_string(&thrift, 1, writer->metadata_keys[c]);
+            thrift_string(&thrift, 2, writer->metadata_values[c]);
+            thrift_struct_end(&thrift);
+        }
+    }
+
+    thrift_string(&thrift, 6, "r3e-api sample-c");
+    buffer_byte(&footer, 0);
+
+    buffer_u32(&footer, (uint32_t)footer.size);
+    buffer_write(&footer, PARQUET_MAGIC, 4);
+
+    err_code = footer.failed || writer->row_groups.failed ||
+        fwrite(footer.data, footer.size, 1, writer->file) != 1;
+    err_code |= fclose(writer->file) != 0;
+
+    buffer_free(&footer);
+    buffer_free(&writer->row_groups);
+    memset(writer, 0, sizeof(*writer));
+
+    return err_code;
+}
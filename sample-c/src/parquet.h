@@ -0,0 +1,119 @@
+#pragma once
+
+#include "platform.h"
+
+#define PARQUET_MAGIC "PAR1"
+#define PARQUET_NAME_MAX 64
+#define PARQUET_METADATA_MAX 8
+
+// Int and string columns with at most this many distinct values in a row group
+// are dictionary encoded, which takes enum-like fields such as gear,
+// session_phase or pit_state down to a few bits per row before compression
+#define PARQUET_DICTIONARY_MAX 1024
+
+// Physical types, values as in parquet.thrift
+typedef enum
+{
+    PARQUET_INT32 = 1,
+    PARQUET_INT64 = 2,
+    PARQUET_FLOAT = 4,
+    PARQUET_DOUBLE = 5,
+    PARQUET_BYTE_ARRAY = 6
+} parquet_type;
+
+typedef struct
+{
+    char name[PARQUET_NAME_MAX];
+    parquet_type type;
+
+    // Bytes per value in the input, for BYTE_ARRAY a fixed size char array
+    // that is written up to its first NUL as a UTF-8 string
+    uint32_t width;
+
+    // Optional columns take a present flag per row, absent rows are null
+    BOOL optional;
+} parquet_column;
+
+// Growable output buffer, failed is set (and stays set) if an allocation fails
+typedef struct
+{
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+    BOOL failed;
+} parquet_buffer;
+
+// One column of one row group, encoded and compressed, ready to be written
+typedef struct
+{
+    // Dictionary page if there is one, then the data page, headers included
+    parquet_buffer pages;
+    uint32_t dictionary_bytes;
+    BOOL dictionary;
+
+    // Encoding of the values in the data page, as in parquet.thrift
+    int encoding;
+
+    uint32_t rows;
+    uint64_t uncompressed_bytes;
+} parquet_chunk;
+
+// Scratch space for encoding chunks, kept between calls.
+// Encoders on different threads each need their own.
+typedef struct
+{
+    parquet_buffer plain;
+    parquet_buffer packed;
+    uint32_t* indices;
+    uint32_t* levels;
+    uint32_t rows;
+} parquet_encoder;
+
+// Writes a Parquet file of flat columns, one row group at a time. Pages are
+// Snappy compressed v1 data pages. Dictionary encoded columns get a PLAIN
+// dictionary page and RLE_DICTIONARY indices, floats are BYTE_STREAM_SPLIT
+// and the rest PLAIN. The file reads as is in pyarrow, pandas, DuckDB, Spark
+// and the like.
+typedef struct
+{
+    FILE* file;
+    uint64_t offset;
+
+    const parquet_column* columns;
+    int num_columns;
+
+    // Thrift encoded RowGroup structs for the footer
+    parquet_buffer row_groups;
+    int num_row_groups;
+    int64_t num_rows;
+
+    // Key/value pairs for the footer, see parquet_add_metadata
+    const char* metadata_keys[PARQUET_METADATA_MAX];
+    const char* metadata_values[PARQUET_METADATA_MAX];
+    int num_metadata;
+} parquet_writer;
+
+void parquet_encoder_init(parquet_encoder* encoder);
+void parquet_encoder_close(parquet_encoder* encoder);
+
+// Frees the pages of a chunk, a zeroed chunk needs no init
+void parquet_chunk_close(parquet_chunk* chunk);
+
+// Encodes rows values of column into chunk, packed width bytes apart. present
+// holds a flag per row for optional columns and is ignored for required ones.
+// Returns 0 on success, 1 if out of memory
+int parquet_encode(parquet_encoder* encoder, parquet_chunk* chunk, const parquet_column* column,
+    const uint8_t* values, const uint8_t* present, uint32_t rows);
+
+// columns must stay valid until parquet_close. Returns 0 on success
+int parquet_open(parquet_writer* writer, const char* path, const parquet_column* columns, int num_columns);
+
+// Writes one encoded chunk per column, all with the same number of rows. Returns 0 on success
+int parquet_write_row_group(parquet_writer* writer, const parquet_chunk* chunks);
+
+// Stores a key/value pair in the footer, both must stay valid until parquet_close
+// Returns 0 on success, 1 if there is no room left
+int parquet_add_metadata(parquet_writer* writer, const char* key, const char* value);
+
+// Writes the footer and closes the file, returns 0 on success
+int parquet_close(parquet_writer* writer);
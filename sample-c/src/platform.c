@@ -0,0 +1,474 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "platform.h"
+
+#include <string.h>
+
+#ifdef _WIN32
+
+// timeBeginPeriod/timeEndPeriod
+#pragma comment(lib, "winmm.lib")
+
+static int map_view(shared_map* map, size_t size, DWORD access)
+{
+    map->view = MapViewOfFile(map->handle, access, 0, 0, size);
+    if (map->view == NULL)
+    {
+        CloseHandle(map->handle);
+        map->handle = NULL;
+        return 1;
+    }
+
+    map->size = size;
+    return 0;
+}
+
+int shared_map_open(shared_map* map, const char* name, size_t size, BOOL writable)
+{
+    DWORD access = writable ? FILE_MAP_WRITE | FILE_MAP_READ : FILE_MAP_READ;
+
+    memset(map, 0, sizeof(*map));
+
+    map->handle = OpenFileMappingA(access, FALSE, name);
+    if (map->handle == NULL)
+        return 1;
+
+    return map_view(map, size, access);
+}
+
+int shared_map_create(shared_map* map, const char* name, size_t size)
+{
+    memset(map, 0, sizeof(*map));
+
+    map->handle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)size, name);
+    if (map->handle == NULL)
+        return 1;
+
+    map->owner = TRUE;
+    return map_view(map, size, FILE_MAP_WRITE | FILE_MAP_READ);
+}
+
+BOOL shared_map_exists(const char* name)
+{
+    HANDLE handle = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+
+    if (handle != NULL)
+        CloseHandle(handle);
+
+    return handle != NULL;
+}
+
+void shared_map_close(shared_map* map)
+{
+    if (map->view) UnmapViewOfFile(map->view);
+    if (map->handle) CloseHandle(map->handle);
+
+    memset(map, 0, sizeof(*map));
+}
+
+int mapped_file_open(mapped_file* file, const char* path)
+{
+    LARGE_INTEGER size;
+
+    memset(file, 0, sizeof(*file));
+
+    file->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file->file == INVALID_HANDLE_VALUE)
+    {
+        file->file = NULL;
+        return 1;
+    }
+
+    if (!GetFileSizeEx(file->file, &size) || size.QuadPart == 0 || (uint64_t)size.QuadPart > (SIZE_T)-1)
+    {
+        mapped_file_close(file);
+        return 1;
+    }
+
+    file->size = (uint64_t)size.QuadPart;
+    file->mapping = CreateFileMappingA(file->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (file->mapping != NULL)
+        file->view = MapViewOfFile(file->mapping, FILE_MAP_READ, 0, 0, 0);
+
+    if (file->view == NULL)
+    {
+        mapped_file_close(file);
+        return 1;
+    }
+
+    return 0;
+}
+
+void mapped_file_close(mapped_file* file)
+{
+    if (file->view) UnmapViewOfFile(file->view);
+    if (file->mapping) CloseHandle(file->mapping);
+    if (file->file) CloseHandle(file->file);
+
+    memset(file, 0, sizeof(*file));
+}
+
+FILE* file_open(const char* path, const char* mode)
+{
+    FILE* file = NULL;
+
+    if (fopen_s(&file, path, mode) != 0)
+        return NULL;
+
+    return file;
+}
+
+int file_replace(const char* from, const char* to)
+{
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) ? 0 : 1;
+}
+
+uint64_t time_now_us()
+{
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+
+    QueryPerformanceCounter(&counter);
+
+    return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000 +
+        (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart;
+}
+
+uint64_t time_now_ns()
+{
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+
+    QueryPerformanceCounter(&counter);
+
+    return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000 +
+        (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000 / frequency.QuadPart;
+}
+
+void sleep_ms(uint32_t ms)
+{
+    Sleep(ms);
+}
+
+void timer_resolution_begin()
+{
+    timeBeginPeriod(1);
+}
+
+void timer_resolution_end()
+{
+    timeEndPeriod(1);
+}
+
+void* aligned_malloc(size_t size, size_t alignment)
+{
+    return _aligned_malloc(size, alignment);
+}
+
+void aligned_free(void* memory)
+{
+    _aligned_free(memory);
+}
+
+static DWORD WINAPI thread_main(LPVOID arg)
+{
+    platform_thread* thread = (platform_thread*)arg;
+
+    thread->func(thread->arg);
+    return 0;
+}
+
+int thread_start(platform_thread* thread, thread_func func, void* arg)
+{
+    thread->func = func;
+    thread->arg = arg;
+    thread->handle = CreateThread(NULL, 0, thread_main, thread, 0, NULL);
+    thread->started = thread->handle != NULL;
+
+    return !thread->started;
+}
+
+void thread_join(platform_thread* thread)
+{
+    if (!thread->started)
+        return;
+
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+    thread->started = FALSE;
+}
+
+static volatile BOOL* stop_flag = NULL;
+
+static BOOL WINAPI stop_handler(DWORD type)
+{
+    if (type != CTRL_C_EVENT && type != CTRL_BREAK_EVENT && type != CTRL_CLOSE_EVENT)
+        return FALSE;
+
+    *stop_flag = TRUE;
+    return TRUE;
+}
+
+int stop_on_interrupt(volatile BOOL* stop)
+{
+    stop_flag = stop;
+
+    return !SetConsoleCtrlHandler(stop_handler, TRUE);
+}
+
+#else
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static void posix_name(char* dest, size_t size, const char* name)
+{
+    snprintf(dest, size, "%s%s", name[0] == '/' ? "" : "/", name);
+}
+
+static int map_view(shared_map* map, size_t size, int prot)
+{
+    map->view = mmap(NULL, size, prot, MAP_SHARED, map->fd, 0);
+    if (map->view == MAP_FAILED)
+    {
+        map->view = NULL;
+        close(map->fd);
+        map->fd = -1;
+        return 1;
+    }
+
+    map->size = size;
+    return 0;
+}
+
+int shared_map_open(shared_map* map, const char* name, size_t size, BOOL writable)
+{
+    struct stat st;
+
+    memset(map, 0, sizeof(*map));
+    posix_name(map->name, sizeof(map->name), name);
+
+    map->fd = shm_open(map->name, writable ? O_RDWR : O_RDONLY, 0);
+    if (map->fd < 0)
+        return 1;
+
+    // Don't map past the end of a block created smaller than we expect
+    if (fstat(map->fd, &st) != 0 || (size_t)st.st_size < size)
+    {
+        close(map->fd);
+        map->fd = -1;
+        return 1;
+    }
+
+    return map_view(map, size, writable ? PROT_READ | PROT_WRITE : PROT_READ);
+}
+
+int shared_map_create(shared_map* map, const char* name, size_t size)
+{
+    memset(map, 0, sizeof(*map));
+    posix_name(map->name, sizeof(map->name), name);
+
+    map->fd = shm_open(map->name, O_RDWR | O_CREAT, 0644);
+    if (map->fd < 0)
+        return 1;
+
+    if (ftruncate(map->fd, (off_t)size) != 0)
+    {
+        close(map->fd);
+        shm_unlink(map->name);
+        map->fd = -1;
+        return 1;
+    }
+
+    map->owner = TRUE;
+    return map_view(map, size, PROT_READ | PROT_WRITE);
+}
+
+BOOL shared_map_exists(const char* name)
+{
+    char posix[64];
+    int fd;
+
+    posix_name(posix, sizeof(posix), name);
+
+    fd = shm_open(posix, O_RDONLY, 0);
+    if (fd >= 0)
+        close(fd);
+
+    return fd >= 0;
+}
+
+void shared_map_close(shared_map* map)
+{
+    if (map->view) munmap(map->view, map->size);
+    if (map->fd > 0) close(map->fd);
+    if (map->owner) shm_unlink(map->name);
+
+    memset(map, 0, sizeof(*map));
+}
+
+int mapped_file_open(mapped_file* file, const char* path)
+{
+    struct stat st;
+    void* view;
+
+    memset(file, 0, sizeof(*file));
+
+    file->fd = open(path, O_RDONLY);
+    if (file->fd < 0)
+        return 1;
+
+    if (fstat(file->fd, &st) != 0 || st.st_size == 0)
+    {
+        close(file->fd);
+        file->fd = 0;
+        return 1;
+    }
+
+    view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, file->fd, 0);
+    if (view == MAP_FAILED)
+    {
+        close(file->fd);
+        file->fd = 0;
+        return 1;
+    }
+
+    file->view = view;
+    file->size = (uint64_t)st.st_size;
+
+    return 0;
+}
+
+void mapped_file_close(mapped_file* file)
+{
+    if (file->view) munmap((void*)file->view, (size_t)file->size);
+    if (file->fd > 0) close(file->fd);
+
+    memset(file, 0, sizeof(*file));
+}
+
+FILE* file_open(const char* path, const char* mode)
+{
+    return fopen(path, mode);
+}
+
+int file_replace(const char* from, const char* to)
+{
+    return rename(from, to) != 0;
+}
+
+uint64_t time_now_us()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+uint64_t time_now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+void sleep_ms(uint32_t ms)
+{
+    struct timespec ts;
+
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (long)(ms % 1000) * 1000000;
+
+    nanosleep(&ts, NULL);
+}
+
+void timer_resolution_begin()
+{
+}
+
+void timer_resolution_end()
+{
+}
+
+void* aligned_malloc(size_t size, size_t alignment)
+{
+    void* memory = NULL;
+
+    if (posix_memalign(&memory, alignment, size) != 0)
+        return NULL;
+
+    return memory;
+}
+
+void aligned_free(void* memory)
+{
+    free(memory);
+}
+
+static void* thread_main(void* arg)
+{
+    platform_thread* thread = (platform_thread*)arg;
+
+    thread->func(thread->arg);
+    return NULL;
+}
+
+int thread_start(platform_thread* thread, thread_func func, void* arg)
+{
+    thread->func = func;
+    thread->arg = arg;
+
+    thread->started = pthread_create(&thread->handle, NULL, thread_main, thread) == 0;
+
+    return !thread->started;
+}
+
+void thread_join(platform_thread* thread)
+{
+    if (!thread->started)
+        return;
+
+    pthread_join(thread->handle, NULL);
+    thread->started = FALSE;
+}
+
+static volatile BOOL* stop_flag = NULL;
+
+static void stop_handler(int signal_number)
+{
+    (void)signal_number;
+    *stop_flag = TRUE;
+}
+
+int stop_on_interrupt(volatile BOOL* stop)
+{
+    struct sigaction action;
+
+    stop_flag = stop;
+
+    // No SA_RESTART, a blocking select returns early so the flag is seen promptly
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stop_handler;
+    sigemptyset(&action.sa_mask);
+
+    return sigaction(SIGINT, &action, NULL) != 0 || sigaction(SIGTERM, &action, NULL) != 0;
+}
+
+#endif
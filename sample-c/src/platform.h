@@ -0,0 +1,161 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Size used to keep data written by different threads apart
+#define CACHE_LINE_SIZE 64
+
+#ifdef _MSC_VER
+#define ALIGNED(n) __declspec(align(n))
+#else
+#define ALIGNED(n) __attribute__((aligned(n)))
+#endif
+
+// SIMD level picked at compile time (/arch:AVX2 or -mavx2, SSE2 is the x64 baseline)
+#if defined(__AVX2__)
+#define PLATFORM_AVX2 1
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PLATFORM_SSE2 1
+#endif
+
+#ifdef _WIN32
+
+// Before Windows.h, which would otherwise pull in the old winsock.h
+#include <winsock2.h>
+#include <Windows.h>
+#include <intrin.h>
+#include <tchar.h>
+
+#define platform_barrier() MemoryBarrier()
+#define platform_compiler_barrier() _ReadWriteBarrier()
+#define platform_cpu_relax() YieldProcessor()
+
+// snprintf only arrived with Visual Studio 2015
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define snprintf(buffer, size, ...) _snprintf_s(buffer, size, _TRUNCATE, __VA_ARGS__)
+#endif
+
+// wprintf_s format for a char string argument, %s means a wide string here
+#define NARROW_STR L"%S"
+
+#else
+
+#include <pthread.h>
+
+typedef int BOOL;
+typedef char TCHAR;
+
+#define TRUE 1
+#define FALSE 0
+#define TEXT(s) s
+
+#include <wchar.h>
+
+#define wprintf_s wprintf
+#define NARROW_STR L"%s"
+
+#define platform_barrier() __sync_synchronize()
+#define platform_compiler_barrier() __asm__ __volatile__("" ::: "memory")
+
+#if defined(__i386__) || defined(__x86_64__)
+#define platform_cpu_relax() __builtin_ia32_pause()
+#else
+#define platform_cpu_relax() ((void)0)
+#endif
+
+#endif
+
+// A named shared memory block, a file mapping backed by the page file on Windows and
+// shm_open() objects on POSIX systems (the name gets a leading '/' there)
+typedef struct
+{
+    void* view;
+    size_t size;
+    BOOL owner;
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    int fd;
+    char name[64];
+#endif
+} shared_map;
+
+// Maps an existing block, returns 0 on success
+int shared_map_open(shared_map* map, const char* name, size_t size, BOOL writable);
+
+// Creates (or reuses) a block and maps it writable, returns 0 on success
+// Note: On POSIX systems the creator removes the name again in shared_map_close
+int shared_map_create(shared_map* map, const char* name, size_t size);
+
+BOOL shared_map_exists(const char* name);
+void shared_map_close(shared_map* map);
+
+// A whole file mapped read-only
+// Note: 32-bit builds can only map files that fit in their address space
+typedef struct
+{
+    const void* view;
+    uint64_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int fd;
+#endif
+} mapped_file;
+
+// Returns 0 on success
+int mapped_file_open(mapped_file* file, const char* path);
+void mapped_file_close(mapped_file* file);
+
+// fopen, without the deprecation warning on Windows
+FILE* file_open(const char* path, const char* mode);
+
+// Moves from over to, replacing to if it exists, returns 0 on success
+int file_replace(const char* from, const char* to);
+
+// Monotonic time in microseconds
+uint64_t time_now_us();
+
+// Monotonic time in nanoseconds, for timing spans too short for time_now_us
+// Note: Windows counts in units of the performance counter, typically 100 ns
+uint64_t time_now_ns();
+
+void sleep_ms(uint32_t ms);
+
+// Raise the system timer resolution so sleep_ms(1) sleeps for about 1 ms
+void timer_resolution_begin();
+void timer_resolution_end();
+
+// Memory aligned to alignment bytes (a power of two), free with aligned_free
+void* aligned_malloc(size_t size, size_t alignment);
+void aligned_free(void* memory);
+
+typedef void (*thread_func)(void* arg);
+
+typedef struct
+{
+    thread_func func;
+    void* arg;
+    BOOL started;
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+} platform_thread;
+
+// Runs func(arg) on a new thread, returns 0 on success
+int thread_start(platform_thread* thread, thread_func func, void* arg);
+
+// Waits for the thread to return, does nothing if it wasn't started
+void thread_join(platform_thread* thread);
+
+// Sets *stop to TRUE when the process is asked to quit (Ctrl+C, closing the console, SIGTERM)
+// instead of ending it, so a loop that checks the flag can clean up on its way out.
+// Only one flag at a time, returns 0 on success
+int stop_on_interrupt(volatile BOOL* stop);
@@ -0,0 +1,159 @@
+#include "r3e.h"
+#include "platform.h"
+#include "synth.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STATUS_SEC 5
+
+// Spin instead of sleeping when the next frame is closer than this
+#define SPIN_WINDOW_US 2000
+
+shared_map map_view;
+r3e_shared* map_buffer = NULL;
+synth_state race;
+r3e_shared frame;
+
+static void usage()
+{
+    wprintf_s(L"Usage: producer [-rate hz] [-cars n] [-seconds n] [-seed n] [-tear-us n] [-tear-every n]\n");
+    wprintf_s(L"  -rate       frames per second, one game tick per frame (default 400)\n");
+    wprintf_s(L"  -cars       number of cars, 1 - %d (default %d)\n", R3E_NUM_DRIVERS_MAX, R3E_NUM_DRIVERS_MAX);
+    wprintf_s(L"  -seconds    run time, 0 = until killed (default 0)\n");
+    wprintf_s(L"  -seed       seed for the synthetic race (default 1)\n");
+    wprintf_s(L"  -tear-us    stall this long halfway through publishing a frame (default 0)\n");
+    wprintf_s(L"  -tear-every only stall every n-th frame (default 1)\n");
+}
+
+// Copies the frame into the mapping in the same order the game lays it out.
+// With tear_us set the copy stops halfway through the driver array, so readers
+// can land on a frame that is half old and half new.
+static void publish(uint32_t tear_us)
+{
+    const size_t split = offsetof(r3e_shared, all_drivers_data_1[R3E_NUM_DRIVERS_MAX / 2]);
+    uint64_t stall_end = 0;
+
+    if (tear_us == 0)
+    {
+        memcpy(map_buffer, &frame, sizeof(frame));
+        return;
+    }
+
+    memcpy(map_buffer, &frame, split);
+
+    stall_end = time_now_us() + tear_us;
+    while (time_now_us() < stall_end)
+        platform_cpu_relax();
+
+    memcpy((char*)map_buffer + split, (const char*)&frame + split, sizeof(frame) - split);
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t rate = 400;
+    int cars = R3E_NUM_DRIVERS_MAX;
+    uint32_t seconds = 0;
+    uint32_t seed = 1;
+    uint32_t tear_us = 0;
+    uint32_t tear_every = 1;
+    uint64_t period_us, start_us, next_us, status_us, now_us;
+    uint64_t frames = 0, late = 0, status_frames = 0;
+    int i;
+
+    for (i = 1; i < argc; ++i)
+    {
+        if (i + 1 < argc && strcmp(argv[i], "-rate") == 0)
+            rate = (uint32_t)atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "-cars") == 0)
+            cars = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "-seconds") == 0)
+            seconds = (uint32_t)atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "-seed") == 0)
+            seed = (uint32_t)atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "-tear-us") == 0)
+            tear_us = (uint32_t)atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "-tear-every") == 0)
+            tear_every = (uint32_t)atoi(argv[++i]);
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if (rate == 0 || cars < 1 || cars > R3E_NUM_DRIVERS_MAX || tear_every == 0)
+    {
+        usage();
+        return 1;
+    }
+
+    if (shared_map_create(&map_view, R3E_SHARED_MEMORY_NAME, sizeof(r3e_shared)))
+    {
+        wprintf_s(L"Failed to create mapping\n");
+        return 1;
+    }
+
+    map_buffer = (r3e_shared*)map_view.view;
+
+    synth_init(&race, cars, seed);
+    synth_write(&race, &frame);
+    memcpy(map_buffer, &frame, sizeof(frame));
+
+    wprintf_s(L"Producing %d cars at %u Hz\n", cars, rate);
+
+    timer_resolution_begin();
+
+    period_us = 1000000 / rate;
+    start_us = time_now_us();
+    next_us = start_us;
+    status_us = start_us + STATUS_SEC * 1000000;
+
+    for (;;)
+    {
+        // Ticks stay 1/400th of a second of race time, above 400 Hz the race runs faster than real time
+        synth_step(&race);
+        synth_write_player(&race, &frame);
+        synth_write_drivers(&race, &frame, 0, race.num_cars);
+
+        publish(frames % tear_every == 0 ? tear_us : 0);
+        frames++;
+
+        next_us += period_us;
+        now_us = time_now_us();
+
+        if (now_us > next_us + period_us)
+        {
+            // Fell more than a frame behind, don't try to catch up with a burst
+            late++;
+            next_us = now_us;
+        }
+
+        while ((now_us = time_now_us()) < next_us)
+        {
+            if (next_us - now_us > SPIN_WINDOW_US)
+                sleep_ms(1);
+            else
+                platform_cpu_relax();
+        }
+
+        if (now_us >= status_us)
+        {
+            wprintf_s(L"Tick %d, %.1f frames/s, %llu late\n", race.tick,
+                (double)(frames - status_frames) / STATUS_SEC, (unsigned long long)late);
+            status_frames = frames;
+            status_us += STATUS_SEC * 1000000;
+        }
+
+        if (seconds != 0 && now_us - start_us >= (uint64_t)seconds * 1000000)
+            break;
+    }
+
+    timer_resolution_end();
+    shared_map_close(&map_view);
+
+    wprintf_s(L"Produced %llu frames, %llu late\n", (unsigned long long)frames, (unsigned long long)late);
+
+    return 0;
+}
@@ -0,0 +1,398 @@
+#include "racelog.h"
+
+#include <string.h>
+
+#if PLATFORM_AVX2
+#include <immintrin.h>
+#elif PLATFORM_SSE2
+#include <emmintrin.h>
+#endif
+
+// One bit per slot
+#define RACELOG_WORDS (RACELOG_SLOTS / 32)
+
+static const char* kind_names[RACELOG_KIND_COUNT] =
+{
+    "session",
+    "phase",
+    "start_lights",
+    "flag_on",
+    "flag_off",
+    "pit_state",
+    "driver_joined",
+    "driver_left",
+    "pit_in",
+    "pit_out",
+    "pit_stop",
+    "overtake",
+    "penalty",
+    "penalty_cleared",
+    "finish"
+};
+
+int racelog_init(racelog* log, const char* path, racelog_callback callback, void* context)
+{
+    memset(log, 0, sizeof(*log));
+
+    log->callback = callback;
+    log->context = context;
+    log->previous = (racelog_state*)aligned_malloc(sizeof(racelog_state), 32);
+    log->current = (racelog_state*)aligned_malloc(sizeof(racelog_state), 32);
+
+    if (log->previous == NULL || log->current == NULL)
+    {
+        racelog_close(log);
+        return 1;
+    }
+
+    if (path)
+    {
+        log->file = file_open(path, "a");
+        if (log->file == NULL)
+        {
+            racelog_close(log);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+void racelog_close(racelog* log)
+{
+    if (log->file)
+        fclose(log->file);
+
+    aligned_free(log->previous);
+    aligned_free(log->current);
+    memset(log, 0, sizeof(*log));
+}
+
+void racelog_reset(racelog* log)
+{
+    log->has_previous = FALSE;
+}
+
+uint32_t racelog_flags(const r3e_shared* frame)
+{
+    const r3e_flags* flags = &frame->flags;
+
+    return (uint32_t)(flags->yellow > 0) << RACELOG_FLAG_YELLOW |
+        (uint32_t)(flags->sector_yellow[0] > 0) << RACELOG_FLAG_SECTOR_YELLOW |
+        (uint32_t)(flags->sector_yellow[1] > 0) << (RACELOG_FLAG_SECTOR_YELLOW + 1) |
+        (uint32_t)(flags->sector_yellow[2] > 0) << (RACELOG_FLAG_SECTOR_YELLOW + 2) |
+        (uint32_t)(flags->blue > 0) << RACELOG_FLAG_BLUE |
+        (uint32_t)(flags->black > 0) << RACELOG_FLAG_BLACK |
+        (uint32_t)(flags->green > 0) << RACELOG_FLAG_GREEN |
+        (uint32_t)(flags->checkered > 0) << RACELOG_FLAG_CHECKERED |
+        (uint32_t)(flags->white > 0) << RACELOG_FLAG_WHITE |
+        (uint32_t)(flags->black_and_white > 0) << RACELOG_FLAG_BLACK_AND_WHITE;
+}
+
+static void gather(racelog_state* state, const r3e_shared* frame)
+{
+    const r3e_driver_data* driver;
+    r3e_int32 slot;
+    int count = frame->num_cars;
+    int i;
+
+    if (count < 0)
+        count = 0;
+    if (count > R3E_NUM_DRIVERS_MAX)
+        count = R3E_NUM_DRIVERS_MAX;
+
+    memset(state, 0, sizeof(*state));
+
+    for (i = 0; i < count; ++i)
+    {
+        driver = &frame->all_drivers_data_1[i];
+        slot = driver->driver_info.slot_id;
+
+        if (slot < 0 || slot >= RACELOG_SLOTS)
+            continue;
+
+        state->present[slot] = 1;
+        state->place[slot] = driver->place;
+        state->in_pitlane[slot] = driver->in_pitlane;
+        state->num_pitstops[slot] = driver->num_pitstops;
+        state->penalty_type[slot] = driver->penaltyType;
+        state->penalty_reason[slot] = driver->penaltyReason;
+        state->finish_status[slot] = driver->finish_status;
+        state->completed_laps[slot] = driver->completed_laps;
+    }
+
+    state->session_type = frame->session_type;
+    state->session_iteration = frame->session_iteration;
+    state->session_phase = frame->session_phase;
+    state->start_lights = frame->start_lights;
+    state->pit_state = frame->pit_state;
+    state->flags = racelog_flags(frame);
+}
+
+// Sets a bit in changed for every slot where any compared column differs
+#if PLATFORM_AVX2
+
+static __m256i equal(const r3e_int32* a, const r3e_int32* b, int i)
+{
+    return _mm256_cmpeq_epi32(_mm256_load_si256((const __m256i*)(a + i)), _mm256_load_si256((const __m256i*)(b + i)));
+}
+
+static void compare(const racelog_state* a, const racelog_state* b, uint32_t* changed)
+{
+    __m256i same;
+    uint32_t bits;
+    int i;
+
+    for (i = 0; i < RACELOG_SLOTS; i += 8)
+    {
+        same = _mm256_and_si256(equal(a->present, b->present, i), equal(a->place, b->place, i));
+        same = _mm256_and_si256(same, equal(a->in_pitlane, b->in_pitlane, i));
+        same = _mm256_and_si256(same, equal(a->num_pitstops, b->num_pitstops, i));
+        same = _mm256_and_si256(same, equal(a->penalty_type, b->penalty_type, i));
+        same = _mm256_and_si256(same, equal(a->penalty_reason, b->penalty_reason, i));
+        same = _mm256_and_si256(same, equal(a->finish_status, b->finish_status, i));
+
+        bits = ~(uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(same)) & 0xFFu;
+        changed[i / 32] |= bits << (i % 32);
+    }
+}
+
+#elif PLATFORM_SSE2
+
+static __m128i equal(const r3e_int32* a, const r3e_int32* b, int i)
+{
+    return _mm_cmpeq_epi32(_mm_load_si128((const __m128i*)(a + i)), _mm_load_si128((const __m128i*)(b + i)));
+}
+
+static void compare(const racelog_state* a, const racelog_state* b, uint32_t* changed)
+{
+    __m128i same;
+    uint32_t bits;
+    int i;
+
+    for (i = 0; i < RACELOG_SLOTS; i += 4)
+    {
+        same = _mm_and_si128(equal(a->present, b->present, i), equal(a->place, b->place, i));
+        same = _mm_and_si128(same, equal(a->in_pitlane, b->in_pitlane, i));
+        same = _mm_and_si128(same, equal(a->num_pitstops, b->num_pitstops, i));
+        same = _mm_and_si128(same, equal(a->penalty_type, b->penalty_type, i));
+        same = _mm_and_si128(same, equal(a->penalty_reason, b->penalty_reason, i));
+        same = _mm_and_si128(same, equal(a->finish_status, b->finish_status, i));
+
+        bits = ~(uint32_t)_mm_movemask_ps(_mm_castsi128_ps(same)) & 0xFu;
+        changed[i / 32] |= bits << (i % 32);
+    }
+}
+
+#else
+
+static void compare(const racelog_state* a, const racelog_state* b, uint32_t* changed)
+{
+    uint32_t differs;
+    int i;
+
+    for (i = 0; i < RACELOG_SLOTS; ++i)
+    {
+        differs = (uint32_t)(a->present[i] != b->present[i]) | (uint32_t)(a->place[i] != b->place[i]) |
+            (uint32_t)(a->in_pitlane[i] != b->in_pitlane[i]) | (uint32_t)(a->num_pitstops[i] != b->num_pitstops[i]) |
+            (uint32_t)(a->penalty_type[i] != b->penalty_type[i]) | (uint32_t)(a->penalty_reason[i] != b->penalty_reason[i]) |
+            (uint32_t)(a->finish_status[i] != b->finish_status[i]);
+
+        changed[i / 32] |= differs << (i % 32);
+    }
+}
+
+#endif
+
+// event has when, who and the lap filled in
+static void emit(racelog* log, racelog_event* event, racelog_kind kind, r3e_int32 before, r3e_int32 after, r3e_int32 detail)
+{
+    char line[256];
+
+    event->kind = kind;
+    event->before = before;
+    event->after = after;
+    event->detail = detail;
+
+    log->events++;
+    log->counts[kind]++;
+
+    if (log->callback)
+        log->callback(event, log->context);
+
+    if (log->file)
+    {
+        racelog_format(event, line, sizeof(line));
+        fputs(line, log->file);
+        fputc('\n', log->file);
+    }
+}
+
+static void session_events(racelog* log, racelog_event* event)
+{
+    const racelog_state* prev = log->previous;
+    const racelog_state* cur = log->current;
+    uint32_t flags = prev->flags ^ cur->flags;
+    int i;
+
+    if (cur->session_phase != prev->session_phase)
+        emit(log, event, RACELOG_PHASE, prev->session_phase, cur->session_phase, -1);
+
+    if (cur->start_lights != prev->start_lights)
+        emit(log, event, RACELOG_START_LIGHTS, prev->start_lights, cur->start_lights, -1);
+
+    for (i = 0; flags; ++i, flags >>= 1)
+    {
+        if (flags & 1)
+            emit(log, event, cur->flags & (1u << i) ? RACELOG_FLAG_ON : RACELOG_FLAG_OFF, -1, -1, i);
+    }
+
+    if (cur->pit_state != prev->pit_state)
+        emit(log, event, RACELOG_PIT_STATE, prev->pit_state, cur->pit_state, -1);
+}
+
+// Events of one slot that changed, returns whether its place changed
+static BOOL driver_events(racelog* log, racelog_event* event, r3e_int32 slot)
+{
+    const racelog_state* prev = log->previous;
+    const racelog_state* cur = log->current;
+
+    event->slot_id = slot;
+    event->other_slot_id = -1;
+    event->lap = cur->present[slot] ? cur->completed_laps[slot] : prev->completed_laps[slot];
+
+    if (cur->present[slot] != prev->present[slot])
+    {
+        emit(log, event, cur->present[slot] ? RACELOG_DRIVER_JOINED : RACELOG_DRIVER_LEFT, -1, -1, -1);
+        return FALSE;
+    }
+
+    if (prev->in_pitlane[slot] <= 0 && cur->in_pitlane[slot] > 0)
+        emit(log, event, RACELOG_PIT_IN, prev->in_pitlane[slot], cur->in_pitlane[slot], -1);
+    else if (prev->in_pitlane[slot] > 0 && cur->in_pitlane[slot] <= 0)
+        emit(log, event, RACELOG_PIT_OUT, prev->in_pitlane[slot], cur->in_pitlane[slot], -1);
+
+    if (cur->num_pitstops[slot] > prev->num_pitstops[slot])
+        emit(log, event, RACELOG_PIT_STOP, prev->num_pitstops[slot], cur->num_pitstops[slot], -1);
+
+    if (cur->penalty_type[slot] != prev->penalty_type[slot] || cur->penalty_reason[slot] != prev->penalty_reason[slot])
+    {
+        if (cur->penalty_type[slot] >= 0)
+            emit(log, event, RACELOG_PENALTY, prev->penalty_type[slot], cur->penalty_type[slot], cur->penalty_reason[slot]);
+        else if (prev->penalty_type[slot] >= 0)
+            emit(log, event, RACELOG_PENALTY_CLEARED, prev->penalty_type[slot], cur->penalty_type[slot], prev->penalty_reason[slot]);
+    }
+
+    if (cur->finish_status[slot] != prev->finish_status[slot])
+        emit(log, event, RACELOG_FINISH, prev->finish_status[slot], cur->finish_status[slot], -1);
+
+    return cur->place[slot] != prev->place[slot] && cur->place[slot] > 0 && prev->place[slot] > 0;
+}
+
+// moved: slots whose place changed. Every slot that went from behind another
+// one to ahead of it passed it
+static void overtakes(racelog* log, racelog_event* event, const r3e_int32* moved, int num_moved)
+{
+    const racelog_state* prev = log->previous;
+    const racelog_state* cur = log->current;
+    r3e_int32 a, b;
+    int i, j;
+
+    for (i = 0; i < num_moved; ++i)
+    {
+        a = moved[i];
+        if (cur->place[a] >= prev->place[a])
+            continue;
+
+        for (j = 0; j < num_moved; ++j)
+        {
+            b = moved[j];
+            if (prev->place[b] >= prev->place[a] || cur->place[b] <= cur->place[a])
+                continue;
+
+            event->slot_id = a;
+            event->other_slot_id = b;
+            event->lap = cur->completed_laps[a];
+            emit(log, event, RACELOG_OVERTAKE, prev->place[a], cur->place[a], -1);
+        }
+    }
+}
+
+uint32_t racelog_update(racelog* log, const r3e_shared* frame)
+{
+    uint32_t changed[RACELOG_WORDS];
+    r3e_int32 moved[RACELOG_SLOTS];
+    racelog_state* swap;
+    racelog_event event;
+    uint64_t events = log->events;
+    uint32_t word;
+    int num_moved = 0;
+    int i, bit;
+
+    gather(log->current, frame);
+    log->frames++;
+
+    memset(&event, 0, sizeof(event));
+    event.ticks = frame->player.game_simulation_ticks;
+    event.time = frame->player.game_simulation_time;
+    event.slot_id = -1;
+    event.other_slot_id = -1;
+    event.lap = frame->completed_laps;
+
+    if (log->has_previous)
+    {
+        // A new session starts over, nothing carries across
+        if (log->current->session_type != log->previous->session_type ||
+            log->current->session_iteration != log->previous->session_iteration)
+        {
+            emit(log, &event, RACELOG_SESSION, log->previous->session_type, log->current->session_type,
+                log->current->session_iteration);
+        }
+        else
+        {
+            session_events(log, &event);
+
+            memset(changed, 0, sizeof(changed));
+            compare(log->previous, log->current, changed);
+
+            for (i = 0; i < RACELOG_WORDS; ++i)
+            {
+                for (word = changed[i], bit = 0; word; word >>= 1, ++bit)
+                {
+                    if ((word & 1) && driver_events(log, &event, i * 32 + bit))
+                        moved[num_moved++] = i * 32 + bit;
+                }
+            }
+
+            if (frame->session_type == R3E_SESSION_RACE)
+                overtakes(log, &event, moved, num_moved);
+        }
+    }
+
+    swap = log->previous;
+    log->previous = log->current;
+    log->current = swap;
+    log->has_previous = TRUE;
+
+    if (log->file && log->events != events)
+        fflush(log->file);
+
+    return (uint32_t)(log->events - events);
+}
+
+const char* racelog_kind_name(racelog_kind kind)
+{
+    if ((int)kind < 0 || kind >= RACELOG_KIND_COUNT)
+        return "unknown";
+
+    return kind_names[kind];
+}
+
+void racelog_format(const racelog_event* event, char* buffer, size_t size)
+{
+    snprintf(buffer, size,
+        "{\"ticks\": %d, \"time\": %.4f, \"event\": \"%s\", \"slot\": %d, \"other\": %d, \"lap\": %d, "
+        "\"before\": %d, \"after\": %d, \"detail\": %d}",
+        event->ticks, event->time, racelog_kind_name(event->kind), event->slot_id, event->other_slot_id,
+        event->lap, event->before, event->after, event->detail);
+}
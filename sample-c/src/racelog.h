@@ -0,0 +1,157 @@
+#pragma once
+
+#include "r3e.h"
+#include "platform.h"
+
+// Driver slots tracked, indexed by driver_info.slot_id
+#define RACELOG_SLOTS R3E_NUM_DRIVERS_MAX
+
+// Bits of the flag mask, see racelog_flags
+enum
+{
+    RACELOG_FLAG_YELLOW = 0,
+
+    // + sector (0 - 2)
+    RACELOG_FLAG_SECTOR_YELLOW = 1,
+
+    RACELOG_FLAG_BLUE = 4,
+    RACELOG_FLAG_BLACK = 5,
+    RACELOG_FLAG_GREEN = 6,
+    RACELOG_FLAG_CHECKERED = 7,
+    RACELOG_FLAG_WHITE = 8,
+    RACELOG_FLAG_BLACK_AND_WHITE = 9,
+
+    RACELOG_FLAG_COUNT = 10
+};
+
+typedef enum
+{
+    // Session events, slot_id is -1
+
+    // session_type or session_iteration changed: before/after are the session types, detail the new iteration
+    RACELOG_SESSION = 0,
+    RACELOG_PHASE = 1,
+    RACELOG_START_LIGHTS = 2,
+
+    // A flag period started or ended, detail is the RACELOG_FLAG_ bit
+    RACELOG_FLAG_ON = 3,
+    RACELOG_FLAG_OFF = 4,
+
+    // The player's pit_state
+    RACELOG_PIT_STATE = 5,
+
+    // Driver events
+
+    RACELOG_DRIVER_JOINED = 6,
+    RACELOG_DRIVER_LEFT = 7,
+    RACELOG_PIT_IN = 8,
+    RACELOG_PIT_OUT = 9,
+
+    // num_pitstops went up
+    RACELOG_PIT_STOP = 10,
+
+    // In a race, the driver went from behind other_slot_id to ahead of it: before/after are the driver's places
+    RACELOG_OVERTAKE = 11,
+
+    // before/after are penaltyType, detail the new penaltyReason
+    RACELOG_PENALTY = 12,
+
+    // The penalty before (penaltyType) was served or lifted
+    RACELOG_PENALTY_CLEARED = 13,
+
+    // finish_status changed
+    RACELOG_FINISH = 14,
+
+    RACELOG_KIND_COUNT = 15
+} racelog_kind;
+
+typedef struct
+{
+    racelog_kind kind;
+
+    // When, player.game_simulation_ticks and player.game_simulation_time
+    r3e_int32 ticks;
+    r3e_float64 time;
+
+    // The driver and the other driver involved, -1 if none
+    r3e_int32 slot_id;
+    r3e_int32 other_slot_id;
+
+    // Driver's completed_laps (the player's for session events)
+    r3e_int32 lap;
+
+    // Old and new value, and a detail, depending on kind, -1 if unused
+    r3e_int32 before;
+    r3e_int32 after;
+    r3e_int32 detail;
+} racelog_event;
+
+typedef void (*racelog_callback)(const racelog_event* event, void* context);
+
+// State compared from one tick to the next, one column per field indexed by
+// slot id. Absent slots are all zeros.
+typedef struct
+{
+    ALIGNED(32) r3e_int32 present[RACELOG_SLOTS];
+    ALIGNED(32) r3e_int32 place[RACELOG_SLOTS];
+    ALIGNED(32) r3e_int32 in_pitlane[RACELOG_SLOTS];
+    ALIGNED(32) r3e_int32 num_pitstops[RACELOG_SLOTS];
+    ALIGNED(32) r3e_int32 penalty_type[RACELOG_SLOTS];
+    ALIGNED(32) r3e_int32 penalty_reason[RACELOG_SLOTS];
+    ALIGNED(32) r3e_int32 finish_status[RACELOG_SLOTS];
+    ALIGNED(32) r3e_int32 completed_laps[RACELOG_SLOTS];
+
+    r3e_int32 session_type;
+    r3e_int32 session_iteration;
+    r3e_int32 session_phase;
+    r3e_int32 start_lights;
+    r3e_int32 pit_state;
+    uint32_t flags;
+} racelog_state;
+
+// Turns per tick state into race events: session phases, start lights, flag
+// periods and the player's pit state, and per driver joins, pit lane entries
+// and exits, pit stops, overtakes, penalties and finishes.
+// Each tick the drivers are gathered into columns by slot id, and every column
+// is compared with the last tick's 4 (SSE2) or 8 (AVX2) slots at a time into
+// a bit per slot that changed; only those slots are looked at further, so a
+// quiet tick costs the same whatever the field size. Overtakes are paired up
+// among the slots whose place changed. Nothing is allocated per tick.
+// Events go to the callback and, as JSON lines, to the log file, which is
+// only ever appended to.
+typedef struct
+{
+    racelog_callback callback;
+    void* context;
+    FILE* file;
+
+    racelog_state* previous;
+    racelog_state* current;
+    BOOL has_previous;
+
+    uint64_t frames;
+    uint64_t events;
+    uint64_t counts[RACELOG_KIND_COUNT];
+} racelog;
+
+// path is the log file to append to and callback gets every event, either can be NULL
+// Returns 0 on success
+int racelog_init(racelog* log, const char* path, racelog_callback callback, void* context);
+void racelog_close(racelog* log);
+
+// Compares with the last frame and reports what happened since.
+// The first frame after init or racelog_reset reports nothing.
+// Returns the number of events emitted.
+uint32_t racelog_update(racelog* log, const r3e_shared* frame);
+
+// Forget the previous frame, e.g. after reconnecting
+void racelog_reset(racelog* log);
+
+// Flags set in frame->flags as a mask of RACELOG_FLAG_ bits
+uint32_t racelog_flags(const r3e_shared* frame);
+
+// "pit_in", "overtake", etc.
+const char* racelog_kind_name(racelog_kind kind);
+
+// Writes the event as one JSON object, without a line break
+void racelog_format(const racelog_event* event, char* buffer, size_t size);
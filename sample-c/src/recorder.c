@@ -0,0 +1,103 @@
+#include "recorder.h"
+#include "delta.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define FILE_BUFFER_SIZE (1024 * 1024)
+
+static int write_header(recorder* rec, const r3e_shared* frame)
+{
+    recorder_file_header header;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RECORDER_MAGIC, sizeof(header.magic));
+    header.format_version = RECORDER_FORMAT_VERSION;
+    header.version_major = frame->version_major;
+    header.version_minor = frame->version_minor;
+    header.all_drivers_offset = frame->all_drivers_offset;
+    header.driver_data_size = frame->driver_data_size;
+    header.frame_size = sizeof(r3e_shared);
+    header.keyframe_interval = rec->keyframe_interval;
+
+    return fwrite(&header, sizeof(header), 1, rec->file) != 1;
+}
+
+int recorder_open(recorder* rec, const char* path, uint32_t keyframe_interval)
+{
+    memset(rec, 0, sizeof(*rec));
+
+    rec->keyframe_interval = keyframe_interval > 0 ? keyframe_interval : 1;
+    rec->previous = (r3e_shared*)malloc(sizeof(r3e_shared));
+    rec->buffer = (uint8_t*)malloc(DELTA_BOUND(sizeof(r3e_shared)));
+    rec->file = file_open(path, "wb");
+
+    if (rec->previous == NULL || rec->buffer == NULL || rec->file == NULL)
+    {
+        recorder_close(rec);
+        return 1;
+    }
+
+    setvbuf(rec->file, NULL, _IOFBF, FILE_BUFFER_SIZE);
+
+    return 0;
+}
+
+int recorder_write(recorder* rec, const r3e_shared* frame)
+{
+    recorder_frame_header header;
+    const void* payload = frame;
+
+    if (!rec->has_previous && write_header(rec, frame))
+        return 1;
+
+    header.ticks = frame->player.game_simulation_ticks;
+    header.type = RECORDER_DELTA;
+    header.size = sizeof(r3e_shared);
+
+    // Keyframe on schedule, and whenever the tick goes backwards so seeking stays simple
+    if (!rec->has_previous ||
+        rec->frames_since_keyframe + 1 >= rec->keyframe_interval ||
+        frame->player.game_simulation_ticks < rec->previous->player.game_simulation_ticks)
+    {
+        header.type = RECORDER_KEYFRAME;
+    }
+
+    if (header.type == RECORDER_DELTA)
+    {
+        header.size = (uint32_t)delta_encode((const uint8_t*)rec->previous, (const uint8_t*)frame, sizeof(r3e_shared), rec->buffer);
+        payload = rec->buffer;
+        rec->frames_since_keyframe++;
+    }
+    else
+    {
+        rec->frames_since_keyframe = 0;
+        rec->keyframes++;
+    }
+
+    if (fwrite(&header, sizeof(header), 1, rec->file) != 1 ||
+        (header.size > 0 && fwrite(payload, header.size, 1, rec->file) != 1))
+    {
+        return 1;
+    }
+
+    memcpy(rec->previous, frame, sizeof(r3e_shared));
+    rec->has_previous = TRUE;
+
+    rec->frames++;
+    rec->bytes_in += sizeof(r3e_shared);
+    rec->bytes_out += sizeof(header) + header.size;
+
+    return 0;
+}
+
+void recorder_close(recorder* rec)
+{
+    if (rec->file) fclose(rec->file);
+    free(rec->previous);
+    free(rec->buffer);
+
+    rec->file = NULL;
+    rec->previous = NULL;
+    rec->buffer = NULL;
+}
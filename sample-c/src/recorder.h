@@ -0,0 +1,73 @@
+#pragma once
+
+#include "r3e.h"
+#include "platform.h"
+
+#define RECORDER_MAGIC "R3ER"
+#define RECORDER_FORMAT_VERSION 1
+
+// One keyframe per second of ticks by default
+#define RECORDER_KEYFRAME_INTERVAL_DEFAULT 400
+
+enum
+{
+    RECORDER_KEYFRAME = 0,
+    RECORDER_DELTA = 1,
+};
+
+// A recording is a file header followed by frames. Each frame is a frame header
+// and either a raw r3e_shared (keyframe) or a delta.h encoding against the frame
+// before it. The header repeats the layout fields of the first recorded frame
+// so files can be read back by builds with a different r3e.h.
+#pragma pack(push, 1)
+
+typedef struct
+{
+    char magic[4];
+    uint32_t format_version;
+
+    r3e_int32 version_major;
+    r3e_int32 version_minor;
+    r3e_int32 all_drivers_offset;
+    r3e_int32 driver_data_size;
+
+    // Size of one decoded frame
+    uint32_t frame_size;
+    uint32_t keyframe_interval;
+} recorder_file_header;
+
+typedef struct
+{
+    uint8_t type;
+    r3e_int32 ticks;
+
+    // Bytes of frame data following this header
+    uint32_t size;
+} recorder_frame_header;
+
+#pragma pack(pop)
+
+typedef struct
+{
+    FILE* file;
+    uint32_t keyframe_interval;
+    uint32_t frames_since_keyframe;
+
+    r3e_shared* previous;
+    uint8_t* buffer;
+    BOOL has_previous;
+
+    // Statistics
+    uint64_t frames;
+    uint64_t keyframes;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+} recorder;
+
+// Returns 0 on success
+int recorder_open(recorder* rec, const char* path, uint32_t keyframe_interval);
+
+// Appends a frame, returns 0 on success
+int recorder_write(recorder* rec, const r3e_shared* frame);
+
+void recorder_close(recorder* rec);
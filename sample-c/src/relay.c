@@ -0,0 +1,275 @@
+#include "relay.h"
+#include "delta.h"
+#include "tickwait.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SHARED_SIZE(field) sizeof(((r3e_shared*)0)->field)
+#define SHARED_END(field) (offsetof(r3e_shared, field) + SHARED_SIZE(field))
+
+static const relay_range player_ranges[] =
+{
+    { offsetof(r3e_shared, player), SHARED_SIZE(player) },
+    { offsetof(r3e_shared, tire_temp), SHARED_SIZE(tire_temp) },
+    { offsetof(r3e_shared, brake_temp), SHARED_SIZE(brake_temp) },
+    { 0, 0 }
+};
+
+static const relay_range driver_ranges[] =
+{
+    { offsetof(r3e_shared, all_drivers_data_1), SHARED_SIZE(all_drivers_data_1) },
+    { 0, 0 }
+};
+
+// The gaps between the other two channels
+static const relay_range session_ranges[] =
+{
+    { 0, offsetof(r3e_shared, player) },
+    { SHARED_END(player), offsetof(r3e_shared, tire_temp) - SHARED_END(player) },
+    { SHARED_END(tire_temp), offsetof(r3e_shared, brake_temp) - SHARED_END(tire_temp) },
+    { SHARED_END(brake_temp), offsetof(r3e_shared, all_drivers_data_1) - SHARED_END(brake_temp) },
+    { 0, 0 }
+};
+
+const relay_range* const relay_channel_ranges[RELAY_CHANNEL_COUNT] =
+{
+    player_ranges,
+    driver_ranges,
+    session_ranges
+};
+
+uint32_t relay_channel_size(relay_channel channel)
+{
+    const relay_range* range;
+    uint32_t size = 0;
+
+    for (range = relay_channel_ranges[channel]; range->size != 0; ++range)
+        size += range->size;
+
+    return size;
+}
+
+void relay_gather(relay_channel channel, const r3e_shared* frame, uint8_t* image)
+{
+    const relay_range* range;
+
+    for (range = relay_channel_ranges[channel]; range->size != 0; ++range)
+    {
+        memcpy(image, (const uint8_t*)frame + range->offset, range->size);
+        image += range->size;
+    }
+}
+
+void relay_scatter(relay_channel channel, const uint8_t* image, r3e_shared* frame)
+{
+    const relay_range* range;
+
+    for (range = relay_channel_ranges[channel]; range->size != 0; ++range)
+    {
+        memcpy((uint8_t*)frame + range->offset, image, range->size);
+        image += range->size;
+    }
+}
+
+int relay_encoder_init(relay_encoder* encoder, uint32_t keyframe_interval, uint64_t budget,
+    relay_send_func send, void* context)
+{
+    relay_channel_state* state;
+    int c;
+
+    memset(encoder, 0, sizeof(*encoder));
+
+    encoder->keyframe_interval = keyframe_interval > 0 ? keyframe_interval : 1;
+    encoder->budget = budget;
+    encoder->send = send;
+    encoder->context = context;
+
+    // The driver channel is the largest by far, every buffer is sized for it
+    encoder->buffer = (uint8_t*)malloc(DELTA_BOUND(relay_channel_size(RELAY_CHANNEL_DRIVERS)));
+    encoder->zeros = (uint8_t*)calloc(1, relay_channel_size(RELAY_CHANNEL_DRIVERS));
+    encoder->packet = (uint8_t*)malloc(RELAY_PACKET_MAX);
+
+    if (encoder->buffer == NULL || encoder->zeros == NULL || encoder->packet == NULL)
+    {
+        relay_encoder_close(encoder);
+        return 1;
+    }
+
+    for (c = 0; c < RELAY_CHANNEL_COUNT; ++c)
+    {
+        state = &encoder->channels[c];
+        state->size = relay_channel_size((relay_channel)c);
+        state->image = (uint8_t*)malloc(state->size);
+        state->previous = (uint8_t*)malloc(state->size);
+
+        if (state->image == NULL || state->previous == NULL)
+        {
+            relay_encoder_close(encoder);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+void relay_encoder_close(relay_encoder* encoder)
+{
+    int c;
+
+    for (c = 0; c < RELAY_CHANNEL_COUNT; ++c)
+    {
+        free(encoder->channels[c].image);
+        free(encoder->channels[c].previous);
+    }
+
+    free(encoder->buffer);
+    free(encoder->zeros);
+    free(encoder->packet);
+
+    memset(encoder, 0, sizeof(*encoder));
+}
+
+// Splits an encoded frame into packets and hands them to the send callback
+static void send_frame(relay_encoder* encoder, relay_channel channel, uint8_t type,
+    uint32_t size, r3e_int32 ticks, uint64_t capture_us)
+{
+    relay_channel_state* state = &encoder->channels[channel];
+    relay_packet_header header;
+    uint32_t offset = 0, chunk;
+    uint32_t count = (size + RELAY_FRAGMENT_SIZE - 1) / RELAY_FRAGMENT_SIZE;
+
+    // Unchanged frames still go out as an empty packet, it carries the tick
+    if (count == 0)
+        count = 1;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RELAY_MAGIC, sizeof(header.magic));
+    header.format_version = RELAY_FORMAT_VERSION;
+    header.channel = (uint8_t)channel;
+    header.type = type;
+    header.fragment_count = (uint8_t)count;
+    header.sequence = state->sequence;
+    header.base_sequence = type == RELAY_KEYFRAME ? state->sequence : state->sequence - 1;
+    header.frame_size = size;
+    header.ticks = ticks;
+    header.capture_us = capture_us;
+
+    for (header.fragment = 0; header.fragment < count; ++header.fragment)
+    {
+        chunk = size - offset < RELAY_FRAGMENT_SIZE ? size - offset : RELAY_FRAGMENT_SIZE;
+        header.size = (uint16_t)chunk;
+        header.fragment_offset = offset;
+
+        memcpy(encoder->packet, &header, sizeof(header));
+        memcpy(encoder->packet + sizeof(header), encoder->buffer + offset, chunk);
+        encoder->send(channel, encoder->packet, sizeof(header) + chunk, encoder->context);
+
+        state->packets++;
+        state->bytes += sizeof(header) + chunk;
+        offset += chunk;
+    }
+}
+
+// Returns the number of bytes sent
+static uint64_t encode_channel(relay_encoder* encoder, relay_channel channel, const r3e_shared* frame, uint64_t capture_us)
+{
+    relay_channel_state* state = &encoder->channels[channel];
+    uint64_t bytes_before = state->bytes;
+    uint8_t type = RELAY_DELTA;
+    uint8_t* swap;
+    size_t size;
+
+    relay_gather(channel, frame, state->image);
+
+    if (!state->has_previous || state->ticks_since_keyframe + 1 >= encoder->keyframe_interval)
+        type = RELAY_KEYFRAME;
+
+    if (type == RELAY_KEYFRAME)
+    {
+        size = delta_encode(encoder->zeros, state->image, state->size, encoder->buffer);
+
+        // Spread the channels' keyframes over the interval instead of sending them on the same tick
+        state->ticks_since_keyframe = state->has_previous ? 0 :
+            (uint32_t)channel * encoder->keyframe_interval / RELAY_CHANNEL_COUNT;
+        state->keyframes++;
+    }
+    else
+    {
+        size = delta_encode(state->previous, state->image, state->size, encoder->buffer);
+        state->ticks_since_keyframe++;
+    }
+
+    state->sequence++;
+    send_frame(encoder, channel, type, (uint32_t)size, frame->player.game_simulation_ticks, capture_us);
+
+    swap = state->previous;
+    state->previous = state->image;
+    state->image = swap;
+    state->has_previous = TRUE;
+    state->frames++;
+
+    return state->bytes - bytes_before;
+}
+
+// Adds the budget for the ticks since the last frame, at most a second's worth is banked
+static void refill_budget(relay_encoder* encoder, r3e_int32 ticks)
+{
+    int64_t elapsed = ticks - encoder->budget_ticks;
+
+    if (!encoder->has_budget_ticks || elapsed < 0)
+    {
+        encoder->budget_left = (int64_t)encoder->budget;
+        encoder->has_budget_ticks = TRUE;
+    }
+    else
+    {
+        encoder->budget_left += (int64_t)(encoder->budget * (uint64_t)elapsed / TICK_RATE_HZ);
+        if (encoder->budget_left > (int64_t)encoder->budget)
+            encoder->budget_left = (int64_t)encoder->budget;
+    }
+
+    encoder->budget_ticks = ticks;
+}
+
+// Takes what was sent off the budget, at most a second's worth of debt is carried
+// so the driver channel resumes once the budget has a second to catch up
+static void charge_budget(relay_encoder* encoder, uint64_t sent)
+{
+    encoder->budget_left -= (int64_t)sent;
+    if (encoder->budget_left < -(int64_t)encoder->budget)
+        encoder->budget_left = -(int64_t)encoder->budget;
+}
+
+void relay_encode(relay_encoder* encoder, const r3e_shared* frame, uint64_t capture_us)
+{
+    relay_channel_state* drivers = &encoder->channels[RELAY_CHANNEL_DRIVERS];
+    uint64_t sent = 0;
+
+    if (encoder->budget)
+        refill_budget(encoder, frame->player.game_simulation_ticks);
+
+    sent += encode_channel(encoder, RELAY_CHANNEL_PLAYER, frame, capture_us);
+    sent += encode_channel(encoder, RELAY_CHANNEL_SESSION, frame, capture_us);
+
+    if (encoder->budget)
+    {
+        charge_budget(encoder, sent);
+
+        // A keyframe that is due goes out over budget, receivers that lost a
+        // frame or joined late would otherwise never see the drivers
+        if (encoder->budget_left <= 0 && drivers->has_previous &&
+            drivers->ticks_since_keyframe + 1 < encoder->keyframe_interval)
+        {
+            drivers->deferred++;
+            drivers->ticks_since_keyframe++;
+            return;
+        }
+    }
+
+    sent = encode_channel(encoder, RELAY_CHANNEL_DRIVERS, frame, capture_us);
+
+    if (encoder->budget)
+        charge_budget(encoder, sent);
+}
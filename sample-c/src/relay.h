@@ -0,0 +1,156 @@
+#pragma once
+
+#include "r3e.h"
+#include "platform.h"
+
+#define RELAY_MAGIC "R3EN"
+#define RELAY_FORMAT_VERSION 1
+
+#define RELAY_GROUP_DEFAULT "239.255.30.3"
+#define RELAY_PORT_DEFAULT 30300
+
+// One keyframe per channel per second of ticks by default
+#define RELAY_KEYFRAME_INTERVAL_DEFAULT 400
+
+// Payload bytes per packet, keeps packets under a 1500 byte Ethernet MTU
+#define RELAY_FRAGMENT_SIZE 1400
+
+// Largest packet the relay sends, header included
+#define RELAY_PACKET_MAX (sizeof(relay_packet_header) + RELAY_FRAGMENT_SIZE)
+
+// r3e_shared is split into channels, each multicast to its own port (port base + channel)
+// so receivers only pay for what they listen to. A channel's bytes are gathered
+// into one contiguous image in the order of relay_channel_ranges.
+typedef enum
+{
+    // player, tire_temp and brake_temp, the high rate player-only blocks
+    RELAY_CHANNEL_PLAYER = 0,
+
+    // all_drivers_data_1
+    RELAY_CHANNEL_DRIVERS = 1,
+
+    // Everything else: version, session, pit, flags, timing of the player etc.
+    RELAY_CHANNEL_SESSION = 2,
+
+    RELAY_CHANNEL_COUNT = 3
+} relay_channel;
+
+enum
+{
+    RELAY_KEYFRAME = 0,
+    RELAY_DELTA = 1,
+};
+
+// Every frame of a channel is a delta.h encoding of its image, a keyframe
+// against an all zero image (so unused driver slots cost nothing) and a
+// delta against the image of the previous frame sent on the channel. An
+// encoded frame larger than RELAY_FRAGMENT_SIZE is split over several
+// packets that all repeat the header.
+#pragma pack(push, 1)
+
+typedef struct
+{
+    char magic[4];
+    uint8_t format_version;
+    uint8_t channel;
+    uint8_t type;
+
+    // Fragment index and number of fragments of this frame
+    uint8_t fragment;
+    uint8_t fragment_count;
+    uint8_t unused;
+
+    // Payload bytes following this header
+    uint16_t size;
+
+    // Frame number on this channel, and the frame a delta applies to
+    uint32_t sequence;
+    uint32_t base_sequence;
+
+    // Encoded size of the whole frame and where this fragment starts in it
+    uint32_t frame_size;
+    uint32_t fragment_offset;
+
+    // player.game_simulation_ticks of the frame
+    r3e_int32 ticks;
+
+    // Relay clock (time_now_us) when the frame was captured
+    uint64_t capture_us;
+} relay_packet_header;
+
+#pragma pack(pop)
+
+typedef struct
+{
+    uint32_t offset;
+    uint32_t size;
+} relay_range;
+
+// Byte ranges of r3e_shared making up each channel, terminated by a zero size range
+extern const relay_range* const relay_channel_ranges[RELAY_CHANNEL_COUNT];
+
+// Size of a channel's image
+uint32_t relay_channel_size(relay_channel channel);
+
+// Copies a channel's ranges out of frame into image and back
+void relay_gather(relay_channel channel, const r3e_shared* frame, uint8_t* image);
+void relay_scatter(relay_channel channel, const uint8_t* image, r3e_shared* frame);
+
+typedef void (*relay_send_func)(relay_channel channel, const void* packet, size_t size, void* context);
+
+typedef struct
+{
+    uint8_t* image;
+    uint8_t* previous;
+    uint32_t size;
+
+    uint32_t sequence;
+
+    // Ticks relayed since the last keyframe, deferred ones included
+    uint32_t ticks_since_keyframe;
+    BOOL has_previous;
+
+    // Statistics
+    uint64_t frames;
+    uint64_t keyframes;
+    uint64_t packets;
+    uint64_t bytes;
+
+    // Frames held back to stay under the bandwidth budget
+    uint64_t deferred;
+} relay_channel_state;
+
+// Turns captured frames into relay packets.
+// With a bandwidth budget the driver channel is the one that gives: its frames
+// are held back while the budget is used up, and the next one sent is a delta
+// against the last one sent, so receivers just see a lower driver rate.
+// Deferred ticks still count towards the keyframe interval, and a keyframe
+// that is due is sent even over budget, so a receiver that lost a frame waits
+// no longer for a keyframe than without a budget. The player and session
+// channels are always sent; at most a second's worth of debt is carried.
+typedef struct
+{
+    relay_channel_state channels[RELAY_CHANNEL_COUNT];
+    uint32_t keyframe_interval;
+
+    // Bytes per second, 0 for no limit
+    uint64_t budget;
+    int64_t budget_left;
+    r3e_int32 budget_ticks;
+    BOOL has_budget_ticks;
+
+    relay_send_func send;
+    void* context;
+
+    uint8_t* buffer;
+    uint8_t* zeros;
+    uint8_t* packet;
+} relay_encoder;
+
+// budget is in bytes per second, 0 for no limit. Returns 0 on success
+int relay_encoder_init(relay_encoder* encoder, uint32_t keyframe_interval, uint64_t budget,
+    relay_send_func send, void* context);
+void relay_encoder_close(relay_encoder* encoder);
+
+// Encodes one captured frame and hands its packets to the send callback
+void relay_encode(relay_encoder* encoder, const r3e_shared* frame, uint64_t capture_us);
@@ -0,0 +1,386 @@
+#include "r3e.h"
+#include "layout.h"
+#include "net.h"
+#include "platform.h"
+#include "relay.h"
+#include "replica.h"
+#include "snapshot.h"
+#include "synth.h"
+#include "tickwait.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STATUS_SEC 5
+#define WAIT_MS 100
+
+shared_map map_view;
+layout_adapter map_layout;
+r3e_shared* map_buffer = NULL;
+snapshot_reader map_reader;
+tick_waiter map_waiter;
+r3e_shared frame;
+relay_encoder encoder;
+udp_socket sender;
+
+typedef struct
+{
+    udp_socket* sock;
+    uint16_t port;
+    uint64_t errors;
+} send_context;
+
+static void usage()
+{
+    wprintf_s(L"Usage: relayd [-group addr] [-port n] [-ttl n] [-keyframe n] [-budget kbit] [-synthetic] [-bench seconds] [-cars n]\n");
+    wprintf_s(L"       relayd -receive [-group addr] [-port n] [-publish] [-same-clock]\n");
+    wprintf_s(L"  -group      multicast group (default " NARROW_STR L")\n", RELAY_GROUP_DEFAULT);
+    wprintf_s(L"  -port       first port, channel n goes to port + n (default %d)\n", RELAY_PORT_DEFAULT);
+    wprintf_s(L"  -ttl        multicast hops, 1 = local network only (default 1)\n");
+    wprintf_s(L"  -keyframe   ticks between keyframes of a channel (default %d)\n", RELAY_KEYFRAME_INTERVAL_DEFAULT);
+    wprintf_s(L"  -budget     bandwidth budget in kbit/s, 0 = unlimited (default 0)\n");
+    wprintf_s(L"  -synthetic  attach to any $R3E mapping without waiting for RRRE.exe\n");
+    wprintf_s(L"  -bench      relay a synthetic race over loopback for this many seconds of ticks and report\n");
+    wprintf_s(L"  -cars       cars in the benchmark race, 1 - %d (default %d)\n", R3E_NUM_DRIVERS_MAX, R3E_NUM_DRIVERS_MAX);
+    wprintf_s(L"  -receive    receive a relay instead of sending one\n");
+    wprintf_s(L"  -publish    publish what is received as $R3E on this machine until Ctrl+C\n");
+    wprintf_s(L"  -same-clock the relay runs on this machine, report absolute latency\n");
+}
+
+static void send_packet(relay_channel channel, const void* packet, size_t size, void* context)
+{
+    send_context* send = (send_context*)context;
+
+    if (udp_send(send->sock, (uint16_t)(send->port + channel), packet, size))
+        send->errors++;
+}
+
+static void print_channels(const relay_encoder* enc, const relay_encoder* last, double seconds)
+{
+    static const wchar_t* names[RELAY_CHANNEL_COUNT] = { L"player", L"drivers", L"session" };
+    const relay_channel_state* state;
+    const relay_channel_state* before;
+    uint64_t total = 0, always = 0;
+    int c;
+
+    for (c = 0; c < RELAY_CHANNEL_COUNT; ++c)
+    {
+        state = &enc->channels[c];
+        before = &last->channels[c];
+        total += state->bytes - before->bytes;
+        if (c != RELAY_CHANNEL_DRIVERS)
+            always += state->bytes - before->bytes;
+
+        wprintf_s(L"  %-8ls %8.1f kbit/s %7.1f packets/s %6.1f frames/s, %llu keyframes, %llu deferred\n", names[c],
+            (state->bytes - before->bytes) * 8 / 1000.0 / seconds,
+            (state->packets - before->packets) / seconds,
+            (state->frames - before->frames) / seconds,
+            (unsigned long long)(state->keyframes - before->keyframes),
+            (unsigned long long)(state->deferred - before->deferred));
+    }
+
+    wprintf_s(L"  total    %8.1f kbit/s\n", total * 8 / 1000.0 / seconds);
+
+    if (enc->budget && always > enc->budget * seconds)
+        wprintf_s(L"  budget %.1f kbit/s is below the player and session channels, drivers only get keyframes\n",
+            enc->budget * 8 / 1000.0);
+}
+
+// Relays a synthetic race as fast as it can be encoded and sent, then reports
+// the tick rate it could sustain and the bandwidth per second of race time
+static int bench(send_context* send, int cars, uint32_t seconds)
+{
+    static synth_state race;
+    relay_encoder start;
+    uint32_t ticks = seconds * TICK_RATE_HZ, t;
+    uint64_t start_us, synth_us = 0, relay_us = 0, now_us;
+
+    synth_init(&race, cars, 1);
+    synth_write(&race, &frame);
+
+    memcpy(&start, &encoder, sizeof(start));
+    start_us = time_now_us();
+
+    for (t = 0; t < ticks; ++t)
+    {
+        now_us = time_now_us();
+
+        synth_step(&race);
+        synth_write_player(&race, &frame);
+        synth_write_drivers(&race, &frame, 0, race.num_cars);
+
+        synth_us += time_now_us() - now_us;
+        now_us = time_now_us();
+
+        relay_encode(&encoder, &frame, now_us);
+
+        relay_us += time_now_us() - now_us;
+    }
+
+    now_us = time_now_us();
+
+    wprintf_s(L"Relayed %u ticks of %d cars in %.3f s (%.3f s synthesizing)\n",
+        ticks, cars, (now_us - start_us) / 1e6, synth_us / 1e6);
+    wprintf_s(L"Relay: %.1f us per tick, sustains %.0f ticks/s (%ls %d Hz)\n",
+        (double)relay_us / ticks, relay_us ? ticks * 1e6 / relay_us : 0.0,
+        relay_us * TICK_RATE_HZ <= (uint64_t)ticks * 1000000 ? L"keeps up with" : L"falls behind",
+        TICK_RATE_HZ);
+    wprintf_s(L"Bandwidth per second of race time:\n");
+    print_channels(&encoder, &start, seconds);
+
+    if (send->errors)
+        wprintf_s(L"Send errors: %llu\n", (unsigned long long)send->errors);
+
+    return 0;
+}
+
+static int map_init()
+{
+    if (layout_map(&map_layout, &map_view, R3E_SHARED_MEMORY_NAME))
+        return 1;
+
+    map_buffer = (r3e_shared*)map_view.view;
+
+    snapshot_init(&map_reader, map_buffer, SNAPSHOT_RETRIES_DEFAULT);
+    tick_waiter_init(&map_waiter, map_buffer);
+
+    return 0;
+}
+
+static int relay_live(BOOL need_process)
+{
+    relay_encoder last;
+    uint64_t capture_us, status_us;
+    int err_code;
+
+    wprintf_s(L"Looking for RRRE.exe...\n");
+
+    // The game creates the shared memory before it writes the header, until
+    // then keep trying
+    for (;;)
+    {
+        while ((need_process && !is_r3e_running()) || !shared_map_exists(R3E_SHARED_MEMORY_NAME))
+            sleep_ms(WAIT_MS);
+
+        err_code = map_init();
+        if (!err_code || map_layout.match != LAYOUT_NOT_READY)
+            break;
+
+        sleep_ms(WAIT_MS);
+    }
+
+    if (err_code)
+    {
+        if (map_layout.match == LAYOUT_UNSUPPORTED && map_layout.version_major != 0)
+            wprintf_s(L"Unsupported shared memory version %d.%d\n", map_layout.version_major, map_layout.version_minor);
+        else
+            wprintf_s(L"Failed to map buffer\n");
+        return 1;
+    }
+
+    if (map_layout.match == LAYOUT_ADAPTED)
+        wprintf_s(L"Shared memory version %d.%d, remapping it to %d.%d\n",
+            map_layout.version_major, map_layout.version_minor, R3E_VERSION_MAJOR, R3E_VERSION_MINOR);
+
+    wprintf_s(L"Relaying\n");
+
+    memcpy(&last, &encoder, sizeof(last));
+    status_us = time_now_us() + STATUS_SEC * 1000000;
+
+    for (;;)
+    {
+        if (tick_wait(&map_waiter, WAIT_MS, NULL) == TICK_WAIT_OK)
+        {
+            capture_us = time_now_us();
+
+            if (layout_read(&map_layout, &map_reader, &frame) == 0)
+                relay_encode(&encoder, &frame, capture_us);
+        }
+
+        if (time_now_us() >= status_us)
+        {
+            wprintf_s(L"Tick %d, %llu missed, %u torn\n", frame.player.game_simulation_ticks,
+                (unsigned long long)map_waiter.ticks_missed, map_reader.torn_reads);
+            print_channels(&encoder, &last, STATUS_SEC);
+
+            memcpy(&last, &encoder, sizeof(last));
+            status_us += STATUS_SEC * 1000000;
+
+            if (need_process && !is_r3e_running())
+                break;
+        }
+    }
+
+    tick_waiter_close(&map_waiter);
+    shared_map_close(&map_view);
+
+    return 0;
+}
+
+// Set by Ctrl+C so receive closes the replica, and with it a published $R3E
+static volatile BOOL receive_stop = FALSE;
+
+// Rebuilds the relayed r3e_shared and reports how far behind the source it is, until Ctrl+C
+static int receive(const char* group, int port, BOOL publish, BOOL same_clock)
+{
+    static replica rep;
+    replica_channel last[RELAY_CHANNEL_COUNT];
+    const replica_channel* channel;
+    uint64_t status_us;
+    int c;
+
+    if (publish && shared_map_exists(R3E_SHARED_MEMORY_NAME))
+    {
+        wprintf_s(L"$R3E already exists, is the game or another producer running?\n");
+        return 1;
+    }
+
+    if (replica_open(&rep, group, (uint16_t)port, REPLICA_ALL_CHANNELS,
+        publish ? R3E_SHARED_MEMORY_NAME : NULL, same_clock))
+    {
+        wprintf_s(L"Failed to join " NARROW_STR L":%d-%d\n", group, port, port + RELAY_CHANNEL_COUNT - 1);
+        return 1;
+    }
+
+    if (stop_on_interrupt(&receive_stop))
+        wprintf_s(L"Can't catch Ctrl+C, $R3E won't be removed on exit\n");
+
+    wprintf_s(L"Receiving from " NARROW_STR L":%d-%d, Ctrl+C to stop\n", group, port, port + RELAY_CHANNEL_COUNT - 1);
+
+    memcpy(last, rep.channels, sizeof(last));
+    status_us = time_now_us() + STATUS_SEC * 1000000;
+
+    while (!receive_stop)
+    {
+        replica_poll(&rep, WAIT_MS);
+
+        if (time_now_us() < status_us)
+            continue;
+
+        wprintf_s(L"Tick %d, latency %.2f ms (mean %.2f, max %.2f), %llu stale\n", rep.ticks,
+            rep.latency_us / 1000.0, rep.latency_mean_us / 1000.0, rep.latency_max_us / 1000.0,
+            (unsigned long long)rep.stale_frames);
+
+        for (c = 0; c < RELAY_CHANNEL_COUNT; ++c)
+        {
+            channel = &rep.channels[c];
+
+            wprintf_s(L"  channel %d: %6.1f frames/s, %llu gaps, %llu resyncs, %llu dropped\n", c,
+                (double)(channel->frames - last[c].frames) / STATUS_SEC,
+                (unsigned long long)channel->gaps, (unsigned long long)channel->resyncs,
+                (unsigned long long)channel->dropped);
+        }
+
+        memcpy(last, rep.channels, sizeof(last));
+        status_us += STATUS_SEC * 1000000;
+    }
+
+    wprintf_s(L"Stopped at tick %d\n", rep.ticks);
+    replica_close(&rep);
+
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* group = RELAY_GROUP_DEFAULT;
+    send_context send;
+    int port = RELAY_PORT_DEFAULT;
+    int ttl = 1;
+    uint32_t keyframe = RELAY_KEYFRAME_INTERVAL_DEFAULT;
+    uint32_t budget_kbit = 0;
+    uint32_t bench_seconds = 0;
+    int cars = R3E_NUM_DRIVERS_MAX;
+    BOOL need_process = TRUE;
+    BOOL receiving = FALSE;
+    BOOL publish = FALSE;
+    BOOL same_clock = FALSE;
+    int err_code = 0;
+    int i;
+
+    for (i = 1; i < argc; ++i)
+    {
+        if (i + 1 < argc && strcmp(argv[i], "-group") == 0)
+            group = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "-port") == 0)
+            port = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "-ttl") == 0)
+            ttl = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "-keyframe") == 0)
+            keyframe = (uint32_t)atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "-budget") == 0)
+            budget_kbit = (uint32_t)atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "-bench") == 0)
+            bench_seconds = (uint32_t)atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "-cars") == 0)
+            cars = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-synthetic") == 0)
+            need_process = FALSE;
+        else if (strcmp(argv[i], "-receive") == 0)
+            receiving = TRUE;
+        else if (strcmp(argv[i], "-publish") == 0)
+            publish = TRUE;
+        else if (strcmp(argv[i], "-same-clock") == 0)
+            same_clock = TRUE;
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if (port <= 0 || port + RELAY_CHANNEL_COUNT > 65536 || ttl < 0 || ttl > 255 ||
+        cars < 1 || cars > R3E_NUM_DRIVERS_MAX)
+    {
+        usage();
+        return 1;
+    }
+
+    if (net_init())
+    {
+        wprintf_s(L"Failed to start networking\n");
+        return 1;
+    }
+
+    if (receiving)
+    {
+        err_code = receive(group, port, publish, same_clock);
+        net_cleanup();
+        return err_code;
+    }
+
+    // Loopback on, so receivers on the same machine (and the benchmark) see the packets
+    if (udp_open_sender(&sender, group, ttl, TRUE))
+    {
+        wprintf_s(L"Failed to open socket for " NARROW_STR L"\n", group);
+        net_cleanup();
+        return 1;
+    }
+
+    send.sock = &sender;
+    send.port = (uint16_t)port;
+    send.errors = 0;
+
+    if (relay_encoder_init(&encoder, keyframe, (uint64_t)budget_kbit * 1000 / 8, send_packet, &send))
+    {
+        wprintf_s(L"Failed to allocate encoder\n");
+        udp_close(&sender);
+        net_cleanup();
+        return 1;
+    }
+
+    wprintf_s(L"Sending to " NARROW_STR L":%d-%d\n", group, port, port + RELAY_CHANNEL_COUNT - 1);
+
+    if (bench_seconds > 0)
+        err_code = bench(&send, cars, bench_seconds);
+    else
+        err_code = relay_live(need_process);
+
+    relay_encoder_close(&encoder);
+    udp_close(&sender);
+    net_cleanup();
+
+    return err_code;
+}
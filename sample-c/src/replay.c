@@ -0,0 +1,221 @@
+#include "replay.h"
+#include "delta.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const uint8_t* file_at(const replay* rep, uint64_t offset)
+{
+    return (const uint8_t*)rep->file.view + offset;
+}
+
+// Reads the frame header at offset, returns 0 if a complete frame is there
+static int peek_frame(const replay* rep, uint64_t offset, recorder_frame_header* header)
+{
+    if (offset + sizeof(*header) > rep->file.size)
+        return 1;
+
+    memcpy(header, file_at(rep, offset), sizeof(*header));
+
+    return offset + sizeof(*header) + header->size > rep->file.size;
+}
+
+static int build_index(replay* rep)
+{
+    recorder_frame_header header;
+    uint64_t offset = sizeof(recorder_file_header);
+    uint32_t capacity = 0;
+    replay_keyframe* grown;
+
+    rep->num_frames = 0;
+    rep->num_keyframes = 0;
+
+    // A recording cut short by a crash just ends at the last complete frame
+    while (peek_frame(rep, offset, &header) == 0)
+    {
+        if (header.type == RECORDER_KEYFRAME)
+        {
+            if (header.size != rep->header.frame_size)
+                break;
+
+            if (rep->num_keyframes == capacity)
+            {
+                capacity = capacity ? capacity * 2 : 256;
+                grown = (replay_keyframe*)realloc(rep->keyframes, capacity * sizeof(replay_keyframe));
+                if (grown == NULL)
+                    return 1;
+                rep->keyframes = grown;
+            }
+
+            rep->keyframes[rep->num_keyframes].ticks = header.ticks;
+            rep->keyframes[rep->num_keyframes].frame_index = rep->num_frames;
+            rep->keyframes[rep->num_keyframes].offset = offset;
+            rep->num_keyframes++;
+        }
+        else if (header.type != RECORDER_DELTA || rep->num_keyframes == 0)
+        {
+            break;
+        }
+
+        rep->num_frames++;
+        offset += sizeof(header) + header.size;
+    }
+
+    return rep->num_keyframes == 0;
+}
+
+int replay_open(replay* rep, const char* path)
+{
+    size_t frame_size;
+
+    memset(rep, 0, sizeof(*rep));
+
+    if (mapped_file_open(&rep->file, path))
+        return 1;
+
+    if (rep->file.size < sizeof(rep->header))
+    {
+        replay_close(rep);
+        return 1;
+    }
+
+    memcpy(&rep->header, rep->file.view, sizeof(rep->header));
+
+    if (memcmp(rep->header.magic, RECORDER_MAGIC, sizeof(rep->header.magic)) != 0 ||
+        rep->header.format_version != RECORDER_FORMAT_VERSION ||
+        rep->header.version_major != R3E_VERSION_MAJOR ||
+        rep->header.frame_size == 0)
+    {
+        replay_close(rep);
+        return 1;
+    }
+
+    // Frames from a different minor version are exposed as-is, zero padded up to our r3e_shared
+    frame_size = rep->header.frame_size > sizeof(r3e_shared) ? rep->header.frame_size : sizeof(r3e_shared);
+    rep->frame = (r3e_shared*)calloc(1, frame_size);
+
+    if (rep->frame == NULL || build_index(rep))
+    {
+        replay_close(rep);
+        return 1;
+    }
+
+    return 0;
+}
+
+void replay_close(replay* rep)
+{
+    mapped_file_close(&rep->file);
+    free(rep->keyframes);
+    free(rep->frame);
+
+    memset(rep, 0, sizeof(*rep));
+}
+
+const r3e_shared* replay_frame(const replay* rep)
+{
+    return rep->has_frame ? rep->frame : NULL;
+}
+
+static int decode_at(replay* rep, uint64_t offset, uint32_t frame_index)
+{
+    recorder_frame_header header;
+    const uint8_t* payload;
+
+    if (peek_frame(rep, offset, &header))
+        return 1;
+
+    payload = file_at(rep, offset + sizeof(header));
+
+    if (header.type == RECORDER_KEYFRAME)
+    {
+        if (header.size != rep->header.frame_size)
+            return 1;
+        memcpy(rep->frame, payload, header.size);
+    }
+    else if (!rep->has_frame || delta_decode(payload, header.size, (uint8_t*)rep->frame, rep->header.frame_size))
+    {
+        rep->has_frame = FALSE;
+        return 1;
+    }
+
+    rep->has_frame = TRUE;
+    rep->frame_index = frame_index;
+    rep->next_offset = offset + sizeof(header) + header.size;
+
+    return 0;
+}
+
+int replay_next(replay* rep)
+{
+    if (!rep->has_frame)
+        return replay_seek_frame(rep, 0);
+
+    if (rep->frame_index + 1 >= rep->num_frames)
+        return 1;
+
+    return decode_at(rep, rep->next_offset, rep->frame_index + 1);
+}
+
+static int seek_from_keyframe(replay* rep, uint32_t key, uint32_t index, r3e_int32 ticks, BOOL by_ticks)
+{
+    recorder_frame_header header;
+
+    // Carry on from the current frame when it's between the keyframe and the target
+    if (!rep->has_frame || rep->frame_index < rep->keyframes[key].frame_index || rep->frame_index > index ||
+        (by_ticks && rep->frame->player.game_simulation_ticks > ticks))
+    {
+        if (decode_at(rep, rep->keyframes[key].offset, rep->keyframes[key].frame_index))
+            return 1;
+    }
+
+    while (rep->frame_index < index && rep->frame_index + 1 < rep->num_frames)
+    {
+        if (by_ticks && (peek_frame(rep, rep->next_offset, &header) || header.ticks > ticks))
+            break;
+
+        if (decode_at(rep, rep->next_offset, rep->frame_index + 1))
+            return 1;
+    }
+
+    return 0;
+}
+
+int replay_seek(replay* rep, r3e_int32 ticks)
+{
+    uint32_t low = 0, high = rep->num_keyframes, mid, index;
+
+    // Last keyframe with ticks <= target
+    while (high - low > 1)
+    {
+        mid = low + (high - low) / 2;
+        if (rep->keyframes[mid].ticks <= ticks)
+            low = mid;
+        else
+            high = mid;
+    }
+
+    // The frames up to the next keyframe are the only candidates
+    index = low + 1 < rep->num_keyframes ? rep->keyframes[low + 1].frame_index - 1 : rep->num_frames - 1;
+
+    return seek_from_keyframe(rep, low, index, ticks, TRUE);
+}
+
+int replay_seek_frame(replay* rep, uint32_t index)
+{
+    uint32_t low = 0, high = rep->num_keyframes, mid;
+
+    if (index >= rep->num_frames)
+        return 1;
+
+    while (high - low > 1)
+    {
+        mid = low + (high - low) / 2;
+        if (rep->keyframes[mid].frame_index <= index)
+            low = mid;
+        else
+            high = mid;
+    }
+
+    return seek_from_keyframe(rep, low, index, 0, FALSE);
+}
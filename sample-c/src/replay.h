@@ -0,0 +1,54 @@
+#pragma once
+
+#include "r3e.h"
+#include "platform.h"
+#include "recorder.h"
+
+typedef struct
+{
+    r3e_int32 ticks;
+    uint32_t frame_index;
+    uint64_t offset;
+} replay_keyframe;
+
+// Random access to a recording made by recorder.c.
+// The file is memory mapped and scanned once for keyframes (headers only, no
+// decoding), seeking binary searches that index and decodes forward from the
+// closest keyframe. The decoded frame is exposed as an r3e_shared, the same
+// view the live snapshot reader fills in.
+// Note: Tick seeks assume ticks only grow. After a tick reset (new session)
+// in the middle of a recording, use replay_seek_frame instead.
+typedef struct
+{
+    mapped_file file;
+    recorder_file_header header;
+
+    replay_keyframe* keyframes;
+    uint32_t num_keyframes;
+    uint32_t num_frames;
+
+    // Decoded frame, at least sizeof(r3e_shared) bytes
+    r3e_shared* frame;
+
+    // Index of the decoded frame, and file offset of the frame after it
+    uint32_t frame_index;
+    uint64_t next_offset;
+    BOOL has_frame;
+} replay;
+
+// Returns 0 on success, 1 if the file can't be mapped or isn't a compatible recording
+int replay_open(replay* rep, const char* path);
+void replay_close(replay* rep);
+
+// Current frame, NULL before the first seek/next
+const r3e_shared* replay_frame(const replay* rep);
+
+// Decodes the frame after the current one, returns 1 at the end of the recording
+int replay_next(replay* rep);
+
+// Positions on the last frame with game_simulation_ticks <= ticks
+// (or the first frame if ticks is before the recording), returns 0 on success
+int replay_seek(replay* rep, r3e_int32 ticks);
+
+// Positions on frame number index, returns 0 on success
+int replay_seek_frame(replay* rep, uint32_t index);
@@ -0,0 +1,299 @@
+#include "replica.h"
+#include "delta.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Stop draining sockets after this many packets so the caller gets control back
+#define POLL_PACKETS_MAX 256
+
+// Weight of a new sample in the mean latency
+#define LATENCY_EWMA 0.01
+
+// How fast the clock offset estimate follows the other machine's clock drifting away
+#define CLOCK_OFFSET_FOLLOW 4096
+
+int replica_open(replica* rep, const char* group, uint16_t port, uint32_t channels,
+    const char* shared_name, BOOL same_clock)
+{
+    replica_channel* channel;
+    int c;
+
+    memset(rep, 0, sizeof(*rep));
+    rep->same_clock = same_clock;
+
+    if (shared_name)
+    {
+        if (shared_map_create(&rep->map, shared_name, sizeof(r3e_shared)))
+            return 1;
+
+        rep->frame = (r3e_shared*)rep->map.view;
+        rep->shared = TRUE;
+        memset(rep->frame, 0, sizeof(r3e_shared));
+    }
+    else
+    {
+        rep->frame = (r3e_shared*)calloc(1, sizeof(r3e_shared));
+    }
+
+    rep->staging = (r3e_shared*)calloc(1, sizeof(r3e_shared));
+    rep->packet = (uint8_t*)malloc(RELAY_PACKET_MAX);
+
+    if (rep->frame == NULL || rep->staging == NULL || rep->packet == NULL)
+    {
+        replica_close(rep);
+        return 1;
+    }
+
+    for (c = 0; c < RELAY_CHANNEL_COUNT; ++c)
+    {
+        if (!(channels & REPLICA_CHANNEL(c)))
+            continue;
+
+        channel = &rep->channels[c];
+        channel->subscribed = TRUE;
+        channel->size = relay_channel_size((relay_channel)c);
+        channel->image = (uint8_t*)malloc(channel->size);
+        channel->assembly = (uint8_t*)malloc(DELTA_BOUND(channel->size));
+
+        if (channel->image == NULL || channel->assembly == NULL ||
+            udp_open_receiver(&rep->sockets[c], group, (uint16_t)(port + c)))
+        {
+            replica_close(rep);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+void replica_close(replica* rep)
+{
+    int c;
+
+    for (c = 0; c < RELAY_CHANNEL_COUNT; ++c)
+    {
+        udp_close(&rep->sockets[c]);
+        free(rep->channels[c].image);
+        free(rep->channels[c].assembly);
+    }
+
+    if (rep->shared)
+        shared_map_close(&rep->map);
+    else
+        free(rep->frame);
+
+    free(rep->staging);
+    free(rep->packet);
+
+    memset(rep, 0, sizeof(*rep));
+}
+
+const r3e_shared* replica_frame(const replica* rep)
+{
+    return rep->frame;
+}
+
+static void measure_latency(replica* rep, uint64_t capture_us)
+{
+    uint64_t now_us = time_now_us();
+    int64_t offset = (int64_t)(now_us - capture_us);
+    int64_t latency;
+
+    if (rep->same_clock)
+    {
+        latency = offset;
+    }
+    else
+    {
+        // The lowest offset seen is the one with the least delay, drift it up slowly
+        // so a clock running apart doesn't leave the estimate stuck in the past
+        if (!rep->has_clock_offset || offset < rep->clock_offset_us)
+            rep->clock_offset_us = offset;
+        else
+            rep->clock_offset_us += (offset - rep->clock_offset_us) / CLOCK_OFFSET_FOLLOW;
+
+        rep->has_clock_offset = TRUE;
+        latency = offset - rep->clock_offset_us;
+    }
+
+    if (latency < 0)
+        latency = 0;
+
+    rep->latency_us = (uint64_t)latency;
+    rep->latency_mean_us += (latency - rep->latency_mean_us) * LATENCY_EWMA;
+
+    if (rep->latency_us > rep->latency_max_us)
+        rep->latency_max_us = rep->latency_us;
+    if (rep->latency_us > REPLICA_STALE_US)
+        rep->stale_frames++;
+}
+
+// Copies the staging frame to the one readers see, the tick last so a tick
+// guarded read overlapping the copy retries. A tick that was already published
+// stays staged until the next one, publishing it twice would look like no write.
+static void publish(replica* rep)
+{
+    const size_t ticks_offset = offsetof(r3e_shared, player.game_simulation_ticks);
+    const size_t after_ticks = ticks_offset + sizeof(r3e_int32);
+
+    if (!rep->pending || (rep->has_published && rep->pending_ticks == rep->published_ticks))
+        return;
+
+    memcpy(rep->frame, rep->staging, ticks_offset);
+    memcpy((uint8_t*)rep->frame + after_ticks, (const uint8_t*)rep->staging + after_ticks, sizeof(r3e_shared) - after_ticks);
+    platform_barrier();
+    *(volatile r3e_int32*)&rep->frame->player.game_simulation_ticks = rep->pending_ticks;
+
+    rep->published_ticks = rep->pending_ticks;
+    rep->has_published = TRUE;
+    rep->pending = FALSE;
+}
+
+// Decodes a fully reassembled frame into the channel image, returns 0 if it was applied
+static int apply_frame(replica* rep, relay_channel c, const relay_packet_header* header)
+{
+    replica_channel* channel = &rep->channels[c];
+
+    if (header->type == RELAY_KEYFRAME)
+    {
+        memset(channel->image, 0, channel->size);
+        channel->keyframes++;
+    }
+    else if (!channel->has_image || header->base_sequence != channel->sequence)
+    {
+        // A frame in between went missing, this channel waits for the next keyframe
+        if (channel->has_image)
+        {
+            channel->gaps += header->sequence - channel->sequence - 1;
+            channel->resyncs++;
+        }
+
+        channel->has_image = FALSE;
+        return 1;
+    }
+
+    if (delta_decode(channel->assembly, header->frame_size, channel->image, channel->size))
+    {
+        channel->has_image = FALSE;
+        channel->dropped++;
+        return 1;
+    }
+
+    channel->sequence = header->sequence;
+    channel->has_image = TRUE;
+    channel->frames++;
+
+    // A frame of another tick, what's staged so far is all of the last one
+    if (rep->pending && header->ticks != rep->pending_ticks)
+        publish(rep);
+
+    relay_scatter(c, channel->image, rep->staging);
+    rep->pending_ticks = header->ticks;
+    rep->pending = TRUE;
+
+    if (c == RELAY_CHANNEL_PLAYER)
+        rep->ticks = header->ticks;
+
+    measure_latency(rep, header->capture_us);
+
+    return 0;
+}
+
+// Adds a packet to the frame it belongs to, returns 1 when that completed and applied a frame
+static int receive_packet(replica* rep, relay_channel c, const uint8_t* packet, int size)
+{
+    replica_channel* channel = &rep->channels[c];
+    relay_packet_header header;
+
+    channel->packets++;
+
+    if (size < (int)sizeof(header))
+    {
+        channel->dropped++;
+        return 0;
+    }
+
+    memcpy(&header, packet, sizeof(header));
+
+    if (memcmp(header.magic, RELAY_MAGIC, sizeof(header.magic)) != 0 ||
+        header.format_version != RELAY_FORMAT_VERSION ||
+        header.channel != (uint8_t)c ||
+        header.fragment_count == 0 || header.fragment_count > 64 ||
+        header.fragment >= header.fragment_count ||
+        (int)sizeof(header) + header.size != size ||
+        header.frame_size > DELTA_BOUND(channel->size) ||
+        header.size > header.frame_size - header.fragment_offset ||
+        header.fragment_offset > header.frame_size)
+    {
+        channel->dropped++;
+        return 0;
+    }
+
+    // Frames we already have, or older than the one being put together
+    if ((channel->has_image && (int32_t)(header.sequence - channel->sequence) <= 0) ||
+        (channel->assembling && (int32_t)(header.sequence - channel->assembly_sequence) < 0))
+    {
+        channel->dropped++;
+        return 0;
+    }
+
+    if (!channel->assembling || header.sequence != channel->assembly_sequence)
+    {
+        // A newer frame started before the last one was complete, so that one is lost
+        if (channel->assembling && channel->has_image)
+        {
+            channel->gaps++;
+            channel->resyncs++;
+            channel->has_image = FALSE;
+        }
+
+        channel->assembling = TRUE;
+        channel->assembly_sequence = header.sequence;
+        channel->assembly_mask = 0;
+        channel->assembly_count = header.fragment_count;
+    }
+
+    memcpy(channel->assembly + header.fragment_offset, packet + sizeof(header), header.size);
+    channel->assembly_mask |= (uint64_t)1 << header.fragment;
+
+    if (channel->assembly_mask != (channel->assembly_count == 64 ? ~(uint64_t)0 : ((uint64_t)1 << channel->assembly_count) - 1))
+        return 0;
+
+    channel->assembling = FALSE;
+
+    return apply_frame(rep, c, &header) == 0;
+}
+
+uint32_t replica_poll(replica* rep, uint32_t timeout_ms)
+{
+    uint32_t ready, applied = 0, packets = 0;
+    int c, size;
+
+    ready = udp_select(rep->sockets, RELAY_CHANNEL_COUNT, timeout_ms);
+
+    while (ready != 0 && packets < POLL_PACKETS_MAX)
+    {
+        for (c = 0; c < RELAY_CHANNEL_COUNT; ++c)
+        {
+            if (!(ready & REPLICA_CHANNEL(c)))
+                continue;
+
+            size = udp_receive(&rep->sockets[c], rep->packet, RELAY_PACKET_MAX, 1);
+            if (size <= 0)
+                continue;
+
+            packets++;
+            applied += receive_packet(rep, (relay_channel)c, rep->packet, size);
+        }
+
+        // Drain whatever else is already queued without waiting
+        ready = udp_select(rep->sockets, RELAY_CHANNEL_COUNT, 0);
+    }
+
+    // Nothing more queued, the tick's remaining channels may not be coming (e.g. deferred drivers)
+    publish(rep);
+
+    return applied;
+}
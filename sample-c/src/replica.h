@@ -0,0 +1,115 @@
+#pragma once
+
+#include "r3e.h"
+#include "net.h"
+#include "platform.h"
+#include "relay.h"
+
+// Frames older than this when applied count as stale (us)
+#define REPLICA_STALE_US 10000
+
+// Channel mask for replica_open
+#define REPLICA_CHANNEL(channel) (1u << (channel))
+#define REPLICA_ALL_CHANNELS ((1u << RELAY_CHANNEL_COUNT) - 1)
+
+typedef struct
+{
+    BOOL subscribed;
+
+    // Decoded channel image and the sequence number it is at
+    uint8_t* image;
+    uint32_t size;
+    uint32_t sequence;
+    BOOL has_image;
+
+    // Frame being reassembled from fragments, one bit per fragment received
+    uint8_t* assembly;
+    uint32_t assembly_sequence;
+    uint64_t assembly_mask;
+    uint8_t assembly_count;
+    BOOL assembling;
+
+    // Statistics
+    uint64_t packets;
+    uint64_t frames;
+    uint64_t keyframes;
+
+    // Frames that went missing, and the times the channel had to wait for a keyframe because of it
+    uint64_t gaps;
+    uint64_t resyncs;
+
+    // Packets that didn't belong to anything we could use (old, malformed, wrong version)
+    uint64_t dropped;
+} replica_channel;
+
+// Rebuilds r3e_shared from relayd packets.
+// Each subscribed channel is reassembled from its fragments and applied in
+// sequence order. A missing frame (sequence gap, or a frame whose fragments
+// never all arrived) stops the channel until the next keyframe, since every
+// delta builds on the frame before it. Channels that aren't subscribed stay
+// zero in the replica, but for player.game_simulation_ticks.
+//
+// The replica is either private memory or a named shared memory block, so a
+// reader written for the game's $R3E mapping can attach to it unmodified.
+// Frames are decoded into a private staging copy. Once a tick's frames are in
+// (a frame of another tick arrives, or nothing more is queued) the staging
+// copy is published in one go with player.game_simulation_ticks written last,
+// and every publication carries a tick the last one didn't: frames of a tick
+// already published wait for the next one. A tick guarded read (snapshot.h)
+// overlapping a publication sees the tick move and retries, as on $R3E.
+//
+// Latency is the time from the relay capturing a tick to the replica applying
+// it. The relay's clock only means something here when both run on the same
+// machine (same_clock), otherwise the fastest frame seen is taken as zero
+// latency and the rest are measured against it, which shows queueing and
+// jitter but not the constant part of the network delay.
+typedef struct
+{
+    udp_socket sockets[RELAY_CHANNEL_COUNT];
+    replica_channel channels[RELAY_CHANNEL_COUNT];
+
+    // What readers see, and where frames are decoded until it is published
+    r3e_shared* frame;
+    r3e_shared* staging;
+    shared_map map;
+    BOOL shared;
+
+    // Tick of the frames staged since the last publication, and of that publication
+    BOOL pending;
+    r3e_int32 pending_ticks;
+    r3e_int32 published_ticks;
+    BOOL has_published;
+
+    uint8_t* packet;
+
+    BOOL same_clock;
+
+    // Estimated receiver clock minus relay clock, for frames with no queueing delay
+    int64_t clock_offset_us;
+    BOOL has_clock_offset;
+
+    // Latency of the last frame applied, mean over all of them (EWMA) and worst case (us)
+    uint64_t latency_us;
+    double latency_mean_us;
+    uint64_t latency_max_us;
+
+    // Frames applied later than REPLICA_STALE_US
+    uint64_t stale_frames;
+
+    // player.game_simulation_ticks of the last player frame applied
+    r3e_int32 ticks;
+} replica;
+
+// Joins group on port + channel for every channel in mask. shared_name names a
+// shared memory block to publish into (e.g. R3E_SHARED_MEMORY_NAME), NULL keeps
+// the replica private. Returns 0 on success
+int replica_open(replica* rep, const char* group, uint16_t port, uint32_t channels,
+    const char* shared_name, BOOL same_clock);
+void replica_close(replica* rep);
+
+// Receives and applies whatever arrives within timeout_ms
+// Returns the number of frames applied, across all channels
+uint32_t replica_poll(replica* rep, uint32_t timeout_ms);
+
+// The replica, valid until replica_close
+const r3e_shared* replica_frame(const replica* rep);
@@ -0,0 +1,375 @@
+#define _USE_MATH_DEFINES
+
+#include "resample.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if PLATFORM_AVX2
+#include <immintrin.h>
+#elif PLATFORM_SSE2
+#include <emmintrin.h>
+#endif
+
+typedef struct
+{
+    resampler* sampler;
+    BOOL hold;
+} add_context;
+
+void resample_init(resampler* sampler, uint32_t input_hz)
+{
+    memset(sampler, 0, sizeof(*sampler));
+    sampler->input_hz = input_hz;
+}
+
+void resample_close(resampler* sampler)
+{
+    int i;
+
+    for (i = 0; i < sampler->num_outputs; ++i)
+    {
+        aligned_free(sampler->outputs[i].taps);
+        aligned_free(sampler->outputs[i].weights);
+        free(sampler->outputs[i].frame);
+    }
+
+    aligned_free(sampler->history);
+    memset(sampler, 0, sizeof(*sampler));
+}
+
+static int add_field(const field_desc* field, uint32_t offset, void* context)
+{
+    resampler* sampler = ((add_context*)context)->sampler;
+    uint32_t size = field_type_size(field->type);
+    uint32_t i;
+
+    if (((add_context*)context)->hold || (field->type != FIELD_FLOAT32 && field->type != FIELD_FLOAT64))
+    {
+        if (sampler->num_holds == RESAMPLE_HOLDS_MAX)
+            return 1;
+
+        sampler->holds[sampler->num_holds].offset = offset;
+        sampler->holds[sampler->num_holds].size = field->count * size;
+        sampler->num_holds++;
+
+        return 0;
+    }
+
+    if (sampler->num_channels + field->count > RESAMPLE_CHANNELS_MAX)
+        return 1;
+
+    for (i = 0; i < field->count; ++i)
+    {
+        sampler->channels[sampler->num_channels].offset = offset + i * size;
+        sampler->channels[sampler->num_channels].type = field->type;
+        sampler->num_channels++;
+    }
+
+    return 0;
+}
+
+int resample_add_field(resampler* sampler, const char* name, BOOL hold)
+{
+    add_context context;
+
+    if (sampler->history)
+        return 1;
+
+    context.sampler = sampler;
+    context.hold = hold;
+
+    return fields_match(name, add_field, &context);
+}
+
+int resample_add_output(resampler* sampler, uint32_t rate_hz)
+{
+    if (sampler->history || sampler->num_outputs == RESAMPLE_OUTPUTS_MAX || rate_hz == 0 || rate_hz > sampler->input_hz)
+        return -1;
+
+    sampler->outputs[sampler->num_outputs].rate_hz = rate_hz;
+
+    return sampler->num_outputs++;
+}
+
+// Hamming windowed sinc with unity gain at DC, cutoff in cycles per input tick
+static void design_filter(double* taps, uint32_t num_taps, double cutoff)
+{
+    double middle = (num_taps - 1) / 2.0;
+    double sum = 0.0, x;
+    uint32_t i;
+
+    for (i = 0; i < num_taps; ++i)
+    {
+        x = i - middle;
+        taps[i] = x == 0.0 ? 2.0 * cutoff : sin(2.0 * M_PI * cutoff * x) / (M_PI * x);
+        taps[i] *= 0.54 - 0.46 * cos(2.0 * M_PI * i / (num_taps - 1));
+        sum += taps[i];
+    }
+
+    for (i = 0; i < num_taps; ++i)
+        taps[i] /= sum;
+}
+
+static int start_output(resampler* sampler, resample_output* output)
+{
+    double ratio = (double)output->rate_hz / sampler->input_hz;
+    double taps = ceil(RESAMPLE_TAPS_PER_RATIO / ratio);
+    double cutoff;
+
+    output->num_taps = 1;
+    if (output->rate_hz < sampler->input_hz)
+        output->num_taps = taps < RESAMPLE_TAPS_MAX ? (uint32_t)taps | 1 : RESAMPLE_TAPS_MAX;
+
+    output->taps = (double*)aligned_malloc(output->num_taps * sizeof(double), 32);
+    output->weights = (double*)aligned_malloc((output->num_taps + 1) * sizeof(double), 32);
+    output->frame = (r3e_shared*)calloc(1, sizeof(r3e_shared));
+    if (output->taps == NULL || output->weights == NULL || output->frame == NULL)
+        return 1;
+
+    if (output->num_taps == 1)
+        output->taps[0] = 1.0;
+    else
+    {
+        // Middle of the transition band, which is 3.3 / num_taps wide for a Hamming window
+        cutoff = 0.5 * ratio - 1.65 / output->num_taps;
+        design_filter(output->taps, output->num_taps, cutoff > 0.25 * ratio ? cutoff : 0.25 * ratio);
+    }
+
+    output->delay = (output->num_taps - 1) / 2.0 / sampler->input_hz;
+
+    // Due on the first tick
+    output->phase = sampler->input_hz - output->rate_hz;
+
+    return 0;
+}
+
+int resample_start(resampler* sampler)
+{
+    uint32_t longest = 1;
+    int i;
+
+    if (sampler->history || sampler->num_outputs == 0)
+        return 1;
+
+    for (i = 0; i < sampler->num_outputs; ++i)
+    {
+        if (start_output(sampler, &sampler->outputs[i]))
+            return 1;
+
+        if (sampler->outputs[i].num_taps > longest)
+            longest = sampler->outputs[i].num_taps;
+    }
+
+    // Room for num_taps + 1 ticks, keeps every row 32 byte aligned too
+    sampler->history_size = 4;
+    while (sampler->history_size < longest + 1)
+        sampler->history_size <<= 1;
+
+    sampler->history = (double*)aligned_malloc(
+        (sampler->num_channels > 0 ? sampler->num_channels : 1) * 2 * sampler->history_size * sizeof(double), 32);
+
+    return sampler->history == NULL;
+}
+
+static double read_channel(const resample_channel* channel, const r3e_shared* frame)
+{
+    const char* value = (const char*)frame + channel->offset;
+
+    return channel->type == FIELD_FLOAT64 ? *(const r3e_float64*)value : *(const r3e_float32*)value;
+}
+
+static void write_channel(const resample_channel* channel, r3e_shared* frame, double value)
+{
+    char* dest = (char*)frame + channel->offset;
+
+    if (channel->type == FIELD_FLOAT64)
+        *(r3e_float64*)dest = value;
+    else
+        *(r3e_float32*)dest = (r3e_float32)value;
+}
+
+// Sum of weights[i] * values[i], weights is 32 byte aligned
+#if PLATFORM_AVX2
+
+static double dot(const double* weights, const double* values, uint32_t count)
+{
+    __m256d sum0 = _mm256_setzero_pd(), sum1 = _mm256_setzero_pd();
+    __m128d half;
+    double sum;
+    uint32_t i = 0;
+
+    // Two accumulators to keep the adds from waiting on each other
+    for (; i + 8 <= count; i += 8)
+    {
+        sum0 = _mm256_add_pd(sum0, _mm256_mul_pd(_mm256_load_pd(weights + i), _mm256_loadu_pd(values + i)));
+        sum1 = _mm256_add_pd(sum1, _mm256_mul_pd(_mm256_load_pd(weights + i + 4), _mm256_loadu_pd(values + i + 4)));
+    }
+    for (; i + 4 <= count; i += 4)
+        sum0 = _mm256_add_pd(sum0, _mm256_mul_pd(_mm256_load_pd(weights + i), _mm256_loadu_pd(values + i)));
+
+    sum0 = _mm256_add_pd(sum0, sum1);
+    half = _mm_add_pd(_mm256_castpd256_pd128(sum0), _mm256_extractf128_pd(sum0, 1));
+    sum = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+
+    for (; i < count; ++i)
+        sum += weights[i] * values[i];
+
+    return sum;
+}
+
+#elif PLATFORM_SSE2
+
+static double dot(const double* weights, const double* values, uint32_t count)
+{
+    __m128d sum0 = _mm_setzero_pd(), sum1 = _mm_setzero_pd();
+    double sum;
+    uint32_t i = 0;
+
+    // Two accumulators to keep the adds from waiting on each other
+    for (; i + 4 <= count; i += 4)
+    {
+        sum0 = _mm_add_pd(sum0, _mm_mul_pd(_mm_load_pd(weights + i), _mm_loadu_pd(values + i)));
+        sum1 = _mm_add_pd(sum1, _mm_mul_pd(_mm_load_pd(weights + i + 2), _mm_loadu_pd(values + i + 2)));
+    }
+
+    sum0 = _mm_add_pd(sum0, sum1);
+    sum = _mm_cvtsd_f64(_mm_add_sd(sum0, _mm_unpackhi_pd(sum0, sum0)));
+
+    for (; i < count; ++i)
+        sum += weights[i] * values[i];
+
+    return sum;
+}
+
+#else
+
+static double dot(const double* weights, const double* values, uint32_t count)
+{
+    double sum = 0.0;
+    uint32_t i;
+
+    for (i = 0; i < count; ++i)
+        sum += weights[i] * values[i];
+
+    return sum;
+}
+
+#endif
+
+// Writes one sample of output, fraction is where it falls between the previous tick (0) and the latest (1)
+static void emit(resampler* sampler, resample_output* output, const r3e_shared* frame, double fraction)
+{
+    uint32_t n = output->num_taps, row_size = 2 * sampler->history_size, i;
+    const double* window;
+    int c;
+
+    // The filter evaluated at both ticks and interpolated is the same as one
+    // pass with interpolated taps, in the order the history is in (oldest
+    // first). taps is symmetric, so no reversing is needed.
+    output->weights[0] = (1.0 - fraction) * output->taps[0];
+    for (i = 1; i < n; ++i)
+        output->weights[i] = fraction * output->taps[i - 1] + (1.0 - fraction) * output->taps[i];
+    output->weights[n] = fraction * output->taps[n - 1];
+
+    for (c = 0; c < sampler->num_channels; ++c)
+    {
+        window = sampler->history + c * row_size + sampler->position + sampler->history_size - n;
+        write_channel(&sampler->channels[c], output->frame, dot(output->weights, window, n + 1));
+    }
+
+    for (c = 0; c < sampler->num_holds; ++c)
+    {
+        memcpy((char*)output->frame + sampler->holds[c].offset,
+            (const char*)frame + sampler->holds[c].offset, sampler->holds[c].size);
+    }
+
+    output->samples++;
+}
+
+// Fills every row with the frame's values, as if it had been there forever
+static void prime(resampler* sampler, const r3e_shared* frame)
+{
+    uint32_t row_size = 2 * sampler->history_size, i;
+    double* row;
+    double value;
+    int c;
+
+    for (c = 0; c < sampler->num_channels; ++c)
+    {
+        row = sampler->history + c * row_size;
+        value = read_channel(&sampler->channels[c], frame);
+
+        for (i = 0; i < row_size; ++i)
+            row[i] = value;
+    }
+}
+
+uint32_t resample_push(resampler* sampler, const r3e_shared* frame)
+{
+    r3e_int32 tick = frame->player.game_simulation_ticks;
+    uint32_t mask = 0, steps = 1, step, position;
+    resample_output* output;
+    double* row;
+    double last, value;
+    int c, o;
+
+    if (sampler->history == NULL)
+        return 0;
+
+    if (sampler->started && tick == sampler->last_tick)
+        return 0;
+
+    if (!sampler->started || tick < sampler->last_tick || (uint32_t)(tick - sampler->last_tick) > sampler->input_hz)
+        prime(sampler, frame);
+    else
+        steps = (uint32_t)(tick - sampler->last_tick);
+
+    sampler->started = TRUE;
+    sampler->last_tick = tick;
+
+    for (step = 1; step <= steps; ++step)
+    {
+        position = (sampler->position + 1) & (sampler->history_size - 1);
+
+        // Skipped ticks are filled in along a straight line to this one. last is
+        // the step before, already on the line, so the rest of the way to the
+        // new value is split evenly over the steps left.
+        for (c = 0; c < sampler->num_channels; ++c)
+        {
+            row = sampler->history + c * 2 * sampler->history_size;
+            last = row[sampler->position];
+            value = read_channel(&sampler->channels[c], frame);
+            value = last + (value - last) / (steps - step + 1);
+
+            row[position] = value;
+            row[position + sampler->history_size] = value;
+        }
+
+        sampler->position = position;
+        sampler->ticks++;
+
+        for (o = 0; o < sampler->num_outputs; ++o)
+        {
+            output = &sampler->outputs[o];
+
+            if (output->phase + output->rate_hz < sampler->input_hz)
+            {
+                output->phase += output->rate_hz;
+                continue;
+            }
+
+            emit(sampler, output, frame, (double)(sampler->input_hz - output->phase) / output->rate_hz);
+            output->phase = output->phase + output->rate_hz - sampler->input_hz;
+            mask |= 1u << o;
+        }
+    }
+
+    return mask;
+}
+
+const r3e_shared* resample_frame(const resampler* sampler, int output)
+{
+    return sampler->outputs[output].frame;
+}
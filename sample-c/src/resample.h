@@ -0,0 +1,107 @@
+#pragma once
+
+#include "r3e.h"
+#include "fields.h"
+#include "platform.h"
+#include "snapshot.h"
+
+#define RESAMPLE_CHANNELS_MAX 64
+#define RESAMPLE_HOLDS_MAX 64
+#define RESAMPLE_OUTPUTS_MAX 8
+
+// Filters are Hamming windowed sincs with this many taps per input ticks per
+// output sample, which puts the transition band between 0.3 and 0.5 of the
+// output rate with ~53 dB of stop band attenuation
+#define RESAMPLE_TAPS_PER_RATIO 16.5
+
+// Longest filter, ~10 s at 400 Hz. Output rates low enough to want more get a
+// wider transition band instead, their stop band still starts at half the rate
+#define RESAMPLE_TAPS_MAX 4095
+
+// A float channel filtered for every output, one element of a field
+typedef struct
+{
+    uint32_t offset;
+    field_type type;
+} resample_channel;
+
+typedef struct
+{
+    uint32_t rate_hz;
+
+    // Low-pass filter, symmetric, num_taps of them (1 when the input passes through)
+    double* taps;
+    uint32_t num_taps;
+
+    // taps shifted to where the output falls between two input ticks, num_taps + 1
+    double* weights;
+
+    // Filtered channels lag the held fields by (num_taps - 1) / 2 input ticks (s)
+    double delay;
+
+    // Counts rate_hz per input tick, an output is due each time it reaches input_hz
+    uint32_t phase;
+
+    // Latest output, only the fields that were added are written
+    r3e_shared* frame;
+    uint64_t samples;
+} resample_output;
+
+// Turns the tick stream of one capture thread into several lower rate streams
+// at once, e.g. 400 Hz physics, 60 Hz for a display and 1 Hz for a log.
+// Float fields are low-pass filtered before they are decimated, so vibrations
+// above an output's Nyquist rate don't alias into it. Int and string fields
+// (gear, flags, names, ...) and float fields added with hold are sampled as
+// they are at the output instant instead.
+//
+// The input history is kept per channel (SoA), so each filtered value is one
+// contiguous dot product, 4 (AVX2) or 2 (SSE2) taps at a time. The filters only
+// run when an output is due, so a tick costs a store per channel plus the
+// outputs that fall on it. Ticks are counted with player.game_simulation_ticks:
+// up to a second of skipped ticks is interpolated, longer gaps and ticks going
+// backwards (a replay seek, a new session) restart the filters.
+typedef struct
+{
+    uint32_t input_hz;
+
+    resample_channel channels[RESAMPLE_CHANNELS_MAX];
+    int num_channels;
+
+    snapshot_range holds[RESAMPLE_HOLDS_MAX];
+    int num_holds;
+
+    resample_output outputs[RESAMPLE_OUTPUTS_MAX];
+    int num_outputs;
+
+    // One row per channel, a ring of history_size ticks stored twice over so
+    // the latest num_taps + 1 of them are always contiguous. position is where
+    // the latest tick is in the first copy.
+    double* history;
+    uint32_t history_size;
+    uint32_t position;
+
+    BOOL started;
+    r3e_int32 last_tick;
+    uint64_t ticks;
+} resampler;
+
+// input_hz is the game's tick rate, TICK_RATE_HZ
+void resample_init(resampler* sampler, uint32_t input_hz);
+void resample_close(resampler* sampler);
+
+// Adds a field by name, as for fields_match. Float fields are filtered unless
+// hold is set, everything else is held. Returns 0 on success, 1 if nothing
+// matched or there's no room left
+int resample_add_field(resampler* sampler, const char* name, BOOL hold);
+
+// Adds an output at rate_hz, at most input_hz. Returns its index, -1 if there's no room left
+int resample_add_output(resampler* sampler, uint32_t rate_hz);
+
+// Designs the filters and allocates the buffers once everything is added, returns 0 on success
+int resample_start(resampler* sampler);
+
+// Feeds one tick, returns a bit per output that got a new sample (bit i for output i)
+uint32_t resample_push(resampler* sampler, const r3e_shared* frame);
+
+// The latest sample of an output
+const r3e_shared* resample_frame(const resampler* sampler, int output);
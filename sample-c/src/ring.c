@@ -0,0 +1,228 @@
+#include "ring.h"
+
+#include <string.h>
+
+// How long the capture thread waits for a tick before checking for stop
+#define CAPTURE_WAIT_MS 100
+
+static uint32_t load_sequence(const volatile uint32_t* sequence)
+{
+    return *sequence;
+}
+
+static uint8_t* slot_at(const ring* r, uint32_t sequence)
+{
+    return r->slots + (size_t)(sequence & r->mask) * r->slot_size;
+}
+
+static volatile uint32_t* slot_sequence(uint8_t* slot)
+{
+    return (volatile uint32_t*)slot;
+}
+
+// The frame starts on the cache line after the sequence number
+static r3e_shared* slot_frame(uint8_t* slot)
+{
+    return (r3e_shared*)(slot + CACHE_LINE_SIZE);
+}
+
+int ring_init(ring* r, uint32_t capacity)
+{
+    uint32_t rounded = 1;
+
+    memset(r, 0, sizeof(*r));
+
+    if (capacity == 0)
+        capacity = RING_CAPACITY_DEFAULT;
+
+    while (rounded < capacity)
+        rounded <<= 1;
+
+    r->capacity = rounded;
+    r->mask = rounded - 1;
+    r->slot_size = (CACHE_LINE_SIZE + sizeof(r3e_shared) + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1);
+    r->slots = (uint8_t*)aligned_malloc(r->slot_size * r->capacity, CACHE_LINE_SIZE);
+
+    if (r->slots == NULL)
+        return 1;
+
+    // Touch every page now so the first laps don't page fault on the capture thread
+    memset(r->slots, 0, r->slot_size * r->capacity);
+
+    return 0;
+}
+
+void ring_close(ring* r)
+{
+    aligned_free(r->slots);
+    r->slots = NULL;
+}
+
+r3e_shared* ring_begin_write(ring* r)
+{
+    uint8_t* slot = slot_at(r, r->written + 1);
+
+    *slot_sequence(slot) = 0;
+    platform_barrier();
+
+    return slot_frame(slot);
+}
+
+void ring_end_write(ring* r)
+{
+    uint32_t sequence = r->written + 1;
+
+    platform_barrier();
+    *slot_sequence(slot_at(r, sequence)) = sequence;
+    platform_barrier();
+    r->written = sequence;
+}
+
+void ring_cancel_write(ring* r)
+{
+    // The slot stays marked as being written, readers treat it as overwritten
+    (void)r;
+}
+
+void ring_write(ring* r, const r3e_shared* frame)
+{
+    memcpy(ring_begin_write(r), frame, sizeof(r3e_shared));
+    ring_end_write(r);
+}
+
+void ring_cursor_init(ring_cursor* cursor, const ring* r)
+{
+    memset(cursor, 0, sizeof(*cursor));
+    cursor->source = r;
+    cursor->next = load_sequence(&r->written) + 1;
+}
+
+void ring_cursor_instrument(ring_cursor* cursor, metrics_shard* shard, int overruns, int frames_lost)
+{
+    cursor->metrics = shard;
+    cursor->overruns_metric = overruns;
+    cursor->frames_lost_metric = frames_lost;
+}
+
+// Copies frame number sequence, returns 0 if the slot still held it after the copy
+static int copy_frame(const ring* r, uint32_t sequence, r3e_shared* dest)
+{
+    uint8_t* slot = slot_at(r, sequence);
+
+    if (load_sequence(slot_sequence(slot)) != sequence)
+        return 1;
+
+    platform_barrier();
+    memcpy(dest, slot_frame(slot), sizeof(r3e_shared));
+    platform_barrier();
+
+    return load_sequence(slot_sequence(slot)) != sequence;
+}
+
+ring_read_result ring_read(ring_cursor* cursor, r3e_shared* dest)
+{
+    const ring* r = cursor->source;
+    uint32_t written, oldest;
+
+    for (;;)
+    {
+        written = load_sequence(&r->written);
+
+        // Wrap safe "next > written"
+        if ((int32_t)(written - cursor->next) < 0)
+            return RING_READ_EMPTY;
+
+        if (copy_frame(r, cursor->next, dest) == 0)
+        {
+            cursor->next++;
+            cursor->reads++;
+            return RING_READ_OK;
+        }
+
+        // Lapped, skip to the oldest frame that can't be overwritten before we get to it.
+        // The slot after the newest one may be in the middle of a write.
+        oldest = written - r->capacity + 2;
+        if ((int32_t)(oldest - cursor->next) <= 0)
+            oldest = cursor->next + 1;
+
+        cursor->overruns++;
+        cursor->frames_lost += oldest - cursor->next;
+        METRICS_ADD(cursor->metrics, cursor->overruns_metric, 1);
+        METRICS_ADD(cursor->metrics, cursor->frames_lost_metric, oldest - cursor->next);
+        cursor->next = oldest;
+    }
+}
+
+ring_read_result ring_read_latest(ring_cursor* cursor, r3e_shared* dest)
+{
+    const ring* r = cursor->source;
+    uint32_t written;
+
+    for (;;)
+    {
+        written = load_sequence(&r->written);
+
+        if ((int32_t)(written - cursor->next) < 0)
+            return RING_READ_EMPTY;
+
+        // Skipping on purpose doesn't count as lost
+        cursor->next = written;
+
+        if (copy_frame(r, written, dest) == 0)
+        {
+            cursor->next++;
+            cursor->reads++;
+            return RING_READ_OK;
+        }
+    }
+}
+
+static void capture_main(void* arg)
+{
+    ring_capture* capture = (ring_capture*)arg;
+    r3e_shared* frame;
+
+    while (!capture->stop)
+    {
+        if (tick_wait(&capture->waiter, CAPTURE_WAIT_MS, NULL) != TICK_WAIT_OK)
+            continue;
+
+        frame = ring_begin_write(capture->target);
+
+        if (snapshot_read(&capture->reader, frame))
+        {
+            ring_cancel_write(capture->target);
+            capture->torn++;
+            continue;
+        }
+
+        ring_end_write(capture->target);
+        capture->frames++;
+    }
+}
+
+int ring_capture_start(ring_capture* capture, ring* target, const r3e_shared* source)
+{
+    memset(capture, 0, sizeof(*capture));
+    capture->target = target;
+
+    snapshot_init(&capture->reader, source, SNAPSHOT_RETRIES_DEFAULT);
+    tick_waiter_init(&capture->waiter, source);
+
+    if (thread_start(&capture->thread, capture_main, capture))
+    {
+        tick_waiter_close(&capture->waiter);
+        return 1;
+    }
+
+    return 0;
+}
+
+void ring_capture_stop(ring_capture* capture)
+{
+    capture->stop = TRUE;
+    thread_join(&capture->thread);
+
+    if (capture->waiter.source)
+        tick_waiter_close(&capture->waiter);
+}
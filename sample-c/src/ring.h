@@ -0,0 +1,111 @@
+#pragma once
+
+#include "r3e.h"
+#include "metrics.h"
+#include "platform.h"
+#include "snapshot.h"
+#include "tickwait.h"
+
+// Slots in a ring made with capacity 0, about 40 ms of ticks
+#define RING_CAPACITY_DEFAULT 16
+
+typedef enum
+{
+    RING_READ_OK = 0,
+
+    // Nothing newer than the last frame read
+    RING_READ_EMPTY = 1,
+} ring_read_result;
+
+// Single producer, multi consumer ring of r3e_shared frames.
+// One capture thread writes validated frames into preallocated slots, any
+// number of consumers read them through their own cursor without locks and
+// without slowing the writer down. Every slot carries the sequence number of
+// the frame in it (0 while it is being written), readers check it before and
+// after copying, so a reader that fell a whole ring behind notices it got
+// lapped and skips ahead instead of reading a half overwritten frame.
+// Slots start on a cache line and the write position sits on a line of its
+// own, so readers polling it don't share a line with frame data.
+// Note: Sequence numbers are 32 bits, they wrap after about 120 days at 400 Hz.
+typedef struct
+{
+    char pad_before[CACHE_LINE_SIZE];
+
+    // Sequence number of the last published frame, 0 before the first one
+    volatile uint32_t written;
+
+    char pad_after[CACHE_LINE_SIZE];
+
+    uint8_t* slots;
+    size_t slot_size;
+    uint32_t capacity;
+    uint32_t mask;
+} ring;
+
+// Read position of one consumer, owned by the consumer's thread
+typedef struct
+{
+    const ring* source;
+
+    // Sequence number of the next frame to read
+    uint32_t next;
+
+    // Number of frames read
+    uint64_t reads;
+
+    // Number of times the writer lapped this reader, and frames skipped because of it
+    uint32_t overruns;
+    uint64_t frames_lost;
+
+    // Where overruns are also counted, see ring_cursor_instrument
+    metrics_shard* metrics;
+    int overruns_metric;
+    int frames_lost_metric;
+} ring_cursor;
+
+// capacity is rounded up to a power of two, returns 0 on success
+int ring_init(ring* r, uint32_t capacity);
+void ring_close(ring* r);
+
+// Producer side. ring_begin_write hands out the slot for the next frame so a
+// snapshot can be copied straight into it, ring_end_write publishes it and
+// ring_cancel_write drops it (the slot's old frame is gone either way).
+r3e_shared* ring_begin_write(ring* r);
+void ring_end_write(ring* r);
+void ring_cancel_write(ring* r);
+
+// Copies frame into the next slot and publishes it
+void ring_write(ring* r, const r3e_shared* frame);
+
+// Starts a cursor at the next frame written after this call
+void ring_cursor_init(ring_cursor* cursor, const ring* r);
+
+// Also counts the cursor's overruns and frames lost in the consumer thread's metrics shard
+// (shard can be NULL). Only the overrun path pays for it
+void ring_cursor_instrument(ring_cursor* cursor, metrics_shard* shard, int overruns, int frames_lost);
+
+// Copies the next unread frame into dest, oldest first
+ring_read_result ring_read(ring_cursor* cursor, r3e_shared* dest);
+
+// Copies the newest frame into dest and skips everything before it,
+// for consumers that only care about the current state
+ring_read_result ring_read_latest(ring_cursor* cursor, r3e_shared* dest);
+
+// Capture thread feeding a ring from the live mapping: waits for each tick,
+// snapshots it straight into the next slot and publishes it if it wasn't torn
+typedef struct
+{
+    ring* target;
+    snapshot_reader reader;
+    tick_waiter waiter;
+    platform_thread thread;
+    volatile BOOL stop;
+
+    // Frames published and snapshots thrown away as torn
+    uint64_t frames;
+    uint64_t torn;
+} ring_capture;
+
+// Returns 0 on success
+int ring_capture_start(ring_capture* capture, ring* target, const r3e_shared* source);
+void ring_capture_stop(ring_capture* capture);
@@ -1,126 +1,578 @@
 #include "r3e.h"
+#include "diff.h"
+#include "fields.h"
+#include "gaps.h"
+#include "layout.h"
+#include "metrics.h"
+#include "racelog.h"
+#include "recorder.h"
+#include "replay.h"
+#include "snapshot.h"
+#include "subscription.h"
+#include "tickwait.h"
+#include "strategy.h"
+#include "thermal.h"
+#include "trackmap.h"
 #include "utils.h"
 
 #define _USE_MATH_DEFINES
 
 #include <math.h>
 #include <stdio.h>
-#include <time.h>
-#include <Windows.h>
-#include <tchar.h>
+#include <stdlib.h>
+#include <string.h>
 
 #define ALIVE_SEC 600
 #define INTERVAL_MS 100
+#define INTERVAL_TICKS (INTERVAL_MS * TICK_RATE_HZ / 1000)
 
-HANDLE map_handle = INVALID_HANDLE_VALUE;
+shared_map map_view;
+layout_adapter map_layout;
 r3e_shared* map_buffer = NULL;
+snapshot_reader map_reader;
+tick_waiter map_waiter;
+r3e_shared map_snapshot;
+subscription map_subscription;
+BOOL map_subscribed = FALSE;
+recorder map_recorder;
+diff_engine map_diff;
+trackmap map_track;
+BOOL map_tracking = FALSE;
+strategy map_strategy;
+BOOL map_planning = FALSE;
+thermal map_thermal;
+BOOL map_heating = FALSE;
+gaps_engine map_gaps;
+BOOL map_timing = FALSE;
+racelog map_racelog;
+metrics_registry map_metrics;
+metrics_shard* map_shard = NULL;
 
-HANDLE map_open()
+// Metric ids, see metrics_setup
+typedef struct
 {
-    return OpenFileMapping(
-        FILE_MAP_READ,
-        FALSE,
-        TEXT(R3E_SHARED_MEMORY_NAME));
-}
+    int ticks;
+    int ticks_skipped;
+    int reads;
+    int torn_retries;
+    int failed_reads;
+    int copy_ns;
+    int tick_to_consume_us;
+} sample_metric_ids;
+
+sample_metric_ids map_ids;
 
 BOOL map_exists()
 {
-    HANDLE handle = map_open();
-
-    if (handle != NULL)
-        CloseHandle(handle);
-        
-    return handle != NULL;
+    return shared_map_exists(R3E_SHARED_MEMORY_NAME);
 }
 
 int map_init()
 {
-    map_handle = map_open();
+    if (layout_map(&map_layout, &map_view, R3E_SHARED_MEMORY_NAME))
+    {
+        if (map_layout.match == LAYOUT_NOT_READY)
+            return 1;
+
+        if (map_layout.match == LAYOUT_UNSUPPORTED && map_layout.version_major != 0)
+            wprintf_s(L"Unsupported shared memory version %d.%d, this sample reads %d.x\n",
+                map_layout.version_major, map_layout.version_minor, R3E_VERSION_MAJOR);
+        else
+            wprintf_s(L"Failed to map buffer\n");
+        return 1;
+    }
+
+    if (map_layout.match == LAYOUT_ADAPTED)
+        wprintf_s(L"Shared memory version %d.%d, remapping it to %d.%d\n",
+            map_layout.version_major, map_layout.version_minor, R3E_VERSION_MAJOR, R3E_VERSION_MINOR);
+
+    map_buffer = (r3e_shared*)map_view.view;
+
+    snapshot_init(&map_reader, map_buffer, SNAPSHOT_RETRIES_DEFAULT);
+    tick_waiter_init(&map_waiter, map_buffer);
+
+    return 0;
+}
+
+void map_close()
+{
+    if (map_waiter.source) tick_waiter_close(&map_waiter);
+    if (map_buffer) shared_map_close(&map_view);
+}
+
+void print_thermal()
+{
+    static const char* corners[R3E_TIRE_INDEX_MAX] = { "FL", "FR", "RL", "RR" };
+    int i;
+
+    for (i = 0; i < R3E_TIRE_INDEX_MAX; ++i)
+    {
+        if (!map_thermal.seen[THERMAL_TIRE + i])
+            continue;
+
+        wprintf_s(L"Tire " NARROW_STR L": %.1f C, %.0f%% in window, brake %.0f C", corners[i],
+            map_thermal.value[THERMAL_TIRE + i], thermal_in_window(&map_thermal, THERMAL_TIRE + i) * 100.f,
+            map_thermal.value[THERMAL_BRAKE + i]);
+
+        if (map_thermal.wear_per_lap[i] >= 0.f)
+            wprintf_s(L", wear %.3f (%.3f per lap)", map_thermal.wear[i], map_thermal.wear_per_lap[i]);
+
+        if (map_planning && map_strategy.laps_remaining >= 0.f && map_thermal.wear_per_lap[i] >= 0.f)
+            wprintf_s(L", %.3f at the finish", thermal_wear_after(&map_thermal, i, map_strategy.laps_remaining));
+
+        wprintf_s(L"\n");
+    }
+}
+
+void print_gap(const char* to, const gaps_gap* gap)
+{
+    if (!gap->valid)
+        return;
+
+    wprintf_s(L", %.3f s", gap->seconds);
+    if (gap->laps > 0)
+        wprintf_s(L" and %d laps", gap->laps);
+    wprintf_s(L" to the " NARROW_STR, to);
+}
+
+void print_gaps(const r3e_shared* frame)
+{
+    const gaps_car* car;
+    int slot = frame->vehicle_info.slot_id;
+
+    if (slot < 0 || slot >= GAPS_SLOTS || !map_gaps.cars[slot].active)
+        return;
+
+    car = &map_gaps.cars[slot];
 
-    if (map_handle == NULL)
+    wprintf_s(L"Place: %d (%d in class)", car->place, car->place_class);
+    if (car->place > 1)
     {
-        wprintf_s(L"Failed to open mapping");
+        print_gap("car ahead", &car->interval);
+        print_gap("leader", &car->leader);
+    }
+    wprintf_s(L"\n");
+}
+
+void print_frame(const r3e_shared* frame)
+{
+    trackmap_hit hit;
+
+    if (frame->gear > -2)
+    {
+        wprintf_s(L"Gear: %i\n", frame->gear);
+    }
+
+    if (frame->engine_rps > -1.f)
+    {
+        wprintf_s(L"RPM: %.3f\n", frame->engine_rps * RPS_TO_RPM);
+        wprintf_s(L"Speed: %.3f km/h\n", frame->car_speed * MPS_TO_KPH);
+    }
+
+    if (map_tracking && trackmap_nearest(&map_track, (float)frame->player.position.x, (float)frame->player.position.z, &hit) == 0)
+        wprintf_s(L"Track map: %.1f m into the lap, %.1f m off the centerline\n", hit.lap_distance, hit.distance);
+
+    // Known once there's a pace to tell the race distance by
+    if (map_planning && map_strategy.fuel.to_add >= 0.f)
+        wprintf_s(L"Fuel: %.1f l, %.1f laps in the tank, %.1f l to add to finish\n",
+            map_strategy.fuel.left, map_strategy.fuel.laps_to_empty, map_strategy.fuel.to_add);
+
+    if (map_planning && map_strategy.energy.to_add >= 0.f)
+        wprintf_s(L"Virtual energy: %.1f MJ, %.1f laps left, %.1f MJ to add to finish\n",
+            map_strategy.energy.left, map_strategy.energy.laps_to_empty, map_strategy.energy.to_add);
+
+    if (map_heating)
+        print_thermal();
+
+    if (map_timing)
+        print_gaps(frame);
+
+    wprintf_s(L"\n");
+}
+
+// Floats change nearly every tick, only print discrete state such as places, flags or pit status
+void print_change(const diff_event* event, void* context)
+{
+    char line[256];
+
+    (void)context;
+
+    if (event->field && event->field->type == FIELD_FLOAT32)
+        return;
+    if (event->field && event->field->type == FIELD_FLOAT64)
+        return;
+
+    diff_format(event, line, sizeof(line));
+    wprintf_s(NARROW_STR L"\n", line);
+}
+
+// Whether enough ticks went by since the last printed frame
+BOOL print_due(const r3e_shared* frame, r3e_int32* print_ticks)
+{
+    if (frame->player.game_simulation_ticks >= *print_ticks &&
+        frame->player.game_simulation_ticks - *print_ticks < INTERVAL_TICKS)
+        return FALSE;
+
+    *print_ticks = frame->player.game_simulation_ticks;
+    return TRUE;
+}
+
+void metrics_setup(BOOL enabled)
+{
+    metrics_init(&map_metrics, enabled);
+
+    map_ids.ticks = metrics_register_counter(&map_metrics, "ticks");
+    map_ids.ticks_skipped = metrics_register_counter(&map_metrics, "ticks_skipped");
+    map_ids.reads = metrics_register_counter(&map_metrics, "reads");
+    map_ids.torn_retries = metrics_register_counter(&map_metrics, "torn_retries");
+    map_ids.failed_reads = metrics_register_counter(&map_metrics, "failed_reads");
+
+    // Time to copy the frame, and from the tick showing up to being done with it
+    map_ids.copy_ns = metrics_register_histogram(&map_metrics, "copy", "ns");
+    map_ids.tick_to_consume_us = metrics_register_histogram(&map_metrics, "tick_to_consume", "us");
+
+    map_shard = metrics_shard_open(&map_metrics, "main");
+}
+
+// Only what print_frame shows is copied when nothing needs the whole frame
+void subscription_setup()
+{
+    subscription_init(&map_subscription);
+
+    subscription_add_field(&map_subscription, "gear");
+    subscription_add_field(&map_subscription, "engine_rps");
+    subscription_add_field(&map_subscription, "car_speed");
+    subscription_build(&map_subscription);
+
+    map_subscribed = TRUE;
+}
+
+// Reads the tick tick_wait just saw, returns 0 on a consistent copy
+int capture_frame()
+{
+    uint32_t torn_before = map_reader.torn_reads;
+    uint64_t copy_start_ns = map_shard ? time_now_ns() : 0;
+    int err_code;
+
+    // Subscription offsets are in the r3e.h layout
+    if (map_subscribed && map_layout.match == LAYOUT_EXACT)
+        err_code = subscription_read(&map_subscription, &map_reader, &map_snapshot);
+    else
+        err_code = layout_read(&map_layout, &map_reader, &map_snapshot);
+
+    if (map_shard)
+    {
+        METRICS_RECORD(map_shard, map_ids.copy_ns, time_now_ns() - copy_start_ns);
+        METRICS_ADD(map_shard, map_ids.reads, 1);
+        METRICS_ADD(map_shard, map_ids.torn_retries, map_reader.torn_reads - torn_before);
+        METRICS_ADD(map_shard, map_ids.failed_reads, err_code != 0);
+    }
+
+    return err_code;
+}
+
+// events_path, if not NULL, gets the race log of the recording appended
+int replay_file(const char* path, const char* events_path)
+{
+    replay rep;
+    r3e_int32 print_ticks = 0;
+
+    if (replay_open(&rep, path))
+    {
+        wprintf_s(L"Failed to open replay\n");
         return 1;
     }
 
-    map_buffer = (r3e_shared*)MapViewOfFile(map_handle, FILE_MAP_READ, 0, 0, sizeof(r3e_shared));
-    if (map_buffer == NULL)
+    if (events_path && racelog_init(&map_racelog, events_path, NULL, NULL))
     {
-        wprintf_s(L"Failed to map buffer");
+        wprintf_s(L"Failed to open race log\n");
+        replay_close(&rep);
         return 1;
     }
 
+    wprintf_s(L"Replaying %u frames\n", rep.num_frames);
+
+    while (replay_next(&rep) == 0)
+    {
+        if (events_path)
+            racelog_update(&map_racelog, replay_frame(&rep));
+
+        if (print_due(replay_frame(&rep), &print_ticks))
+            print_frame(replay_frame(&rep));
+    }
+
+    replay_close(&rep);
+
+    if (events_path)
+    {
+        wprintf_s(L"Race log: %llu events over %llu frames\n",
+            (unsigned long long)map_racelog.events, (unsigned long long)map_racelog.frames);
+        racelog_close(&map_racelog);
+    }
+
     return 0;
 }
 
-void map_close()
+int write_schema(const char* path)
 {
-    if (map_buffer) UnmapViewOfFile(map_buffer);
-    if (map_handle) CloseHandle(map_handle);
+    FILE* file = file_open(path, "w");
+    int err_code = 0;
+
+    if (file == NULL)
+    {
+        wprintf_s(L"Failed to open schema file\n");
+        return 1;
+    }
+
+    err_code = fields_write_schema(file);
+    fclose(file);
+
+    return err_code;
 }
 
-int main()
+int main(int argc, char* argv[])
 {
-    clock_t clk_start = 0, clk_last = 0;
-    clock_t clk_delta_ms = 0, clk_elapsed = 0;
+    uint64_t clk_start = 0, clk_last = 0;
     int err_code = 0;
+    r3e_int32 print_ticks = 0;
     BOOL mapped_r3e = FALSE;
+    BOOL found_r3e = FALSE;
+    BOOL need_process = TRUE;
+    const char* record_path = NULL;
+    const char* events_path = NULL;
+    BOOL print_changes = FALSE;
+    BOOL metrics_enabled = TRUE;
+    const char* metrics_path = NULL;
+    size_t length;
+    uint32_t missed;
+    int i;
+
+    for (i = 1; i < argc; ++i)
+    {
+        // -synthetic attaches to any $R3E mapping, e.g. one filled by the producer tool
+        if (strcmp(argv[i], "-synthetic") == 0)
+            need_process = FALSE;
+        // -record <file> writes every captured tick to a recording
+        else if (strcmp(argv[i], "-record") == 0 && i + 1 < argc)
+            record_path = argv[++i];
+        // -events <file> appends session, flag, pit, overtake and penalty events to a race log (JSON lines)
+        else if (strcmp(argv[i], "-events") == 0 && i + 1 < argc)
+            events_path = argv[++i];
+        // -replay <file> prints a recording instead of live data, after -events it also logs its events
+        else if (strcmp(argv[i], "-replay") == 0 && i + 1 < argc)
+            return replay_file(argv[++i], events_path);
+        // -changes prints what changed every tick instead of a frame every interval
+        else if (strcmp(argv[i], "-changes") == 0)
+            print_changes = TRUE;
+        // -schema <file> writes the shared memory layout as JSON
+        else if (strcmp(argv[i], "-schema") == 0 && i + 1 < argc)
+            return write_schema(argv[++i]);
+        // -metrics <file> rewrites capture metrics to a file every second, as JSON if it ends in .json
+        else if (strcmp(argv[i], "-metrics") == 0 && i + 1 < argc)
+            metrics_path = argv[++i];
+        // -no-metrics turns the capture metrics off
+        else if (strcmp(argv[i], "-no-metrics") == 0)
+            metrics_enabled = FALSE;
+        // -trackmap <dir> learns the track's layout from the player's laps, cached in dir
+        else if (strcmp(argv[i], "-trackmap") == 0 && i + 1 < argc)
+        {
+            trackmap_init(&map_track, argv[++i]);
+            map_tracking = TRUE;
+        }
+        // -strategy prints fuel and virtual energy projections
+        else if (strcmp(argv[i], "-strategy") == 0)
+        {
+            strategy_init(&map_strategy);
+            map_planning = TRUE;
+        }
+        // -thermal prints smoothed tire and brake temperatures and tire wear
+        else if (strcmp(argv[i], "-thermal") == 0)
+        {
+            thermal_init(&map_thermal);
+            map_heating = TRUE;
+        }
+        // -gaps prints the player's place and live gaps to the car ahead and the leader
+        else if (strcmp(argv[i], "-gaps") == 0)
+        {
+            if (gaps_init(&map_gaps, 0))
+            {
+                wprintf_s(L"Failed to allocate the gap engine\n");
+                return 1;
+            }
+            map_timing = TRUE;
+        }
+    }
+
+    metrics_setup(metrics_enabled);
+
+    if (metrics_enabled && metrics_path)
+    {
+        length = strlen(metrics_path);
+
+        if (metrics_dump_start(&map_metrics, metrics_path,
+            length >= 5 && strcmp(metrics_path + length - 5, ".json") == 0 ? METRICS_JSON : METRICS_TEXT,
+            METRICS_DUMP_INTERVAL_DEFAULT))
+        {
+            wprintf_s(L"Failed to start writing metrics\n");
+            return 1;
+        }
+    }
+
+    if (record_path && recorder_open(&map_recorder, record_path, RECORDER_KEYFRAME_INTERVAL_DEFAULT))
+    {
+        wprintf_s(L"Failed to open recording\n");
+        err_code = 1;
+    }
+    else if (print_changes && diff_init(&map_diff, print_change, NULL))
+    {
+        wprintf_s(L"Failed to allocate change tracking\n");
+        err_code = 1;
+    }
+    else if (events_path && racelog_init(&map_racelog, events_path, NULL, NULL))
+    {
+        wprintf_s(L"Failed to open race log\n");
+        err_code = 1;
+    }
+
+    // The player block is high rate physics, ticks included
+    if (print_changes)
+        diff_enable(&map_diff, DIFF_PLAYER, "", FALSE);
 
-    clk_start = clock();
+    if (!record_path && !print_changes && !map_tracking && !map_planning && !map_heating && !map_timing && !events_path)
+        subscription_setup();
+
+    clk_start = time_now_us();
     clk_last = clk_start;
 
-    wprintf_s(L"Looking for RRRE.exe...\n");
+    if (!err_code)
+        wprintf_s(L"Looking for RRRE.exe...\n");
 
-    for(;;)
+    // Errors fall through to the cleanup below, which stops the metrics dump
+    // and closes whatever was opened
+    while (!err_code)
     {
-        clk_elapsed = (clock() - clk_start) / CLOCKS_PER_SEC;
-        if (clk_elapsed >= ALIVE_SEC)
+        if (time_now_us() - clk_start >= (uint64_t)ALIVE_SEC * 1000000)
             break;
 
-        clk_delta_ms = (clock() - clk_last) / CLOCKS_PER_MS;
-        if (clk_delta_ms < INTERVAL_MS)
+        if (mapped_r3e)
+        {
+            // Capture every tick, but only print at the old polling interval
+            if (tick_wait(&map_waiter, INTERVAL_MS, &missed) != TICK_WAIT_OK)
+                continue;
+
+            METRICS_ADD(map_shard, map_ids.ticks, 1);
+            METRICS_ADD(map_shard, map_ids.ticks_skipped, missed);
+
+            if (capture_frame())
+                continue;
+
+            if (record_path && recorder_write(&map_recorder, &map_snapshot))
+            {
+                wprintf_s(L"Failed to write recording\n");
+                record_path = NULL;
+            }
+
+            if (map_tracking)
+                trackmap_update(&map_track, &map_snapshot);
+
+            if (map_planning)
+                strategy_update(&map_strategy, &map_snapshot);
+
+            if (map_heating)
+                thermal_update(&map_thermal, &map_snapshot);
+
+            if (map_timing)
+                gaps_update(&map_gaps, &map_snapshot);
+
+            if (events_path)
+                racelog_update(&map_racelog, &map_snapshot);
+
+            if (print_changes)
+                diff_update(&map_diff, &map_snapshot);
+            else if (print_due(&map_snapshot, &print_ticks))
+                print_frame(&map_snapshot);
+
+            if (map_shard)
+                METRICS_RECORD(map_shard, map_ids.tick_to_consume_us, time_now_us() - map_waiter.last_tick_us);
+
+            continue;
+        }
+
+        if (time_now_us() - clk_last < INTERVAL_MS * 1000)
         {
-            Sleep(1);
+            sleep_ms(1);
             continue;
         }
 
-        clk_last = clock();
+        clk_last = time_now_us();
 
-        if (!mapped_r3e && is_r3e_running() && map_exists())
+        if ((!need_process || is_r3e_running()) && map_exists())
         {
-            wprintf_s(L"Found RRRE.exe, mapping shared memory...\n");
+            if (!found_r3e)
+                wprintf_s(L"Found RRRE.exe, mapping shared memory...\n");
+            found_r3e = TRUE;
 
+            // The game creates the shared memory before it writes the header,
+            // try again at the next interval
             err_code = map_init();
+            if (err_code && map_layout.match == LAYOUT_NOT_READY)
+            {
+                err_code = 0;
+                continue;
+            }
+
             if (err_code)
-                return err_code;
+                break;
 
             wprintf_s(L"Memory mapped successfully\n");
 
             mapped_r3e = TRUE;
-            clk_start = clock();
+            clk_start = time_now_us();
         }
+    }
 
-        if (mapped_r3e)
-        {
-            if (map_buffer->gear > -2)
-            {
-                wprintf_s(L"Gear: %i\n", map_buffer->gear);
-            }
+    if (mapped_r3e && map_shard)
+        metrics_print(&map_metrics);
 
-            if (map_buffer->engine_rps > -1.f)
-            {
-                wprintf_s(L"RPM: %.3f\n", map_buffer->engine_rps * RPS_TO_RPM);
-                wprintf_s(L"Speed: %.3f km/h\n", map_buffer->car_speed * MPS_TO_KPH);
-            }
+    map_close();
+    metrics_close(&map_metrics);
 
-            wprintf_s(L"\n");
-        }
+    if (map_tracking)
+    {
+        if (map_track.ready)
+            wprintf_s(L"Track map: %u points\n", map_track.num_points);
+        trackmap_close(&map_track);
     }
 
-    map_close();
+    if (map_timing)
+        gaps_close(&map_gaps);
 
-    wprintf_s(L"All done!");
+    if (map_racelog.previous)
+    {
+        wprintf_s(L"Race log: %llu events over %llu frames\n",
+            (unsigned long long)map_racelog.events, (unsigned long long)map_racelog.frames);
+        racelog_close(&map_racelog);
+    }
+
+    if (map_diff.previous)
+    {
+        wprintf_s(L"Changes: %llu events over %llu frames\n",
+            (unsigned long long)map_diff.events, (unsigned long long)map_diff.frames);
+        diff_close(&map_diff);
+    }
+
+    if (map_recorder.file)
+    {
+        wprintf_s(L"Recorded %llu frames, %llu bytes (%.1f%% of raw)\n",
+            (unsigned long long)map_recorder.frames, (unsigned long long)map_recorder.bytes_out,
+            map_recorder.bytes_in ? 100.0 * map_recorder.bytes_out / map_recorder.bytes_in : 0.0);
+        recorder_close(&map_recorder);
+    }
+
+    wprintf_s(L"All done!\n");
+#ifdef _WIN32
     system("PAUSE");
+#endif
 
-    return 0;
+    return err_code;
 }
\ No newline at end of file
@@ -0,0 +1,223 @@
+#include "snappy.h"
+
+#include <string.h>
+
+#define BLOCK_SIZE 65536
+#define HASH_BITS 14
+
+// Longest copy one element can hold with a 2 byte offset
+#define COPY_MAX 64
+
+static uint32_t load32(const uint8_t* p)
+{
+    uint32_t value;
+
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t hash32(uint32_t value)
+{
+    return (value * 0x1e35a7bdu) >> (32 - HASH_BITS);
+}
+
+static uint8_t* write_varint(uint8_t* out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        *out++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+
+    *out++ = (uint8_t)value;
+    return out;
+}
+
+static uint8_t* write_literal(uint8_t* out, const uint8_t* in, size_t length)
+{
+    size_t n = length - 1;
+
+    if (n < 60)
+    {
+        *out++ = (uint8_t)(n << 2);
+    }
+    else if (n < 0x100)
+    {
+        *out++ = 60 << 2;
+        *out++ = (uint8_t)n;
+    }
+    else
+    {
+        *out++ = 61 << 2;
+        *out++ = (uint8_t)n;
+        *out++ = (uint8_t)(n >> 8);
+    }
+
+    memcpy(out, in, length);
+    return out + length;
+}
+
+static uint8_t* write_copy(uint8_t* out, size_t offset, size_t length)
+{
+    size_t n;
+
+    while (length > 0)
+    {
+        // Leave at least 4 for the last element, so it can still be a copy
+        n = length > COPY_MAX ? (length - COPY_MAX < 4 ? COPY_MAX - 4 : COPY_MAX) : length;
+
+        *out++ = (uint8_t)(((n - 1) << 2) | 2);
+        *out++ = (uint8_t)offset;
+        *out++ = (uint8_t)(offset >> 8);
+
+        length -= n;
+    }
+
+    return out;
+}
+
+static uint8_t* compress_block(const uint8_t* in, size_t size, uint8_t* out, uint16_t* table)
+{
+    const uint8_t* literal = in;
+    const uint8_t* end = in + size;
+    const uint8_t* p = in;
+    const uint8_t* candidate;
+    size_t length;
+    uint32_t h, misses = 0;
+
+    memset(table, 0, sizeof(uint16_t) << HASH_BITS);
+
+    while (p + 4 <= end)
+    {
+        h = hash32(load32(p));
+        candidate = in + table[h];
+        table[h] = (uint16_t)(p - in);
+
+        // Step further the longer nothing matched, noisy data goes by quickly
+        if (candidate >= p || load32(candidate) != load32(p))
+        {
+            p += 1 + (misses++ >> 5);
+            continue;
+        }
+
+        misses = 0;
+
+        for (length = 4; p + length < end && candidate[length] == p[length]; ++length)
+            ;
+
+        if (p > literal)
+            out = write_literal(out, literal, p - literal);
+
+        out = write_copy(out, p - candidate, length);
+        p += length;
+        literal = p;
+    }
+
+    if (end > literal)
+        out = write_literal(out, literal, end - literal);
+
+    return out;
+}
+
+size_t snappy_compress(const uint8_t* in, size_t size, uint8_t* out)
+{
+    uint16_t table[1 << HASH_BITS];
+    uint8_t* p = write_varint(out, (uint32_t)size);
+    size_t offset, block;
+
+    for (offset = 0; offset < size; offset += block)
+    {
+        block = size - offset < BLOCK_SIZE ? size - offset : BLOCK_SIZE;
+        p = compress_block(in + offset, block, p, table);
+    }
+
+    return p - out;
+}
+
+size_t snappy_decompress(const uint8_t* in, size_t in_size, uint8_t* out, size_t out_size)
+{
+    const uint8_t* end = in + in_size;
+    size_t size = 0, written = 0, length, offset, i;
+    int shift = 0;
+    uint8_t tag;
+
+    do
+    {
+        if (in == end || shift > 28)
+            return 0;
+
+        size |= (size_t)(*in & 0x7f) << shift;
+        shift += 7;
+    }
+    while (*in++ & 0x80);
+
+    if (size > out_size)
+        return 0;
+
+    while (in < end)
+    {
+        tag = *in++;
+
+        if ((tag & 3) == 0)
+        {
+            length = (tag >> 2) + 1;
+
+            if (length > 60)
+            {
+                if ((size_t)(end - in) < length - 60)
+                    return 0;
+
+                offset = length - 60;
+                length = 0;
+                for (i = 0; i < offset; ++i)
+                    length |= (size_t)in[i] << (8 * i);
+                length++;
+                in += offset;
+            }
+
+            if ((size_t)(end - in) < length || size - written < length)
+                return 0;
+
+            memcpy(out + written, in, length);
+            in += length;
+            written += length;
+            continue;
+        }
+
+        if ((tag & 3) == 1)
+        {
+            if (in == end)
+                return 0;
+
+            length = ((tag >> 2) & 7) + 4;
+            offset = ((size_t)(tag >> 5) << 8) | *in++;
+        }
+        else if ((tag & 3) == 2)
+        {
+            if (end - in < 2)
+                return 0;
+
+            length = (tag >> 2) + 1;
+            offset = in[0] | ((size_t)in[1] << 8);
+            in += 2;
+        }
+        else
+        {
+            if (end - in < 4)
+                return 0;
+
+            length = (tag >> 2) + 1;
+            offset = load32(in);
+            in += 4;
+        }
+
+        if (offset == 0 || offset > written || size - written < length)
+            return 0;
+
+        // Byte by byte, the source may overlap what is being written
+        for (i = 0; i < length; ++i, ++written)
+            out[written] = out[written - offset];
+    }
+
+    return written == size ? size : 0;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Upper bound for the compressed size of size bytes, same as the reference implementation's
+#define SNAPPY_BOUND(size) (32 + (size) + (size) / 6)
+
+// Compresses in to the raw Snappy format (no framing), as used by Parquet pages.
+// Greedy matching over 64 KB blocks with a 4 byte hash, which finds the long
+// runs in telemetry columns (unused fields, values that only change per lap)
+// at a few hundred MB/s; it doesn't try to squeeze noisy floats.
+// out must hold SNAPPY_BOUND(size) bytes, returns the number of bytes written
+size_t snappy_compress(const uint8_t* in, size_t size, uint8_t* out);
+
+// Decompresses into out, which holds out_size bytes
+// Returns the decompressed size, or 0 if the input is malformed or doesn't fit
+size_t snappy_decompress(const uint8_t* in, size_t in_size, uint8_t* out, size_t out_size);
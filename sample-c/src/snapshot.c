@@ -0,0 +1,99 @@
+#include "snapshot.h"
+#include "platform.h"
+
+#include <string.h>
+
+static r3e_int32 load_ticks(const r3e_shared* source)
+{
+    return *(const volatile r3e_int32*)&source->player.game_simulation_ticks;
+}
+
+void snapshot_init(snapshot_reader* reader, const r3e_shared* source, int max_retries)
+{
+    memset(reader, 0, sizeof(*reader));
+    reader->source = source;
+    reader->max_retries = max_retries > 0 ? max_retries : 1;
+}
+
+int snapshot_read(snapshot_reader* reader, r3e_shared* dest)
+{
+    return snapshot_read_range(reader, dest, 0, sizeof(r3e_shared));
+}
+
+int snapshot_read_range(snapshot_reader* reader, r3e_shared* dest, size_t offset, size_t size)
+{
+    snapshot_range range;
+
+    range.offset = (uint32_t)offset;
+    range.size = (uint32_t)size;
+
+    return snapshot_read_ranges(reader, dest, &range, 1);
+}
+
+int snapshot_read_ranges(snapshot_reader* reader, r3e_shared* dest, const snapshot_range* ranges, int count)
+{
+    const char* src = (const char*)reader->source;
+    r3e_int32 ticks_before = 0;
+    r3e_int32 ticks_after = 0;
+    int attempt, r;
+
+    reader->reads++;
+
+    for (attempt = 0; attempt < reader->max_retries; ++attempt)
+    {
+        ticks_before = load_ticks(reader->source);
+        platform_barrier();
+
+        for (r = 0; r < count; ++r)
+            memcpy((char*)dest + ranges[r].offset, src + ranges[r].offset, ranges[r].size);
+
+        platform_barrier();
+        ticks_after = load_ticks(reader->source);
+
+        if (ticks_before == ticks_after)
+        {
+            dest->player.game_simulation_ticks = ticks_before;
+            return 0;
+        }
+
+        reader->torn_reads++;
+    }
+
+    reader->failed_reads++;
+    dest->player.game_simulation_ticks = ticks_after;
+    return 1;
+}
+
+int snapshot_read_copies(snapshot_reader* reader, r3e_shared* dest, const snapshot_copy* copies, int count)
+{
+    const char* src = (const char*)reader->source;
+    r3e_int32 ticks_before = 0;
+    r3e_int32 ticks_after = 0;
+    int attempt, c;
+
+    reader->reads++;
+
+    for (attempt = 0; attempt < reader->max_retries; ++attempt)
+    {
+        ticks_before = load_ticks(reader->source);
+        platform_barrier();
+
+        for (c = 0; c < count; ++c)
+            memcpy((char*)dest + copies[c].dest_offset, src + copies[c].source_offset, copies[c].size);
+
+        platform_barrier();
+        ticks_after = load_ticks(reader->source);
+
+        if (ticks_before == ticks_after)
+        {
+            dest->player.game_simulation_ticks = ticks_before;
+            return 0;
+        }
+
+        reader->torn_reads++;
+    }
+
+    reader->failed_reads++;
+    dest->player.game_simulation_ticks = ticks_after;
+    return 1;
+}
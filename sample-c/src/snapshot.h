@@ -0,0 +1,66 @@
+#pragma once
+
+#include "r3e.h"
+
+#include <stddef.h>
+
+// Number of copy attempts before a read gives up on getting a consistent frame
+#define SNAPSHOT_RETRIES_DEFAULT 8
+
+// Offset and size of a member of r3e_shared, for use with snapshot_read_range
+// Example: snapshot_read_range(&reader, &frame, SNAPSHOT_FIELD(tire_temp));
+#define SNAPSHOT_FIELD(field) offsetof(r3e_shared, field), sizeof(((r3e_shared*)0)->field)
+
+// Copies the live mapping into a private buffer without locking the game.
+// player.game_simulation_ticks is read before and after each copy, if it moved
+// the copy may mix two physics ticks and is thrown away and retried.
+// Note: This only catches writes that bump the tick while the copy is running,
+// it can't detect a game write that is still in progress on an unchanged tick.
+typedef struct
+{
+    const r3e_shared* source;
+    int max_retries;
+
+    // Number of read calls
+    uint32_t reads;
+
+    // Number of copy attempts thrown away because the tick moved
+    uint32_t torn_reads;
+
+    // Number of read calls that ran out of attempts
+    uint32_t failed_reads;
+} snapshot_reader;
+
+void snapshot_init(snapshot_reader* reader, const r3e_shared* source, int max_retries);
+
+// Copies all of r3e_shared into dest
+// Returns 0 on a consistent copy, 1 if every attempt was torn (dest holds the last attempt)
+int snapshot_read(snapshot_reader* reader, r3e_shared* dest);
+
+// Copies the byte range [offset, offset + size) to the same offset in dest and stamps
+// dest->player.game_simulation_ticks with the tick the copied range belongs to
+// Returns 0 on a consistent copy, 1 if every attempt was torn
+int snapshot_read_range(snapshot_reader* reader, r3e_shared* dest, size_t offset, size_t size);
+
+typedef struct
+{
+    uint32_t offset;
+    uint32_t size;
+} snapshot_range;
+
+// Copies each of count ranges to the same offset in dest, all within one tick
+// guarded attempt, and stamps dest->player.game_simulation_ticks like snapshot_read_range
+// Returns 0 on a consistent copy, 1 if every attempt was torn
+int snapshot_read_ranges(snapshot_reader* reader, r3e_shared* dest, const snapshot_range* ranges, int count);
+
+// A range that lands somewhere else in dest than it is in the source
+typedef struct
+{
+    uint32_t source_offset;
+    uint32_t dest_offset;
+    uint32_t size;
+} snapshot_copy;
+
+// Like snapshot_read_ranges, for a source laid out differently from r3e_shared
+// Only the tick has to be where r3e.h has it
+int snapshot_read_copies(snapshot_reader* reader, r3e_shared* dest, const snapshot_copy* copies, int count);
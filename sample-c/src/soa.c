@@ -0,0 +1,190 @@
+#include "soa.h"
+
+#include <math.h>
+#include <string.h>
+
+#if PLATFORM_AVX2
+#include <immintrin.h>
+#elif PLATFORM_SSE2
+#include <emmintrin.h>
+#endif
+
+// Number of lanes the kernels process, count rounded up to a whole 8-wide vector
+static int padded_count(const soa_drivers* columns)
+{
+    return (columns->count + 7) & ~7;
+}
+
+void soa_transpose(soa_drivers* columns, const r3e_shared* frame)
+{
+    const r3e_driver_data* driver;
+    int count = frame->num_cars;
+    int i;
+
+    if (count < 0)
+        count = 0;
+    if (count > SOA_CAPACITY)
+        count = SOA_CAPACITY;
+
+    columns->count = count;
+    columns->layout_length = frame->layout_length;
+
+    for (i = 0; i < count; ++i)
+    {
+        driver = &frame->all_drivers_data_1[i];
+
+        columns->lap_distance[i] = driver->lap_distance;
+        columns->total_distance[i] = driver->completed_laps * frame->layout_length + driver->lap_distance;
+        columns->car_speed[i] = driver->car_speed;
+        columns->time_delta_front[i] = driver->time_delta_front;
+        columns->time_delta_behind[i] = driver->time_delta_behind;
+        columns->place[i] = driver->place;
+        columns->place_class[i] = driver->place_class;
+        columns->class_id[i] = driver->driver_info.class_id;
+        columns->slot_id[i] = driver->driver_info.slot_id;
+        columns->completed_laps[i] = driver->completed_laps;
+        columns->in_pitlane[i] = driver->in_pitlane;
+    }
+
+    // Zero the tail of the last vector so padded lanes are harmless
+    for (; i < padded_count(columns); ++i)
+    {
+        columns->lap_distance[i] = 0.f;
+        columns->total_distance[i] = 0.f;
+        columns->car_speed[i] = 0.f;
+        columns->time_delta_front[i] = 0.f;
+        columns->time_delta_behind[i] = 0.f;
+        columns->place[i] = 0;
+        columns->place_class[i] = 0;
+        columns->class_id[i] = 0;
+        columns->slot_id[i] = 0;
+        columns->completed_laps[i] = 0;
+        columns->in_pitlane[i] = 0;
+    }
+}
+
+#if PLATFORM_AVX2
+
+void soa_gaps(const soa_drivers* columns, int ref, float* out)
+{
+    __m256 ref_distance = _mm256_set1_ps(columns->total_distance[ref]);
+    __m256 min_speed = _mm256_set1_ps(SOA_MIN_SPEED);
+    __m256 distance, speed;
+    int i, n = padded_count(columns);
+
+    for (i = 0; i < n; i += 8)
+    {
+        distance = _mm256_sub_ps(ref_distance, _mm256_load_ps(columns->total_distance + i));
+        speed = _mm256_max_ps(_mm256_load_ps(columns->car_speed + i), min_speed);
+        _mm256_storeu_ps(out + i, _mm256_div_ps(distance, speed));
+    }
+}
+
+void soa_relative_positions(const soa_drivers* columns, int ref, float* out)
+{
+    __m256 ref_distance = _mm256_set1_ps(columns->lap_distance[ref]);
+    __m256 length = _mm256_set1_ps(columns->layout_length);
+    __m256 inv_length = _mm256_set1_ps(columns->layout_length > 0.f ? 1.0f / columns->layout_length : 0.f);
+    __m256 delta, laps;
+    int i, n = padded_count(columns);
+
+    for (i = 0; i < n; i += 8)
+    {
+        delta = _mm256_sub_ps(_mm256_load_ps(columns->lap_distance + i), ref_distance);
+        laps = _mm256_round_ps(_mm256_mul_ps(delta, inv_length), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        _mm256_storeu_ps(out + i, _mm256_sub_ps(delta, _mm256_mul_ps(laps, length)));
+    }
+}
+
+void soa_speed_deltas(const soa_drivers* columns, int ref, float* out)
+{
+    __m256 ref_speed = _mm256_set1_ps(columns->car_speed[ref]);
+    int i, n = padded_count(columns);
+
+    for (i = 0; i < n; i += 8)
+        _mm256_storeu_ps(out + i, _mm256_sub_ps(_mm256_load_ps(columns->car_speed + i), ref_speed));
+}
+
+#elif PLATFORM_SSE2
+
+void soa_gaps(const soa_drivers* columns, int ref, float* out)
+{
+    __m128 ref_distance = _mm_set1_ps(columns->total_distance[ref]);
+    __m128 min_speed = _mm_set1_ps(SOA_MIN_SPEED);
+    __m128 distance, speed;
+    int i, n = padded_count(columns);
+
+    for (i = 0; i < n; i += 4)
+    {
+        distance = _mm_sub_ps(ref_distance, _mm_load_ps(columns->total_distance + i));
+        speed = _mm_max_ps(_mm_load_ps(columns->car_speed + i), min_speed);
+        _mm_storeu_ps(out + i, _mm_div_ps(distance, speed));
+    }
+}
+
+void soa_relative_positions(const soa_drivers* columns, int ref, float* out)
+{
+    __m128 ref_distance = _mm_set1_ps(columns->lap_distance[ref]);
+    __m128 length = _mm_set1_ps(columns->layout_length);
+    __m128 inv_length = _mm_set1_ps(columns->layout_length > 0.f ? 1.0f / columns->layout_length : 0.f);
+    __m128 delta, laps;
+    int i, n = padded_count(columns);
+
+    for (i = 0; i < n; i += 4)
+    {
+        delta = _mm_sub_ps(_mm_load_ps(columns->lap_distance + i), ref_distance);
+        // cvtps rounds to nearest under the default MXCSR mode
+        laps = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(delta, inv_length)));
+        _mm_storeu_ps(out + i, _mm_sub_ps(delta, _mm_mul_ps(laps, length)));
+    }
+}
+
+void soa_speed_deltas(const soa_drivers* columns, int ref, float* out)
+{
+    __m128 ref_speed = _mm_set1_ps(columns->car_speed[ref]);
+    int i, n = padded_count(columns);
+
+    for (i = 0; i < n; i += 4)
+        _mm_storeu_ps(out + i, _mm_sub_ps(_mm_load_ps(columns->car_speed + i), ref_speed));
+}
+
+#else
+
+void soa_gaps(const soa_drivers* columns, int ref, float* out)
+{
+    float ref_distance = columns->total_distance[ref];
+    float speed;
+    int i, n = padded_count(columns);
+
+    for (i = 0; i < n; ++i)
+    {
+        speed = columns->car_speed[i] > SOA_MIN_SPEED ? columns->car_speed[i] : SOA_MIN_SPEED;
+        out[i] = (ref_distance - columns->total_distance[i]) / speed;
+    }
+}
+
+void soa_relative_positions(const soa_drivers* columns, int ref, float* out)
+{
+    float ref_distance = columns->lap_distance[ref];
+    float length = columns->layout_length;
+    float inv_length = length > 0.f ? 1.0f / length : 0.f;
+    float delta;
+    int i, n = padded_count(columns);
+
+    for (i = 0; i < n; ++i)
+    {
+        delta = columns->lap_distance[i] - ref_distance;
+        out[i] = delta - (float)floor(delta * inv_length + 0.5f) * length;
+    }
+}
+
+void soa_speed_deltas(const soa_drivers* columns, int ref, float* out)
+{
+    float ref_speed = columns->car_speed[ref];
+    int i, n = padded_count(columns);
+
+    for (i = 0; i < n; ++i)
+        out[i] = columns->car_speed[i] - ref_speed;
+}
+
+#endif
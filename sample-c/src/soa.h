@@ -0,0 +1,54 @@
+#pragma once
+
+#include "r3e.h"
+#include "platform.h"
+
+// Columns are padded to a whole number of 8-wide vectors
+#define SOA_CAPACITY R3E_NUM_DRIVERS_MAX
+
+// Speeds below this are treated as this when turning distance into time (m/s)
+#define SOA_MIN_SPEED 1.0f
+
+// all_drivers_data_1 transposed into one aligned column per field.
+// r3e_driver_data is over 300 bytes, so reading one field for the whole field
+// of cars touches a cache line per car. The columns keep each field contiguous
+// so the query kernels below can scan them 4 (SSE2) or 8 (AVX2) cars at a time.
+// Index i is the i-th entry of all_drivers_data_1 (place order), entries past
+// count are zero.
+typedef struct
+{
+    int count;
+    float layout_length;
+
+    ALIGNED(32) float lap_distance[SOA_CAPACITY];
+
+    // completed_laps * layout_length + lap_distance
+    // Note: 32-bit floats, so this gets coarser (~0.25 m after 2500 km)
+    ALIGNED(32) float total_distance[SOA_CAPACITY];
+
+    ALIGNED(32) float car_speed[SOA_CAPACITY];
+    ALIGNED(32) float time_delta_front[SOA_CAPACITY];
+    ALIGNED(32) float time_delta_behind[SOA_CAPACITY];
+
+    ALIGNED(32) r3e_int32 place[SOA_CAPACITY];
+    ALIGNED(32) r3e_int32 place_class[SOA_CAPACITY];
+    ALIGNED(32) r3e_int32 class_id[SOA_CAPACITY];
+    ALIGNED(32) r3e_int32 slot_id[SOA_CAPACITY];
+    ALIGNED(32) r3e_int32 completed_laps[SOA_CAPACITY];
+    ALIGNED(32) r3e_int32 in_pitlane[SOA_CAPACITY];
+} soa_drivers;
+
+void soa_transpose(soa_drivers* columns, const r3e_shared* frame);
+
+// The kernels below write a whole number of vectors, out must hold SOA_CAPACITY floats
+
+// Time each car is behind car ref, estimated from distance and its own speed (s)
+// Negative when the car is ahead of ref
+void soa_gaps(const soa_drivers* columns, int ref, float* out);
+
+// On-track distance from car ref to each car, wrapped to [-layout_length / 2, layout_length / 2)
+// Positive when the car is physically ahead of ref on the current lap, regardless of laps
+void soa_relative_positions(const soa_drivers* columns, int ref, float* out);
+
+// Speed of each car minus the speed of car ref (m/s)
+void soa_speed_deltas(const soa_drivers* columns, int ref, float* out);
@@ -0,0 +1,336 @@
+#include "strategy.h"
+
+#include <math.h>
+#include <string.h>
+
+// Standard deviations per mean absolute deviation, for normally spread laps
+#define STRATEGY_SIGMA_PER_DEVIATION 1.25
+
+static void reset_resource(strategy_resource* res)
+{
+    memset(res, 0, sizeof(*res));
+    res->lap_start = -1.f;
+    res->use_per_lap = -1.f;
+    res->laps_to_empty = -1.f;
+    res->to_finish = -1.f;
+    res->to_finish_safe = -1.f;
+    res->to_add = -1.f;
+}
+
+static void reset(strategy* strat, const r3e_shared* frame)
+{
+    strat->session_type = frame ? frame->session_type : -1;
+    strat->session_iteration = frame ? frame->session_iteration : -1;
+    strat->completed_laps = frame ? frame->completed_laps : -1;
+    strat->lap_clean = FALSE;
+    strat->lap_start_time = -1.0;
+    memset(&strat->lap_time, 0, sizeof(strat->lap_time));
+
+    reset_resource(&strat->fuel);
+    reset_resource(&strat->energy);
+}
+
+void strategy_init(strategy* strat)
+{
+    memset(strat, 0, sizeof(*strat));
+    reset(strat, NULL);
+
+    strat->length_format = R3E_SESSION_LENGTH_UNAVAILABLE;
+    strat->position = -1.f;
+    strat->laps_remaining = -1.f;
+    strat->session_elapsed = -1.f;
+    strat->pit_window_start = -1;
+    strat->pit_window_end = -1;
+    strat->lap_pace = -1.f;
+}
+
+static double stat_scale(const strategy_stat* stat)
+{
+    double least = STRATEGY_DEVIATION_MIN * fabs(stat->mean);
+
+    return stat->deviation > least ? stat->deviation : least;
+}
+
+// Plain running averages while warming up, then an exponentially weighted
+// update with the lap clipped to STRATEGY_CLIP deviations of the mean
+static void stat_add(strategy_stat* stat, double value)
+{
+    double residual = value - stat->mean;
+    double limit, clipped;
+
+    stat->count++;
+
+    if (stat->count == 1)
+    {
+        stat->mean = value;
+        stat->deviation = 0.0;
+        return;
+    }
+
+    if (stat->count <= STRATEGY_WARMUP_LAPS)
+    {
+        stat->mean += residual / stat->count;
+        stat->deviation += (fabs(residual) - stat->deviation) / (stat->count - 1);
+        return;
+    }
+
+    limit = STRATEGY_CLIP * stat_scale(stat);
+    clipped = residual < -limit ? -limit : residual > limit ? limit : residual;
+
+    stat->mean += STRATEGY_ALPHA * clipped;
+    stat->deviation += STRATEGY_ALPHA * (fabs(clipped) - stat->deviation);
+}
+
+// Margin for laps still to go, laps being independent
+static double margin(const strategy_resource* res, double laps)
+{
+    if (res->per_lap.count == 0 || laps <= 0.0)
+        return 0.0;
+
+    return STRATEGY_MARGIN_SIGMA * STRATEGY_SIGMA_PER_DEVIATION * stat_scale(&res->per_lap) * sqrt(laps);
+}
+
+// Tracks one resource's lap, on lap_done the lap in progress was just completed
+static void update_resource(strategy_resource* res, float left, float capacity, float game_per_lap,
+    BOOL lap_done, BOOL lap_clean)
+{
+    // Refuelled or recharged, the lap doesn't tell consumption
+    if (res->lap_start >= 0.f && left > res->left)
+        res->lap_start = -1.f;
+
+    if (lap_done)
+    {
+        if (lap_clean && res->lap_start >= 0.f && res->lap_start > left)
+            stat_add(&res->per_lap, res->lap_start - left);
+
+        res->lap_start = left;
+    }
+
+    res->left = left;
+    res->capacity = capacity;
+
+    if (res->per_lap.count > 0)
+        res->use_per_lap = (float)res->per_lap.mean;
+    else
+        res->use_per_lap = game_per_lap > 0.f ? game_per_lap : -1.f;
+}
+
+static void project_resource(strategy_resource* res, float laps_remaining)
+{
+    res->laps_to_empty = -1.f;
+    res->to_finish = -1.f;
+    res->to_finish_safe = -1.f;
+    res->to_add = -1.f;
+
+    if (!res->available || res->use_per_lap <= 0.f)
+        return;
+
+    res->laps_to_empty = res->left / res->use_per_lap;
+
+    if (laps_remaining < 0.f)
+        return;
+
+    res->to_finish = laps_remaining * res->use_per_lap;
+    res->to_finish_safe = res->to_finish + (float)margin(res, laps_remaining);
+    res->to_add = res->to_finish_safe > res->left ? res->to_finish_safe - res->left : 0.f;
+}
+
+// Laps to go from where the player is, -1.0 = N/A
+static float laps_remaining(const strategy* strat, const r3e_shared* frame, float lap_time, float fraction)
+{
+    float to_line = 1.f - fraction;
+    float laps, time_left;
+
+    if (strat->length_format == R3E_SESSION_LENGTH_LAP_BASED)
+    {
+        if (frame->number_of_laps <= 0)
+            return -1.f;
+
+        laps = (float)frame->number_of_laps - strat->position;
+        return laps > 0.f ? laps : 0.f;
+    }
+
+    if (strat->length_format != R3E_SESSION_LENGTH_TIME_BASED &&
+        strat->length_format != R3E_SESSION_LENGTH_TIME_AND_LAP_BASED)
+        return -1.f;
+
+    if (frame->session_time_remaining < 0.f || lap_time <= 0.f)
+        return -1.f;
+
+    // The race ends with the lap in which the time runs out
+    time_left = frame->session_time_remaining - to_line * lap_time;
+    laps = to_line;
+
+    if (time_left > 0.f)
+        laps += (float)ceil(time_left / lap_time);
+
+    if (strat->length_format == R3E_SESSION_LENGTH_TIME_AND_LAP_BASED)
+        laps += 1.f;
+
+    return laps;
+}
+
+void strategy_update(strategy* strat, const r3e_shared* frame)
+{
+    BOOL lap_done = FALSE;
+    BOOL lap_clean = strat->lap_clean;
+    float fraction, lap_time;
+
+    if (frame->session_type != strat->session_type || frame->session_iteration != strat->session_iteration ||
+        frame->completed_laps < strat->completed_laps || frame->completed_laps > strat->completed_laps + 1)
+        reset(strat, frame);
+    else if (frame->completed_laps == strat->completed_laps + 1)
+        lap_done = TRUE;
+
+    if (lap_done)
+    {
+        if (lap_clean && strat->lap_start_time >= 0.0 && frame->player.game_simulation_time > strat->lap_start_time)
+            stat_add(&strat->lap_time, frame->player.game_simulation_time - strat->lap_start_time);
+
+        strat->completed_laps = frame->completed_laps;
+        strat->lap_start_time = frame->player.game_simulation_time;
+        strat->lap_clean = TRUE;
+    }
+
+    // Laps through the pit lane count neither for pace nor for consumption
+    if (frame->in_pitlane > 0)
+    {
+        strat->lap_clean = FALSE;
+        lap_clean = FALSE;
+    }
+
+    strat->fuel.available = frame->fuel_capacity > 0.f && frame->fuel_use_active != 0;
+    strat->energy.available = frame->virtual_energy_capacity > 0.f;
+
+    if (strat->fuel.available)
+        update_resource(&strat->fuel, frame->fuel_left, frame->fuel_capacity, frame->fuel_per_lap, lap_done, lap_clean);
+
+    if (strat->energy.available)
+        update_resource(&strat->energy, frame->virtual_energy_left, frame->virtual_energy_capacity,
+            frame->virtual_energy_per_lap, lap_done, lap_clean);
+
+    fraction = frame->lap_distance_fraction;
+    if (fraction < 0.f || fraction > 1.f)
+        fraction = 0.f;
+
+    if (strat->lap_time.count > 0)
+        lap_time = (float)strat->lap_time.mean;
+    else
+        lap_time = frame->lap_time_best_self > 0.f ? frame->lap_time_best_self : -1.f;
+
+    strat->length_format = frame->session_length_format;
+    strat->position = frame->completed_laps >= 0 ? (float)frame->completed_laps + fraction : -1.f;
+    strat->session_elapsed = frame->session_time_duration >= 0.f && frame->session_time_remaining >= 0.f ?
+        frame->session_time_duration - frame->session_time_remaining : -1.f;
+    strat->pit_window_start = frame->pit_window_start;
+    strat->pit_window_end = frame->pit_window_end;
+    strat->lap_pace = lap_time;
+    strat->laps_remaining = strat->position >= 0.f ? laps_remaining(strat, frame, lap_time, fraction) : -1.f;
+
+    project_resource(&strat->fuel, strat->laps_remaining);
+    project_resource(&strat->energy, strat->laps_remaining);
+}
+
+// Walks the stops for one resource, adding at each what it takes to the next
+// stop or the finish, margin included, as far as the tank allows
+static void evaluate_resource(const strategy* strat, const strategy_resource* res, strategy_plan* plan,
+    float* to_add, float* at_finish)
+{
+    double finish = strat->position + strat->laps_remaining;
+    double position = strat->position;
+    double left = res->left;
+    double per_lap = res->use_per_lap;
+    double target, want, add;
+    int i;
+
+    memset(to_add, 0, STRATEGY_STOPS_MAX * sizeof(*to_add));
+    *at_finish = -1.f;
+
+    if (!res->available || per_lap <= 0.0)
+        return;
+
+    for (i = 0; i < plan->num_stops; ++i)
+    {
+        left -= (plan->laps[i] - position) * per_lap;
+        if (left < 0.0)
+            plan->reachable = FALSE;
+
+        position = plan->laps[i];
+        target = i + 1 < plan->num_stops ? plan->laps[i + 1] : finish;
+        want = (target - position) * per_lap + margin(res, target - position);
+
+        if (want > res->capacity)
+            plan->fits = FALSE;
+
+        add = want - (left > 0.0 ? left : 0.0);
+        if (add > res->capacity - left)
+            add = res->capacity - left;
+        if (add < 0.0)
+            add = 0.0;
+
+        to_add[i] = (float)add;
+        left += add;
+    }
+
+    left -= (finish - position) * per_lap;
+    if (left < 0.0)
+        plan->reachable = FALSE;
+
+    *at_finish = (float)left;
+}
+
+// Whether stopping at the end of lap is inside the pit window
+static BOOL stop_in_window(const strategy* strat, r3e_int32 lap)
+{
+    BOOL time_based = strat->length_format == R3E_SESSION_LENGTH_TIME_BASED ||
+        strat->length_format == R3E_SESSION_LENGTH_TIME_AND_LAP_BASED;
+    float minute;
+
+    if (!time_based)
+        return lap >= strat->pit_window_start && lap <= strat->pit_window_end;
+
+    if (strat->session_elapsed < 0.f || strat->lap_pace <= 0.f)
+        return FALSE;
+
+    minute = (strat->session_elapsed + (lap - strat->position) * strat->lap_pace) / 60.f;
+    return minute >= strat->pit_window_start && minute <= strat->pit_window_end;
+}
+
+int strategy_evaluate(const strategy* strat, strategy_plan* plan)
+{
+    int i;
+
+    plan->reachable = TRUE;
+    plan->in_window = strat->pit_window_start < 0 || strat->pit_window_end < 0;
+    plan->fits = TRUE;
+    plan->fuel_at_finish = -1.f;
+    plan->energy_at_finish = -1.f;
+    memset(plan->fuel_to_add, 0, sizeof(plan->fuel_to_add));
+    memset(plan->energy_to_add, 0, sizeof(plan->energy_to_add));
+
+    if (strat->position < 0.f || strat->laps_remaining < 0.f ||
+        plan->num_stops < 0 || plan->num_stops > STRATEGY_STOPS_MAX)
+    {
+        plan->reachable = FALSE;
+        return 1;
+    }
+
+    // Stops have to be ahead, in order and before the finish
+    for (i = 0; i < plan->num_stops; ++i)
+    {
+        if (plan->laps[i] < strat->position || plan->laps[i] >= strat->position + strat->laps_remaining ||
+            (i > 0 && plan->laps[i] <= plan->laps[i - 1]))
+        {
+            plan->reachable = FALSE;
+            return 1;
+        }
+
+        if (!plan->in_window && stop_in_window(strat, plan->laps[i]))
+            plan->in_window = TRUE;
+    }
+
+    evaluate_resource(strat, &strat->fuel, plan, plan->fuel_to_add, &plan->fuel_at_finish);
+    evaluate_resource(strat, &strat->energy, plan, plan->energy_to_add, &plan->energy_at_finish);
+
+    return plan->reachable && plan->in_window && plan->fits ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "r3e.h"
+#include "platform.h"
+
+// Laps averaged plainly before the robust updates take over
+#define STRATEGY_WARMUP_LAPS 3
+
+// Weight of a new lap once warmed up, ~the last 5 laps count
+#define STRATEGY_ALPHA 0.2
+
+// Laps further than this many deviations from the mean are clipped to it
+#define STRATEGY_CLIP 3.0
+
+// Deviation assumed at least, relative to the mean
+#define STRATEGY_DEVIATION_MIN 0.01
+
+// Margin kept on top of the mean, in standard deviations of the laps still to go
+#define STRATEGY_MARGIN_SIGMA 2.0
+
+#define STRATEGY_STOPS_MAX 4
+
+// Running per lap figures, robust to the odd lap behind a safety car or with
+// a spin: once warmed up each lap moves the mean by at most STRATEGY_CLIP
+// deviations, weighted exponentially. O(1) per lap, nothing is kept per lap.
+typedef struct
+{
+    uint32_t count;
+    double mean;
+
+    // Mean absolute deviation, ~0.8 standard deviations for normal laps
+    double deviation;
+} strategy_stat;
+
+// Fuel (l) or virtual energy (MJ)
+typedef struct
+{
+    BOOL available;
+    float left;
+    float capacity;
+
+    strategy_stat per_lap;
+
+    // Left when the lap in progress started, -1.0 if the lap doesn't count
+    float lap_start;
+
+    // Per lap figure in use, the measured mean or the game's estimate before
+    // there is one, -1.0 = N/A
+    float use_per_lap;
+
+    // Projections, -1.0 = N/A
+    float laps_to_empty;
+    float to_finish;
+    float to_finish_safe;
+    float to_add;
+} strategy_resource;
+
+// A pit stop plan: stop at the end of each lap in laps (completed_laps counts,
+// in order), refuelling just enough to reach the next stop or the finish
+typedef struct
+{
+    r3e_int32 laps[STRATEGY_STOPS_MAX];
+    int num_stops;
+
+    // Results of strategy_evaluate. reachable: every stop and the finish are
+    // reached on what's on board, in_window: a stop is inside the pit window
+    // (TRUE without one), fits: no stop needs more than the tank holds
+    BOOL reachable;
+    BOOL in_window;
+    BOOL fits;
+    float fuel_to_add[STRATEGY_STOPS_MAX];
+    float energy_to_add[STRATEGY_STOPS_MAX];
+
+    // Left when crossing the finish line with the mean consumption
+    float fuel_at_finish;
+    float energy_at_finish;
+} strategy_plan;
+
+// Fuel and virtual energy strategy of the player's car, updated on the
+// capture thread. Consumption is measured per lap from fuel_left and
+// virtual_energy_left (laps through the pit lane or with a refuel don't count)
+// and lap times from player.game_simulation_time. Projections follow
+// session_length_format: lap based races end after number_of_laps, time based
+// ones with the lap in which session_time_remaining runs out (one more for
+// time and lap based ones), going by the player's own pace.
+// Note: The leader finishing earlier can end the race a lap sooner
+typedef struct
+{
+    r3e_int32 session_type;
+    r3e_int32 session_iteration;
+    r3e_int32 completed_laps;
+    BOOL lap_clean;
+
+    double lap_start_time;
+    strategy_stat lap_time;
+
+    // Lap time in use, the measured mean or the player's best before there is one, -1.0 = N/A (s)
+    float lap_pace;
+
+    strategy_resource fuel;
+    strategy_resource energy;
+
+    // Where the race stands at the last update: laps into the session
+    // (completed_laps + lap_distance_fraction), laps to go and seconds gone,
+    // -1.0 = N/A
+    r3e_session_length_format length_format;
+    float position;
+    float laps_remaining;
+    float session_elapsed;
+
+    // Minutes in time based sessions, otherwise laps, -1 = N/A
+    r3e_int32 pit_window_start;
+    r3e_int32 pit_window_end;
+} strategy;
+
+void strategy_init(strategy* strat);
+
+// Call once per tick, O(1)
+void strategy_update(strategy* strat, const r3e_shared* frame);
+
+// Fills in the results of plan, O(stops). Returns 0 if the plan gets to the finish
+int strategy_evaluate(const strategy* strat, strategy_plan* plan);
@@ -0,0 +1,88 @@
+#include "subscription.h"
+#include "fields.h"
+
+#include <string.h>
+
+void subscription_init(subscription* sub)
+{
+    memset(sub, 0, sizeof(*sub));
+}
+
+int subscription_add_range(subscription* sub, size_t offset, size_t size)
+{
+    if (size == 0 || offset >= sizeof(r3e_shared) || size > sizeof(r3e_shared) - offset)
+        return 1;
+
+    if (sub->num_requested == SUBSCRIPTION_RANGES_MAX)
+        return 1;
+
+    sub->requested[sub->num_requested].offset = (uint32_t)offset;
+    sub->requested[sub->num_requested].size = (uint32_t)size;
+    sub->num_requested++;
+    sub->built = FALSE;
+
+    return 0;
+}
+
+static int add_field(const field_desc* field, uint32_t offset, void* context)
+{
+    return subscription_add_range((subscription*)context, offset, field->count * field_type_size(field->type));
+}
+
+int subscription_add_field(subscription* sub, const char* name)
+{
+    return fields_match(name, add_field, sub);
+}
+
+void subscription_build(subscription* sub)
+{
+    snapshot_range range;
+    snapshot_range* last;
+    uint32_t end;
+    int i, j;
+
+    memcpy(sub->plan, sub->requested, sub->num_requested * sizeof(snapshot_range));
+
+    // Insertion sort by offset, there are only a handful of ranges
+    for (i = 1; i < sub->num_requested; ++i)
+    {
+        range = sub->plan[i];
+
+        for (j = i; j > 0 && sub->plan[j - 1].offset > range.offset; --j)
+            sub->plan[j] = sub->plan[j - 1];
+
+        sub->plan[j] = range;
+    }
+
+    sub->num_plan = 0;
+    sub->plan_bytes = 0;
+
+    for (i = 0; i < sub->num_requested; ++i)
+    {
+        last = sub->num_plan > 0 ? &sub->plan[sub->num_plan - 1] : NULL;
+        end = sub->plan[i].offset + sub->plan[i].size;
+
+        // Overlapping, touching or close enough to the previous one
+        if (last && sub->plan[i].offset <= last->offset + last->size + SUBSCRIPTION_MERGE_GAP)
+        {
+            if (end > last->offset + last->size)
+                last->size = end - last->offset;
+            continue;
+        }
+
+        sub->plan[sub->num_plan++] = sub->plan[i];
+    }
+
+    for (i = 0; i < sub->num_plan; ++i)
+        sub->plan_bytes += sub->plan[i].size;
+
+    sub->built = TRUE;
+}
+
+int subscription_read(subscription* sub, snapshot_reader* reader, r3e_shared* dest)
+{
+    if (!sub->built)
+        subscription_build(sub);
+
+    return snapshot_read_ranges(reader, dest, sub->plan, sub->num_plan);
+}
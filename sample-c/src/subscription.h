@@ -0,0 +1,51 @@
+#pragma once
+
+#include "r3e.h"
+#include "platform.h"
+#include "snapshot.h"
+
+// Ranges a subscription can hold before and after merging
+#define SUBSCRIPTION_RANGES_MAX 64
+
+// Ranges closer than this are copied as one, copying the bytes in between is
+// cheaper than another memcpy call and they share cache lines anyway
+#define SUBSCRIPTION_MERGE_GAP 64
+
+// The part of r3e_shared a consumer actually reads, e.g. a dashboard that only
+// shows gear, engine_rps, car_speed and the tire temperatures needs ~200 of the
+// ~40 KB. Fields are added by name or by offset, subscription_build sorts and
+// merges them into a copy plan once, and every subscription_read then copies
+// just those bytes inside the same tick guard as snapshot_read.
+// Everything outside the plan is left as it was in dest.
+typedef struct
+{
+    snapshot_range requested[SUBSCRIPTION_RANGES_MAX];
+    int num_requested;
+
+    // Sorted and merged, rebuilt by subscription_build after something was added
+    snapshot_range plan[SUBSCRIPTION_RANGES_MAX];
+    int num_plan;
+    BOOL built;
+
+    // Bytes copied per read
+    uint32_t plan_bytes;
+} subscription;
+
+void subscription_init(subscription* sub);
+
+// Adds the byte range [offset, offset + size) of r3e_shared, returns 0 on success
+// Example: subscription_add_range(&sub, SNAPSHOT_FIELD(tire_temp));
+int subscription_add_range(subscription* sub, size_t offset, size_t size);
+
+// Adds a field by its name in fields.h: "gear", "player.position.x" or
+// "all_drivers_data_1[3].place". A name that is the start of a nested struct
+// or array of structs adds all of it, e.g. "tire_temp" or "player.velocity".
+// Returns 0 on success, 1 if nothing matched or the subscription is full
+int subscription_add_field(subscription* sub, const char* name);
+
+// Sorts and merges the requested ranges into the copy plan
+void subscription_build(subscription* sub);
+
+// Copies the subscribed ranges into dest, building the plan first if needed
+// Returns 0 on a consistent copy, 1 if every attempt was torn
+int subscription_read(subscription* sub, snapshot_reader* reader, r3e_shared* dest);
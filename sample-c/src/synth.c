@@ -0,0 +1,480 @@
+#define _USE_MATH_DEFINES
+
+#include "synth.h"
+#include "platform.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TICK_DT (1.0 / 400.0)
+
+#define LAYOUT_LENGTH 5000.0f
+#define GRID_SPACING 8.0f
+#define PIT_SPEED 22.0f
+#define PIT_STOP_SEC 20.0f
+#define PIT_IN_FRACTION 0.93f
+#define PIT_OUT_FRACTION 0.05f
+#define SESSION_SEC 3600.0f
+#define NUM_CLASSES 3
+#define FUEL_CAPACITY 100.0f
+
+static uint32_t next_random(uint32_t* seed)
+{
+    // xorshift32
+    uint32_t x = *seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *seed = x;
+    return x;
+}
+
+static float random_unit(uint32_t* seed)
+{
+    return (float)(next_random(seed) & 0xffffff) / (float)0x1000000;
+}
+
+static r3e_int32 completed_laps(const synth_state* state, int slot)
+{
+    double laps = floor(state->distance[slot] / state->layout_length);
+    return laps < 0 ? 0 : (r3e_int32)laps;
+}
+
+static float lap_fraction(const synth_state* state, int slot)
+{
+    double fraction = fmod(state->distance[slot], state->layout_length) / state->layout_length;
+    return (float)(fraction < 0 ? fraction + 1.0 : fraction);
+}
+
+static int track_sector(const synth_state* state, float fraction)
+{
+    if (fraction >= state->sector_starts.sector3)
+        return 3;
+    if (fraction >= state->sector_starts.sector2)
+        return 2;
+    return 1;
+}
+
+static int in_pitlane(const synth_state* state, int slot)
+{
+    r3e_int32 laps = completed_laps(state, slot);
+    float fraction = lap_fraction(state, slot);
+
+    if (state->pit_timer[slot] > 0.f)
+        return 1;
+    if ((laps + 1) % state->pit_every[slot] == 0 && fraction > PIT_IN_FRACTION)
+        return 1;
+    if (laps > 0 && laps % state->pit_every[slot] == 0 && fraction < PIT_OUT_FRACTION)
+        return 1;
+    return 0;
+}
+
+// World position of a point on the layout, a wobbly loop of roughly layout_length
+static void track_point(const synth_state* state, float fraction, double* x, double* y, double* z)
+{
+    double angle = 2.0 * M_PI * fraction;
+    double radius = state->layout_length / (2.0 * M_PI) * (1.0 + 0.15 * sin(3.0 * angle));
+
+    *x = radius * cos(angle);
+    *y = 5.0 * sin(angle);
+    *z = radius * sin(angle);
+}
+
+static float target_speed(const synth_state* state, int slot, float fraction)
+{
+    // Four corners per lap shared by everyone, plus a little per car noise
+    return state->pace[slot] * (1.0f + 0.18f * (float)sin(8.0 * M_PI * fraction)) +
+        0.5f * (float)sin(state->time * 0.3 + slot);
+}
+
+static void sort_places(synth_state* state)
+{
+    // Places change rarely between ticks, so insertion sort is close to linear
+    int i, j;
+    r3e_int32 slot;
+
+    for (i = 1; i < state->num_cars; ++i)
+    {
+        slot = state->order[i];
+        for (j = i; j > 0 && state->distance[state->order[j - 1]] < state->distance[slot]; --j)
+            state->order[j] = state->order[j - 1];
+        state->order[j] = slot;
+    }
+}
+
+void synth_init(synth_state* state, int num_cars, uint32_t seed)
+{
+    int i, j;
+
+    memset(state, 0, sizeof(*state));
+
+    if (num_cars < 1)
+        num_cars = 1;
+    if (num_cars > R3E_NUM_DRIVERS_MAX)
+        num_cars = R3E_NUM_DRIVERS_MAX;
+
+    state->num_cars = num_cars;
+    state->seed = seed != 0 ? seed : 1;
+    state->layout_length = LAYOUT_LENGTH;
+    state->sector_starts.sector1 = 0.0f;
+    state->sector_starts.sector2 = 0.34f;
+    state->sector_starts.sector3 = 0.71f;
+
+    for (i = 0; i < num_cars; ++i)
+    {
+        // Grid in slot order, leader at the front
+        state->distance[i] = (num_cars - i) * GRID_SPACING;
+        state->pace[i] = 52.0f + 6.0f * random_unit(&state->seed);
+        state->pit_every[i] = 12 + (r3e_int32)(next_random(&state->seed) % 8);
+        state->order[i] = i;
+
+        for (j = 0; j < 3; ++j)
+        {
+            state->sector_times[i][j] = -1.0f;
+            state->sector_times_previous[i][j] = -1.0f;
+            state->sector_times_best[i][j] = -1.0f;
+        }
+    }
+
+    state->fuel_left = 60.0f;
+    state->fuel_per_lap = 2.4f + 0.2f * random_unit(&state->seed);
+
+    for (i = 0; i < R3E_TIRE_INDEX_MAX; ++i)
+        state->tire_wear[i] = 1.0f;
+}
+
+void synth_step(synth_state* state)
+{
+    int slot, sector_before, sector_after;
+    r3e_int32 laps_before;
+    float fraction, speed, lap_time;
+    int pitting;
+
+    state->tick++;
+    state->time += TICK_DT;
+
+    for (slot = 0; slot < state->num_cars; ++slot)
+    {
+        if (state->pit_timer[slot] > 0.f)
+        {
+            state->pit_timer[slot] -= (float)TICK_DT;
+            state->speed[slot] = 0.f;
+            continue;
+        }
+
+        fraction = lap_fraction(state, slot);
+        pitting = in_pitlane(state, slot);
+        speed = pitting ? PIT_SPEED : target_speed(state, slot, fraction);
+
+        laps_before = completed_laps(state, slot);
+        sector_before = track_sector(state, fraction);
+
+        state->speed[slot] = speed;
+        state->distance[slot] += speed * TICK_DT;
+
+        if (slot == 0)
+        {
+            state->fuel_left -= state->fuel_per_lap * speed * (float)TICK_DT / state->layout_length;
+            if (state->fuel_left < 0.f)
+                state->fuel_left = 0.f;
+
+            state->tire_wear[0] -= 0.004f * speed * (float)TICK_DT / state->layout_length;
+            state->tire_wear[1] -= 0.005f * speed * (float)TICK_DT / state->layout_length;
+            state->tire_wear[2] -= 0.003f * speed * (float)TICK_DT / state->layout_length;
+            state->tire_wear[3] -= 0.0035f * speed * (float)TICK_DT / state->layout_length;
+        }
+
+        sector_after = track_sector(state, lap_fraction(state, slot));
+        lap_time = (float)(state->time - state->lap_start_time[slot]);
+
+        // Sector times are cumulative, the last one is the lap time
+        if (completed_laps(state, slot) != laps_before)
+        {
+            state->sector_times[slot][2] = lap_time;
+            memcpy(state->sector_times_previous[slot], state->sector_times[slot], sizeof(state->sector_times[slot]));
+
+            if (state->sector_times_best[slot][2] < 0.f || lap_time < state->sector_times_best[slot][2])
+                memcpy(state->sector_times_best[slot], state->sector_times[slot], sizeof(state->sector_times[slot]));
+
+            state->sector_times[slot][0] = -1.0f;
+            state->sector_times[slot][1] = -1.0f;
+            state->sector_times[slot][2] = -1.0f;
+            state->lap_start_time[slot] = (float)state->time;
+
+            // Crossed the line on an in-lap, stop at the pit box
+            if (pitting)
+            {
+                state->pit_timer[slot] = PIT_STOP_SEC;
+                state->num_pitstops[slot]++;
+
+                if (slot == 0)
+                {
+                    state->fuel_left = FUEL_CAPACITY * 0.9f;
+                    state->tire_wear[0] = state->tire_wear[1] = state->tire_wear[2] = state->tire_wear[3] = 1.0f;
+                }
+            }
+        }
+        else if (sector_after != sector_before)
+        {
+            state->sector_times[slot][sector_before - 1] = lap_time;
+        }
+    }
+
+    sort_places(state);
+}
+
+void synth_write_static(const synth_state* state, r3e_shared* frame)
+{
+    int i;
+
+    frame->version_major = R3E_VERSION_MAJOR;
+    frame->version_minor = R3E_VERSION_MINOR;
+    frame->all_drivers_offset = (r3e_int32)offsetof(r3e_shared, num_cars);
+    frame->driver_data_size = (r3e_int32)sizeof(r3e_driver_data);
+
+    frame->game_mode = R3E_GAMEMODE_SINGLERACE;
+
+    snprintf((char*)frame->track_name, sizeof(frame->track_name), "Synthetic Ring");
+    snprintf((char*)frame->layout_name, sizeof(frame->layout_name), "Full %u", (unsigned)state->num_cars);
+    snprintf((char*)frame->player_name, sizeof(frame->player_name), "Driver 1");
+    frame->track_id = 9000;
+    frame->layout_id = 9001;
+    frame->layout_length = state->layout_length;
+    frame->sector_start_factors = state->sector_starts;
+
+    for (i = 0; i < 3; ++i)
+    {
+        frame->race_session_laps[i] = -1;
+        frame->race_session_minutes[i] = i == 0 ? (r3e_int32)(SESSION_SEC / 60) : -1;
+    }
+
+    frame->event_index = -1;
+    frame->session_type = R3E_SESSION_RACE;
+    frame->session_iteration = 1;
+    frame->session_length_format = R3E_SESSION_LENGTH_TIME_BASED;
+    frame->session_pit_speed_limit = PIT_SPEED;
+    frame->tire_wear_active = 1;
+    frame->fuel_use_active = 1;
+    frame->number_of_laps = -1;
+    frame->session_time_duration = SESSION_SEC;
+    frame->max_incident_points = -1;
+
+    frame->pit_window_start = 10;
+    frame->pit_window_end = 30;
+
+    frame->control_type = R3E_CONTROL_PLAYER;
+    frame->max_engine_rps = 900.0f;
+    frame->upshift_rps = 850.0f;
+    frame->num_gears = 6;
+    frame->fuel_capacity = FUEL_CAPACITY;
+    frame->virtual_energy_left = -1.0f;
+    frame->virtual_energy_capacity = -1.0f;
+    frame->virtual_energy_per_lap = -1.0f;
+
+    for (i = 0; i < R3E_TIRE_INDEX_MAX; ++i)
+    {
+        frame->tire_temp[i].optimal_temp = 85.0f;
+        frame->tire_temp[i].cold_temp = 70.0f;
+        frame->tire_temp[i].hot_temp = 100.0f;
+        frame->brake_temp[i].optimal_temp = 500.0f;
+        frame->brake_temp[i].cold_temp = 250.0f;
+        frame->brake_temp[i].hot_temp = 750.0f;
+        frame->tire_on_mtrl[i] = R3E_MTRL_TYPE_TARMAC;
+    }
+}
+
+void synth_write_player(const synth_state* state, r3e_shared* frame)
+{
+    r3e_playerdata* player = &frame->player;
+    float fraction = lap_fraction(state, 0);
+    float speed = state->speed[0];
+    double x, y, z, ahead_x, ahead_y, ahead_z, length;
+    double t = state->time;
+    int i, place = 1;
+
+    for (i = 0; i < state->num_cars; ++i)
+    {
+        if (state->order[i] == 0)
+            place = i + 1;
+    }
+
+    frame->game_paused = 0;
+    frame->game_in_menus = 0;
+
+    player->game_simulation_ticks = state->tick;
+    player->game_simulation_time = t;
+
+    track_point(state, fraction, &x, &y, &z);
+    track_point(state, fraction + 0.0005f, &ahead_x, &ahead_y, &ahead_z);
+    length = sqrt((ahead_x - x) * (ahead_x - x) + (ahead_y - y) * (ahead_y - y) + (ahead_z - z) * (ahead_z - z));
+    if (length <= 0.0)
+        length = 1.0;
+
+    player->position.x = x;
+    player->position.y = y;
+    player->position.z = z;
+    player->velocity.x = (ahead_x - x) / length * speed;
+    player->velocity.y = (ahead_y - y) / length * speed;
+    player->velocity.z = (ahead_z - z) / length * speed;
+    player->local_velocity.x = 0.0;
+    player->local_velocity.y = 0.0;
+    player->local_velocity.z = -speed;
+    player->local_g_force.x = 1.6 * sin(8.0 * M_PI * fraction);
+    player->local_g_force.y = 1.0 + 0.05 * sin(t * 31.0);
+    player->local_g_force.z = 0.9 * cos(8.0 * M_PI * fraction);
+
+    for (i = 0; i < R3E_TIRE_INDEX_MAX; ++i)
+    {
+        player->suspension_deflection[i] = 0.03 + 0.01 * sin(t * 7.0 + i);
+        player->suspension_velocity[i] = 0.07 * cos(t * 7.0 + i) + 0.02 * sin(t * 97.0 + i);
+        player->ride_height[i] = 0.05 + 0.01 * sin(t * 7.0 + i);
+    }
+
+    frame->session_phase = R3E_SESSION_PHASE_GREEN;
+    frame->start_lights = 6;
+    frame->session_time_remaining = (float)(SESSION_SEC - t) > 0.f ? (float)(SESSION_SEC - t) : 0.f;
+    frame->pit_window_status = t < frame->pit_window_start * 60 ? R3E_PIT_WINDOW_CLOSED :
+        t < frame->pit_window_end * 60 ? R3E_PIT_WINDOW_OPEN : R3E_PIT_WINDOW_COMPLETED;
+    frame->in_pitlane = in_pitlane(state, 0);
+    frame->pit_state = state->pit_timer[0] > 0.f ? 3 : frame->in_pitlane ? 2 : 0;
+    frame->num_pitstops = state->num_pitstops[0];
+
+    frame->flags.green = 1;
+    frame->flags.sector_yellow[0] = frame->flags.sector_yellow[1] = frame->flags.sector_yellow[2] = 0;
+    frame->flags.closest_yellow_distance_into_track = -1.0f;
+
+    frame->position = place;
+    frame->position_class = place;
+    frame->completed_laps = completed_laps(state, 0);
+    frame->current_lap_valid = 1;
+    frame->track_sector = track_sector(state, fraction);
+    frame->lap_distance = fraction * state->layout_length;
+    frame->lap_distance_fraction = fraction;
+    frame->lap_time_current_self = (float)(t - state->lap_start_time[0]);
+    frame->lap_time_previous_self = state->sector_times_previous[0][2];
+    frame->lap_time_best_self = state->sector_times_best[0][2];
+    memcpy(frame->sector_time_current_self, state->sector_times[0], sizeof(frame->sector_time_current_self));
+    memcpy(frame->sector_time_previous_self, state->sector_times_previous[0], sizeof(frame->sector_time_previous_self));
+    memcpy(frame->sector_time_best_self, state->sector_times_best[0], sizeof(frame->sector_time_best_self));
+
+    frame->car_speed = speed;
+    frame->gear = speed < 0.5f ? 0 : 1 + (r3e_int32)(speed / 13.0f);
+    if (frame->gear > frame->num_gears)
+        frame->gear = frame->num_gears;
+    frame->engine_rps = frame->gear == 0 ? 100.0f : 350.0f + 500.0f * (float)fmod(speed, 13.0f) / 13.0f;
+    frame->throttle = speed > 0.f ? 0.5f + 0.5f * (float)cos(8.0 * M_PI * fraction) : 0.f;
+    frame->brake = 1.0f - frame->throttle > 0.6f ? 1.0f - frame->throttle : 0.f;
+    frame->clutch = 0.f;
+    frame->fuel_left = state->fuel_left;
+    frame->fuel_per_lap = state->fuel_per_lap;
+    frame->engine_temp = 90.0f + 3.0f * (float)sin(t * 0.01);
+
+    for (i = 0; i < R3E_TIRE_INDEX_MAX; ++i)
+    {
+        frame->tire_rps[i] = speed / 0.33f;
+        frame->tire_speed[i] = speed;
+        frame->tire_grip[i] = 1.0f;
+        frame->tire_wear[i] = state->tire_wear[i];
+        frame->tire_pressure[i] = 175.0f + 8.0f * (float)sin(t * 0.02 + i);
+        frame->tire_temp[i].current_temp[R3E_TIRE_TEMP_LEFT] = 82.0f + 9.0f * (float)sin(t * 0.5 + i) + 2.0f * i;
+        frame->tire_temp[i].current_temp[R3E_TIRE_TEMP_CENTER] = 85.0f + 9.0f * (float)sin(t * 0.5 + i + 0.3);
+        frame->tire_temp[i].current_temp[R3E_TIRE_TEMP_RIGHT] = 88.0f + 9.0f * (float)sin(t * 0.5 + i + 0.6) - 2.0f * i;
+        frame->brake_temp[i].current_temp = 450.0f + 250.0f * (float)sin(8.0 * M_PI * fraction + i);
+        frame->brake_pressure[i] = frame->brake * 40.0f;
+        frame->tire_load[i] = 4000.0f + 1500.0f * (float)player->local_g_force.x * (i % 2 == 0 ? 1.0f : -1.0f);
+    }
+}
+
+void synth_write_drivers(const synth_state* state, r3e_shared* frame, int first, int count)
+{
+    r3e_driver_data* driver;
+    int place, slot, front, behind, class_place, i;
+    float fraction;
+    double x, y, z;
+
+    frame->num_cars = state->num_cars;
+
+    if (first + count > state->num_cars)
+        count = state->num_cars - first;
+
+    for (place = first; place < first + count; ++place)
+    {
+        slot = state->order[place];
+        driver = &frame->all_drivers_data_1[place];
+        fraction = lap_fraction(state, slot);
+
+        class_place = 1;
+        for (i = 0; i < place; ++i)
+        {
+            if (state->order[i] % NUM_CLASSES == slot % NUM_CLASSES)
+                class_place++;
+        }
+
+        snprintf((char*)driver->driver_info.name, sizeof(driver->driver_info.name), "Driver %d", slot + 1);
+        driver->driver_info.car_number = slot + 1;
+        driver->driver_info.class_id = 100 + slot % NUM_CLASSES;
+        driver->driver_info.model_id = 200 + slot % 7;
+        driver->driver_info.team_id = 300 + slot / 2;
+        driver->driver_info.livery_id = 400 + slot;
+        driver->driver_info.manufacturer_id = 500 + slot % 5;
+        driver->driver_info.user_id = -1;
+        driver->driver_info.slot_id = slot;
+        driver->driver_info.class_performance_index = slot % NUM_CLASSES;
+        driver->driver_info.engine_type = R3E_ENGINE_TYPE_COMBUSTION;
+        driver->driver_info.car_width = 1.9f;
+        driver->driver_info.car_length = 4.6f;
+
+        driver->finish_status = R3E_FINISH_STATUS_NONE;
+        driver->place = place + 1;
+        driver->place_class = class_place;
+        driver->lap_distance = fraction * state->layout_length;
+        driver->lap_distance_fraction = fraction;
+
+        track_point(state, fraction, &x, &y, &z);
+        driver->position.x = (float)x;
+        driver->position.y = (float)y;
+        driver->position.z = (float)z;
+
+        driver->track_sector = track_sector(state, fraction);
+        driver->completed_laps = completed_laps(state, slot);
+        driver->current_lap_valid = 1;
+        driver->lap_time_current_self = (float)(state->time - state->lap_start_time[slot]);
+        memcpy(driver->sector_time_current_self, state->sector_times[slot], sizeof(driver->sector_time_current_self));
+        memcpy(driver->sector_time_previous_self, state->sector_times_previous[slot], sizeof(driver->sector_time_previous_self));
+        memcpy(driver->sector_time_best_self, state->sector_times_best[slot], sizeof(driver->sector_time_best_self));
+
+        front = place > 0 ? state->order[place - 1] : -1;
+        behind = place + 1 < state->num_cars ? state->order[place + 1] : -1;
+        driver->time_delta_front = front < 0 ? -1.0f : (float)((state->distance[front] - state->distance[slot]) / state->pace[slot]);
+        driver->time_delta_behind = behind < 0 ? -1.0f : (float)((state->distance[slot] - state->distance[behind]) / state->pace[behind]);
+
+        driver->pitstop_status = R3E_PITSTOP_STATUS_UNAVAILABLE;
+        driver->in_pitlane = in_pitlane(state, slot);
+        driver->num_pitstops = state->num_pitstops[slot];
+        driver->penalties.drive_through = -1.0f;
+        driver->penalties.stop_and_go = -1.0f;
+        driver->penalties.pit_stop = -1.0f;
+        driver->penalties.time_deduction = -1.0f;
+        driver->penalties.slow_down = -1.0f;
+        driver->car_speed = state->speed[slot];
+        driver->tire_type_front = R3E_TIRE_TYPE_PRIME;
+        driver->tire_type_rear = R3E_TIRE_TYPE_PRIME;
+        driver->tire_subtype_front = state->num_pitstops[slot] % 2 == 0 ? R3E_TIRE_SUBTYPE_MEDIUM : R3E_TIRE_SUBTYPE_HARD;
+        driver->tire_subtype_rear = driver->tire_subtype_front;
+        driver->drs_state = -1;
+        driver->ptp_state = -1;
+        driver->virtual_energy = -1.0f;
+        driver->penaltyType = -1;
+        driver->penaltyReason = -1;
+        driver->engineState = 3;
+    }
+}
+
+void synth_write(const synth_state* state, r3e_shared* frame)
+{
+    synth_write_static(state, frame);
+    synth_write_player(state, frame);
+    synth_write_drivers(state, frame, 0, state->num_cars);
+}
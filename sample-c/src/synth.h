@@ -0,0 +1,56 @@
+#pragma once
+
+#include "r3e.h"
+
+// Synthetic race used to feed consumers without a running game.
+// Cars drive around a closed layout of layout_length meters at individual
+// pace, pit every few laps and fill in the r3e_shared fields a consumer would
+// look at. Runs are deterministic for a given seed and car count.
+typedef struct
+{
+    int num_cars;
+    uint32_t seed;
+
+    r3e_int32 tick;
+    double time;
+
+    float layout_length;
+    r3e_sectorStarts sector_starts;
+
+    // Per car, indexed by slot id
+    double distance[R3E_NUM_DRIVERS_MAX];
+    float pace[R3E_NUM_DRIVERS_MAX];
+    float speed[R3E_NUM_DRIVERS_MAX];
+    float lap_start_time[R3E_NUM_DRIVERS_MAX];
+    float sector_times[R3E_NUM_DRIVERS_MAX][3];
+    float sector_times_previous[R3E_NUM_DRIVERS_MAX][3];
+    float sector_times_best[R3E_NUM_DRIVERS_MAX][3];
+    r3e_int32 pit_every[R3E_NUM_DRIVERS_MAX];
+    r3e_int32 num_pitstops[R3E_NUM_DRIVERS_MAX];
+    float pit_timer[R3E_NUM_DRIVERS_MAX];
+
+    // Slot ids in place order
+    r3e_int32 order[R3E_NUM_DRIVERS_MAX];
+
+    // Player car (slot 0)
+    float fuel_left;
+    float fuel_per_lap;
+    float tire_wear[R3E_TIRE_INDEX_MAX];
+} synth_state;
+
+void synth_init(synth_state* state, int num_cars, uint32_t seed);
+
+// Advances the race by one physics tick (1/400th of a second)
+void synth_step(synth_state* state);
+
+// Fills everything that doesn't change during a session (version, names, layout, etc.)
+void synth_write_static(const synth_state* state, r3e_shared* frame);
+
+// Fills everything up to num_cars, including player.game_simulation_ticks
+void synth_write_player(const synth_state* state, r3e_shared* frame);
+
+// Fills all_drivers_data_1[first, first + count) and num_cars
+void synth_write_drivers(const synth_state* state, r3e_shared* frame, int first, int count);
+
+// synth_write_static + synth_write_player + synth_write_drivers for all cars
+void synth_write(const synth_state* state, r3e_shared* frame);
@@ -0,0 +1,308 @@
+#include "thermal.h"
+#include "tickwait.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#if PLATFORM_AVX2
+#include <immintrin.h>
+#elif PLATFORM_SSE2
+#include <emmintrin.h>
+#endif
+
+static void reset(thermal* th, const r3e_shared* frame)
+{
+    int i;
+
+    memset(th, 0, sizeof(*th));
+
+    th->session_type = frame ? frame->session_type : -1;
+    th->session_iteration = frame ? frame->session_iteration : -1;
+    th->last_ticks = -1;
+    th->stint_start = -1.f;
+    th->position = -1.f;
+
+    for (i = 0; i < THERMAL_LANES; ++i)
+    {
+        th->input[i] = -1.f;
+        th->cold[i] = -FLT_MAX;
+        th->hot[i] = FLT_MAX;
+        th->peak[i] = -1.f;
+    }
+
+    for (i = 0; i < R3E_TIRE_INDEX_MAX; ++i)
+    {
+        th->wear[i] = -1.f;
+        th->stint_wear[i] = -1.f;
+        th->wear_per_lap[i] = -1.f;
+    }
+}
+
+void thermal_init(thermal* th)
+{
+    reset(th, NULL);
+}
+
+// A window the game doesn't give (-1.0) is left open
+static void set_window(thermal* th, int lane, float cold, float hot)
+{
+    th->cold[lane] = cold != -1.f ? cold : -FLT_MAX;
+    th->hot[lane] = hot != -1.f ? hot : FLT_MAX;
+}
+
+// Readings and windows into the lanes, pressures and loads keep the open window reset gave them
+static void gather(thermal* th, const r3e_shared* frame)
+{
+    const r3e_float32* zones;
+    int corner, zone, lane;
+    float sum;
+
+    for (corner = 0; corner < R3E_TIRE_INDEX_MAX; ++corner)
+    {
+        zones = frame->tire_temp[corner].current_temp;
+        sum = 0.f;
+
+        for (zone = 0; zone < R3E_TIRE_TEMP_INDEX_MAX; ++zone)
+        {
+            lane = THERMAL_TIRE_ZONE + corner * R3E_TIRE_TEMP_INDEX_MAX + zone;
+            th->input[lane] = zones[zone];
+            set_window(th, lane, frame->tire_temp[corner].cold_temp, frame->tire_temp[corner].hot_temp);
+            sum += zones[zone];
+        }
+
+        lane = THERMAL_TIRE + corner;
+        th->input[lane] = zones[0] != -1.f && zones[1] != -1.f && zones[2] != -1.f ? sum / 3.f : -1.f;
+        set_window(th, lane, frame->tire_temp[corner].cold_temp, frame->tire_temp[corner].hot_temp);
+
+        lane = THERMAL_BRAKE + corner;
+        th->input[lane] = frame->brake_temp[corner].current_temp;
+        set_window(th, lane, frame->brake_temp[corner].cold_temp, frame->brake_temp[corner].hot_temp);
+
+        th->input[THERMAL_PRESSURE + corner] = frame->tire_pressure[corner];
+        th->input[THERMAL_LOAD + corner] = frame->tire_load[corner];
+    }
+}
+
+// Smooths every lane with rate and adds ticks to the window it is in,
+// masked by whether the lane has a reading
+#if PLATFORM_AVX2
+
+static void update_lanes(thermal* th, float rate, uint32_t ticks)
+{
+    __m256 na = _mm256_set1_ps(-1.f);
+    __m256 one = _mm256_set1_ps(1.f);
+    __m256 smoothing = _mm256_set1_ps(rate);
+    __m256i elapsed = _mm256_set1_epi32((int)ticks);
+    __m256 input, value, seen, valid, weight, cold, hot, inside;
+    __m256i* ticks_cold;
+    __m256i* ticks_in;
+    __m256i* ticks_hot;
+    int i;
+
+    for (i = 0; i < THERMAL_LANES; i += 8)
+    {
+        input = _mm256_load_ps(th->input + i);
+        value = _mm256_load_ps(th->value + i);
+        seen = _mm256_castsi256_ps(_mm256_load_si256((const __m256i*)(th->seen + i)));
+        valid = _mm256_cmp_ps(input, na, _CMP_NEQ_OQ);
+
+        // A lane's first reading is taken as it is
+        weight = _mm256_blendv_ps(one, smoothing, seen);
+        value = _mm256_blendv_ps(value, _mm256_add_ps(value, _mm256_mul_ps(weight, _mm256_sub_ps(input, value))), valid);
+
+        _mm256_store_ps(th->value + i, value);
+        _mm256_store_ps(th->peak + i, _mm256_blendv_ps(_mm256_load_ps(th->peak + i),
+            _mm256_max_ps(_mm256_load_ps(th->peak + i), value), valid));
+        _mm256_store_si256((__m256i*)(th->seen + i), _mm256_castps_si256(_mm256_or_ps(seen, valid)));
+
+        cold = _mm256_and_ps(valid, _mm256_cmp_ps(value, _mm256_load_ps(th->cold + i), _CMP_LT_OQ));
+        hot = _mm256_and_ps(valid, _mm256_cmp_ps(value, _mm256_load_ps(th->hot + i), _CMP_GT_OQ));
+        inside = _mm256_andnot_ps(_mm256_or_ps(cold, hot), valid);
+
+        ticks_cold = (__m256i*)(th->ticks_cold + i);
+        ticks_in = (__m256i*)(th->ticks_in + i);
+        ticks_hot = (__m256i*)(th->ticks_hot + i);
+        _mm256_store_si256(ticks_cold, _mm256_add_epi32(_mm256_load_si256(ticks_cold),
+            _mm256_and_si256(_mm256_castps_si256(cold), elapsed)));
+        _mm256_store_si256(ticks_in, _mm256_add_epi32(_mm256_load_si256(ticks_in),
+            _mm256_and_si256(_mm256_castps_si256(inside), elapsed)));
+        _mm256_store_si256(ticks_hot, _mm256_add_epi32(_mm256_load_si256(ticks_hot),
+            _mm256_and_si256(_mm256_castps_si256(hot), elapsed)));
+    }
+}
+
+#elif PLATFORM_SSE2
+
+// SSE2 has no blendv
+static __m128 select_ps(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static void update_lanes(thermal* th, float rate, uint32_t ticks)
+{
+    __m128 na = _mm_set1_ps(-1.f);
+    __m128 one = _mm_set1_ps(1.f);
+    __m128 smoothing = _mm_set1_ps(rate);
+    __m128i elapsed = _mm_set1_epi32((int)ticks);
+    __m128 input, value, seen, valid, weight, cold, hot, inside;
+    __m128i* ticks_cold;
+    __m128i* ticks_in;
+    __m128i* ticks_hot;
+    int i;
+
+    for (i = 0; i < THERMAL_LANES; i += 4)
+    {
+        input = _mm_load_ps(th->input + i);
+        value = _mm_load_ps(th->value + i);
+        seen = _mm_castsi128_ps(_mm_load_si128((const __m128i*)(th->seen + i)));
+        valid = _mm_cmpneq_ps(input, na);
+
+        // cmpneq is also true for NaN, which no reading should be
+        valid = _mm_and_ps(valid, _mm_cmpord_ps(input, input));
+
+        // A lane's first reading is taken as it is
+        weight = select_ps(seen, smoothing, one);
+        value = select_ps(valid, _mm_add_ps(value, _mm_mul_ps(weight, _mm_sub_ps(input, value))), value);
+
+        _mm_store_ps(th->value + i, value);
+        _mm_store_ps(th->peak + i, select_ps(valid, _mm_max_ps(_mm_load_ps(th->peak + i), value), _mm_load_ps(th->peak + i)));
+        _mm_store_si128((__m128i*)(th->seen + i), _mm_castps_si128(_mm_or_ps(seen, valid)));
+
+        cold = _mm_and_ps(valid, _mm_cmplt_ps(value, _mm_load_ps(th->cold + i)));
+        hot = _mm_and_ps(valid, _mm_cmpgt_ps(value, _mm_load_ps(th->hot + i)));
+        inside = _mm_andnot_ps(_mm_or_ps(cold, hot), valid);
+
+        ticks_cold = (__m128i*)(th->ticks_cold + i);
+        ticks_in = (__m128i*)(th->ticks_in + i);
+        ticks_hot = (__m128i*)(th->ticks_hot + i);
+        _mm_store_si128(ticks_cold, _mm_add_epi32(_mm_load_si128(ticks_cold), _mm_and_si128(_mm_castps_si128(cold), elapsed)));
+        _mm_store_si128(ticks_in, _mm_add_epi32(_mm_load_si128(ticks_in), _mm_and_si128(_mm_castps_si128(inside), elapsed)));
+        _mm_store_si128(ticks_hot, _mm_add_epi32(_mm_load_si128(ticks_hot), _mm_and_si128(_mm_castps_si128(hot), elapsed)));
+    }
+}
+
+#else
+
+static void update_lanes(thermal* th, float rate, uint32_t ticks)
+{
+    float input;
+    int i;
+
+    for (i = 0; i < THERMAL_LANES; ++i)
+    {
+        input = th->input[i];
+        if (input == -1.f || input != input)
+            continue;
+
+        th->value[i] += (th->seen[i] ? rate : 1.f) * (input - th->value[i]);
+        th->seen[i] = 0xFFFFFFFFu;
+
+        if (th->value[i] > th->peak[i])
+            th->peak[i] = th->value[i];
+
+        if (th->value[i] < th->cold[i])
+            th->ticks_cold[i] += ticks;
+        else if (th->value[i] > th->hot[i])
+            th->ticks_hot[i] += ticks;
+        else
+            th->ticks_in[i] += ticks;
+    }
+}
+
+#endif
+
+// Wear per corner over the stint, which starts over on a tire change or when the position goes back
+static void update_wear(thermal* th, const r3e_shared* frame, float position)
+{
+    BOOL available = frame->tire_wear_active != 0 && position >= 0.f;
+    BOOL new_stint = th->stint_start < 0.f || position < th->position;
+    int i;
+
+    for (i = 0; i < R3E_TIRE_INDEX_MAX; ++i)
+    {
+        if (frame->tire_wear[i] < 0.f)
+            available = FALSE;
+        else if (th->wear[i] >= 0.f && frame->tire_wear[i] > th->wear[i])
+            new_stint = TRUE;
+    }
+
+    th->position = position;
+
+    if (!available)
+    {
+        for (i = 0; i < R3E_TIRE_INDEX_MAX; ++i)
+        {
+            th->wear[i] = -1.f;
+            th->wear_per_lap[i] = -1.f;
+        }
+        th->stint_start = -1.f;
+        return;
+    }
+
+    if (new_stint)
+    {
+        th->stint_start = position;
+        for (i = 0; i < R3E_TIRE_INDEX_MAX; ++i)
+            th->stint_wear[i] = frame->tire_wear[i];
+    }
+
+    for (i = 0; i < R3E_TIRE_INDEX_MAX; ++i)
+    {
+        th->wear[i] = frame->tire_wear[i];
+        th->wear_per_lap[i] = position - th->stint_start >= THERMAL_WEAR_LAPS_MIN ?
+            (th->stint_wear[i] - th->wear[i]) / (position - th->stint_start) : -1.f;
+    }
+}
+
+void thermal_update(thermal* th, const r3e_shared* frame)
+{
+    r3e_int32 elapsed;
+    float position = -1.f;
+    float rate;
+
+    if (frame->session_type != th->session_type || frame->session_iteration != th->session_iteration)
+        reset(th, frame);
+
+    elapsed = th->last_ticks >= 0 ? frame->player.game_simulation_ticks - th->last_ticks : 0;
+
+    // Paused or restarted: nothing to count. A gap counts for at most a second
+    if (elapsed < 0)
+        elapsed = 0;
+    if (elapsed > TICK_RATE_HZ)
+        elapsed = TICK_RATE_HZ;
+
+    th->last_ticks = frame->player.game_simulation_ticks;
+    rate = (float)(1.0 - exp(-elapsed / (TICK_RATE_HZ * THERMAL_TIME_CONSTANT)));
+
+    gather(th, frame);
+    update_lanes(th, rate, (uint32_t)elapsed);
+
+    if (frame->completed_laps >= 0 && frame->lap_distance_fraction >= 0.f)
+        position = (float)frame->completed_laps + frame->lap_distance_fraction;
+
+    update_wear(th, frame, position);
+}
+
+float thermal_in_window(const thermal* th, int lane)
+{
+    uint32_t total;
+
+    if (lane < 0 || lane >= THERMAL_LANES)
+        return -1.f;
+
+    total = th->ticks_cold[lane] + th->ticks_in[lane] + th->ticks_hot[lane];
+    return total > 0 ? (float)th->ticks_in[lane] / (float)total : -1.f;
+}
+
+float thermal_wear_after(const thermal* th, int corner, float laps)
+{
+    float wear;
+
+    if (corner < 0 || corner >= R3E_TIRE_INDEX_MAX || th->wear_per_lap[corner] < 0.f)
+        return -1.f;
+
+    wear = th->wear[corner] - th->wear_per_lap[corner] * laps;
+    return wear > 0.f ? wear : 0.f;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "r3e.h"
+#include "platform.h"
+
+// Smoothing time constant of the lanes (s)
+#define THERMAL_TIME_CONSTANT 0.5
+
+// Stint distance before a wear rate is given (laps)
+#define THERMAL_WEAR_LAPS_MIN 0.5f
+
+// Lanes of the per tick pass, a multiple of 8 so AVX2 needs no tail
+typedef enum
+{
+    // + corner * 3 + zone (r3e_tire_index_enum, r3e_tire_temp_enum)
+    THERMAL_TIRE_ZONE = 0,
+
+    // + corner, mean of the three zones
+    THERMAL_TIRE = 12,
+
+    // + corner
+    THERMAL_BRAKE = 16,
+    THERMAL_PRESSURE = 20,
+    THERMAL_LOAD = 24,
+
+    THERMAL_LANES_USED = 28,
+    THERMAL_LANES = 32
+} thermal_lane;
+
+// Live tire and brake analysis of the player's car. Every tick the raw
+// readings are gathered into lanes (tire zones, tire corners, brakes,
+// pressures and loads), and one SIMD pass over all of them updates:
+// - value: exponentially smoothed with THERMAL_TIME_CONSTANT
+// - peak: highest smoothed value
+// - ticks_cold/in/hot: time spent below cold_temp, inside the window and
+//   above hot_temp, judged on the smoothed value (pressures and loads have
+//   no window and count as inside)
+// Lanes that read -1.0 (N/A) on a tick are left as they were.
+//
+// Wear is followed per corner over the stint, which starts over when a tire
+// is changed: wear_per_lap is the wear since the stint started over the laps
+// driven since, so projecting to the end of the stint is O(1).
+typedef struct
+{
+    r3e_int32 session_type;
+    r3e_int32 session_iteration;
+
+    // game_simulation_ticks of the last update, -1 before the first
+    r3e_int32 last_ticks;
+
+    // This tick's readings and window, -1.0 = N/A
+    ALIGNED(32) float input[THERMAL_LANES];
+    ALIGNED(32) float cold[THERMAL_LANES];
+    ALIGNED(32) float hot[THERMAL_LANES];
+
+    ALIGNED(32) float value[THERMAL_LANES];
+    ALIGNED(32) float peak[THERMAL_LANES];
+
+    // All bits set once a lane had a reading
+    ALIGNED(32) uint32_t seen[THERMAL_LANES];
+
+    // Unit: Ticks (1 tick = 1/400th of a second)
+    ALIGNED(32) uint32_t ticks_cold[THERMAL_LANES];
+    ALIGNED(32) uint32_t ticks_in[THERMAL_LANES];
+    ALIGNED(32) uint32_t ticks_hot[THERMAL_LANES];
+
+    // Range: 0.0 - 1.0 (-1.0 = N/A)
+    float wear[R3E_TIRE_INDEX_MAX];
+    float stint_wear[R3E_TIRE_INDEX_MAX];
+
+    // -1.0 = N/A
+    float wear_per_lap[R3E_TIRE_INDEX_MAX];
+
+    // Laps into the session (completed_laps + lap_distance_fraction), -1.0 = N/A
+    float stint_start;
+    float position;
+} thermal;
+
+void thermal_init(thermal* th);
+
+// Call once per tick, O(1)
+void thermal_update(thermal* th, const r3e_shared* frame);
+
+// Share of time inside the window (0 - 1), -1.0 = N/A
+float thermal_in_window(const thermal* th, int lane);
+
+// Wear of a corner laps from now, e.g. at the end of the stint, -1.0 = N/A
+float thermal_wear_after(const thermal* th, int corner, float laps);
@@ -0,0 +1,130 @@
+#include "tickwait.h"
+#include "platform.h"
+
+#include <string.h>
+
+#define SPIN_US_MIN 100
+#define SPIN_US_MAX TICK_PERIOD_US
+#define SPIN_US_START 1000
+
+// The game may publish less often than every physics tick
+#define PERIOD_US_MAX 100000
+
+// Spinning longer than this before a tick arrives means the window can shrink
+#define SPIN_US_TARGET 250
+
+static r3e_int32 load_ticks(const r3e_shared* source)
+{
+    return *(const volatile r3e_int32*)&source->player.game_simulation_ticks;
+}
+
+void tick_waiter_init(tick_waiter* waiter, const r3e_shared* source)
+{
+    memset(waiter, 0, sizeof(*waiter));
+    waiter->source = source;
+    waiter->last_tick = load_ticks(source);
+    waiter->last_tick_us = time_now_us();
+    waiter->period_us = TICK_PERIOD_US;
+    waiter->spin_us = SPIN_US_START;
+
+    // sleep_ms(1) needs a 1 ms timer resolution to be useful at this rate
+    timer_resolution_begin();
+}
+
+void tick_waiter_close(tick_waiter* waiter)
+{
+    waiter->source = NULL;
+
+    timer_resolution_end();
+}
+
+tick_wait_result tick_wait(tick_waiter* waiter, uint32_t timeout_ms, uint32_t* missed)
+{
+    uint64_t now_us = time_now_us();
+    uint64_t start_us = now_us;
+    uint64_t spin_start_us = 0;
+    uint64_t expected_us = 0;
+    int64_t period_us = 0;
+    r3e_int32 tick = 0;
+    BOOL slept = FALSE;
+
+    if (missed)
+        *missed = 0;
+
+    for (;;)
+    {
+        tick = load_ticks(waiter->source);
+        if (tick != waiter->last_tick)
+            break;
+
+        now_us = time_now_us();
+        if (now_us - start_us >= (uint64_t)timeout_ms * 1000)
+            return TICK_WAIT_TIMEOUT;
+
+        expected_us = waiter->last_tick_us + waiter->period_us;
+
+        // Sleep while the tick is still far away, or when it is long overdue
+        // (game paused, loading, in menus) so we don't spin at 100% CPU
+        if (now_us + waiter->spin_us < expected_us || now_us > expected_us + waiter->period_us)
+        {
+            sleep_ms(1);
+            slept = TRUE;
+            spin_start_us = 0;
+        }
+        else
+        {
+            if (spin_start_us == 0)
+                spin_start_us = now_us;
+
+            platform_cpu_relax();
+            slept = FALSE;
+        }
+    }
+
+    now_us = time_now_us();
+
+    if (slept)
+    {
+        // Woke up too late, start spinning earlier next time
+        waiter->late_wakeups++;
+        waiter->spin_us += TICK_PERIOD_US / 10;
+        if (waiter->spin_us > SPIN_US_MAX)
+            waiter->spin_us = SPIN_US_MAX;
+    }
+    else if (spin_start_us != 0 && now_us - spin_start_us > SPIN_US_TARGET)
+    {
+        // Spun longer than needed, start spinning a bit later next time
+        waiter->spin_us -= waiter->spin_us / 8;
+        if (waiter->spin_us < SPIN_US_MIN)
+            waiter->spin_us = SPIN_US_MIN;
+    }
+
+    if (tick < waiter->last_tick)
+    {
+        waiter->resets++;
+    }
+    else
+    {
+        if (tick - waiter->last_tick > 1)
+        {
+            waiter->ticks_missed += tick - waiter->last_tick - 1;
+
+            if (missed)
+                *missed = tick - waiter->last_tick - 1;
+        }
+
+        period_us = waiter->period_us;
+        period_us += ((int64_t)(now_us - waiter->last_tick_us) - period_us) / 8;
+        if (period_us < TICK_PERIOD_US)
+            period_us = TICK_PERIOD_US;
+        if (period_us > PERIOD_US_MAX)
+            period_us = PERIOD_US_MAX;
+        waiter->period_us = (uint32_t)period_us;
+    }
+
+    waiter->ticks_seen++;
+    waiter->last_tick = tick;
+    waiter->last_tick_us = now_us;
+
+    return TICK_WAIT_OK;
+}
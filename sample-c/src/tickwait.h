@@ -0,0 +1,52 @@
+#pragma once
+
+#include "r3e.h"
+
+// Physics rate, see player.game_simulation_ticks
+#define TICK_RATE_HZ 400
+#define TICK_PERIOD_US (1000000 / TICK_RATE_HZ)
+
+typedef enum
+{
+    TICK_WAIT_OK = 0,
+    TICK_WAIT_TIMEOUT = 1,
+} tick_wait_result;
+
+// Blocks until player.game_simulation_ticks advances.
+// The waiter sleeps through most of the update period (2.5 ms when the game
+// publishes every tick) and spins for the last part of it. The spin window grows when a sleep overshoots a tick and
+// shrinks when spinning takes longer than needed, so it settles on the
+// shortest window that still catches every tick.
+typedef struct
+{
+    const r3e_shared* source;
+
+    // Last tick returned and local time (us) it was first seen
+    r3e_int32 last_tick;
+    uint64_t last_tick_us;
+
+    // Average time between two advances
+    uint32_t period_us;
+
+    // How long before the expected tick we stop sleeping and start spinning
+    uint32_t spin_us;
+
+    // Number of tick advances seen
+    uint64_t ticks_seen;
+
+    // Number of ticks that went by unobserved between two advances
+    uint64_t ticks_missed;
+
+    // Number of times the tick went backwards (session restart, replay, etc.)
+    uint32_t resets;
+
+    // Number of sleeps that woke up after the tick had already advanced
+    uint32_t late_wakeups;
+} tick_waiter;
+
+void tick_waiter_init(tick_waiter* waiter, const r3e_shared* source);
+void tick_waiter_close(tick_waiter* waiter);
+
+// Waits for the next tick, or at most timeout_ms
+// missed receives the number of ticks skipped since the previous call (can be NULL)
+tick_wait_result tick_wait(tick_waiter* waiter, uint32_t timeout_ms, uint32_t* missed);
@@ -0,0 +1,560 @@
+#include "trackmap.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Deeper than the tree of the longest layout gets
+#define TRACKMAP_STACK 64
+
+#pragma pack(push, 1)
+
+typedef struct
+{
+    char magic[4];
+    uint32_t format_version;
+    r3e_int32 track_id;
+    r3e_int32 layout_id;
+    float layout_length;
+    uint32_t num_points;
+} trackmap_file_header;
+
+#pragma pack(pop)
+
+void trackmap_init(trackmap* map, const char* cache_dir)
+{
+    memset(map, 0, sizeof(*map));
+    map->track_id = -1;
+    map->layout_id = -1;
+
+    if (cache_dir)
+        snprintf(map->cache_dir, sizeof(map->cache_dir), "%s", cache_dir);
+}
+
+// Drops the map and the learning state, keeps the layout and the cache settings
+static void clear(trackmap* map)
+{
+    free(map->distance);
+    free(map->x);
+    free(map->y);
+    free(map->nodes);
+    free(map->bins);
+
+    map->distance = NULL;
+    map->x = NULL;
+    map->y = NULL;
+    map->nodes = NULL;
+    map->bins = NULL;
+    map->num_points = 0;
+    map->num_nodes = 0;
+    map->num_bins = 0;
+    map->laps = 0;
+    map->ready = FALSE;
+}
+
+void trackmap_close(trackmap* map)
+{
+    clear(map);
+    memset(map, 0, sizeof(*map));
+}
+
+void trackmap_path(const char* dir, r3e_int32 track_id, r3e_int32 layout_id, char* path, size_t size)
+{
+    snprintf(path, size, "%s/track_%d_%d.r3et", dir, track_id, layout_id);
+}
+
+static int alloc_points(trackmap* map, uint32_t count)
+{
+    map->distance = (float*)malloc(count * sizeof(float));
+    map->x = (float*)malloc(count * sizeof(float));
+    map->y = (float*)malloc(count * sizeof(float));
+
+    // A leaf per segment at most, and fewer inner nodes than leaves
+    map->nodes = (trackmap_node*)malloc(2 * count * sizeof(trackmap_node));
+
+    return map->distance == NULL || map->x == NULL || map->y == NULL || map->nodes == NULL;
+}
+
+// Builds the subtree over count segments starting at first, returns its index
+static uint32_t build_node(trackmap* map, uint32_t first, uint32_t count)
+{
+    uint32_t index = map->num_nodes++;
+    trackmap_node* node = &map->nodes[index];
+    uint32_t half, i;
+
+    node->min_x = node->max_x = map->x[first];
+    node->min_y = node->max_y = map->y[first];
+
+    for (i = first + 1; i <= first + count; ++i)
+    {
+        if (map->x[i] < node->min_x) node->min_x = map->x[i];
+        if (map->x[i] > node->max_x) node->max_x = map->x[i];
+        if (map->y[i] < node->min_y) node->min_y = map->y[i];
+        if (map->y[i] > node->max_y) node->max_y = map->y[i];
+    }
+
+    node->first = first;
+    node->count = count;
+    node->right = 0;
+
+    if (count <= TRACKMAP_LEAF_SEGMENTS)
+        return index;
+
+    half = count / 2;
+    build_node(map, first, half);
+    map->nodes[index].right = build_node(map, first + half, count - half);
+
+    return index;
+}
+
+static void build_index(trackmap* map)
+{
+    map->num_nodes = 0;
+    build_node(map, 0, map->num_points - 1);
+    map->ready = TRUE;
+}
+
+// Squared distance from x/y to the segment between a and b, t is where the nearest point is
+static float segment_distance2(float ax, float ay, float bx, float by, float x, float y, float* t)
+{
+    float dx = bx - ax, dy = by - ay;
+    float length2 = dx * dx + dy * dy;
+    float u = length2 > 0.f ? ((x - ax) * dx + (y - ay) * dy) / length2 : 0.f;
+
+    u = u < 0.f ? 0.f : u > 1.f ? 1.f : u;
+    *t = u;
+
+    dx = ax + u * dx - x;
+    dy = ay + u * dy - y;
+
+    return dx * dx + dy * dy;
+}
+
+// Fills the bins nothing landed in along a straight line between their filled neighbours
+static void fill_gaps(const trackmap_bin* bins, uint32_t count, double* x, double* y)
+{
+    uint32_t first, last, last_step, step, i, s, gap;
+
+    first = 0;
+    while (first < count && bins[first].count == 0)
+        first++;
+
+    last = first;
+    last_step = 0;
+
+    for (step = 1; step <= count; ++step)
+    {
+        i = (first + step) % count;
+        if (bins[i].count == 0)
+            continue;
+
+        gap = step - last_step;
+        for (s = 1; s < gap; ++s)
+        {
+            x[(last + s) % count] = x[last] + (x[i] - x[last]) * s / gap;
+            y[(last + s) % count] = y[last] + (y[i] - y[last]) * s / gap;
+        }
+
+        last = i;
+        last_step = step;
+    }
+}
+
+// Douglas-Peucker over points 0 - count - 1, marks the ones to keep. The error
+// of a point is measured to where interpolating by lap distance puts it, not
+// to the nearest point of the chord, so lap distances map to x/y as closely
+// as the shape does.
+static int simplify(const double* x, const double* y, uint32_t count, uint8_t* keep)
+{
+    uint32_t* stack = (uint32_t*)malloc(2 * count * sizeof(uint32_t));
+    uint32_t depth = 0, lo, hi, i, farthest;
+    double tolerance2 = TRACKMAP_TOLERANCE_M * TRACKMAP_TOLERANCE_M;
+    double t, dx, dy, distance2, farthest2;
+
+    if (stack == NULL)
+        return 1;
+
+    memset(keep, 0, count);
+    keep[0] = 1;
+    keep[count - 1] = 1;
+
+    stack[depth++] = 0;
+    stack[depth++] = count - 1;
+
+    while (depth > 0)
+    {
+        hi = stack[--depth];
+        lo = stack[--depth];
+        farthest = lo;
+        farthest2 = tolerance2;
+
+        for (i = lo + 1; i < hi; ++i)
+        {
+            t = (double)(i - lo) / (hi - lo);
+            dx = x[lo] + (x[hi] - x[lo]) * t - x[i];
+            dy = y[lo] + (y[hi] - y[lo]) * t - y[i];
+            distance2 = dx * dx + dy * dy;
+
+            if (distance2 > farthest2)
+            {
+                farthest = i;
+                farthest2 = distance2;
+            }
+        }
+
+        if (farthest == lo)
+            continue;
+
+        keep[farthest] = 1;
+        stack[depth++] = lo;
+        stack[depth++] = farthest;
+        stack[depth++] = farthest;
+        stack[depth++] = hi;
+    }
+
+    free(stack);
+
+    return 0;
+}
+
+// Averages the bins into points and keeps the ones simplify picks
+static int build_polyline(trackmap* map, double* x, double* y, uint8_t* keep)
+{
+    uint32_t n = map->num_bins, i, p = 0;
+
+    for (i = 0; i < n; ++i)
+    {
+        if (map->bins[i].count == 0)
+            continue;
+
+        x[i] = map->bins[i].x / map->bins[i].count;
+        y[i] = map->bins[i].y / map->bins[i].count;
+    }
+
+    fill_gaps(map->bins, n, x, y);
+
+    // Closed, the first bin again a lap later
+    x[n] = x[0];
+    y[n] = y[0];
+
+    if (simplify(x, y, n + 1, keep))
+        return 1;
+
+    for (i = 0; i <= n; ++i)
+        p += keep[i];
+
+    if (alloc_points(map, p))
+        return 1;
+
+    for (i = 0, p = 0; i <= n; ++i)
+    {
+        if (!keep[i])
+            continue;
+
+        map->distance[p] = (i + 0.5f) * map->bin_size;
+        map->x[p] = (float)x[i];
+        map->y[p] = (float)y[i];
+        p++;
+    }
+
+    map->num_points = p;
+    build_index(map);
+
+    return 0;
+}
+
+// Turns the bins into the map, returns 0 on success
+static int build(trackmap* map)
+{
+    double* x = (double*)malloc((map->num_bins + 1) * sizeof(double));
+    double* y = (double*)malloc((map->num_bins + 1) * sizeof(double));
+    uint8_t* keep = (uint8_t*)malloc(map->num_bins + 1);
+    int err_code = 1;
+
+    if (x && y && keep)
+        err_code = build_polyline(map, x, y, keep);
+
+    free(x);
+    free(y);
+    free(keep);
+
+    return err_code;
+}
+
+// Share of the bins anything landed in
+static double coverage(const trackmap* map)
+{
+    uint32_t filled = 0, i;
+
+    for (i = 0; i < map->num_bins; ++i)
+        filled += map->bins[i].count > 0;
+
+    return (double)filled / map->num_bins;
+}
+
+// Starts over on the frame's layout, from the cache if it has it
+static void start_layout(trackmap* map, const r3e_shared* frame)
+{
+    char path[300];
+
+    clear(map);
+
+    if (map->cache_dir[0])
+    {
+        trackmap_path(map->cache_dir, frame->track_id, frame->layout_id, path, sizeof(path));
+
+        if (trackmap_load(map, path) == 0 && map->track_id == frame->track_id &&
+            map->layout_id == frame->layout_id && map->layout_length == frame->layout_length)
+            return;
+
+        clear(map);
+    }
+
+    map->track_id = frame->track_id;
+    map->layout_id = frame->layout_id;
+    map->layout_length = frame->layout_length;
+    map->previous_distance = -1.f;
+
+    map->num_bins = (uint32_t)ceil(map->layout_length / TRACKMAP_BIN_M);
+    if (map->num_bins > TRACKMAP_BINS_MAX)
+        map->num_bins = TRACKMAP_BINS_MAX;
+    if (map->num_bins < 2)
+        map->num_bins = 2;
+
+    map->bin_size = map->layout_length / map->num_bins;
+    map->bins = (trackmap_bin*)calloc(map->num_bins, sizeof(trackmap_bin));
+}
+
+void trackmap_update(trackmap* map, const r3e_shared* frame)
+{
+    char path[300];
+    float distance = frame->lap_distance;
+    uint32_t bin;
+
+    if (frame->layout_length <= 0.f)
+        return;
+
+    if (frame->track_id != map->track_id || frame->layout_id != map->layout_id || frame->layout_length != map->layout_length)
+        start_layout(map, frame);
+
+    if (map->ready || map->bins == NULL)
+        return;
+
+    // The pit lane isn't the track, and lap_distance still counts along it
+    if (frame->game_paused || frame->in_pitlane || distance < 0.f || distance >= map->layout_length)
+        return;
+
+    // Crossed the line
+    if (map->previous_distance >= 0.f && distance < map->previous_distance - 0.5f * map->layout_length)
+    {
+        map->laps++;
+
+        if (map->laps >= TRACKMAP_LAPS_MIN && coverage(map) >= TRACKMAP_COVERAGE_MIN)
+        {
+            if (build(map))
+            {
+                clear(map);
+                return;
+            }
+
+            free(map->bins);
+            map->bins = NULL;
+
+            if (map->cache_dir[0])
+            {
+                trackmap_path(map->cache_dir, map->track_id, map->layout_id, path, sizeof(path));
+                if (trackmap_save(map, path))
+                    map->cache_errors++;
+            }
+
+            return;
+        }
+    }
+
+    map->previous_distance = distance;
+
+    bin = (uint32_t)(distance / map->bin_size);
+    if (bin >= map->num_bins)
+        bin = map->num_bins - 1;
+
+    map->bins[bin].x += frame->player.position.x;
+    map->bins[bin].y += frame->player.position.z;
+    map->bins[bin].count++;
+}
+
+void trackmap_project(const trackmap* map, float lap_distance, float* x, float* y)
+{
+    uint32_t lo = 0, hi, mid;
+    float first, offset, t;
+
+    if (!map->ready)
+    {
+        *x = 0.f;
+        *y = 0.f;
+        return;
+    }
+
+    // The polyline starts half a bin into the lap and ends a lap after that
+    first = map->distance[0];
+    offset = fmodf(lap_distance - first, map->layout_length);
+    if (offset < 0.f)
+        offset += map->layout_length;
+
+    lap_distance = first + offset;
+    hi = map->num_points - 1;
+
+    while (hi - lo > 1)
+    {
+        mid = (lo + hi) / 2;
+        if (map->distance[mid] <= lap_distance)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    t = (lap_distance - map->distance[lo]) / (map->distance[hi] - map->distance[lo]);
+    t = t < 0.f ? 0.f : t > 1.f ? 1.f : t;
+
+    *x = map->x[lo] + (map->x[hi] - map->x[lo]) * t;
+    *y = map->y[lo] + (map->y[hi] - map->y[lo]) * t;
+}
+
+// Squared distance from x/y to a node's box, 0 inside it
+static float box_distance2(const trackmap_node* node, float x, float y)
+{
+    float dx = node->min_x - x > 0.f ? node->min_x - x : x - node->max_x > 0.f ? x - node->max_x : 0.f;
+    float dy = node->min_y - y > 0.f ? node->min_y - y : y - node->max_y > 0.f ? y - node->max_y : 0.f;
+
+    return dx * dx + dy * dy;
+}
+
+int trackmap_nearest(const trackmap* map, float x, float y, trackmap_hit* hit)
+{
+    uint32_t stack[TRACKMAP_STACK];
+    uint32_t depth = 0, index, near_child, far_child, i;
+    const trackmap_node* node;
+    float best2 = -1.f, distance2, t;
+
+    if (!map->ready)
+        return 1;
+
+    stack[depth++] = 0;
+
+    while (depth > 0)
+    {
+        index = stack[--depth];
+        node = &map->nodes[index];
+
+        if (best2 >= 0.f && box_distance2(node, x, y) >= best2)
+            continue;
+
+        if (node->right == 0)
+        {
+            for (i = node->first; i < node->first + node->count; ++i)
+            {
+                distance2 = segment_distance2(map->x[i], map->y[i], map->x[i + 1], map->y[i + 1], x, y, &t);
+                if (best2 < 0.f || distance2 < best2)
+                {
+                    best2 = distance2;
+                    hit->segment = i;
+                    hit->t = t;
+                }
+            }
+            continue;
+        }
+
+        // The nearer child goes on top, so it's searched first and prunes the other
+        near_child = index + 1;
+        far_child = node->right;
+        if (box_distance2(&map->nodes[far_child], x, y) < box_distance2(&map->nodes[near_child], x, y))
+        {
+            near_child = node->right;
+            far_child = index + 1;
+        }
+
+        stack[depth++] = far_child;
+        stack[depth++] = near_child;
+    }
+
+    hit->distance = sqrtf(best2);
+    hit->lap_distance = map->distance[hit->segment] +
+        (map->distance[hit->segment + 1] - map->distance[hit->segment]) * hit->t;
+    if (hit->lap_distance >= map->layout_length)
+        hit->lap_distance -= map->layout_length;
+
+    return 0;
+}
+
+int trackmap_save(const trackmap* map, const char* path)
+{
+    trackmap_file_header header;
+    FILE* file;
+    int err_code;
+
+    if (!map->ready)
+        return 1;
+
+    memcpy(header.magic, TRACKMAP_MAGIC, sizeof(header.magic));
+    header.format_version = TRACKMAP_FORMAT_VERSION;
+    header.track_id = map->track_id;
+    header.layout_id = map->layout_id;
+    header.layout_length = map->layout_length;
+    header.num_points = map->num_points;
+
+    file = file_open(path, "wb");
+    if (file == NULL)
+        return 1;
+
+    err_code = fwrite(&header, sizeof(header), 1, file) != 1 ||
+        fwrite(map->distance, sizeof(float), map->num_points, file) != map->num_points ||
+        fwrite(map->x, sizeof(float), map->num_points, file) != map->num_points ||
+        fwrite(map->y, sizeof(float), map->num_points, file) != map->num_points;
+
+    return fclose(file) != 0 || err_code;
+}
+
+int trackmap_load(trackmap* map, const char* path)
+{
+    trackmap_file_header header;
+    FILE* file = file_open(path, "rb");
+    uint32_t i;
+    int err_code;
+
+    if (file == NULL)
+        return 1;
+
+    clear(map);
+
+    err_code = fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, TRACKMAP_MAGIC, sizeof(header.magic)) != 0 ||
+        header.format_version != TRACKMAP_FORMAT_VERSION ||
+        header.num_points < 2 || header.num_points > TRACKMAP_BINS_MAX + 1 || !(header.layout_length > 0.f);
+
+    if (!err_code)
+    {
+        err_code = alloc_points(map, header.num_points) ||
+            fread(map->distance, sizeof(float), header.num_points, file) != header.num_points ||
+            fread(map->x, sizeof(float), header.num_points, file) != header.num_points ||
+            fread(map->y, sizeof(float), header.num_points, file) != header.num_points;
+    }
+
+    fclose(file);
+
+    // The searches need distances going up
+    for (i = 1; !err_code && i < header.num_points; ++i)
+        err_code = !(map->distance[i] > map->distance[i - 1]);
+
+    if (err_code)
+    {
+        clear(map);
+        return 1;
+    }
+
+    map->track_id = header.track_id;
+    map->layout_id = header.layout_id;
+    map->layout_length = header.layout_length;
+    map->num_points = header.num_points;
+    build_index(map);
+
+    return 0;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "r3e.h"
+#include "platform.h"
+
+#define TRACKMAP_MAGIC "R3ET"
+#define TRACKMAP_FORMAT_VERSION 1
+
+// Positions are averaged per this much lap distance while learning (m)
+#define TRACKMAP_BIN_M 2.0f
+
+// ~32 km of layout
+#define TRACKMAP_BINS_MAX 16384
+
+// Laps to drive, and the share of the lap they have to cover, before the map is built
+#define TRACKMAP_LAPS_MIN 3
+#define TRACKMAP_COVERAGE_MIN 0.95
+
+// How far the simplified centerline may stray from the averaged positions (m)
+#define TRACKMAP_TOLERANCE_M 0.25f
+
+// Segments per leaf of the search tree
+#define TRACKMAP_LEAF_SEGMENTS 8
+
+// Bounding box of a subtree of segments. Children follow in preorder: the
+// left one at index + 1, the right one at right. Leaves have right == 0.
+typedef struct
+{
+    float min_x;
+    float min_y;
+    float max_x;
+    float max_y;
+
+    uint32_t first;
+    uint32_t count;
+    uint32_t right;
+} trackmap_node;
+
+// Nearest point of the centerline to a query position
+typedef struct
+{
+    // Segment from point segment to point segment + 1, and how far along it (0 - 1)
+    uint32_t segment;
+    float t;
+
+    // Distance from the query position (m)
+    float distance;
+
+    // Lap distance of the nearest point (m)
+    float lap_distance;
+} trackmap_hit;
+
+// Per bin sums while learning
+typedef struct
+{
+    double x;
+    double y;
+    uint32_t count;
+} trackmap_bin;
+
+// Centerline of the current layout, learned from the player's position and
+// lap_distance. While the player laps, positions are averaged per 2 m of lap
+// distance (pit lane excluded); after a few laps the averages are simplified
+// into a polyline of a few hundred points, which is what gets stored and
+// cached. Map coordinates are world x and z, y being up.
+//
+// lap_distance to x/y is a binary search over the points' lap distances, and
+// position to nearest segment walks a tree of segment bounding boxes, nearer
+// boxes first, so both are O(log n) per query instead of a scan of the points.
+//
+// With a cache directory, a map is loaded from it as soon as the layout is
+// known and written to it once learned, so each layout is only learned once.
+typedef struct
+{
+    r3e_int32 track_id;
+    r3e_int32 layout_id;
+    float layout_length;
+
+    BOOL ready;
+
+    // The polyline, closed: the last point is the first one again, a lap later
+    uint32_t num_points;
+    float* distance;
+    float* x;
+    float* y;
+
+    trackmap_node* nodes;
+    uint32_t num_nodes;
+
+    // Learning state, freed once the map is built
+    trackmap_bin* bins;
+    uint32_t num_bins;
+    float bin_size;
+    float previous_distance;
+    int laps;
+
+    char cache_dir[260];
+    uint64_t cache_errors;
+} trackmap;
+
+// cache_dir holds learned maps, NULL for none
+void trackmap_init(trackmap* map, const char* cache_dir);
+void trackmap_close(trackmap* map);
+
+// Call once per tick. Starts over when the layout changes, loading the layout's
+// map from the cache if there is one. map->ready tells when queries can be made
+void trackmap_update(trackmap* map, const r3e_shared* frame);
+
+// Map position of a lap distance, any car's (m)
+void trackmap_project(const trackmap* map, float lap_distance, float* x, float* y);
+
+// Nearest point of the centerline to x/y, returns 0 if the map is ready
+int trackmap_nearest(const trackmap* map, float x, float y, trackmap_hit* hit);
+
+// Cache file of a layout, "<dir>/track_<track_id>_<layout_id>.r3et"
+void trackmap_path(const char* dir, r3e_int32 track_id, r3e_int32 layout_id, char* path, size_t size);
+
+// Returns 0 on success
+int trackmap_save(const trackmap* map, const char* path);
+int trackmap_load(trackmap* map, const char* path);
@@ -1,7 +1,8 @@
 #include "utils.h"
 
+#ifdef _WIN32
+
 #include <TlHelp32.h>
-#include <tchar.h>
 
 BOOL is_process_running(const TCHAR* name)
 {
@@ -32,6 +33,57 @@ BOOL is_process_running(const TCHAR* name)
     return result;
 }
 
+#else
+
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+
+BOOL is_process_running(const TCHAR* name)
+{
+    BOOL result = FALSE;
+    DIR* proc = NULL;
+    struct dirent* entry = NULL;
+    char path[288];
+    char comm[256];
+    FILE* file = NULL;
+    size_t length = 0;
+
+    proc = opendir("/proc");
+    if (proc == NULL)
+        return FALSE;
+
+    while (!result && (entry = readdir(proc)) != NULL)
+    {
+        if (entry->d_name[0] < '0' || entry->d_name[0] > '9')
+            continue;
+
+        snprintf(path, sizeof(path), "/proc/%s/comm", entry->d_name);
+
+        file = fopen(path, "r");
+        if (file == NULL)
+            continue;
+
+        if (fgets(comm, sizeof(comm), file) != NULL)
+        {
+            length = strlen(comm);
+            if (length > 0 && comm[length - 1] == '\n')
+                comm[length - 1] = '\0';
+
+            // comm is cut off at 15 characters
+            result = strncmp(comm, name, 15) == 0;
+        }
+
+        fclose(file);
+    }
+
+    closedir(proc);
+
+    return result;
+}
+
+#endif
+
 BOOL is_r3e_running()
 {
     return is_process_running(TEXT("RRRE.exe")) || is_process_running(TEXT("RRRE64.exe"));
@@ -1,6 +1,6 @@
 #pragma once
 
-#include <Windows.h>
+#include "platform.h"
 
 #define CLOCKS_PER_MS (CLOCKS_PER_SEC / 1000)
 #define RPS_TO_RPM (60 / (2 * M_PI))
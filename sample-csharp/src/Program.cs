@@ -1,11 +1,8 @@
 ﻿using System;
 using System.Diagnostics;
 using System.IO;
-using System.IO.MemoryMappedFiles;
-using System.Runtime.InteropServices;
 using System.Threading;
 using System.Windows.Forms;
-using R3E.Data;
 
 namespace R3E
 {
@@ -13,19 +10,27 @@ namespace R3E
     {
         private bool Mapped 
         {
-            get { return (_file != null); }
+            get { return (_reader != null); }
         }
 
-        private Shared _data;
-        private MemoryMappedFile _file;
-        private byte[] _buffer;
+        private SharedReader _reader;
+        private byte[] _name = new byte[64];
+        private Int32 _gear;
+        private Single _engineRps;
+        private Single _carSpeed;
+
+        // Attempts at a consistent read before giving up until the next poll
+        private const int ReadRetries = 8;
 
         private readonly TimeSpan _timeAlive = TimeSpan.FromMinutes(10);
         private readonly TimeSpan _timeInterval = TimeSpan.FromMilliseconds(100);
 
         public void Dispose()
         {
-            _file.Dispose();
+            if (_reader != null)
+            {
+                _reader.Dispose();
+            }
         }
 
         public void Run()
@@ -60,8 +65,6 @@ namespace R3E
                     {
                         Console.WriteLine("Memory mapped successfully");
                         timeReset = DateTime.UtcNow;
-
-                        _buffer = new Byte[Marshal.SizeOf(typeof(Shared))];
                     }
                 }
 
@@ -78,7 +81,7 @@ namespace R3E
         {
             try
             {
-                _file = MemoryMappedFile.OpenExisting(Constant.SharedMemoryName);
+                _reader = new SharedReader(Constant.SharedMemoryName);
                 return true;
             }
             catch(FileNotFoundException)
@@ -87,40 +90,42 @@ namespace R3E
             }
         }
 
+        // Copies out only the fields printed, straight from the mapped view
         private bool Read()
         {
-            try
+            for (var attempt = 0; attempt < ReadRetries; ++attempt)
             {
-                var _view = _file.CreateViewStream();
-                BinaryReader _stream = new BinaryReader(_view);
-                _buffer = _stream.ReadBytes(Marshal.SizeOf(typeof(Shared)));
-                GCHandle _handle = GCHandle.Alloc(_buffer, GCHandleType.Pinned);
-                _data = (Shared)Marshal.PtrToStructure(_handle.AddrOfPinnedObject(), typeof(Shared));
-                _handle.Free();
+                var ticks = _reader.BeginRead();
 
-                return true;
-            }
-            catch(Exception)
-            {
-                return false;
+                _reader.ReadBytes(SharedOffset.PlayerName, _name, _name.Length);
+                _gear = _reader.ReadInt32(SharedOffset.Gear);
+                _engineRps = _reader.ReadSingle(SharedOffset.EngineRps);
+                _carSpeed = _reader.ReadSingle(SharedOffset.CarSpeed);
+
+                if (_reader.EndRead(ticks))
+                {
+                    return true;
+                }
             }
+
+            return false;
         }
 
         private void Print()
         {
             if (Read())
             {
-                Console.WriteLine("Name: {0}", System.Text.Encoding.UTF8.GetString(_data.PlayerName).TrimEnd('\0'));
+                Console.WriteLine("Name: {0}", System.Text.Encoding.UTF8.GetString(_name).TrimEnd('\0'));
 
-                if (_data.Gear >= -1)
+                if (_gear >= -1)
                 {
-                    Console.WriteLine("Gear: {0}", _data.Gear);
+                    Console.WriteLine("Gear: {0}", _gear);
                 }
 
-                if (_data.EngineRps > -1.0f)
+                if (_engineRps > -1.0f)
                 {
-                    Console.WriteLine("RPM: {0}", Utilities.RpsToRpm(_data.EngineRps));
-                    Console.WriteLine("Speed: {0}", Utilities.MpsToKph(_data.CarSpeed));
+                    Console.WriteLine("RPM: {0}", Utilities.RpsToRpm(_engineRps));
+                    Console.WriteLine("Speed: {0}", Utilities.MpsToKph(_carSpeed));
                 }
 
 
@@ -0,0 +1,199 @@
+﻿using System;
+using System.IO.MemoryMappedFiles;
+using System.Runtime.InteropServices;
+using System.Threading;
+using R3E.Data;
+
+namespace R3E
+{
+    // Byte offsets into the shared memory, worked out once from the struct layouts
+    static class SharedOffset
+    {
+        public static readonly int Player = Of(typeof(Shared), "Player");
+        public static readonly int GameSimulationTicks = Player + Of(typeof(PlayerData), "GameSimulationTicks");
+        public static readonly int GameSimulationTime = Player + Of(typeof(PlayerData), "GameSimulationTime");
+        public static readonly int Position = Player + Of(typeof(PlayerData), "Position");
+        public static readonly int LocalGforce = Player + Of(typeof(PlayerData), "LocalGforce");
+
+        public static readonly int VersionMajor = Of(typeof(Shared), "VersionMajor");
+        public static readonly int VersionMinor = Of(typeof(Shared), "VersionMinor");
+        public static readonly int PlayerName = Of(typeof(Shared), "PlayerName");
+        public static readonly int CarSpeed = Of(typeof(Shared), "CarSpeed");
+        public static readonly int EngineRps = Of(typeof(Shared), "EngineRps");
+        public static readonly int Gear = Of(typeof(Shared), "Gear");
+        public static readonly int Throttle = Of(typeof(Shared), "Throttle");
+        public static readonly int Brake = Of(typeof(Shared), "Brake");
+        public static readonly int FuelLeft = Of(typeof(Shared), "FuelLeft");
+        public static readonly int TireWear = Of(typeof(Shared), "TireWear");
+        public static readonly int TirePressure = Of(typeof(Shared), "TirePressure");
+        public static readonly int TireTemp = Of(typeof(Shared), "TireTemp");
+        public static readonly int BrakeTemp = Of(typeof(Shared), "BrakeTemp");
+        public static readonly int NumCars = Of(typeof(Shared), "NumCars");
+        public static readonly int AllDriversData = Of(typeof(Shared), "DriverData");
+
+        public static readonly int SharedSize = Marshal.SizeOf(typeof(Shared));
+        public static readonly int DriverDataSize = Marshal.SizeOf(typeof(DriverData));
+
+        // Offsets into one DriverData record, see SharedReader.DriverOffset
+        public static class Driver
+        {
+            public static readonly int SlotId = Of(typeof(DriverData), "DriverInfo") + Of(typeof(DriverInfo), "SlotId");
+            public static readonly int Place = Of(typeof(DriverData), "Place");
+            public static readonly int LapDistance = Of(typeof(DriverData), "LapDistance");
+            public static readonly int CompletedLaps = Of(typeof(DriverData), "CompletedLaps");
+            public static readonly int InPitlane = Of(typeof(DriverData), "InPitlane");
+            public static readonly int CarSpeed = Of(typeof(DriverData), "CarSpeed");
+        }
+
+        private static int Of(Type type, string field)
+        {
+            return Marshal.OffsetOf(type, field).ToInt32();
+        }
+    }
+
+    // Reads the shared memory in place through one view kept open for the
+    // lifetime of the reader. Nothing is allocated per read: fields are read
+    // through a pointer into the view and sub-structures are copied into
+    // values or arrays the caller owns. Reading the whole Shared struct with
+    // Marshal.PtrToStructure allocates every array in it, use this instead
+    // when polling at high rates.
+    //
+    // The game doesn't lock the memory while writing it. Read the tick with
+    // BeginRead, read the fields and check EndRead, if it returns false the
+    // game moved on while reading and the values may come from two ticks.
+    unsafe class SharedReader : IDisposable
+    {
+        private MemoryMappedFile _file;
+        private MemoryMappedViewAccessor _view;
+        private byte* _base;
+
+        // Throws FileNotFoundException when the memory doesn't exist (yet)
+        public SharedReader(string name)
+        {
+            _file = MemoryMappedFile.OpenExisting(name, MemoryMappedFileRights.Read);
+            _view = _file.CreateViewAccessor(0, SharedOffset.SharedSize, MemoryMappedFileAccess.Read);
+            _view.SafeMemoryMappedViewHandle.AcquirePointer(ref _base);
+        }
+
+        public void Dispose()
+        {
+            if (_base != null)
+            {
+                _view.SafeMemoryMappedViewHandle.ReleasePointer();
+                _base = null;
+            }
+
+            _view.Dispose();
+            _file.Dispose();
+        }
+
+        public Int32 Ticks
+        {
+            get { return Thread.VolatileRead(ref *(Int32*)(_base + SharedOffset.GameSimulationTicks)); }
+        }
+
+        public Int32 BeginRead()
+        {
+            var ticks = Ticks;
+            Thread.MemoryBarrier();
+            return ticks;
+        }
+
+        // True if the tick is still the one BeginRead returned
+        public bool EndRead(Int32 ticks)
+        {
+            Thread.MemoryBarrier();
+            return Ticks == ticks;
+        }
+
+        public Int32 ReadInt32(int offset)
+        {
+            return *(Int32*)(_base + offset);
+        }
+
+        public Single ReadSingle(int offset)
+        {
+            return *(Single*)(_base + offset);
+        }
+
+        public Double ReadDouble(int offset)
+        {
+            return *(Double*)(_base + offset);
+        }
+
+        public void Read(int offset, out Vector3<Single> value)
+        {
+            var p = (Single*)(_base + offset);
+            value.X = p[0];
+            value.Y = p[1];
+            value.Z = p[2];
+        }
+
+        public void Read(int offset, out Vector3<Double> value)
+        {
+            var p = (Double*)(_base + offset);
+            value.X = p[0];
+            value.Y = p[1];
+            value.Z = p[2];
+        }
+
+        public void Read(int offset, out TireData<Single> value)
+        {
+            var p = (Single*)(_base + offset);
+            value.FrontLeft = p[0];
+            value.FrontRight = p[1];
+            value.RearLeft = p[2];
+            value.RearRight = p[3];
+        }
+
+        public void Read(int offset, out TireData<TireTempInformation> value)
+        {
+            var size = sizeof(Single) * 6;
+            Read(offset, out value.FrontLeft);
+            Read(offset + size, out value.FrontRight);
+            Read(offset + size * 2, out value.RearLeft);
+            Read(offset + size * 3, out value.RearRight);
+        }
+
+        public void Read(int offset, out TireData<BrakeTemp> value)
+        {
+            var size = sizeof(Single) * 4;
+            Read(offset, out value.FrontLeft);
+            Read(offset + size, out value.FrontRight);
+            Read(offset + size * 2, out value.RearLeft);
+            Read(offset + size * 3, out value.RearRight);
+        }
+
+        public void Read(int offset, out TireTempInformation value)
+        {
+            var p = (Single*)(_base + offset);
+            value.CurrentTemp.Left = p[0];
+            value.CurrentTemp.Center = p[1];
+            value.CurrentTemp.Right = p[2];
+            value.OptimalTemp = p[3];
+            value.ColdTemp = p[4];
+            value.HotTemp = p[5];
+        }
+
+        public void Read(int offset, out BrakeTemp value)
+        {
+            var p = (Single*)(_base + offset);
+            value.CurrentTemp = p[0];
+            value.OptimalTemp = p[1];
+            value.ColdTemp = p[2];
+            value.HotTemp = p[3];
+        }
+
+        // Copies count bytes into dest, e.g. a UTF-8 name into a buffer kept between reads
+        public void ReadBytes(int offset, byte[] dest, int count)
+        {
+            Marshal.Copy(new IntPtr(_base + offset), dest, 0, count);
+        }
+
+        // Start of DriverData record index, add a SharedOffset.Driver offset to read a field of it
+        public int DriverOffset(int index)
+        {
+            return SharedOffset.AllDriversData + index * SharedOffset.DriverDataSize;
+        }
+    }
+}